@@ -16,14 +16,13 @@
 #define MAX_CHANNELS_PER_FX 24    // Pokrije 19ch moving heade in segmentirane naprave
 #define MAX_RANGES_PER_CH    6    // Pokrije OFL importe; grupiraj če > 6
 #define MAX_GROUPS           8
-#define MAX_STATE_SNAPSHOTS  3    // Zmanjšano iz 5 — prihranek ~1KB
-#define MAX_SCENES          20
 #define MAX_SCENE_NAME_LEN  24
 #define MAX_CUES            40
 #define MAX_CONFIGS          8    // Shranjene konfiguracije na LittleFS
 #define CROSSFADE_MIN_MS    0      // Takojšen
 #define CROSSFADE_MAX_MS    10000  // 10 sekund
 #define CROSSFADE_DEFAULT_MS 1500  // 1.5 sekunde
+#define CUE_DELAY_MAX_MS    60000  // Zamik časovne skupine cue-ja
 #define DMX_MAX_CHANNELS   512
 
 // Persona vmesniki (LittleFS)
@@ -88,6 +87,31 @@
 #define HAS_PSRAM           0
 #endif
 
+// Univerze: 0 = nodeCfg.universe (DMX port + efekti), 1.. = nodeCfg.universe+u
+// samo omrežni izhodi. Dodatne univerze so v PSRAM, zato brez PSRAM samo ena.
+#if HAS_PSRAM
+#define MAX_UNIVERSES       4
+#else
+#define MAX_UNIVERSES       1
+#endif
+
+// Banka scen: indeks 32 B na slot + LRU cache razpakiranih scen (537 B vsaka),
+// oboje v PSRAM; brez PSRAM manj slotov in majhen cache v DRAM
+#if HAS_PSRAM
+#define MAX_SCENES          512
+#define SCENE_CACHE_LINES   64
+#else
+#define MAX_SCENES          64
+#define SCENE_CACHE_LINES   8
+#endif
+
+// Hkratni playbacki/submasterji (seznami kanalov so v PSRAM, 2 KB na playback)
+#if HAS_PSRAM
+#define MAX_PLAYBACKS       16
+#else
+#define MAX_PLAYBACKS       8
+#endif
+
 // Sound-to-light (HAS_PSRAM mora biti definiran prej!)
 #if HAS_PSRAM
 #define FFT_SAMPLES        1024    // Boljša frekvenčna ločljivost s PSRAM (~10.7 Hz/bin)
@@ -118,17 +142,27 @@
 //  DMX KONSTANTE
 // ============================================================================
 #define DMX_BAUD         250000
-#define DMX_BREAK_BAUD    96000
+#define DMX_BREAK_US        176   // Break (min 92µs po E1.11)
+#define DMX_MAB_US           16   // Mark-after-break (min 12µs)
+#define DMX_SLOT_US          44   // 1 start + 8 data + 2 stop bita pri 250 kbaud
+#define DMX_MIN_PACKET_US  1204   // E1.11: min. čas break → break (~830 fps)
+#define DMX_FIXED_INTERVAL_US 25000  // Fiksni način: 40 fps
+
+// Osveževanje DMX izhoda
+enum DmxRefreshMode : uint8_t {
+  DMX_REFRESH_FIXED    = 0,  // 40 fps, vedno channelCount slotov
+  DMX_REFRESH_ADAPTIVE = 1   // Sloti do najvišjega patchanega naslova, fps iz časa na žici
+};
 
 // ============================================================================
 //  ENUMI
 // ============================================================================
 
-// Način krmiljenja
+// Način krmiljenja — izpeljan iz spajanja virov (MergeEngine), za UI in LED
 enum ControlMode : uint8_t {
-  CTRL_ARTNET        = 0,  // ArtNet je aktiven, prejema pakete
-  CTRL_LOCAL_AUTO    = 1,  // Ni ArtNet-a Xs, samodejni preklop
-  CTRL_LOCAL_MANUAL  = 2,  // Uporabnik ročno preklopil
+  CTRL_ARTNET        = 0,  // ArtNet sodeluje v spajanju (sam ali skupaj z lokalnim)
+  CTRL_LOCAL_AUTO    = 1,  // Ni ArtNet-a (nikoli ali po timeoutu)
+  CTRL_LOCAL_MANUAL  = 2,  // Uporabnik ročno pripel lokalni vir
   CTRL_LOCAL_PRIMARY = 3   // Manualna mešalka ima prednost; ArtNet se ignorira dokler operator ne dovoli
 };
 
@@ -175,6 +209,7 @@ struct ChannelDef {
   char name[20];
   uint8_t type;           // ChannelType
   uint8_t defaultValue;
+  bool fine;              // 16-bit LSB prejšnjega kanala ("fine": true; pan_fine/tilt_fine po tipu)
   uint8_t rangeCount;
   ChannelRange ranges[MAX_RANGES_PER_CH];
 };
@@ -208,6 +243,7 @@ struct PatchEntry {
   uint8_t panMax;         // Zgornja meja Pan (0-255, privzeto 255)
   uint8_t tiltMin;        // Spodnja meja Tilt (0-255, privzeto 0)
   uint8_t tiltMax;        // Zgornja meja Tilt (0-255, privzeto 255)
+  uint8_t universe;       // 0 = primarna univerza, u = nodeCfg.universe + u
 };
 
 struct GroupDef {
@@ -230,28 +266,89 @@ struct StateSnapshot {
 //  STRUKTURE — Scene
 // ============================================================================
 
+// Scena, prevedena skozi trenutni patch (shranjena je kot zapisi fixture-ov,
+// glej scene_bank.h). Kanali, ki jih scena ne določa, so v dmx 0.
+#define SCENE_FULL  0x01        // Ob priklicu gredo nedoločeni kanali na 0 (sicer ostanejo)
+
 struct Scene {
   char name[MAX_SCENE_NAME_LEN];
   uint8_t dmx[DMX_MAX_CHANNELS];
+  uint32_t defined[DMX_MAX_CHANNELS / 32];   // Bit = scena določa naslov
+  uint16_t definedCount;
+  uint8_t flags;                             // SCENE_FULL
   bool valid;
 };
 
+inline bool sceneDefines(const Scene& sc, int addr) {
+  return sc.defined[addr >> 5] & (1UL << (addr & 31));
+}
+
+// Kanal crossfade-a, ki se dejansko spremeni (seznam zgradi startCrossfade)
+#define XF_ADDR_MASK   0x01FF
+#define XF_LINEAR      0x0000
+#define XF_SNAP        0x4000             // Gobo/prism/shutter...: cilj na polovici fada
+#define XF_PAIR16      0x8000             // Coarse 16-bit para; naslednji vnos je fine
+#define XF_MODE_MASK   0xC000
+#define XF_GROUP_SHIFT 9                  // Časovna skupina (CueTimingGroup) v bitih 9-11
+#define XF_GROUP_MASK  0x0E00
+
+// Časovne skupine cue-ja (split fade). Skupina kanala se določi ob GO iz
+// tipa kanala v PatchMap-u; intenziteta še po smeri (gor/dol).
+enum CueTimingGroup : uint8_t {
+  CUE_TG_BASE = 0,        // Ostali kanali (generic, speed, macro...) — fadeMs cue-ja
+  CUE_TG_INT_UP = 1,
+  CUE_TG_INT_DOWN = 2,
+  CUE_TG_POSITION = 3,    // Pan/tilt
+  CUE_TG_COLOR = 4,       // RGBWAUV, lime, cyan, CCT
+  CUE_TG_BEAM = 5,        // Gobo, prism, shutter, strobe, focus, zoom
+  CUE_TG_COUNT
+};
+
+#define CUE_TIME_INHERIT 0xFFFF           // Fade skupine = fadeMs cue-ja
+
+struct CueTiming {
+  uint16_t fadeMs;                        // CUE_TIME_INHERIT = fadeMs cue-ja
+  uint16_t delayMs;                       // Zamik od GO
+};
+
+struct XfadeEntry {
+  uint16_t addrMode;                     // Naslov (0-511) | XF_*
+  uint8_t  from;
+  uint8_t  to;
+};
+
 // Crossfade stanje
 struct CrossfadeState {
   bool     active;
-  uint8_t  fromDmx[DMX_MAX_CHANNELS];  // Izhodišče
-  uint8_t  toDmx[DMX_MAX_CHANNELS];    // Cilj
-  uint32_t durationMs;                   // Trajanje crossfade-a
-  uint32_t startTime;                    // millis() ob začetku
+  XfadeEntry* entries;                   // PSRAM, do DMX_MAX_CHANNELS vnosov (ob koncu se zapiše .to)
+  uint16_t entryCount;
+  uint32_t durationMs;                   // Celoten čas (najdaljši zamik + fade skupine)
+  uint32_t groupDelayUs[CUE_TG_COUNT];   // Okno vsake časovne skupine
+  uint32_t groupFadeUs[CUE_TG_COUNT];
+  uint64_t elapsedUs;                    // Vsota dt iz frame clock-a (monotono)
+  uint8_t  curve;                        // FadeCurve — alpha skozi LUT enkrat na frame
   int      targetSceneIdx;               // Katera scena je cilj (-1 = ročno)
 };
 
+// Krivulja fade-a (fade_curve.h) — per cue in per prehod
+enum FadeCurve : uint8_t {
+  FADE_LINEAR = 0,
+  FADE_SCURVE = 1,        // Mehak začetek in konec
+  FADE_EASE_IN = 2,
+  FADE_EASE_OUT = 3,
+  FADE_LOG = 4,           // Intenziteta: hiter začetek
+  FADE_PERCEPTUAL = 5,    // Dimmer: enakomerna zaznana svetlost (CIE L*)
+  FADE_CURVE_COUNT
+};
+
 // Cue List vnos
 struct CueEntry {
-  int8_t   sceneSlot;                   // Scene slot (0-19), -1 = invalid
+  int16_t  sceneSlot;                   // Scene slot (0..MAX_SCENES-1), -1 = invalid
   uint16_t fadeMs;                      // Per-cue fade time (0-10000)
   uint16_t autoFollowMs;               // 0 = manual, >0 = auto-advance delay po fade koncu
   char     label[MAX_SCENE_NAME_LEN];  // Override label
+  uint8_t  curve;                       // FadeCurve
+  CueTiming timing[CUE_TG_COUNT];       // Split časi; [CUE_TG_BASE].fadeMs se ne uporablja
 };
 
 // ============================================================================
@@ -417,6 +514,19 @@ static const ManualBeatConfig MANUAL_BEAT_DEFAULTS = {
    {GROUP_BEAT_INHERIT,GROUP_BEAT_INHERIT,GROUP_BEAT_INHERIT}}
 };
 
+// Beat ura (SoundEngine → kvantizacija ukazov): pozicija ob vzorcu + tempo,
+// bralec ekstrapolira na svoj čas
+#define BEATS_PER_BAR  4
+
+struct BeatClock {
+  bool     valid;          // false = ni vira beata (ukazi se ne kvantizirajo)
+  uint32_t beatCount;      // Beati od začetka vira
+  float    phase;          // 0.0-1.0 znotraj trenutnega beata
+  uint32_t sampleUs;       // micros() ob vzorcu
+  uint32_t intervalUs;     // Trajanje beata
+  int8_t   barBeat;        // Beat v taktu ob vzorcu (0-3, Link), -1 = takt od začetka števca
+};
+
 // Easy mode nastavitve
 struct STLEasyConfig {
   bool     enabled;
@@ -535,6 +645,9 @@ struct PixelMapConfig {
 
 #define MAX_WIFI_APS 5
 
+#define MERGE_PRIORITY_DEFAULT  100                      // Prioriteta vira (kot sACN)
+#define MERGE_HTP_DEFAULT       (1UL << CH_INTENSITY)    // HTP samo intensity, ostalo LTP
+
 struct WifiAP {
   char ssid[33];
   char password[65];
@@ -564,9 +677,23 @@ struct NodeConfig {
   uint16_t artnetTimeoutSec;  // Po koliko sekundah brez ArtNet-a preklopi na LOCAL_AUTO (privzeto 10)
   bool artnetPrimaryMode;     // true = CTRL_LOCAL_PRIMARY ob zagonu (manualna mešalka ima prednost)
 
+  // Spajanje virov (HTP/LTP)
+  uint8_t artnetPriority;     // 0-200; sodelujejo samo aktivni viri z najvišjo prioriteto
+  uint8_t localPriority;
+  uint8_t oscPriority;
+  uint16_t oscTimeoutSec;     // 0 = OSC vir ne poteče
+  uint32_t htpTypeMask;       // bit = ChannelType, ki se spaja HTP (ostali LTP)
+
   // Omrežni protokoli izhod
   bool artnetOutEnabled;      // Oddajaj DMX kot ArtNet broadcast
   bool sacnEnabled;           // Oddajaj DMX kot sACN (E1.31) multicast
+
+  // DMX osveževanje
+  uint8_t dmxRefreshMode;     // DmxRefreshMode
+  uint16_t dmxMaxFps;         // Zgornja meja v adaptivnem načinu (0 = do E1.11 minimuma)
+
+  // Kvantizirani ukazi (beat/takt)
+  uint16_t launchLatencyMs;   // Zakasnitev za izmerjenim izhodom (fixture, omrežje) — ukaz se sproži toliko prej
 };
 
 // Privzete vrednosti
@@ -585,8 +712,16 @@ static const NodeConfig DEFAULT_CONFIG = {
   "",              // authPass (prazno = brez gesla)
   10,              // artnetTimeoutSec
   false,           // artnetPrimaryMode
+  MERGE_PRIORITY_DEFAULT, // artnetPriority
+  MERGE_PRIORITY_DEFAULT, // localPriority
+  MERGE_PRIORITY_DEFAULT, // oscPriority
+  0,               // oscTimeoutSec
+  MERGE_HTP_DEFAULT, // htpTypeMask
   false,           // artnetOutEnabled
-  false            // sacnEnabled
+  false,           // sacnEnabled
+  DMX_REFRESH_FIXED, // dmxRefreshMode
+  0,               // dmxMaxFps
+  0                // launchLatencyMs
 };
 
 // ============================================================================
@@ -599,6 +734,7 @@ static const NodeConfig DEFAULT_CONFIG = {
 #define PATH_PROFILES_DIR "/profiles"
 #define PATH_CONFIGS_DIR  "/configs"
 #define PATH_SOUND_CFG    "/sound.bin"
+#define PATH_PLAYBACKS    "/playbacks.json"
 
 // ============================================================================
 //  PSRAM HELPER
@@ -4,6 +4,7 @@
 #include "config.h"
 #include <ArduinoJson.h>
 #include <LittleFS.h>
+#include "persist.h"
 
 // ============================================================================
 //  NodeConfig
@@ -51,8 +52,20 @@ inline bool configLoad(NodeConfig &cfg) {
   // ArtNet vedenje
   cfg.artnetTimeoutSec = doc["artnetTimeoutSec"] | (uint16_t)10;
   cfg.artnetPrimaryMode = doc["artnetPrimaryMode"] | false;
+
+  // Spajanje virov
+  cfg.artnetPriority = doc["artnetPriority"] | (uint8_t)MERGE_PRIORITY_DEFAULT;
+  cfg.localPriority  = doc["localPriority"]  | (uint8_t)MERGE_PRIORITY_DEFAULT;
+  cfg.oscPriority    = doc["oscPriority"]    | (uint8_t)MERGE_PRIORITY_DEFAULT;
+  cfg.oscTimeoutSec  = doc["oscTimeoutSec"]  | (uint16_t)0;
+  cfg.htpTypeMask    = doc["htpTypeMask"]    | (uint32_t)MERGE_HTP_DEFAULT;
   cfg.artnetOutEnabled = doc["artnetOutEnabled"] | false;
   cfg.sacnEnabled = doc["sacnEnabled"] | false;
+
+  // DMX osveževanje
+  cfg.dmxRefreshMode = doc["dmxRefreshMode"] | (uint8_t)DMX_REFRESH_FIXED;
+  cfg.dmxMaxFps = doc["dmxMaxFps"] | (uint16_t)0;
+  cfg.launchLatencyMs = doc["launchLatencyMs"] | (uint16_t)0;
   return true;
 }
 
@@ -80,8 +93,16 @@ inline bool configSave(const NodeConfig &cfg) {
   doc["authPass"]         = cfg.authPass;
   doc["artnetTimeoutSec"] = cfg.artnetTimeoutSec;
   doc["artnetPrimaryMode"]= cfg.artnetPrimaryMode;
+  doc["artnetPriority"]   = cfg.artnetPriority;
+  doc["localPriority"]    = cfg.localPriority;
+  doc["oscPriority"]      = cfg.oscPriority;
+  doc["oscTimeoutSec"]    = cfg.oscTimeoutSec;
+  doc["htpTypeMask"]      = cfg.htpTypeMask;
   doc["artnetOutEnabled"] = cfg.artnetOutEnabled;
   doc["sacnEnabled"]      = cfg.sacnEnabled;
+  doc["dmxRefreshMode"]   = cfg.dmxRefreshMode;
+  doc["dmxMaxFps"]        = cfg.dmxMaxFps;
+  doc["launchLatencyMs"]  = cfg.launchLatencyMs;
 
   File f = LittleFS.open(PATH_CONFIG, "w");
   if (!f) return false;
@@ -90,6 +111,15 @@ inline bool configSave(const NodeConfig &cfg) {
   return true;
 }
 
+// JSON → kopija v PSRAM → persist task (klicoč task ne čaka na flash)
+inline bool jsonPersist(const char* path, const JsonDocument& doc) {
+  size_t n = measureJson(doc);
+  uint8_t* buf = (uint8_t*)psramPreferMalloc(n + 1);
+  if (!buf) return false;
+  serializeJson(doc, (char*)buf, n + 1);
+  return persistWriteOwned(path, buf, n);
+}
+
 // ============================================================================
 //  Patch
 // ============================================================================
@@ -118,6 +148,7 @@ inline bool patchLoad(PatchEntry* entries, int maxEntries) {
     entries[i].panMax        = obj["panMax"]         | 255;
     entries[i].tiltMin       = obj["tiltMin"]        | 0;
     entries[i].tiltMax       = obj["tiltMax"]        | 255;
+    entries[i].universe      = obj["universe"]       | 0;
     entries[i].active        = true;
     entries[i].profileIndex  = -1;  // Reši se ob nalaganju profilov
     i++;
@@ -142,12 +173,9 @@ inline bool patchSave(const PatchEntry* entries, int maxEntries) {
     if (entries[i].panMax < 255) obj["panMax"]     = entries[i].panMax;
     if (entries[i].tiltMin > 0)  obj["tiltMin"]    = entries[i].tiltMin;
     if (entries[i].tiltMax < 255)obj["tiltMax"]     = entries[i].tiltMax;
+    if (entries[i].universe > 0) obj["universe"]   = entries[i].universe;
   }
-  File f = LittleFS.open(PATH_PATCH, "w");
-  if (!f) return false;
-  serializeJson(doc, f);
-  f.close();
-  return true;
+  return jsonPersist(PATH_PATCH, doc);
 }
 
 // ============================================================================
@@ -185,11 +213,7 @@ inline bool groupsSave(const GroupDef* groups, int maxGroups) {
     JsonObject obj = arr.add<JsonObject>();
     obj["name"] = groups[i].name;
   }
-  File f = LittleFS.open(PATH_GROUPS, "w");
-  if (!f) return false;
-  serializeJson(doc, f);
-  f.close();
-  return true;
+  return jsonPersist(PATH_GROUPS, doc);
 }
 
 #endif // CONFIG_STORE_H
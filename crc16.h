@@ -0,0 +1,17 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-16/CCITT-FALSE za zapise na flash-u (kratki zapisi, zato brez tabele).
+// Veriženje: crc16(b, nb, crc16(a, na)) == crc16(a||b).
+inline uint16_t crc16(const uint8_t* p, size_t n, uint16_t crc = 0xFFFF) {
+  while (n--) {
+    crc ^= (uint16_t)(*p++) << 8;
+    for (int b = 0; b < 8; b++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef CUE_SCHEDULER_H
+#define CUE_SCHEDULER_H
+
+#include <stdint.h>
+
+// ============================================================================
+//  CueScheduler — časi cue liste na show uri
+//
+//  Show ura je vsota dt frame clock-a (isti čas kot crossfade), zato
+//  auto-follow teče brez brskalnika in z izhodom. Rok je absoluten: naslednji
+//  cue = rok prejšnjega + fade + zamik, ne trenutek, ko ga je frame opazil —
+//  zamuda frame-a se ne sešteva. Kar frame zamudi čez rok (< perioda), dobi
+//  novi crossfade kot že pretečen čas (pod-frame natančnost).
+// ============================================================================
+
+class CueScheduler {
+public:
+  void advance(uint32_t dtUs) { _nowUs += dtUs; }
+  uint64_t nowUs() const { return _nowUs; }
+
+  void arm(uint64_t dueUs) { _dueUs = dueUs; _armed = true; }
+  void disarm() { _armed = false; }
+  bool armed() const { return _armed; }
+  uint64_t dueUs() const { return _dueUs; }
+
+  // true = rok je dosežen (razoroži); lateUs = show ura − rok
+  bool poll(uint32_t& lateUs) {
+    if (!_armed || _nowUs < _dueUs) return false;
+    _armed = false;
+    lateUs = (uint32_t)(_nowUs - _dueUs);
+    return true;
+  }
+
+private:
+  uint64_t _nowUs = 0;
+  uint64_t _dueUs = 0;
+  bool     _armed = false;
+};
+
+#endif
@@ -16,31 +16,35 @@ bool DmxOutput::begin(int txPin, int rxPin, int dePin, uart_port_t port) {
 
   if (uart_param_config(_port, &cfg) != ESP_OK) return false;
   if (uart_set_pin(_port, txPin, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK) return false;
+  // TX ring > 513 B → uart_write_bytes() samo kopira, ISR prazni FIFO
   if (uart_driver_install(_port, 1024, 1024, 0, NULL, 0) != ESP_OK) return false;
 
+  _events = xEventGroupCreate();
+  if (!_events) return false;
+
+  esp_timer_create_args_t targs = {};
+  targs.callback = &DmxOutput::timerCb;
+  targs.arg = this;
+  targs.dispatch_method = ESP_TIMER_TASK;
+  targs.name = "dmx_tx";
+  if (esp_timer_create(&targs, &_timer) != ESP_OK) return false;
+
+  _tx.begin(this);
+  _tx.setDoneCallback(&DmxOutput::frameDoneCb, this);
+
   _ok = true;
-  Serial.printf("[DMX] TX pripravljen: UART%d, TX=GPIO%d, DE=GPIO%d\n", _port, txPin, _dePin);
+  Serial.printf("[DMX] TX pripravljen: UART%d, TX=GPIO%d, DE=GPIO%d (async, break %dus, MAB %dus)\n",
+                _port, txPin, _dePin, DMX_BREAK_US, DMX_MAB_US);
   return true;
 }
 
-void DmxOutput::sendBreak() {
-  // Pošlji 0x00 pri 96kHz → 9 bitov LOW (~93.7µs break) + 2 bita HIGH (~20.8µs MAB)
-  uart_wait_tx_done(_port, pdMS_TO_TICKS(50));
-  uart_set_baudrate(_port, DMX_BREAK_BAUD);
-  const uint8_t brk = 0x00;
-  uart_write_bytes(_port, (const char*)&brk, 1);
-  uart_wait_tx_done(_port, pdMS_TO_TICKS(10));
-  uart_set_baudrate(_port, DMX_BAUD);
-}
+// ============================================================================
+//  NEBLOKIRAJOČ VMESNIK
+// ============================================================================
 
 void DmxOutput::sendFrame(const uint8_t* data, uint16_t channels) {
   if (!_ok) return;
-  if (channels > DMX_MAX_CHANNELS) channels = DMX_MAX_CHANNELS;
-
-  sendBreak();
-  const uint8_t startCode = 0x00;
-  uart_write_bytes(_port, (const char*)&startCode, 1);
-  uart_write_bytes(_port, (const char*)data, channels);
+  _tx.submit(data, channels);
 }
 
 void DmxOutput::blackout() {
@@ -50,9 +54,58 @@ void DmxOutput::blackout() {
   sendFrame(zeros, DMX_MAX_CHANNELS);
 }
 
+bool DmxOutput::waitFrameDone(uint32_t timeoutMs) {
+  if (!_ok) return false;
+  EventBits_t bits = xEventGroupWaitBits(_events, DMX_EVT_FRAME_DONE, pdTRUE, pdFALSE,
+                                         pdMS_TO_TICKS(timeoutMs));
+  return (bits & DMX_EVT_FRAME_DONE) != 0;
+}
+
 void DmxOutput::end() {
   if (!_ok) return;
+  // Počakaj, da se trenutni frame odda do konca (max ~23ms)
+  for (int i = 0; i < 5 && _tx.isBusy(); i++) waitFrameDone(10);
+  esp_timer_stop(_timer);
+  esp_timer_delete(_timer);
+  _timer = nullptr;
+  uart_set_line_inverse(_port, UART_SIGNAL_INV_DISABLE);
   if (_dePin >= 0) digitalWrite(_dePin, LOW);
   uart_driver_delete(_port);
+  vEventGroupDelete(_events);
+  _events = nullptr;
   _ok = false;
 }
+
+// ============================================================================
+//  HAL — UART + esp_timer
+//  Break: invertiran TX v mirovanju = linija LOW. Brez menjave baud rate-a
+//  in brez uart_wait_tx_done() v loop().
+// ============================================================================
+
+void DmxOutput::txSetBreak(bool on) {
+  uart_set_line_inverse(_port, on ? UART_SIGNAL_TXD_INV : UART_SIGNAL_INV_DISABLE);
+}
+
+void DmxOutput::txWrite(const uint8_t* data, uint16_t len) {
+  uart_write_bytes(_port, (const char*)data, len);
+}
+
+bool DmxOutput::txDone() {
+  return uart_wait_tx_done(_port, 0) == ESP_OK;
+}
+
+void DmxOutput::txArmTimer(uint32_t us) {
+  esp_timer_start_once(_timer, us ? us : 1);
+}
+
+uint32_t DmxOutput::txNowUs() {
+  return (uint32_t)esp_timer_get_time();
+}
+
+void DmxOutput::timerCb(void* arg) {
+  static_cast<DmxOutput*>(arg)->_tx.onTimer();
+}
+
+void DmxOutput::frameDoneCb(void* ctx) {
+  xEventGroupSetBits(static_cast<DmxOutput*>(ctx)->_events, DMX_EVT_FRAME_DONE);
+}
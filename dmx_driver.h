@@ -3,20 +3,48 @@
 
 #include <Arduino.h>
 #include "driver/uart.h"
+#include "esp_timer.h"
+#include "freertos/event_groups.h"
 #include "config.h"
+#include "dmx_tx.h"
 
-class DmxOutput {
+#define DMX_EVT_FRAME_DONE  (1 << 0)   // Zadnji bit frame-a je na žici
+
+// ============================================================================
+//  DMX izhod — UART + esp_timer za DmxTxMachine
+//  sendFrame() kopira in vrne takoj; break/MAB/konec frame-a vodi timer.
+// ============================================================================
+
+class DmxOutput : public DmxUartHal {
 public:
   bool begin(int txPin, int rxPin, int dePin, uart_port_t port = DMX_UART_PORT);
   void sendFrame(const uint8_t* data, uint16_t channels);
   void blackout();
   void end();
 
+  bool waitFrameDone(uint32_t timeoutMs);   // Čaka DMX_EVT_FRAME_DONE
+  bool isBusy() const { return _tx.isBusy(); }
+  void setPeriodUs(uint32_t us) { _tx.setPeriodUs(us); }   // 0 = frame ob sendFrame()
+  void getStats(DmxTxStats& out) const { _tx.getStats(out); }
+  EventGroupHandle_t getEvents() const { return _events; }
+
+  // DmxUartHal
+  void     txSetBreak(bool on) override;
+  void     txWrite(const uint8_t* data, uint16_t len) override;
+  bool     txDone() override;
+  void     txArmTimer(uint32_t us) override;
+  uint32_t txNowUs() override;
+
 private:
   uart_port_t _port = DMX_UART_PORT;
   int _dePin = -1;
   bool _ok = false;
-  void sendBreak();
+  DmxTxMachine _tx;
+  esp_timer_handle_t _timer = nullptr;
+  EventGroupHandle_t _events = nullptr;
+
+  static void timerCb(void* arg);
+  static void frameDoneCb(void* ctx);
 };
 
 #endif
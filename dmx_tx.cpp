@@ -0,0 +1,173 @@
+#include "dmx_tx.h"
+#include <math.h>
+
+uint32_t dmxFrameIntervalUs(uint16_t slots, uint16_t maxFps) {
+  if (slots > DMX_MAX_CHANNELS) slots = DMX_MAX_CHANNELS;
+  uint32_t us = DMX_BREAK_US + DMX_MAB_US + (uint32_t)(slots + 1) * DMX_SLOT_US;
+  if (us < DMX_MIN_PACKET_US) us = DMX_MIN_PACKET_US;
+  if (maxFps > 0 && us < 1000000UL / maxFps) us = 1000000UL / maxFps;
+  return us;
+}
+
+void DmxTxMachine::begin(DmxUartHal* hal) {
+  _hal = hal;
+  memset(_buf, 0, sizeof(_buf));
+  _len[0] = _len[1] = _len[2] = 0;
+  _back = 0; _front = 1; _ready.store(2);
+  _state.store(DMXTX_IDLE);
+  _frames.store(0);
+  _periodUs.store(0);
+  _dropped = 0;
+  _haveLastStart = false;
+  _winStartUs = hal ? hal->txNowUs() : 0;
+  _winFrames = _winIntervals = 0;
+  _winSum = _winSumSq = 0;
+  _stats = {};
+}
+
+// ============================================================================
+//  PRODUCENT (loop, core 1)
+// ============================================================================
+
+void DmxTxMachine::submit(const uint8_t* data, uint16_t channels) {
+  if (!_hal) return;
+  if (channels > DMX_MAX_CHANNELS) channels = DMX_MAX_CHANNELS;
+
+  uint8_t* b = _buf[_back];
+  b[0] = 0x00;                          // Start code
+  memcpy(b + 1, data, channels);
+  _len[_back] = channels + 1;
+
+  uint8_t prev = _ready.exchange(_back | FRESH);
+  if (prev & FRESH) _dropped++;         // Prejšnji še ni šel na žico
+  _back = prev & 0x03;
+
+  kickIfReady();
+}
+
+void DmxTxMachine::setPeriodUs(uint32_t us) {
+  _periodUs.store(us);
+  // Ob vklopu začni takoj z zadnjim frame-om, tudi če ni novega
+  if (us && _hal && _len[_front]) {
+    uint8_t expected = DMXTX_IDLE;
+    if (_state.compare_exchange_strong(expected, DMXTX_START)) _hal->txArmTimer(0);
+  }
+}
+
+// Avtomat miruje in čaka frame → sproži timer (edini prehod iz IDLE izven onTimer)
+void DmxTxMachine::kickIfReady() {
+  if (!(_ready.load() & FRESH)) return;
+  uint8_t expected = DMXTX_IDLE;
+  if (_state.compare_exchange_strong(expected, DMXTX_START)) _hal->txArmTimer(0);
+}
+
+// ============================================================================
+//  AVTOMAT (timer kontekst)
+// ============================================================================
+
+void DmxTxMachine::onTimer() {
+  if (!_hal) return;
+  switch (_state.load()) {
+    case DMXTX_START:
+      if (!startFrame()) { _state.store(DMXTX_IDLE); kickIfReady(); }
+      break;
+
+    case DMXTX_BREAK:
+      _hal->txSetBreak(false);
+      _state.store(DMXTX_MAB);
+      _hal->txArmTimer(DMX_MAB_US);
+      break;
+
+    case DMXTX_MAB:
+      _hal->txWrite(_buf[_front], _len[_front]);
+      _state.store(DMXTX_DATA);
+      _hal->txArmTimer((uint32_t)_len[_front] * DMX_SLOT_US);
+      break;
+
+    case DMXTX_DATA:
+      // Timer je pričakovan konec; UART FIFO se lahko še prazni
+      if (!_hal->txDone()) { _hal->txArmTimer(DMX_SLOT_US); break; }
+      finishFrame();
+      if (uint32_t period = _periodUs.load()) {
+        uint32_t elapsed = _hal->txNowUs() - _frameStartUs;
+        if (elapsed < period) {
+          _state.store(DMXTX_GAP);
+          _hal->txArmTimer(period - elapsed);
+          break;
+        }
+      }
+      if (!startFrame()) { _state.store(DMXTX_IDLE); kickIfReady(); }
+      break;
+
+    case DMXTX_GAP:
+      if (!startFrame()) { _state.store(DMXTX_IDLE); kickIfReady(); }
+      break;
+
+    default:
+      break;
+  }
+}
+
+bool DmxTxMachine::startFrame() {
+  if (_ready.load() & FRESH) {
+    uint8_t prev = _ready.exchange(_front);
+    _front = prev & 0x03;
+  } else if (!_periodUs.load() || !_len[_front]) {
+    return false;                       // Na zahtevo: ni novega frame-a
+  }                                     // Neprekinjeno: ponovi zadnjega
+
+  uint32_t now = _hal->txNowUs();
+  noteFrameStart(now);
+  _frameStartUs = now;
+  _hal->txSetBreak(true);
+  _state.store(DMXTX_BREAK);
+  _hal->txArmTimer(DMX_BREAK_US);
+  return true;
+}
+
+void DmxTxMachine::finishFrame() {
+  _stats.frameUs = _hal->txNowUs() - _frameStartUs;
+  _frames.fetch_add(1);
+  if (_doneCb) _doneCb(_doneCtx);
+}
+
+// ============================================================================
+//  STATISTIKA — osvežitev in jitter v 1s oknih
+// ============================================================================
+
+void DmxTxMachine::noteFrameStart(uint32_t now) {
+  if (_haveLastStart) {
+    uint32_t iv = now - _lastStartUs;
+    if (_winIntervals == 0 || iv < _winMinUs) _winMinUs = iv;
+    if (_winIntervals == 0 || iv > _winMaxUs) _winMaxUs = iv;
+    _winSum += iv;
+    _winSumSq += (double)iv * iv;
+    _winIntervals++;
+  }
+  _lastStartUs = now;
+  _haveLastStart = true;
+  _winFrames++;
+
+  uint32_t elapsed = now - _winStartUs;
+  if (elapsed >= 1000000UL) {
+    _stats.refreshHz = _winFrames * 1e6f / elapsed;
+    if (_winIntervals) {
+      double mean = _winSum / _winIntervals;
+      double var = _winSumSq / _winIntervals - mean * mean;
+      _stats.intervalUs = (float)mean;
+      _stats.jitterUs = var > 0 ? (float)sqrt(var) : 0.0f;
+      double devHi = _winMaxUs - mean, devLo = mean - _winMinUs;
+      _stats.maxDevUs = (uint32_t)(devHi > devLo ? devHi : devLo);
+    }
+    _winStartUs = now;
+    _winFrames = _winIntervals = 0;
+    _winSum = _winSumSq = 0;
+  }
+}
+
+// Kopija brez locka: med zapisom okna je lahko ena vrednost iz prejšnjega okna
+void DmxTxMachine::getStats(DmxTxStats& out) const {
+  out = _stats;
+  out.frames = _frames.load();
+  out.dropped = _dropped;
+}
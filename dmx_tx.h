@@ -0,0 +1,105 @@
+#ifndef DMX_TX_H
+#define DMX_TX_H
+
+// ============================================================================
+//  DMX TX — neblokirajoč oddajnik (stanje: IDLE → BREAK → MAB → DATA → IDLE)
+//
+//  submit() samo kopira frame v trojni buffer in vrne takoj; korake izvaja
+//  onTimer(), ki ga kliče enkraten timer iz HAL-a (ESP32: esp_timer).
+//  Break/MAB = TX linija LOW/HIGH za DMX_BREAK_US/DMX_MAB_US, nato 513 bajtov
+//  v UART ring buffer; konec frame-a = timer po času na žici + txDone().
+//  Strojni dostop je za DmxUartHal, zato se isti avtomat testira na hostu.
+//
+//  Perioda 0 = frame ob vsakem submit() (loop tempo). Perioda > 0 = neprekinjeno
+//  osveževanje: naslednji frame (nov ali ponovljen) začne periodUs po prejšnjem.
+// ============================================================================
+
+#include "config.h"
+#include <atomic>
+
+// Strojni vmesnik: ESP32 UART v dmx_driver.cpp, simuliran UART v host/bench_dmx_tx.cpp
+class DmxUartHal {
+public:
+  virtual void     txSetBreak(bool on) = 0;                       // true = linija LOW
+  virtual void     txWrite(const uint8_t* data, uint16_t len) = 0; // Neblokirajoče (ring/FIFO)
+  virtual bool     txDone() = 0;                                  // Zadnji stop bit oddan
+  virtual void     txArmTimer(uint32_t us) = 0;                   // Enkraten → onTimer()
+  virtual uint32_t txNowUs() = 0;
+};
+
+enum DmxTxState : uint8_t {
+  DMXTX_IDLE  = 0,
+  DMXTX_START = 1,   // submit() je sprožil timer, frame se začne ob naslednjem onTimer()
+  DMXTX_BREAK = 2,
+  DMXTX_MAB   = 3,
+  DMXTX_DATA  = 4,
+  DMXTX_GAP   = 5    // Neprekinjeno osveževanje: čaka na začetek naslednje periode
+};
+
+// Najkrajši interval frame-a za dano število slotov: čas na žici, E1.11
+// minimum (DMX_MIN_PACKET_US) in operaterjeva omejitev maxFps (0 = brez)
+uint32_t dmxFrameIntervalUs(uint16_t slots, uint16_t maxFps);
+
+struct DmxTxStats {
+  uint32_t frames;        // Vsi oddani frame-i
+  uint32_t dropped;       // Prepisani pred oddajo (novejši frame zmaga)
+  float    refreshHz;     // Zadnje zaključeno 1s okno
+  float    intervalUs;    // Povprečen interval med začetki frame-ov (break)
+  float    jitterUs;      // Standardni odklon intervala
+  uint32_t maxDevUs;      // Največji odklon intervala od povprečja
+  uint32_t frameUs;       // Trajanje zadnjega frame-a (break → zadnji bit)
+};
+
+typedef void (*DmxTxDoneCallback)(void* ctx);
+
+class DmxTxMachine {
+public:
+  void begin(DmxUartHal* hal);
+  void submit(const uint8_t* data, uint16_t channels);   // Iz loop(), ne blokira
+  void onTimer();                                         // Iz timer konteksta
+  void setDoneCallback(DmxTxDoneCallback cb, void* ctx) { _doneCb = cb; _doneCtx = ctx; }
+  void setPeriodUs(uint32_t us);                          // 0 = samo ob submit()
+  uint32_t getPeriodUs() const { return _periodUs.load(); }
+
+  bool isBusy() const { return _state.load() != DMXTX_IDLE; }
+  uint8_t getState() const { return _state.load(); }
+  uint32_t getFrameCount() const { return _frames.load(); }
+  void getStats(DmxTxStats& out) const;
+
+private:
+  DmxUartHal* _hal = nullptr;
+
+  // Trojni buffer: submit() piše v _back, avtomat oddaja _front, _ready je izmenjava
+  static const uint8_t FRESH = 0x80;
+  uint8_t _buf[3][DMX_UNIVERSE_SIZE];     // [0] = start code
+  uint16_t _len[3] = {0, 0, 0};
+  uint8_t _back = 0;
+  uint8_t _front = 1;
+  std::atomic<uint8_t> _ready{2};
+
+  std::atomic<uint8_t> _state{DMXTX_IDLE};
+  std::atomic<uint32_t> _frames{0};
+  std::atomic<uint32_t> _periodUs{0};
+  uint32_t _dropped = 0;
+
+  DmxTxDoneCallback _doneCb = nullptr;
+  void* _doneCtx = nullptr;
+
+  // Statistika (piše samo timer kontekst)
+  uint32_t _frameStartUs = 0;
+  uint32_t _lastStartUs = 0;
+  bool     _haveLastStart = false;
+  uint32_t _winStartUs = 0;
+  uint32_t _winFrames = 0;
+  uint32_t _winMinUs = 0, _winMaxUs = 0;
+  double   _winSum = 0, _winSumSq = 0;
+  uint32_t _winIntervals = 0;
+  DmxTxStats _stats = {};
+
+  bool startFrame();            // false = ni novega frame-a
+  void finishFrame();
+  void kickIfReady();
+  void noteFrameStart(uint32_t now);
+};
+
+#endif
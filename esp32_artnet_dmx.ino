@@ -63,9 +63,15 @@
 #include "osc_server.h"
 #include "lfo_engine.h"
 #include "shape_engine.h"
+#include "playback_engine.h"
+#include "launch_queue.h"
 #include "sacn_output.h"
 #include "pixel_mapper.h"
 #include "espnow_dmx.h"
+#include "metrics.h"
+#include "frame_clock.h"
+#include "persist.h"
+#include <esp_timer.h>
 
 // ============================================================================
 //  GLOBALNI OBJEKTI
@@ -86,6 +92,8 @@ WiFiUDP        pollReplyUdp;   // Za ArtPollReply broadcast
 OscServer      oscServer;
 LfoEngine      lfoEngine;
 ShapeGenerator shapeGen;
+PlaybackEngine playbacks;
+LaunchQueue    launchQueue;
 SacnOutput     sacnOut;
 #if defined(CONFIG_IDF_TARGET_ESP32S3)
 PixelMapper    pixelMap;
@@ -96,9 +104,17 @@ EspNowDmx      espNowDmx;
 static DNSServer dnsServer;
 static bool apModeActive = false;
 
-// DMX output timing
-static unsigned long lastDmxSend = 0;
-const unsigned long  DMX_INTERVAL_US = 25000;  // 40 fps DMX izhod
+// Frame clock — esp_timer tick → frame task (vhod → mixer → objava → izhodi)
+FrameClock     frameClock;
+static esp_timer_handle_t frameTimer = nullptr;
+static TaskHandle_t frameTaskHandle = nullptr;
+#define ARTNET_DRAIN_MAX  16                    // Največ ArtNet paketov na frame
+#define OSC_DRAIN_MAX     16                    // Največ OSC paketov na frame
+
+static DmxFrame outFrame;                       // Objavljen frame za vse izhode
+static DmxFrame* uniFrame = nullptr;            // Dodatne univerze (PSRAM, ob prvi uporabi)
+static uint16_t dmxSlots = 512;                 // Št. slotov na žici (adaptivno: do najvišjega naslova)
+static uint32_t dmxPatchGen = 0xFFFFFFFF;       // Generacija PatchMap-a, za katero velja dmxSlots
 
 // LED blink
 static unsigned long lastLedUpdate = 0;
@@ -116,8 +132,11 @@ const unsigned long  POLL_REPLY_INTERVAL = 5000;  // Vsake 5s
 static RTC_NOINIT_ATTR uint32_t wdtResetCount;  // Preživi soft-reset (v RTC memory)
 static bool safeMode = false;
 
-// Forward declaration za dual-core task
+// Forward declaration za taske
 void auxTask(void* param);
+void frameTask(void* param);
+static void frameTimerCb(void*);
+static void launchExec(const LaunchItem& it, void*);
 
 #include <ESPmDNS.h>
 
@@ -206,8 +225,10 @@ void wifiSetup() {
 // ============================================================================
 
 void onArtNetDmx(uint16_t universe, uint16_t length, uint8_t sequence, uint8_t* data) {
-  if (universe == nodeCfg.universe) {
-    mixer.onArtNetData(data, length);
+  // nodeCfg.universe + u → univerza u mixerja (nepatchane mixer zavrže)
+  uint16_t u = universe - nodeCfg.universe;
+  if (universe >= nodeCfg.universe && u < MAX_UNIVERSES) {
+    mixer.onArtNetData((uint8_t)u, data, length);
   }
 }
 
@@ -217,11 +238,10 @@ void onArtNetDmx(uint16_t universe, uint16_t length, uint8_t sequence, uint8_t*
 
 static uint8_t artnetOutSeq = 0;
 
-void sendArtNetOut() {
+void sendArtNetOut(const uint8_t* dmxData, uint16_t universe) {
   if (!nodeCfg.artnetOutEnabled) return;
   if (mixer.getMode() == CTRL_ARTNET) return;  // Prepreči feedback loop
 
-  const uint8_t* dmxData = mixer.getDmxOutput();
   uint16_t dmxLen = nodeCfg.channelCount;
   if (dmxLen > 512) dmxLen = 512;
   if (dmxLen & 1) dmxLen++;  // ArtDmx zahteva sodo dolžino
@@ -234,8 +254,8 @@ void sendArtNetOut() {
   packet[10] = 0x00; packet[11] = 0x0e; // Protocol version 14 big-endian
   packet[12] = ++artnetOutSeq;           // Sequence
   packet[13] = 0;                        // Physical port
-  packet[14] = nodeCfg.universe & 0xFF;  // Universe little-endian
-  packet[15] = (nodeCfg.universe >> 8) & 0xFF;
+  packet[14] = universe & 0xFF;          // Universe little-endian
+  packet[15] = (universe >> 8) & 0xFF;
   packet[16] = (dmxLen >> 8) & 0xFF;    // Length big-endian
   packet[17] = dmxLen & 0xFF;
   memcpy(packet + 18, dmxData, dmxLen);
@@ -445,6 +465,9 @@ void setup() {
     Serial.println("[WDT] === SAFE MODE === Po več crashih zaganjam brez zvoka/FFT");
   }
 
+  // Metrike realtime zanke (/api/metrics)
+  metricsBegin();
+
   // LED
   ledBegin();
   ledSet(safeMode ? LED_RED : LED_BLUE);
@@ -460,6 +483,8 @@ void setup() {
   }
   Serial.printf("[SYS] LittleFS: %d KB used / %d KB total\n",
                 LittleFS.usedBytes() / 1024, LittleFS.totalBytes() / 1024);
+  // Do zagona persist taska se zapisi izvedejo sinhrono
+  persistBegin();
 
   // Privzeti profili (zapišejo se ob prvem zagonu)
   installDefaultProfiles();
@@ -478,19 +503,24 @@ void setup() {
   // Fixture engine
   fixtures.begin();
 
-  // Scene engine
-  scenes.begin();
+  // Scene engine (patch pred begin: preselitev starih scen jih zapiše po fixture-ih)
   scenes.setFixtureEngine(&fixtures);
+  scenes.begin();
 
   // Mixer
   mixer.begin(&fixtures, &scenes);
   mixer.setArtNetTimeout(nodeCfg.artnetTimeoutSec * 1000UL);
+  mixer.setSourceTimeout(MERGE_SRC_OSC, nodeCfg.oscTimeoutSec * 1000UL);
+  mixer.setSourcePriority(MERGE_SRC_ARTNET, nodeCfg.artnetPriority);
+  mixer.setSourcePriority(MERGE_SRC_LOCAL, nodeCfg.localPriority);
+  mixer.setSourcePriority(MERGE_SRC_OSC, nodeCfg.oscPriority);
+  mixer.setHtpMask(nodeCfg.htpTypeMask);
   if (nodeCfg.artnetPrimaryMode) mixer.switchToPrimaryLocal();
 
   // Sound engine (preskoči v safe mode)
   if (!safeMode) {
     soundEng.begin(&audioIn, &fixtures);
-    mixer.setSoundEngine(&soundEng);
+    mixer.addStage(&soundEng, STAGE_ORDER_SOUND, STAGE_BUDGET_SOUND, MET_MIX_SOUND);
 
     // Audio vhod (če je konfiguriran)
     if (nodeCfg.audioSource > 0) {
@@ -515,16 +545,26 @@ void setup() {
 
   // LFO engine
   lfoEngine.begin(&fixtures);
-  mixer.setLfoEngine(&lfoEngine);
+  mixer.addStage(&lfoEngine, STAGE_ORDER_LFO, STAGE_BUDGET_LFO, MET_MIX_LFO);
 
   // LFO engine → web UI
   webSetLfoEngine(&lfoEngine);
 
   // Shape generator
   shapeGen.begin(&fixtures);
-  mixer.setShapeGenerator(&shapeGen);
+  mixer.addStage(&shapeGen, STAGE_ORDER_SHAPE, STAGE_BUDGET_SHAPE, MET_MIX_SHAPE);
   webSetShapeGenerator(&shapeGen);
 
+  // Playbacki / submasterji (HTP/LTP nad ročnimi vrednostmi)
+  playbacks.begin(&fixtures, &scenes, &mixer);
+  mixer.addStage(&playbacks, STAGE_ORDER_PLAYBACK, STAGE_BUDGET_PLAYBACK, MET_MIX_PLAYBACK);
+  webSetPlaybackEngine(&playbacks);
+
+  // Kvantizirani ukazi (beat/takt) — izvede frame task
+  launchQueue.begin(launchExec, nullptr);
+  launchQueue.setExtraLatencyUs((uint32_t)nodeCfg.launchLatencyMs * 1000);
+  webSetLaunchQueue(&launchQueue);
+
   // sACN (E1.31) output
   if (nodeCfg.sacnEnabled) {
     sacnOut.begin(nodeCfg.universe);
@@ -539,6 +579,8 @@ void setup() {
   // ESP-NOW wireless DMX
   espNowDmx.begin();
   webSetEspNow(&espNowDmx);
+  webSetDmxOutput(&dmxOut);
+  webSetFrameClock(&frameClock);
 
   // OSC server
   oscServer.begin(&mixer, &fixtures);
@@ -561,6 +603,22 @@ void setup() {
   esp_task_wdt_reconfigure(&wdtCfg);
   esp_task_wdt_add(NULL);  // Dodaj loopTask (core 1)
 
+  // --- Frame task na core 1 (nad loopTask), takt iz periodičnega esp_timer-ja ---
+  xTaskCreatePinnedToCore(frameTask, "FRAME", HAS_PSRAM ? 8192 : 6144, NULL, 3, &frameTaskHandle, 1);
+  frameClock.begin(FRAME_PERIOD_US, (uint32_t)esp_timer_get_time());
+  esp_timer_create_args_t targs = {};
+  targs.callback = &frameTimerCb;
+  targs.dispatch_method = ESP_TIMER_TASK;
+  targs.name = "frame";
+  if (esp_timer_create(&targs, &frameTimer) == ESP_OK) {
+    esp_timer_start_periodic(frameTimer, FRAME_PERIOD_US);
+  } else {
+    Serial.println("[SYS] NAPAKA: frame timer ni ustvarjen!");
+  }
+
+  // --- Persist task na core 0: vsi zapisi v LittleFS (pod AUX, da FFT ne čaka na flash) ---
+  persistStartTask(0, 1);
+
   // --- Ustvari pomožni task na core 0 ---
   xTaskCreatePinnedToCore(
     auxTask,       // Funkcija
@@ -572,63 +630,196 @@ void setup() {
     0              // Core 0 (deli z WiFi)
   );
 
-  Serial.printf("[SYS] Dual-core: DMX+Web na core 1, Sound+LED na core 0%s\n",
-                safeMode ? " (SAFE MODE)" : "");
+  Serial.printf("[SYS] Dual-core: DMX frame (%lu us) + Web na core 1, Sound+LED+LittleFS na core 0%s\n",
+                (unsigned long)FRAME_PERIOD_US, safeMode ? " (SAFE MODE)" : "");
   Serial.printf("[SYS] Prosti heap: %d B, min: %d B\n",
                 esp_get_free_heap_size(), esp_get_minimum_free_heap_size());
   Serial.println("[SYS] Inicializacija končana. Pripravljen.\n");
 }
 
 // ============================================================================
-//  CORE 1: DMX REALTIME LOOP (Arduino loop() — visoka prioriteta)
-//  ArtNet branje → Mixer update → DMX output
-//  Mora biti hitro in deterministično (< 2ms/iteracijo)
+//  DMX OSVEŽEVANJE
+//  Fiksno: en frame na tick frame clock-a (40 fps), channelCount slotov.
+//  Adaptivno: sloti do najvišjega patchanega naslova, TX avtomat osvežuje
+//  neprekinjeno s periodo iz časa na žici (E1.11 min 1204µs, ~830 fps max).
 // ============================================================================
 
-void loop() {
-  // Watchdog feed
-  esp_task_wdt_reset();
-
-  // Captive portal DNS (AP način)
-  if (apModeActive) dnsServer.processNextRequest();
+// ============================================================================
+//  KVANTIZIRANI UKAZI — izvedba na frame tasku pod mixer lockom
+// ============================================================================
 
-  // ArtNet — branje UDP paketov
-  artnet.read();
+static void launchExec(const LaunchItem& it, void*) {
+  switch (it.action) {
+    case LA_SCENE:      mixer.recallScene(it.arg, it.fadeMs, it.curve); break;
+    case LA_CUE_GO:     scenes.cueGo(&mixer); break;
+    case LA_CUE_GOTO:   scenes.cueGoTo(it.arg, &mixer); break;
+    case LA_PROGRAM:    soundEng.setProgram((uint8_t)it.arg); break;
+    case LA_CHAIN:      soundEng.startChain(it.arg != 0); break;
+    case LA_PB_GO:      playbacks.go(it.arg, it.fadeMs); break;
+    case LA_PB_RELEASE: playbacks.release(it.arg, it.fadeMs); break;
+    default: break;
+  }
+}
 
-  // OSC — branje UDP paketov
-  oscServer.update();
+static void updateDmxRefresh() {
+  uint32_t gen = fixtures.getPatchGeneration();
+  if (gen == dmxPatchGen) return;
+  dmxPatchGen = gen;
+
+  uint16_t slots = nodeCfg.channelCount;
+  if (slots < 1 || slots > DMX_MAX_CHANNELS) slots = DMX_MAX_CHANNELS;
+  if (nodeCfg.dmxRefreshMode != DMX_REFRESH_ADAPTIVE) {
+    dmxSlots = slots;
+    dmxOut.setPeriodUs(0);
+    return;
+  }
+  const PatchMap* pm = fixtures.getPatchMap();
+  if (pm && pm->highestAddr > 0 && pm->highestAddr < slots) slots = pm->highestAddr;
+  uint32_t period = dmxFrameIntervalUs(slots, nodeCfg.dmxMaxFps);
+  dmxSlots = slots;
+  dmxOut.setPeriodUs(period);
+  Serial.printf("[DMX] Adaptivno: %d slotov, perioda %lu us (%.0f fps)\n",
+                slots, (unsigned long)period, 1e6f / period);
+}
 
-  // Mixer update — timeout logika, sestavi izhod (+ sound overlay)
-  mixer.update();
+// ============================================================================
+//  DODATNE UNIVERZE — ArtNet/sACN/ESP-NOW za univerze 1..MAX_UNIVERSES-1
+// ============================================================================
 
-  // DMX output — pošlji okvir s konstantnim intervalom
-  unsigned long now = micros();
-  if (now - lastDmxSend >= DMX_INTERVAL_US) {
-    lastDmxSend = now;
-    dmxOut.sendFrame(mixer.getDmxOutput(), nodeCfg.channelCount);
-    sendArtNetOut();
+static void sendUniverseOutputs() {
+  uint8_t mask = mixer.getUniverseMask() & ~1;
+  if (!mask) return;
+  if (!uniFrame) {
+    uniFrame = (DmxFrame*)psramPreferMalloc(sizeof(DmxFrame));
+    if (!uniFrame) return;
+  }
+  for (int u = 1; u < MAX_UNIVERSES; u++) {
+    if (!(mask & (1 << u)) || !mixer.readFrame(u, *uniFrame)) continue;
+    METRIC_BEGIN(MET_ARTNET_OUT);
+    sendArtNetOut(uniFrame->data, nodeCfg.universe + u);
+    METRIC_END(MET_ARTNET_OUT);
     if (nodeCfg.sacnEnabled && mixer.getMode() != CTRL_ARTNET) {
-      sacnOut.sendFrame(mixer.getDmxOutput(), nodeCfg.channelCount);
+      METRIC_BEGIN(MET_SACN_OUT);
+      sacnOut.sendFrame(uniFrame->data, nodeCfg.channelCount, nodeCfg.universe + u);
+      METRIC_END(MET_SACN_OUT);
     }
-    // ESP-NOW wireless DMX
     if (espNowDmx.isEnabled()) {
-      espNowDmx.sendFrame(mixer.getDmxOutput(), nodeCfg.channelCount);
+      METRIC_BEGIN(MET_ESPNOW_OUT);
+      espNowDmx.sendFrame(uniFrame->data, nodeCfg.channelCount, u);
+      METRIC_END(MET_ESPNOW_OUT);
     }
-    // Pixel Mapper — preslikaj DMX na WS2812 LED trak
-    #if defined(CONFIG_IDF_TARGET_ESP32S3)
-    if (pixelMap.isActive()) {
-      static float lastPixMs = 0;
-      float nowMs = millis();
-      float dt = (nowMs - lastPixMs) / 1000.0f;
-      lastPixMs = nowMs;
-      if (dt <= 0 || dt > 1.0f) dt = 0.025f;
-      pixelMap.update(mixer.getDmxOutput(), &fixtures, &soundEng, dt);
-    }
-    #endif
   }
+}
+
+// ============================================================================
+//  CORE 1: FRAME TASK (takt iz frame clock-a — visoka prioriteta)
+//  Natanko enkrat na tick: ArtNet/OSC vhod → mixer → objava → vsi izhodi.
+//  Zamujen tick se ne nadoknadi z dodatnimi frame-i; dt ga vsebuje.
+// ============================================================================
+
+// esp_timer task: tick + zbudi frame task (delo je v frameTask)
+static void frameTimerCb(void*) {
+  frameClock.onTick((uint32_t)esp_timer_get_time());
+  if (frameTaskHandle) xTaskNotifyGive(frameTaskHandle);
+}
+
+static void runFrame(float dt) {
+  METRIC_BEGIN(MET_FRAME_TOTAL);
+  uint32_t frameStartUs = (uint32_t)esp_timer_get_time();
+
+  // Vhod — izprazni čakajoče UDP pakete
+  METRIC_BEGIN(MET_ARTNET_READ);
+  for (int i = 0; i < ARTNET_DRAIN_MAX && artnet.read(); i++) {}
+  METRIC_END(MET_ARTNET_READ);
+
+  METRIC_BEGIN(MET_OSC_UPDATE);
+  for (int i = 0; i < OSC_DRAIN_MAX && oscServer.update(); i++) {}
+  METRIC_END(MET_OSC_UPDATE);
+
+  // Kvantizirani ukazi — v frame-u, katerega izhod pade na beat
+  if (launchQueue.pendingCount()) {
+    BeatClock clk;
+    soundEng.getBeatClock(clk);
+    mixer.lock();
+    launchQueue.tick(frameStartUs, frameClock.getPeriodUs(), clk);
+    mixer.unlock();
+  }
+
+  // Mixer — timeout logika, sestavi in objavi izhod
+  mixer.update(dt);
+  playbacks.checkAutoSave();
+
+  // Vsi izhodi dobijo isti objavljen frame (brez mutexa)
+  updateDmxRefresh();
+  mixer.readFrame(outFrame);
+  METRIC_BEGIN(MET_DMX_SEND);
+  // Samo kopija v TX buffer — break/MAB/podatke odda esp_timer (dmx_tx.h);
+  // adaptivno TX avtomat med frame-i ponavlja zadnjega s svojo periodo
+  dmxOut.sendFrame(outFrame.data, dmxSlots);
+  METRIC_END(MET_DMX_SEND);
+  // Zakasnitev izhoda: začetek frame-a → konec DMX paketa
+  DmxTxStats txStats;
+  dmxOut.getStats(txStats);
+  launchQueue.noteOutputLatencyUs((uint32_t)esp_timer_get_time() - frameStartUs + txStats.frameUs);
+  METRIC_BEGIN(MET_ARTNET_OUT);
+  sendArtNetOut(outFrame.data, nodeCfg.universe);
+  METRIC_END(MET_ARTNET_OUT);
+  if (nodeCfg.sacnEnabled && mixer.getMode() != CTRL_ARTNET) {
+    METRIC_BEGIN(MET_SACN_OUT);
+    sacnOut.sendFrame(outFrame.data, nodeCfg.channelCount);
+    METRIC_END(MET_SACN_OUT);
+  }
+  // ESP-NOW wireless DMX
+  if (espNowDmx.isEnabled()) {
+    METRIC_BEGIN(MET_ESPNOW_OUT);
+    espNowDmx.sendFrame(outFrame.data, nodeCfg.channelCount);
+    METRIC_END(MET_ESPNOW_OUT);
+  }
+  // Dodatne univerze — samo omrežni izhodi (DMX port je univerza 0)
+  sendUniverseOutputs();
+  // Pixel Mapper — preslikaj DMX na WS2812 LED trak
+  #if defined(CONFIG_IDF_TARGET_ESP32S3)
+  if (pixelMap.isActive()) {
+    METRIC_BEGIN(MET_PIXEL_MAP);
+    pixelMap.update(outFrame.data, &fixtures, &soundEng, dt);
+    METRIC_END(MET_PIXEL_MAP);
+  }
+  #endif
+
+  METRIC_END(MET_FRAME_TOTAL);
+}
+
+void frameTask(void* param) {
+  esp_task_wdt_add(NULL);
+
+  for (;;) {
+    esp_task_wdt_reset();
+    // Timeout samo zato, da watchdog ostane nahranjen, če timer ne teče
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    float dt;
+    if (!frameClock.beginFrame((uint32_t)esp_timer_get_time(), dt)) continue;
+    runFrame(dt);
+    frameClock.endFrame((uint32_t)esp_timer_get_time());
+  }
+}
+
+// ============================================================================
+//  CORE 1: LOOP (Arduino loopTask — pod frame taskom)
+//  Web, captive DNS, ArtPollReply. Realtime pot je v frameTask().
+// ============================================================================
+
+void loop() {
+  // Watchdog feed
+  esp_task_wdt_reset();
+  METRIC_BEGIN(MET_LOOP_TOTAL);
+
+  // Captive portal DNS (AP način)
+  if (apModeActive) dnsServer.processNextRequest();
 
   // Web — periodično pošiljanje stanja prek WebSocket (mora biti na core 1, ker AsyncTCP ni thread-safe)
+  METRIC_BEGIN(MET_WEB_LOOP);
   webLoop();
+  METRIC_END(MET_WEB_LOOP);
 
   // ArtPollReply — periodični broadcast za discovery
   unsigned long nowMs = millis();
@@ -637,6 +828,7 @@ void loop() {
     sendArtPollReply();
   }
 
+  METRIC_END(MET_LOOP_TOTAL);
   vTaskDelay(1);  // 1 tick = 1ms
 }
 
@@ -3,6 +3,7 @@
 #include <esp_wifi.h>
 #include <esp_idf_version.h>
 #include <LittleFS.h>
+#include "persist.h"
 
 // ESP-NOW send callback — podpis se razlikuje med ESP-IDF 4.x in 5.x
 static volatile int _espnowSendResult = 0;
@@ -64,8 +65,17 @@ void EspNowDmx::deinitEspNow() {
   Serial.println("[NOW] ESP-NOW izklopljen");
 }
 
-void EspNowDmx::sendFrame(const uint8_t* dmxData, uint16_t length) {
+void EspNowDmx::updateUniverseMask() {
+  _universeMask = 0;
+  for (int i = 0; i < _cfg.peerCount; i++) {
+    if (_cfg.peers[i].active && _cfg.peerUniverse[i] < 8) _universeMask |= (1 << _cfg.peerUniverse[i]);
+  }
+  _mixedUniverses = (_universeMask & (_universeMask - 1)) != 0;
+}
+
+void EspNowDmx::sendFrame(const uint8_t* dmxData, uint16_t length, uint8_t universe) {
   if (!_initialized || _cfg.peerCount == 0) return;
+  if (universe >= 8 || !(_universeMask & (1 << universe))) return;   // Nihče ne posluša
   if (length > DMX_MAX_CHANNELS) length = DMX_MAX_CHANNELS;
 
   _seq++;
@@ -84,15 +94,22 @@ void EspNowDmx::sendFrame(const uint8_t* dmxData, uint16_t length) {
     pkt[3] = chunkLen;
     memcpy(&pkt[4], &dmxData[offset], chunkLen);
 
-    // Broadcast to all peers
-    esp_now_send(NULL, pkt, 4 + chunkLen);  // NULL = all peers
+    if (!_mixedUniverses) {
+      esp_now_send(NULL, pkt, 4 + chunkLen);  // NULL = all peers
+    } else {
+      for (int i = 0; i < _cfg.peerCount; i++) {
+        if (_cfg.peers[i].active && _cfg.peerUniverse[i] == universe)
+          esp_now_send(_cfg.peers[i].mac, pkt, 4 + chunkLen);
+      }
+    }
 
     offset += chunkLen;
   }
 }
 
-bool EspNowDmx::addPeer(const uint8_t* mac, const char* name) {
+bool EspNowDmx::addPeer(const uint8_t* mac, const char* name, uint8_t universe) {
   if (_cfg.peerCount >= ESPNOW_MAX_PEERS) return false;
+  if (universe >= MAX_UNIVERSES) universe = 0;
 
   EspNowPeer& p = _cfg.peers[_cfg.peerCount];
   memcpy(p.mac, mac, 6);
@@ -109,9 +126,11 @@ bool EspNowDmx::addPeer(const uint8_t* mac, const char* name) {
     esp_now_add_peer(&pi);
   }
 
+  _cfg.peerUniverse[_cfg.peerCount] = universe;
   _cfg.peerCount++;
-  Serial.printf("[NOW] Peer dodan: %02X:%02X:%02X:%02X:%02X:%02X\n",
-                mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+  updateUniverseMask();
+  Serial.printf("[NOW] Peer dodan: %02X:%02X:%02X:%02X:%02X:%02X (univerza %d)\n",
+                mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], universe);
   return true;
 }
 
@@ -125,18 +144,18 @@ bool EspNowDmx::removePeer(int idx) {
   // Shift remaining peers
   for (int i = idx; i < _cfg.peerCount - 1; i++) {
     _cfg.peers[i] = _cfg.peers[i + 1];
+    _cfg.peerUniverse[i] = _cfg.peerUniverse[i + 1];
   }
   _cfg.peerCount--;
+  _cfg.peerUniverse[_cfg.peerCount] = 0;
+  updateUniverseMask();
   return true;
 }
 
 void EspNowDmx::saveConfig() {
-  File f = LittleFS.open("/espnow.bin", "w");
-  if (!f) return;
-  uint8_t ver = 1;
-  f.write(&ver, 1);
-  f.write((uint8_t*)&_cfg, sizeof(EspNowConfig));
-  f.close();
+  static const uint8_t ver = 2;
+  PersistSeg segs[2] = { { &ver, 1 }, { &_cfg, sizeof(EspNowConfig) } };
+  if (!persistWriteV("/espnow.bin", segs, 2)) return;
   Serial.println("[NOW] Konfiguracija shranjena");
 }
 
@@ -144,9 +163,11 @@ void EspNowDmx::loadConfig() {
   File f = LittleFS.open("/espnow.bin", "r");
   if (!f) return;
   uint8_t ver;
-  if (f.read(&ver, 1) == 1 && ver == 1) {
+  if (f.read(&ver, 1) == 1 && (ver == 1 || ver == 2)) {
+    // V1 nima peerUniverse[] na koncu → ostane 0 (vsi na univerzi 0)
     f.read((uint8_t*)&_cfg, sizeof(EspNowConfig));
   }
   f.close();
+  updateUniverseMask();
   Serial.println("[NOW] Konfiguracija nalozena");
 }
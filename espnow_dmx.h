@@ -11,6 +11,8 @@
 //  - DMX buffer (512B) se fragmentira v 3 pakete po 200B (ESP-NOW limit=250B)
 //  - Vsak paket: [SEQ:1][OFFSET:2][LEN:1][DATA:200]
 //  - Slave sestavi celoten buffer in ga posreduje MAX485
+//  - Vsak peer posluša eno univerzo mixerja (peerUniverse); če so vsi na
+//    isti, gre frame kot broadcast, sicer unicast samo ustreznim peerom
 // ============================================================================
 
 #include "config.h"
@@ -31,18 +33,19 @@ struct EspNowConfig {
   bool    enabled = false;
   uint8_t peerCount = 0;
   EspNowPeer peers[ESPNOW_MAX_PEERS];
+  uint8_t peerUniverse[ESPNOW_MAX_PEERS] = {};   // V2: na koncu, da se V1 datoteka še naloži
 };
 
 class EspNowDmx {
 public:
   void begin();
-  void sendFrame(const uint8_t* dmxData, uint16_t length);
+  void sendFrame(const uint8_t* dmxData, uint16_t length, uint8_t universe = 0);
 
   EspNowConfig& getConfig() { return _cfg; }
   bool isEnabled() const { return _cfg.enabled && _initialized; }
   int  getPeerCount() const { return _cfg.peerCount; }
 
-  bool addPeer(const uint8_t* mac, const char* name = nullptr);
+  bool addPeer(const uint8_t* mac, const char* name = nullptr, uint8_t universe = 0);
   bool removePeer(int idx);
   void setEnabled(bool on);
 
@@ -53,6 +56,10 @@ private:
   EspNowConfig _cfg;
   bool _initialized = false;
   uint8_t _seq = 0;       // Packet sequence number (wraparound)
+  uint8_t _universeMask = 1;  // Univerze, ki jih posluša vsaj en peer
+  bool    _mixedUniverses = false;
+
+  void updateUniverseMask();
 
   void initEspNow();
   void deinitEspNow();
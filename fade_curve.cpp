@@ -0,0 +1,52 @@
+#include "fade_curve.h"
+#include <math.h>
+
+// Točka i = krivulja(i / FADE_LUT_SIZE); zadnja (1.0 → 65536) je implicitna
+static uint16_t _lut[FADE_CURVE_COUNT][FADE_LUT_SIZE];
+static bool _built = false;
+
+static const char* const CURVE_NAMES[FADE_CURVE_COUNT] = {
+  "linear", "s-curve", "ease-in", "ease-out", "log", "perceptual"
+};
+
+static double curveAt(uint8_t curve, double x) {
+  switch (curve) {
+    case FADE_SCURVE:     return x * x * (3.0 - 2.0 * x);
+    case FADE_EASE_IN:    return x * x;
+    case FADE_EASE_OUT:   return 1.0 - (1.0 - x) * (1.0 - x);
+    // Hiter začetek, mehak konec (intenziteta: prvi del fade-a je najbolj viden)
+    case FADE_LOG:        return log(1.0 + 15.0 * x) / log(16.0);
+    // Inverz CIE L*: zaznana svetlost narašča enakomerno
+    case FADE_PERCEPTUAL: {
+      double l = x * 100.0;
+      return l > 8.0 ? pow((l + 16.0) / 116.0, 3.0) : l / 903.3;
+    }
+    default:              return x;
+  }
+}
+
+void fadeCurvesBegin() {
+  if (_built) return;
+  for (int c = 0; c < FADE_CURVE_COUNT; c++) {
+    for (int i = 0; i < FADE_LUT_SIZE; i++) {
+      long v = lround(curveAt(c, (double)i / FADE_LUT_SIZE) * 65536.0);
+      _lut[c][i] = (uint16_t)(v < 0 ? 0 : v > 65535 ? 65535 : v);
+    }
+  }
+  _built = true;
+}
+
+uint32_t fadeCurveApply(uint8_t curve, uint32_t a16) {
+  if (curve == FADE_LINEAR || curve >= FADE_CURVE_COUNT || !_built) return a16;
+  uint32_t idx = a16 >> (16 - FADE_LUT_BITS);
+  if (idx >= FADE_LUT_SIZE) return 65536;
+  uint32_t frac = a16 & ((1 << (16 - FADE_LUT_BITS)) - 1);
+  const uint16_t* t = _lut[curve];
+  uint32_t y0 = t[idx];
+  uint32_t y1 = idx + 1 < FADE_LUT_SIZE ? t[idx + 1] : 65536;
+  return y0 + (((y1 - y0) * frac) >> (16 - FADE_LUT_BITS));
+}
+
+const char* fadeCurveName(uint8_t curve) {
+  return curve < FADE_CURVE_COUNT ? CURVE_NAMES[curve] : "linear";
+}
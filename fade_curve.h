@@ -0,0 +1,22 @@
+#ifndef FADE_CURVE_H
+#define FADE_CURVE_H
+
+#include "config.h"
+
+// ============================================================================
+//  FADE KRIVULJE — alpha fade-a (Q16, 0..65536) skozi tabelo
+//
+//  Vsaka krivulja je tabela FADE_LUT_SIZE+1 točk (Q16), zgrajena enkrat v
+//  fadeCurvesBegin(). Fade preslika alpha enkrat na frame (ena vrednost +
+//  linearna interpolacija med sosednjima točkama), kanali nato uporabijo
+//  isto alpha — cena na kanal je enaka kot pri linearnem fade-u.
+// ============================================================================
+
+#define FADE_LUT_BITS  8
+#define FADE_LUT_SIZE  (1 << FADE_LUT_BITS)
+
+void fadeCurvesBegin();
+uint32_t fadeCurveApply(uint8_t curve, uint32_t a16);   // FadeCurve; neznana = linearna
+const char* fadeCurveName(uint8_t curve);
+
+#endif
@@ -11,6 +11,13 @@ void FixtureEngine::begin() {
     if (!_profiles) { Serial.println("[FIX] NAPAKA: ne morem alocirati _profiles!"); return; }
   }
   memset(_profiles, 0, sizeof(FixtureProfile) * MAX_PROFILES);
+  // Prevedena slika patcha (~5 KB ×2)
+  if (!_map) {
+    _map      = (PatchMap*)psramPreferMalloc(sizeof(PatchMap));
+    _mapBuild = (PatchMap*)psramPreferMalloc(sizeof(PatchMap));
+    if (!_map || !_mapBuild) { Serial.println("[FIX] NAPAKA: ne morem alocirati PatchMap!"); }
+    if (_map) memset(_map, 0, sizeof(PatchMap));
+  }
   memset(_patch, 0, sizeof(_patch));
   memset(_groups, 0, sizeof(_groups));
 
@@ -117,6 +124,7 @@ void FixtureEngine::loadChannelDef(ChannelDef& ch, const JsonObject& chObj) {
   strlcpy(ch.name, chObj["name"] | "?", sizeof(ch.name));
   ch.type = parseChannelType(chObj["type"] | "generic");
   ch.defaultValue = chObj["default"] | 0;
+  ch.fine = chObj["fine"] | false;
   ch.rangeCount = 0;
 
   JsonArray ranges = chObj["ranges"].as<JsonArray>();
@@ -193,7 +201,8 @@ bool FixtureEngine::deleteProfile(const char* id) {
 // ============================================================================
 
 bool FixtureEngine::addFixture(const char* name, const char* profileId,
-                               uint16_t dmxAddress, uint8_t groupMask, bool soundReactive) {
+                               uint16_t dmxAddress, uint8_t groupMask, bool soundReactive,
+                               uint8_t universe) {
   for (int i = 0; i < MAX_FIXTURES; i++) {
     if (!_patch[i].active) {
       strlcpy(_patch[i].name, name, sizeof(_patch[i].name));
@@ -209,6 +218,7 @@ bool FixtureEngine::addFixture(const char* name, const char* profileId,
       _patch[i].panMax        = 255;
       _patch[i].tiltMin       = 0;
       _patch[i].tiltMax       = 255;
+      _patch[i].universe      = universe;
 
       // Poskusi povezati profil
       for (int j = 0; j < _profileCount; j++) {
@@ -217,6 +227,7 @@ bool FixtureEngine::addFixture(const char* name, const char* profileId,
           break;
         }
       }
+      rebuildPatchMap();
       return true;
     }
   }
@@ -226,6 +237,7 @@ bool FixtureEngine::addFixture(const char* name, const char* profileId,
 bool FixtureEngine::removeFixture(int index) {
   if (index < 0 || index >= MAX_FIXTURES) return false;
   _patch[index].active = false;
+  rebuildPatchMap();
   return true;
 }
 
@@ -248,6 +260,7 @@ void FixtureEngine::resolvePatchProfiles() {
       }
     }
   }
+  rebuildPatchMap();
 }
 
 int FixtureEngine::getFixtureCount() const {
@@ -291,6 +304,7 @@ bool FixtureEngine::clearGroup(int bit) {
   for (int i = 0; i < MAX_FIXTURES; i++) {
     _patch[i].groupMask &= ~(1 << bit);
   }
+  rebuildPatchMap();
   return true;
 }
 
@@ -313,6 +327,189 @@ int FixtureEngine::getFixturesInGroup(int groupBit, int* outIndices, int maxOut)
   return count;
 }
 
+// ============================================================================
+//  PREVEDENA SLIKA PATCHA
+// ============================================================================
+
+// Poveži fine kanale s coarse kanali znotraj enega fixture-a:
+// n-ti fine kanal dobi n-ti coarse kanal istega para (pan↔pan_fine, tilt↔tilt_fine).
+static void linkFinePairs(PatchMap& m, uint16_t start, uint8_t count,
+                          uint8_t coarseType, uint8_t fineType) {
+  int nextCoarse = 0;
+  for (int f = 0; f < count; f++) {
+    PatchAddr& fine = m.addr[start + f];
+    if (fine.type != fineType) continue;
+    while (nextCoarse < count && m.addr[start + nextCoarse].type != coarseType) nextCoarse++;
+    if (nextCoarse >= count) return;
+    PatchAddr& coarse = m.addr[start + nextCoarse];
+    coarse.partner = start + f;
+    fine.partner = start + nextCoarse;
+    fine.fine = true;
+    nextCoarse++;
+  }
+}
+
+// Seznam parov; par, ki ga je prekril drug fixture, se razveže
+static void collectPairs(PatchMap& m) {
+  m.pairCount = 0;
+  for (int a = 0; a < DMX_MAX_CHANNELS; a++) {
+    PatchAddr& c = m.addr[a];
+    if (c.partner == PATCH_NONE || c.fine) continue;
+    PatchAddr& f = m.addr[c.partner];
+    if (f.partner != a || !f.fine || f.fixture != c.fixture || m.pairCount >= MAX_PATCH_PAIRS) {
+      c.partner = PATCH_NONE;
+      continue;
+    }
+    PatchPair& p = m.pairs[m.pairCount++];
+    p.coarse = a;
+    p.fine = c.partner;
+    p.type = c.type;
+    p.fixture = c.fixture;
+  }
+  for (int a = 0; a < DMX_MAX_CHANNELS; a++) {
+    PatchAddr& f = m.addr[a];
+    if (!f.fine) continue;
+    if (f.partner == PATCH_NONE || m.addr[f.partner].partner != a) { f.partner = PATCH_NONE; f.fine = false; }
+  }
+}
+
+void FixtureEngine::buildPatchMap(PatchMap& m, uint8_t universe) {
+  m.highestAddr = 0;
+  m.fixtureCount = 0;
+  m.spanCount = 0;
+  for (int a = 0; a < DMX_MAX_CHANNELS; a++) {
+    m.addr[a].fixture = -1;
+    m.addr[a].type = CH_GENERIC;
+    m.addr[a].channel = 0;
+    m.addr[a].groupMask = 0;
+    m.addr[a].partner = PATCH_NONE;
+    m.addr[a].fine = false;
+    m.addr[a].typeBits = 0;
+  }
+  memset(m.fixtureSpan, 0, sizeof(m.fixtureSpan));
+
+  // --- Naslovi po fixture-ih (prekrivanje: kasnejši fixture zmaga) ---
+  for (int i = 0; i < MAX_FIXTURES; i++) {
+    const PatchEntry& fx = _patch[i];
+    if (!fx.active || fx.profileIndex < 0 || fx.universe != universe) continue;
+    if (fx.dmxAddress < 1 || fx.dmxAddress > DMX_MAX_CHANNELS) continue;
+    const FixtureProfile& p = _profiles[fx.profileIndex];
+
+    uint16_t start = fx.dmxAddress - 1;
+    uint8_t count = p.channelCount;
+    if (start + count > DMX_MAX_CHANNELS) count = DMX_MAX_CHANNELS - start;
+
+    for (int ch = 0; ch < count; ch++) {
+      PatchAddr& pa = m.addr[start + ch];
+      uint8_t t = p.channels[ch].type;
+      pa.fixture = i;
+      pa.type = (t < CH_TYPE_COUNT) ? t : (uint8_t)CH_GENERIC;
+      pa.channel = ch;
+      pa.groupMask = fx.groupMask;
+      pa.partner = PATCH_NONE;
+      pa.fine = false;
+      pa.typeBits |= (1UL << pa.type);
+    }
+    linkFinePairs(m, start, count, CH_PAN, CH_PAN_FINE);
+    linkFinePairs(m, start, count, CH_TILT, CH_TILT_FINE);
+    // Pari iz profila: "fine": true je LSB prejšnjega kanala (npr. Dimmer fine)
+    for (int ch = 1; ch < count; ch++) {
+      PatchAddr& fine = m.addr[start + ch];
+      PatchAddr& coarse = m.addr[start + ch - 1];
+      if (!p.channels[ch].fine || fine.partner != PATCH_NONE || coarse.partner != PATCH_NONE) continue;
+      coarse.partner = start + ch;
+      fine.partner = start + ch - 1;
+      fine.fine = true;
+    }
+
+    PatchSpan sp = { start, count, (uint8_t)i };
+    m.fixtureSpan[i] = sp;
+    m.spans[m.spanCount++] = sp;
+    m.fixtureCount++;
+    if (start + count > m.highestAddr) m.highestAddr = start + count;
+  }
+
+  collectPairs(m);
+
+  // --- Seznami naslovov po tipu kanala (counting sort) ---
+  uint16_t typeCount[CH_TYPE_COUNT];
+  memset(typeCount, 0, sizeof(typeCount));
+  for (int a = 0; a < DMX_MAX_CHANNELS; a++) {
+    if (m.addr[a].fixture >= 0) typeCount[m.addr[a].type]++;
+  }
+  m.typeStart[0] = 0;
+  for (int t = 0; t < CH_TYPE_COUNT; t++) m.typeStart[t + 1] = m.typeStart[t] + typeCount[t];
+  uint16_t fill[CH_TYPE_COUNT];
+  memcpy(fill, m.typeStart, sizeof(fill));
+  for (int a = 0; a < DMX_MAX_CHANNELS; a++) {
+    if (m.addr[a].fixture >= 0) m.typeAddrs[fill[m.addr[a].type]++] = a;
+  }
+
+  // --- Razponi po skupinah ---
+  int n = 0;
+  for (int g = 0; g < MAX_GROUPS; g++) {
+    m.groupStart[g] = n;
+    for (int s = 0; s < m.spanCount; s++) {
+      if (_patch[m.spans[s].fixture].groupMask & (1 << g)) m.groupSpans[n++] = m.spans[s];
+    }
+  }
+  m.groupStart[MAX_GROUPS] = n;
+}
+
+void FixtureEngine::rebuildPatchMap() {
+  if (!_map || !_mapBuild || !_profiles) return;
+  uint32_t gen = ++_mapGeneration;
+
+  // Katere dodatne univerze imajo fixture-e
+  uint8_t used = 1;
+  for (int i = 0; i < MAX_FIXTURES; i++) {
+    const PatchEntry& fx = _patch[i];
+    if (fx.active && fx.profileIndex >= 0 && fx.universe < MAX_UNIVERSES) used |= (1 << fx.universe);
+  }
+
+  for (int u = 1; u < MAX_UNIVERSES; u++) {
+    if (!(used & (1 << u)) && !_uniMap[u]) continue;   // Nikoli patchana → brez alokacije
+    if (!_uniMap[u]) {
+      _uniMap[u]      = (PatchMap*)psramPreferMalloc(sizeof(PatchMap));
+      _uniMapBuild[u] = (PatchMap*)psramPreferMalloc(sizeof(PatchMap));
+      if (!_uniMap[u] || !_uniMapBuild[u]) {
+        Serial.printf("[FIX] NAPAKA: ne morem alocirati PatchMap za univerzo %d!\n", u);
+        free(_uniMap[u]); free(_uniMapBuild[u]);
+        _uniMap[u] = _uniMapBuild[u] = nullptr;
+        used &= ~(1 << u);
+        continue;
+      }
+      memset(_uniMap[u], 0, sizeof(PatchMap));
+    }
+    // Izpraznjena univerza ostane alocirana (bralci morda še držijo kazalec).
+    // Gradnja brez locka: stara slika je bila zamenjana pod lockom, frame,
+    // ki jo je bral, je takrat že končal.
+    buildPatchMap(*_uniMapBuild[u], u);
+    _uniMapBuild[u]->generation = gen;
+    if (_mapLock) xSemaphoreTake(_mapLock, portMAX_DELAY);
+    PatchMap* old = _uniMap[u];
+    _uniMap[u] = _uniMapBuild[u];
+    _uniMapBuild[u] = old;
+    if (_mapLock) xSemaphoreGive(_mapLock);
+  }
+
+  // Univerza 0 zadnja: njena generacija sproži prevod v mixerju
+  buildPatchMap(*_mapBuild, 0);
+  _mapBuild->generation = gen;
+  if (_mapLock) xSemaphoreTake(_mapLock, portMAX_DELAY);
+  _universeMask = used;
+  PatchMap* old = _map;
+  _map = _mapBuild;
+  _mapBuild = old;
+  if (_mapLock) xSemaphoreGive(_mapLock);
+}
+
+const PatchMap* FixtureEngine::getPatchMap(uint8_t universe) const {
+  if (universe == 0) return _map;
+  if (universe >= MAX_UNIVERSES || !(_universeMask & (1 << universe))) return nullptr;
+  return _uniMap[universe];
+}
+
 // ============================================================================
 //  POMOŽNE
 // ============================================================================
@@ -3,6 +3,58 @@
 
 #include "config.h"
 #include <ArduinoJson.h>
+#include <freertos/semphr.h>
+
+// ============================================================================
+//  PatchMap — prevedena slika patcha
+//  Zgradi se ob vsaki spremembi patcha (add/update/remove/resolve/clearGroup).
+//  Realtime poti (mixer, scene, efekti, sound) berejo samo to tabelo,
+//  brez hoje po profilih in klicev fixtureChannel() na vsak frame.
+// ============================================================================
+
+#define CH_TYPE_COUNT   25        // Število vrednosti ChannelType
+#define PATCH_NONE      0xFFFF    // Ni coarse/fine partnerja
+#define MAX_PATCH_PAIRS 96        // 16-bit parov na univerzo (24 fixture-ov × 4)
+
+struct PatchAddr {
+  int8_t   fixture;      // Indeks fixture-a (-1 = nepatchan naslov)
+  uint8_t  type;         // ChannelType
+  uint8_t  channel;      // Kanal znotraj fixture-a
+  uint8_t  groupMask;    // Kopija groupMask fixture-a
+  uint16_t partner;      // 0-based naslov coarse/fine para (PATCH_NONE = brez)
+  bool     fine;         // true = LSB para (partner je coarse)
+  uint32_t typeBits;     // OR (1 << tip) vseh fixture-ov na tem naslovu (prekrivanje)
+};
+
+struct PatchSpan {
+  uint16_t start;        // 0-based prvi naslov
+  uint8_t  count;        // Število kanalov (odrezano pri 512)
+  uint8_t  fixture;      // Indeks fixture-a
+};
+
+// 16-bit par: vrednost = (coarse << 8) | fine; tip je tip coarse kanala
+struct PatchPair {
+  uint16_t coarse;       // 0-based naslov MSB
+  uint16_t fine;         // 0-based naslov LSB
+  uint8_t  type;         // ChannelType coarse kanala
+  uint8_t  fixture;
+};
+
+struct PatchMap {
+  uint32_t  generation;                          // Poveča se ob vsaki gradnji
+  uint16_t  highestAddr;                         // Najvišji patchan naslov (1-based, 0 = prazen)
+  uint8_t   fixtureCount;                        // Fixture-i s povezanim profilom
+  uint8_t   spanCount;
+  PatchAddr addr[DMX_MAX_CHANNELS];              // Naslov → fixture, tip, partner
+  PatchSpan fixtureSpan[MAX_FIXTURES];           // Po indeksu fixture-a (count=0 = ni patchan)
+  PatchSpan spans[MAX_FIXTURES];                 // Aktivni fixture-i, urejeni po indeksu
+  uint16_t  typeStart[CH_TYPE_COUNT + 1];        // typeAddrs[typeStart[t] .. typeStart[t+1])
+  uint16_t  typeAddrs[DMX_MAX_CHANNELS];         // 0-based naslovi, po tipu, nato po naslovu
+  uint16_t  groupStart[MAX_GROUPS + 1];          // groupSpans[groupStart[g] .. groupStart[g+1])
+  PatchSpan groupSpans[MAX_FIXTURES * MAX_GROUPS];
+  uint8_t   pairCount;
+  PatchPair pairs[MAX_PATCH_PAIRS];              // Vsi coarse/fine pari, po coarse naslovu
+};
 
 // ============================================================================
 //  FixtureEngine
@@ -25,7 +77,7 @@ public:
 
   // --- Patch ---
   bool addFixture(const char* name, const char* profileId, uint16_t dmxAddress,
-                  uint8_t groupMask = 0, bool soundReactive = false);
+                  uint8_t groupMask = 0, bool soundReactive = false, uint8_t universe = 0);
   bool removeFixture(int index);
   bool updateFixture(int index, const PatchEntry& entry);
   void resolvePatchProfiles();                   // Poveži profileId → profileIndex
@@ -48,6 +100,18 @@ public:
   // Vrne seznam fixture indeksov v skupini
   int getFixturesInGroup(int groupBit, int* outIndices, int maxOut) const;
 
+  // --- Prevedena slika patcha ---
+  const PatchMap* getPatchMap() const { return _map; }            // Univerza 0
+  const PatchMap* getPatchMap(uint8_t universe) const;            // nullptr = univerza ni patchana
+  uint8_t getUniverseMask() const { return _universeMask; }       // bit u = vsaj en fixture
+  uint32_t getPatchGeneration() const { return _map ? _map->generation : 0; }
+  void rebuildPatchMap();                        // Kliči po neposrednem urejanju getFixtureMut()
+  // Lock bralcev slike (mixer: frame task bere PatchMap pod njim). Zamenjava
+  // kazalcev gre pod ta lock, zato gradnja nikoli ne piše v sliko, ki jo
+  // frame še bere — tudi ob več gradnjah v enem frame-u (uvoz patcha).
+  // Klicoč rebuildPatchMap() ne sme držati tega locka.
+  void setMapLock(SemaphoreHandle_t mtx) { _mapLock = mtx; }
+
 private:
   FixtureProfile* _profiles = nullptr;
   int _profileCount = 0;
@@ -56,6 +120,19 @@ private:
 
   GroupDef _groups[MAX_GROUPS];
 
+  // Dvojni buffer: gradi v _mapBuild, nato zamenjaj kazalca (bralci nikoli ne vidijo pol-zgrajene slike)
+  PatchMap* _map = nullptr;
+  PatchMap* _mapBuild = nullptr;
+  uint32_t  _mapGeneration = 0;
+  SemaphoreHandle_t _mapLock = nullptr;
+
+  // Dodatne univerze (1..MAX_UNIVERSES-1): alocirane ob prvem fixture-u v univerzi
+  PatchMap* _uniMap[MAX_UNIVERSES] = {};
+  PatchMap* _uniMapBuild[MAX_UNIVERSES] = {};
+  uint8_t   _universeMask = 1;
+
+  void buildPatchMap(PatchMap& m, uint8_t universe);
+
   ChannelType parseChannelType(const char* str) const;
   void loadChannelDef(ChannelDef& ch, const JsonObject& chObj);
 };
@@ -0,0 +1,90 @@
+#include "frame_clock.h"
+#include <math.h>
+
+void FrameClock::begin(uint32_t periodUs, uint32_t nowUs) {
+  _periodUs = periodUs ? periodUs : FRAME_PERIOD_US;
+  _ticks.store(0);
+  _lastTickUs.store(nowUs);
+  _taken = 0;
+  _haveLastStart = false;
+  _winStartUs = nowUs;
+  _winFrames = _winIntervals = 0;
+  _winSum = _winSumSq = 0;
+  _winMaxLate = _winMaxWork = 0;
+  _stats = {};
+  _stats.periodUs = _periodUs;
+}
+
+// ============================================================================
+//  TIMER (esp_timer task) — samo števec in čas, task zbudi klicoč
+// ============================================================================
+
+void FrameClock::onTick(uint32_t nowUs) {
+  _lastTickUs.store(nowUs, std::memory_order_relaxed);
+  _ticks.fetch_add(1, std::memory_order_release);
+}
+
+// ============================================================================
+//  FRAME TASK
+// ============================================================================
+
+uint32_t FrameClock::beginFrame(uint32_t nowUs, float& dt) {
+  uint32_t ticks = _ticks.load(std::memory_order_acquire);
+  uint32_t n = ticks - _taken;
+  if (n == 0) { dt = 0; return 0; }
+  _taken = ticks;
+  if (n > 1) _stats.missed += n - 1;
+  dt = (float)n * _periodUs * 1e-6f;
+
+  uint32_t late = nowUs - _lastTickUs.load(std::memory_order_relaxed);
+  noteFrameStart(nowUs, late);
+  _frameStartUs = nowUs;
+  return n;
+}
+
+void FrameClock::endFrame(uint32_t nowUs) {
+  uint32_t work = nowUs - _frameStartUs;
+  _stats.workUs = work;
+  if (work > _winMaxWork) _winMaxWork = work;
+  if (work > _periodUs) _stats.overruns++;
+  _stats.frames++;
+}
+
+// ============================================================================
+//  STATISTIKA — takt in jitter v 1s oknih (kot DmxTxMachine)
+// ============================================================================
+
+void FrameClock::noteFrameStart(uint32_t now, uint32_t late) {
+  if (_haveLastStart) {
+    uint32_t iv = now - _lastStartUs;
+    _winSum += iv;
+    _winSumSq += (double)iv * iv;
+    _winIntervals++;
+  }
+  _lastStartUs = now;
+  _haveLastStart = true;
+  _winFrames++;
+  if (late > _winMaxLate) _winMaxLate = late;
+
+  uint32_t elapsed = now - _winStartUs;
+  if (elapsed >= 1000000UL) {
+    _stats.rateHz = _winFrames * 1e6f / elapsed;
+    if (_winIntervals) {
+      double mean = _winSum / _winIntervals;
+      double var = _winSumSq / _winIntervals - mean * mean;
+      _stats.intervalUs = (float)mean;
+      _stats.jitterUs = var > 0 ? (float)sqrt(var) : 0.0f;
+    }
+    _stats.maxLateUs = _winMaxLate;
+    _stats.maxWorkUs = _winMaxWork;
+    _winStartUs = now;
+    _winFrames = _winIntervals = 0;
+    _winSum = _winSumSq = 0;
+    _winMaxLate = _winMaxWork = 0;
+  }
+}
+
+// Kopija brez locka: med zapisom okna je lahko ena vrednost iz prejšnjega okna
+void FrameClock::getStats(FrameClockStats& out) const {
+  out = _stats;
+}
@@ -0,0 +1,62 @@
+#ifndef FRAME_CLOCK_H
+#define FRAME_CLOCK_H
+
+// ============================================================================
+//  FRAME CLOCK — fiksen takt realtime frame-a (vhod → mixer → objava → izhodi)
+//
+//  Periodičen timer (ESP32: esp_timer) kliče onTick(), ki samo prišteje tick
+//  in zbudi frame task. Task v beginFrame() prevzame vse čakajoče tick-e:
+//  dt = tick-i × perioda (ne razlika millis()), zato efekti tečejo s taktom
+//  izhoda tudi, ko task zamudi frame. Več kot en tick naenkrat = izpuščen frame.
+//  Brez strojnih klicev, zato se ista logika meri na hostu (bench_frame_clock).
+// ============================================================================
+
+#include "config.h"
+#include <atomic>
+
+#define FRAME_PERIOD_US  DMX_FIXED_INTERVAL_US   // 40 fps — takt omrežnih izhodov
+
+struct FrameClockStats {
+  uint32_t frames;        // Izvedeni frame-i
+  uint32_t missed;        // Tick-i, ki jih je task preskočil (zamuda > perioda)
+  uint32_t overruns;      // Frame-i, daljši od periode
+  uint32_t periodUs;
+  float    rateHz;        // Zadnje zaključeno 1s okno
+  float    intervalUs;    // Povprečen interval med začetki frame-ov
+  float    jitterUs;      // Standardni odklon intervala
+  uint32_t maxLateUs;     // Največja zamuda začetka frame-a za tick-om (okno)
+  uint32_t workUs;        // Trajanje zadnjega frame-a
+  uint32_t maxWorkUs;     // Najdaljši frame (okno)
+};
+
+class FrameClock {
+public:
+  void begin(uint32_t periodUs, uint32_t nowUs);
+  void onTick(uint32_t nowUs);                      // Timer kontekst
+  // Task: število prevzetih tick-ov (0 = ni novega) in dt v sekundah
+  uint32_t beginFrame(uint32_t nowUs, float& dt);
+  void endFrame(uint32_t nowUs);
+
+  uint32_t getPeriodUs() const { return _periodUs; }
+  void getStats(FrameClockStats& out) const;
+
+private:
+  uint32_t _periodUs = FRAME_PERIOD_US;
+  std::atomic<uint32_t> _ticks{0};                  // Vsi tick-i timerja
+  std::atomic<uint32_t> _lastTickUs{0};             // Čas zadnjega tick-a
+  uint32_t _taken = 0;                              // Tick-i, ki jih je task že prevzel
+
+  // Statistika (piše samo frame task)
+  uint32_t _frameStartUs = 0;
+  uint32_t _lastStartUs = 0;
+  bool     _haveLastStart = false;
+  uint32_t _winStartUs = 0;
+  uint32_t _winFrames = 0, _winIntervals = 0;
+  double   _winSum = 0, _winSumSq = 0;
+  uint32_t _winMaxLate = 0, _winMaxWork = 0;
+  FrameClockStats _stats = {};
+
+  void noteFrameStart(uint32_t now, uint32_t late);
+};
+
+#endif
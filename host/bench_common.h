@@ -0,0 +1,79 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+// ============================================================================
+//  bench_common — skupni deli host benchov
+//
+//    BenchRng        deterministični xorshift32; vsak bench ima svoj seed:
+//                    static BenchRng rnd{1812};  ...  rnd() % n
+//    benchRoot()     prazna LittleFS mapa s kopijo izbranih profilov
+//    benchEngines()  zagon engine-ov v pravem vrstnem redu
+//    benchPatchRig() tipičen rig: vsak tretji moving head, ostalo RGBW PAR-i
+//
+//  Bench obdrži samo svoje preverjanje; tu ni nič, kar bi merilo.
+// ============================================================================
+
+#include "fixture_engine.h"
+#include "scene_engine.h"
+#include "mixer_engine.h"
+#include <LittleFS.h>
+#include <cstdio>
+#include <filesystem>
+
+#define BENCH_HEAD_PROFILE  "varytec-hero-340fx.json"
+#define BENCH_PAR_PROFILE   "par-rgbw-multi.json"
+#define BENCH_HEAD_ID       "varytec-hero-340fx__16ch"
+#define BENCH_PAR_ID        "par-rgbw-multi__7ch"
+
+struct BenchRng {
+  uint32_t s;
+  uint32_t operator()() { s ^= s << 13; s ^= s >> 17; s ^= s << 5; return s; }
+};
+
+// Pobriše root in ga nastavi kot LittleFS koren. profiles: imena datotek v
+// profDir (n), nullptr = vsi .json; profDir nullptr = brez profilov.
+static inline void benchRoot(const std::filesystem::path& root, const char* profDir,
+                             const char* const* profiles = nullptr, int n = 0) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  fs::remove_all(root, ec);
+  fs::create_directories(root / "profiles", ec);
+  fs::create_directories(root / "scenes", ec);
+  if (profDir && profiles) {
+    for (int i = 0; i < n; i++) {
+      if (!fs::copy_file(fs::path(profDir) / profiles[i], root / "profiles" / profiles[i], ec))
+        fprintf(stderr, "[BENCH] Ne morem kopirati profila %s/%s\n", profDir, profiles[i]);
+    }
+  } else if (profDir) {
+    for (const auto& e : fs::directory_iterator(profDir, ec)) {
+      if (e.path().extension() == ".json") fs::copy_file(e.path(), root / "profiles" / e.path().filename(), ec);
+    }
+  }
+  LittleFS.setRoot(root.c_str());
+  LittleFS.begin();
+}
+
+// Patch se naloži pred banko scen: begin() banke seli in prevaja scene skozi
+// PatchMap (glej scene_bank.h). mixer nullptr = bench brez mixerja.
+static inline void benchEngines(FixtureEngine& fixtures, SceneEngine& scenes, MixerEngine* mixer = nullptr) {
+  fixtures.begin();
+  scenes.setFixtureEngine(&fixtures);
+  scenes.begin();
+  if (mixer) mixer->begin(&fixtures, &scenes);
+}
+
+// count fixture-ov (dokler gredo v univerzo), skupina 1; vrne naslednji prost naslov
+static inline uint16_t benchPatchRig(FixtureEngine& fixtures, int count, bool soundReactive) {
+  uint16_t addr = 1;
+  for (int i = 0; i < count; i++) {
+    const FixtureProfile* p = fixtures.findProfile(i % 3 == 0 ? BENCH_HEAD_ID : BENCH_PAR_ID);
+    if (!p || addr + p->channelCount - 1 > DMX_MAX_CHANNELS) break;
+    char name[20];
+    snprintf(name, sizeof(name), "FX %d", i + 1);
+    fixtures.addFixture(name, p->id, addr, 1, soundReactive);
+    addr += p->channelCount;
+  }
+  return addr;
+}
+
+#endif
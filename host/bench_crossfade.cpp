@@ -0,0 +1,322 @@
+// ============================================================================
+//  bench_crossfade — crossfade scen: seznam spremenjenih kanalov
+//
+//  Patch iz pravih profilov (moving head s 16-bit pan/tilt in gobo/prism,
+//  RGBW pari). Referenca je stara pot: vseh 512 kanalov vsak frame, snap
+//  po PatchMap typeBits, nato 16-bit pari. Obe poti dobita isti dt frame
+//  clock-a in morata dati identičen izhod v vsakem frame-u.
+//  Poroča: ns na frame za majhno spremembo (nekaj kanalov) in za celo
+//  univerzo, nova pot proti referenci.
+//  Preveri: ujemanje po frame-ih (linearno in S-krivulja), snap kanali se
+//  preklopijo samo na polovici, končno stanje = cilj, 1-urni fade z 40 Hz
+//  je monoton; LUT krivulje so monotone, s pravimi krajišči in blizu
+//  analitične krivulje; split časi (zamik, fade po skupinah kanalov) se
+//  ujemajo z referenco, ki skupino določi neodvisno po tipu kanala.
+//
+//  Uporaba: bench_crossfade [--frames N] [--profiles dir]
+//  Izhodna koda 0 = ujemanje.
+// ============================================================================
+
+#include "fixture_engine.h"
+#include "scene_engine.h"
+#include "value16.h"
+#include "fade_curve.h"
+#include "frame_clock.h"
+#include "bench_common.h"
+#include <LittleFS.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#ifndef DMX_PROFILES_DIR
+#define DMX_PROFILES_DIR "data/profiles"
+#endif
+
+namespace fs_ = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static BenchRng rnd{1812};
+
+static int failures = 0;
+#define CHECK(c, ...) do { if (!(c)) { printf("[BENCH] NAPAKA: " __VA_ARGS__); printf("\n"); failures++; } } while (0)
+
+static FixtureEngine fixtures;
+static SceneEngine   scenes;
+
+static const uint32_t SNAP_BITS =
+  (1UL << CH_GOBO) | (1UL << CH_SHUTTER) | (1UL << CH_PRISM) |
+  (1UL << CH_MACRO) | (1UL << CH_PRESET);
+
+// ============================================================================
+//  REFERENCA — stara pot čez vse kanale (alpha v Q16 kot nova pot)
+// ============================================================================
+
+static void referenceFrame(const uint8_t* from, const uint8_t* to, uint32_t t16, uint8_t curve, uint8_t* out) {
+  const PatchMap* m = fixtures.getPatchMap();
+  uint32_t a16 = fadeCurveApply(curve, t16);
+  for (int i = 0; i < DMX_MAX_CHANNELS; i++) {
+    if (m && (m->addr[i].typeBits & SNAP_BITS)) {
+      out[i] = (t16 >= 32768) ? to[i] : from[i];
+    } else {
+      int32_t diff = (int32_t)to[i] - from[i];
+      out[i] = (uint8_t)(from[i] + ((diff * (int32_t)a16) >> 16));
+    }
+  }
+  if (m && m->pairCount) {
+    for (int p = 0; p < m->pairCount; p++) {
+      const PatchPair& pp = m->pairs[p];
+      if (SNAP_BITS & (1UL << pp.type)) continue;
+      put16(out, pp.coarse, pp.fine, lerp16(get16(from, pp.coarse, pp.fine), get16(to, pp.coarse, pp.fine), a16));
+    }
+  }
+}
+
+// ============================================================================
+//  PATCH
+// ============================================================================
+
+static const char* BENCH_PROFILES[] = { BENCH_HEAD_PROFILE, BENCH_PAR_PROFILE };
+
+static void patchRig(const fs_::path& root, const char* profDir) {
+  benchRoot(root, profDir, BENCH_PROFILES, 2);
+  benchEngines(fixtures, scenes);
+  uint16_t addr = benchPatchRig(fixtures, 40, true);
+  if (!fixtures.getFixtureCount())
+    fprintf(stderr, "[BENCH] Profili niso naloženi — samo linearni kanali (brez snap/16-bit)\n");
+  const PatchMap* m = fixtures.getPatchMap();
+  int snap = 0;
+  for (int i = 0; i < DMX_MAX_CHANNELS; i++) snap += (m->addr[i].typeBits & SNAP_BITS) != 0;
+  printf("[BENCH] Patch: %d fixture-ov, %d naslovov, %d 16-bit parov, %d snap kanalov\n",
+         fixtures.getFixtureCount(), addr - 1, m->pairCount, snap);
+}
+
+// ============================================================================
+//  MERITEV
+// ============================================================================
+
+// from → to z dt frame clock-a; vsak frame primerja z referenco
+static void runCase(const char* label, const uint8_t* from, const uint8_t* to, uint32_t durMs, int frames,
+                    uint8_t curve = FADE_LINEAR) {
+  uint8_t out[DMX_MAX_CHANNELS], ref[DMX_MAX_CHANNELS];
+  memcpy(out, from, sizeof(out));
+  scenes.startCrossfade(from, to, durMs, 1, curve);
+  uint64_t elapsed = 0, durUs = (uint64_t)durMs * 1000;
+  double tNew = 0, tRef = 0;
+  int mism = 0, n = 0;
+  for (; n < frames && scenes.isCrossfading(); n++) {
+    elapsed += FRAME_PERIOD_US;
+    auto t0 = Clock::now();
+    scenes.updateCrossfade(out, FRAME_PERIOD_US);
+    auto t1 = Clock::now();
+    if (elapsed >= durUs) memcpy(ref, to, sizeof(ref));
+    else referenceFrame(from, to, (uint32_t)((elapsed << 16) / durUs), curve, ref);
+    auto t2 = Clock::now();
+    tNew += std::chrono::duration<double, std::nano>(t1 - t0).count();
+    tRef += std::chrono::duration<double, std::nano>(t2 - t1).count();
+    if (memcmp(out, ref, sizeof(out)) != 0 && mism++ == 0) {
+      int i = 0;
+      while (out[i] == ref[i]) i++;
+      CHECK(false, "%s: frame %d kanal %d = %d, referenca %d", label, n, i + 1, out[i], ref[i]);
+    }
+  }
+  CHECK(mism == 0, "%s: %d frame-ov ne ujema", label, mism);
+  int changed = 0;
+  for (int i = 0; i < DMX_MAX_CHANNELS; i++) changed += from[i] != to[i];
+  printf("[BENCH] %-10s %3d spremenjenih: %7.0f ns/frame (referenca 512 kanalov %7.0f ns, %.1fx)\n",
+         label, changed, tNew / n, tRef / n, tNew > 0 ? tRef / tNew : 0.0);
+}
+
+static void runEnd(const uint8_t* from, const uint8_t* to) {
+  uint8_t out[DMX_MAX_CHANNELS];
+  memcpy(out, from, sizeof(out));
+  scenes.startCrossfade(from, to, 1000, 1);
+  int frames = 0;
+  while (scenes.isCrossfading() && frames < 1000) { scenes.updateCrossfade(out, FRAME_PERIOD_US); frames++; }
+  CHECK(memcmp(out, to, sizeof(out)) == 0, "konec: stanje != cilj");
+  CHECK(frames == (int)((1000000 + FRAME_PERIOD_US - 1) / FRAME_PERIOD_US), "konec: %d frame-ov za 1 s fade", frames);
+}
+
+// Split časi: referenca določi skupino vsakega naslova sama in izračuna okno
+static int refGroup(const PatchMap* m, int addr, bool up) {
+  if (!m || m->addr[addr].fixture < 0) return CUE_TG_BASE;
+  switch (m->addr[addr].type) {
+    case CH_INTENSITY: return up ? CUE_TG_INT_UP : CUE_TG_INT_DOWN;
+    case CH_PAN: case CH_PAN_FINE: case CH_TILT: case CH_TILT_FINE: return CUE_TG_POSITION;
+    case CH_COLOR_R: case CH_COLOR_G: case CH_COLOR_B: case CH_COLOR_W: case CH_COLOR_A:
+    case CH_COLOR_UV: case CH_COLOR_L: case CH_COLOR_C: case CH_CCT: case CH_COLOR_WW: return CUE_TG_COLOR;
+    case CH_GOBO: case CH_PRISM: case CH_SHUTTER: case CH_STROBE: case CH_FOCUS: case CH_ZOOM: return CUE_TG_BEAM;
+    default: return CUE_TG_BASE;
+  }
+}
+
+static uint32_t window16(uint64_t el, const CueTiming& t, uint32_t baseFade, int g) {
+  uint64_t d = t.delayMs * 1000ULL;
+  uint64_t f = (g == CUE_TG_BASE || t.fadeMs == CUE_TIME_INHERIT ? baseFade : t.fadeMs) * 1000ULL;
+  if (el < d) return 0;
+  if (el - d >= f) return 65536;
+  return (uint32_t)(((el - d) << 16) / f);
+}
+
+static void runSplit(const uint8_t* from, const uint8_t* to) {
+  const PatchMap* m = fixtures.getPatchMap();
+  CueTiming t[CUE_TG_COUNT];
+  SceneEngine::defaultTiming(t);
+  const uint32_t baseFade = 1000;
+  t[CUE_TG_BASE].delayMs = 500;
+  t[CUE_TG_INT_UP] = { 2000, 0 };
+  t[CUE_TG_INT_DOWN] = { 500, 0 };
+  t[CUE_TG_POSITION] = { 1000, 1000 };
+  t[CUE_TG_COLOR] = { 3000, 250 };
+  t[CUE_TG_BEAM] = { CUE_TIME_INHERIT, 200 };
+  uint32_t span = SceneEngine::timingSpanMs(baseFade, t);
+  CHECK(span == 3250, "split: trajanje %u ms (pričakovano 3250)", span);
+
+  bool inPair[DMX_MAX_CHANNELS] = {};
+  for (int p = 0; m && p < m->pairCount; p++) inPair[m->pairs[p].coarse] = inPair[m->pairs[p].fine] = true;
+
+  uint8_t out[DMX_MAX_CHANNELS], ref[DMX_MAX_CHANNELS];
+  memcpy(out, from, sizeof(out));
+  scenes.startCrossfade(from, to, baseFade, 1, FADE_LINEAR, t);
+  uint64_t el = 0;
+  int frames = 0, mism = 0;
+  while (scenes.isCrossfading()) {
+    el += FRAME_PERIOD_US;
+    scenes.updateCrossfade(out, FRAME_PERIOD_US);
+    frames++;
+    if (el >= span * 1000ULL) { memcpy(ref, to, sizeof(ref)); }
+    else {
+      for (int i = 0; i < DMX_MAX_CHANNELS; i++) {
+        if (inPair[i]) { ref[i] = out[i]; continue; }
+        int g = refGroup(m, i, to[i] > from[i]);
+        uint32_t w = window16(el, t[g], baseFade, g);
+        if (m && (m->addr[i].typeBits & SNAP_BITS)) ref[i] = w >= 32768 ? to[i] : from[i];
+        else ref[i] = (uint8_t)(from[i] + ((((int32_t)to[i] - from[i]) * (int32_t)w) >> 16));
+      }
+      for (int p = 0; m && p < m->pairCount; p++) {
+        const PatchPair& pp = m->pairs[p];
+        if (SNAP_BITS & (1UL << pp.type)) continue;
+        uint16_t a = get16(from, pp.coarse, pp.fine), b = get16(to, pp.coarse, pp.fine);
+        int g = refGroup(m, pp.coarse, b >= a);
+        put16(ref, pp.coarse, pp.fine, lerp16(a, b, window16(el, t[g], baseFade, g)));
+      }
+    }
+    if (memcmp(out, ref, sizeof(out)) != 0 && mism++ == 0) {
+      int i = 0;
+      while (out[i] == ref[i]) i++;
+      CHECK(false, "split: frame %d kanal %d = %d, referenca %d", frames, i + 1, out[i], ref[i]);
+    }
+    if (el == 400000) {
+      // Pred zamikom osnovne skupine: nepatchani kanali še na začetku
+      for (int i = 0; i < DMX_MAX_CHANNELS; i++) {
+        if (m && m->addr[i].fixture >= 0) continue;
+        if (out[i] != from[i]) { CHECK(false, "split: kanal %d se premakne pred zamikom", i + 1); break; }
+      }
+    }
+  }
+  CHECK(mism == 0, "split: %d frame-ov ne ujema", mism);
+  CHECK(frames == (int)((span * 1000ULL + FRAME_PERIOD_US - 1) / FRAME_PERIOD_US), "split: %d frame-ov za %u ms", frames, span);
+  CHECK(memcmp(out, to, sizeof(out)) == 0, "split: konec != cilj");
+  printf("[BENCH] Split časi: %d frame-ov (%u ms), ujemanje z referenco\n", frames, span);
+
+  // Brez časov in fade 0 → takojšen (ni crossfade-a)
+  SceneEngine::defaultTiming(t);
+  scenes.startCrossfade(from, to, 0, 1, FADE_LINEAR, t);
+  CHECK(!scenes.isCrossfading(), "split: fade 0 brez zamikov ni takojšen");
+}
+
+// Tabele: krajišča, monotonost, odstopanje od analitične krivulje
+static double analytic(int c, double x) {
+  switch (c) {
+    case FADE_SCURVE:     return x * x * (3 - 2 * x);
+    case FADE_EASE_IN:    return x * x;
+    case FADE_EASE_OUT:   return 1 - (1 - x) * (1 - x);
+    case FADE_LOG:        return log(1 + 15 * x) / log(16.0);
+    case FADE_PERCEPTUAL: return x * 100 > 8 ? pow((x * 100 + 16) / 116, 3) : x * 100 / 903.3;
+    default:              return x;
+  }
+}
+
+static void runCurves() {
+  for (int c = 0; c < FADE_CURVE_COUNT; c++) {
+    CHECK(fadeCurveApply(c, 0) == 0 && fadeCurveApply(c, 65536) == 65536, "krivulja %s: krajišča", fadeCurveName(c));
+    uint32_t prev = 0;
+    double maxErr = 0;
+    bool mono = true;
+    for (uint32_t t = 0; t <= 65536; t++) {
+      uint32_t y = fadeCurveApply(c, t);
+      if (y < prev) mono = false;
+      prev = y;
+      maxErr = std::max(maxErr, fabs(y / 65536.0 - analytic(c, t / 65536.0)));
+    }
+    CHECK(mono, "krivulja %s: ni monotona", fadeCurveName(c));
+    CHECK(maxErr < 1.0 / 1024, "krivulja %s: odstopanje %.5f", fadeCurveName(c), maxErr);
+    printf("[BENCH] Krivulja %-10s max odstopanje od analitične %.6f\n", fadeCurveName(c), maxErr);
+  }
+}
+
+// Dolg fade: progress in linearni kanali ne smejo nikoli nazaj
+static void runLongFade() {
+  const PatchMap* m = fixtures.getPatchMap();
+  uint8_t from[DMX_MAX_CHANNELS], to[DMX_MAX_CHANNELS], out[DMX_MAX_CHANNELS], prev[DMX_MAX_CHANNELS];
+  for (int i = 0; i < DMX_MAX_CHANNELS; i++) { from[i] = 0; to[i] = 255; }
+  memcpy(out, from, sizeof(out));
+  scenes.startCrossfade(from, to, 3600000, 1);
+  bool inPair[DMX_MAX_CHANNELS] = {};
+  for (int p = 0; p < m->pairCount; p++) inPair[m->pairs[p].coarse] = inPair[m->pairs[p].fine] = true;
+  float lastP = 0;
+  int back = 0;
+  long frames = 0;
+  while (scenes.isCrossfading()) {
+    memcpy(prev, out, sizeof(prev));
+    scenes.updateCrossfade(out, FRAME_PERIOD_US);
+    frames++;
+    float p = scenes.getCrossfadeProgress();
+    if (p < lastP) back++;
+    lastP = p;
+    for (int i = 0; i < DMX_MAX_CHANNELS; i++) {
+      if (!inPair[i] && out[i] < prev[i]) back++;
+    }
+    for (int p = 0; p < m->pairCount; p++) {
+      const PatchPair& pp = m->pairs[p];
+      if (get16(out, pp.coarse, pp.fine) < get16(prev, pp.coarse, pp.fine)) back++;
+    }
+  }
+  CHECK(back == 0, "1-urni fade: %d korakov nazaj", back);
+  CHECK(memcmp(out, to, sizeof(out)) == 0, "1-urni fade: konec != cilj");
+  printf("[BENCH] 1-urni fade: %ld frame-ov, monoton\n", frames);
+}
+
+int main(int argc, char** argv) {
+  int frames = 2000;
+  const char* profDir = DMX_PROFILES_DIR;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--frames") && i + 1 < argc) frames = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--profiles") && i + 1 < argc) profDir = argv[++i];
+  }
+
+  Serial.setQuiet(true);
+  patchRig(fs_::temp_directory_path() / "bench_crossfade", profDir);
+
+  uint8_t a[DMX_MAX_CHANNELS], b[DMX_MAX_CHANNELS], c[DMX_MAX_CHANNELS];
+  for (int i = 0; i < DMX_MAX_CHANNELS; i++) a[i] = rnd() & 0xFF;
+  memcpy(c, a, sizeof(c));
+  for (int k = 0; k < 12; k++) c[rnd() % DMX_MAX_CHANNELS] = rnd() & 0xFF;   // Nekaj faderjev
+  for (int i = 0; i < DMX_MAX_CHANNELS; i++) b[i] = rnd() & 0xFF;
+
+  uint32_t durMs = (uint32_t)((uint64_t)frames * FRAME_PERIOD_US / 1000) - 3;   // Konec sredi frame-a
+  runCase("majhna", a, c, durMs, frames + 1);
+  runCase("cela", a, b, durMs, frames + 1);
+  runCase("s-krivulja", a, b, durMs, frames + 1, FADE_SCURVE);
+  runEnd(a, b);
+  runLongFade();
+  runCurves();
+  runSplit(a, b);
+
+  printf("[BENCH] %s\n", failures ? "NEUJEMANJE" : "OK");
+  return failures ? 1 : 0;
+}
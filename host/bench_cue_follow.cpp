@@ -0,0 +1,163 @@
+// ============================================================================
+//  bench_cue_follow — auto-follow cue liste na show uri (brez brskalnika)
+//
+//  Cue lista (MAX_CUES, naključni fade, split zamiki, auto-follow od nekaj ms
+//  do sekund, nekaj cue-jev krajših od frame-a) teče v zanki skozi
+//  MixerEngine::update() z dt frame clock-a; občasno frame izpade (dt = 2-3
+//  periode). Idealni urnik: rok naslednjega = rok prejšnjega + fade + zamik.
+//  Preveri:
+//    - v vsakem frame-u je trenutni cue natanko tisti, ki ga da idealni urnik
+//      (tudi več rokov v enem frame-u) — ni drifta čez ure predvajanja
+//    - zamuda sprožitve < dt frame-a
+//    - nov crossfade začne s pretečenim časom = show ura − rok (pod-frame)
+//  Poroča: število cue-jev, največjo/povprečno zamudo proti stari poti
+//  (webLoop vsakih 80 ms, rok od trenutka opažene sprožitve), kjer se zamuda
+//  sešteva.
+//
+//  Uporaba: bench_cue_follow [ure]
+//  Izhodna koda 0 = urnik se ujema.
+// ============================================================================
+
+#include "scene_engine.h"
+#include "mixer_engine.h"
+#include "fixture_engine.h"
+#include "frame_clock.h"
+#include "bench_common.h"
+#include <LittleFS.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+
+namespace fs_ = std::filesystem;
+
+static BenchRng rnd{2301};
+
+static int failures = 0;
+#define CHECK(c, ...) do { if (!(c)) { printf("[BENCH] NAPAKA: " __VA_ARGS__); printf("\n"); failures++; } } while (0)
+
+static FixtureEngine fixtures;
+static SceneEngine   scenes;
+static MixerEngine   mixer;
+
+static const int BENCH_SCENES = 10;
+static const uint32_t WS_GATE_US = 80000;          // Stara pot: WS_UPDATE_INTERVAL
+
+static void setup(const fs_::path& root) {
+  benchRoot(root, nullptr);
+  benchEngines(fixtures, scenes, &mixer);
+
+  uint8_t dmx[DMX_MAX_CHANNELS];
+  for (int s = 0; s < BENCH_SCENES; s++) {
+    for (int i = 0; i < DMX_MAX_CHANNELS; i++) dmx[i] = (uint8_t)rnd();
+    char name[16];
+    snprintf(name, sizeof(name), "S%d", s);
+    scenes.saveScene(s, name, dmx);
+  }
+
+  // Cue lista: večinoma show časi, nekaj brez fade-a in zaporedje cue-jev,
+  // krajših od frame-a (več rokov v istem frame-u)
+  for (int i = 0; i < MAX_CUES; i++) {
+    bool burst = (i >= 12 && i < 16);
+    uint16_t fade = (burst || i % 7 == 3) ? 0 : (uint16_t)(rnd() % 5000);
+    uint16_t follow = burst ? (uint16_t)(3 + rnd() % 10) : (uint16_t)(50 + rnd() % 3000);
+    CueTiming t[CUE_TG_COUNT];
+    SceneEngine::defaultTiming(t);
+    bool split = !burst && (i % 4 == 1);
+    if (split) { t[CUE_TG_POSITION].delayMs = (uint16_t)(rnd() % 1500); t[CUE_TG_COLOR].fadeMs = (uint16_t)(rnd() % 4000); }
+    scenes.addCue((int8_t)(i % BENCH_SCENES), fade, follow, "", FADE_LINEAR, split ? t : nullptr);
+  }
+}
+
+static uint64_t cueLenUs(int i) {
+  const CueEntry* c = scenes.getCue(i);
+  return (uint64_t)(SceneEngine::timingSpanMs(c->fadeMs, c->timing) + c->autoFollowMs) * 1000;
+}
+
+int main(int argc, char** argv) {
+  double hours = argc > 1 ? atof(argv[1]) : 6.0;
+  Serial.setQuiet(true);
+  setup(fs_::temp_directory_path() / "bench_cue_follow");
+  const int n = scenes.getCueCount();
+  CHECK(n == MAX_CUES, "cue lista: %d cue-jev", n);
+
+  const uint64_t endUs = (uint64_t)(hours * 3600e6);
+  uint64_t show = 0;                                // Vsota dt kot v MixerEngine::update
+  mixer.lock();
+  scenes.cueGoTo(0, &mixer);                        // Rok 0 = show ura 0
+  mixer.unlock();
+
+  // Idealni urnik: rok naslednjega cue-ja in koliko jih je že na vrsti
+  uint64_t nextDue = cueLenUs(0);
+  uint64_t fired = 1;
+  uint64_t lastDue = 0;
+  uint64_t frames = 0, skipped = 0;
+  uint64_t maxLate = 0, sumLate = 0, lateCount = 0, multi = 0;
+  uint32_t maxDt = 0;
+
+  while (show < endUs) {
+    uint32_t k = 1;
+    uint32_t r = rnd() % 1000;
+    if (r < 5) k = 3; else if (r < 25) k = 2;       // Izpuščeni tick-i
+    skipped += k - 1;
+    uint32_t dtUs = k * FRAME_PERIOD_US;
+    if (dtUs > maxDt) maxDt = dtUs;
+    mixer.update(dtUs * 1e-6f);
+    show += dtUs;
+    frames++;
+
+    int due = 0;
+    while (nextDue <= show) {
+      lastDue = nextDue;
+      nextDue += cueLenUs((int)(fired % n));
+      fired++;
+      due++;
+    }
+    int expect = (int)((fired - 1) % n);
+    if (scenes.getCurrentCue() != expect) {
+      CHECK(false, "frame %llu (%.3f s): cue %d, urnik %d", (unsigned long long)frames, show / 1e6,
+            scenes.getCurrentCue(), expect);
+      break;
+    }
+    if (!due) continue;
+    if (due > 1) multi++;
+
+    uint64_t late = show - lastDue;
+    CHECK(late < dtUs, "zamuda %llu us >= dt %u", (unsigned long long)late, dtUs);
+    if (late > maxLate) maxLate = late;
+    sumLate += late;
+    lateCount++;
+
+    // Pod-frame: crossfade zadnjega sproženega cue-ja že teče toliko, kolikor je frame za rokom
+    const CueEntry* c = scenes.getCue(expect);
+    uint32_t spanMs = SceneEngine::timingSpanMs(c->fadeMs, c->timing);
+    if (spanMs) {
+      double el = scenes.getCrossfadeProgress() * spanMs * 1000.0;
+      CHECK(scenes.isCrossfading() && fabs(el - (double)late) <= 2.0 + spanMs * 1e-3,
+            "cue %d: pretečeno %.1f us, zamuda %llu us", expect, el, (unsigned long long)late);
+    }
+  }
+  CHECK(scenes.isCueRunning(), "auto-follow ustavljen");
+
+  // Stara pot: webLoop opazi rok ob prvih 80 ms vratih, naslednji rok od tam
+  uint64_t oldAt = 0;
+  uint64_t idealAt = 0;
+  for (uint64_t i = 0; i + 1 < fired; i++) {
+    uint64_t len = cueLenUs((int)(i % n));
+    idealAt += len;
+    uint64_t due = oldAt + len;
+    oldAt = (due + WS_GATE_US - 1) / WS_GATE_US * WS_GATE_US;
+  }
+  double oldDrift = (double)(oldAt - idealAt) / 1e6;
+
+  printf("[BENCH] show %.1f h, %llu frame-ov (%llu izpuščenih tick-ov), %llu cue-jev, %llu frame-ov z več roki\n",
+         show / 3600e6, (unsigned long long)frames, (unsigned long long)skipped,
+         (unsigned long long)fired, (unsigned long long)multi);
+  printf("[BENCH] zamuda sprožitve: max %.2f ms (dt max %.0f ms), povprečje %.2f ms, drift 0 (urnik ujet v vsakem frame-u)\n",
+         maxLate / 1e3, maxDt / 1e3, lateCount ? sumLate / 1e3 / lateCount : 0.0);
+  printf("[BENCH] stara pot (webLoop, 80 ms, rok od opažene sprožitve): drift %.1f s po %llu cue-jih; brez WS klienta se ustavi\n",
+         oldDrift, (unsigned long long)fired);
+
+  printf("[BENCH] %s\n", failures ? "NEUJEMANJE" : "OK");
+  return failures ? 1 : 0;
+}
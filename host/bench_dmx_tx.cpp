@@ -0,0 +1,171 @@
+// ============================================================================
+//  bench_dmx_tx — DmxTxMachine proti simuliranemu UART-u
+//
+//  Diskretna simulacija v µs: timer z zakasnitvijo dispatch-a (kot esp_timer
+//  task), UART, ki frame odda v len×44µs (+ naključen zamik praznjenja FIFO),
+//  in producent (loop), ki kliče submit() v danem intervalu.
+//  Preverja:
+//    - break >= 92µs, MAB >= 12µs, brez breaka/pisanja med oddajo
+//    - vsak frame na žici je cel (vsi bajti enaki) in v pravem vrstnem redu
+//  Poroča: dosežen refresh, interval/jitter (DmxTxStats), čas submit() in
+//  latenco submit() → zadnji slot na žici. Adaptivni scenariji nastavijo
+//  periodo iz dmxFrameIntervalUs() (neprekinjeno osveževanje).
+//
+//  Uporaba: bench_dmx_tx [sekunde]
+//  Izhodna koda 0 = brez kršitev časovnic.
+// ============================================================================
+
+#include "dmx_tx.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+using Clock = std::chrono::steady_clock;
+
+static uint32_t rng = 12345;
+static uint32_t rnd(uint32_t n) { rng = rng * 1664525u + 1013904223u; return n ? (rng >> 8) % n : 0; }
+
+class SimUart : public DmxUartHal {
+public:
+  uint64_t now = 0;
+  bool     timerArmed = false;
+  uint64_t timerDue = 0;
+  uint32_t dispatchLatMaxUs = 0;   // esp_timer task zakasnitev
+  uint32_t drainLagMaxUs = 0;      // FIFO se izprazni malo po nominalnem času
+
+  // Preverjanje
+  bool     lineLow = false;
+  uint64_t breakStart = 0, mabStart = 0, txEnd = 0;
+  uint32_t minBreak = UINT32_MAX, minMab = UINT32_MAX;
+  long     violations = 0, torn = 0, outOfOrder = 0, wireFrames = 0;
+  int      lastValue = -1;
+  const uint64_t* submitAt = nullptr;     // Čas submit() po vrednosti frame-a
+  uint64_t latSum = 0, latMax = 0;
+  long     latCount = 0;
+
+  void txSetBreak(bool on) override {
+    if (on) {
+      if (now < txEnd) violations++;            // Break sredi podatkov
+      lineLow = true;
+      breakStart = now;
+    } else {
+      uint32_t b = (uint32_t)(now - breakStart);
+      minBreak = std::min(minBreak, b);
+      if (b < 92) violations++;
+      lineLow = false;
+      mabStart = now;
+    }
+  }
+
+  void txWrite(const uint8_t* data, uint16_t len) override {
+    if (lineLow || now < txEnd) violations++;
+    uint32_t m = (uint32_t)(now - mabStart);
+    minMab = std::min(minMab, m);
+    if (m < 12) violations++;
+    if (data[0] != 0x00) violations++;        // Start code
+    for (int i = 2; i < len; i++) if (data[i] != data[1]) { torn++; break; }
+    int v = data[1];
+    if (lastValue >= 0 && (uint8_t)(v - lastValue) > 127) outOfOrder++;
+    txEnd = now + (uint64_t)len * DMX_SLOT_US + rnd(drainLagMaxUs + 1);
+    if (v != lastValue && submitAt) {           // Ponovljen frame nima nove latence
+      uint64_t lat = txEnd - submitAt[v];
+      latSum += lat; latMax = std::max(latMax, lat); latCount++;
+    }
+    lastValue = v;
+    wireFrames++;
+  }
+
+  bool txDone() override { return now >= txEnd; }
+
+  void txArmTimer(uint32_t us) override {
+    if (timerArmed) violations++;             // Enkraten timer je že nastavljen
+    timerArmed = true;
+    timerDue = now + us + rnd(dispatchLatMaxUs + 1);
+  }
+
+  uint32_t txNowUs() override { return (uint32_t)now; }
+};
+
+struct Scenario {
+  const char* name;
+  uint32_t submitIntervalUs;
+  uint16_t channels;
+  uint32_t dispatchLatMaxUs;
+  uint32_t drainLagMaxUs;
+  bool     adaptive;          // Neprekinjeno osveževanje s periodo iz dmxFrameIntervalUs()
+  uint16_t maxFps;
+};
+
+static const Scenario SCENARIOS[] = {
+  { "loop_40fps_512ch",   25000, 512, 30, 10, false,   0 },
+  { "saturated_512ch",     1000, 512, 30, 10, false,   0 },
+  { "saturated_96ch",      1000,  96, 30, 10, false,   0 },
+  { "no_latency_512ch",   25000, 512,  0,  0, false,   0 },
+  { "adaptive_512ch",      1000, 512, 30, 10, true,    0 },
+  { "adaptive_96ch",       1000,  96, 30, 10, true,    0 },
+  { "adaptive_16ch",       1000,  16, 30, 10, true,    0 },
+  { "adaptive_16ch_max200", 1000, 16, 30, 10, true,  200 },
+};
+
+static int runScenario(const Scenario& sc, double seconds) {
+  SimUart uart;
+  uart.dispatchLatMaxUs = sc.dispatchLatMaxUs;
+  uart.drainLagMaxUs = sc.drainLagMaxUs;
+  static DmxTxMachine tx;
+  static uint64_t submitAt[256];
+  uart.submitAt = submitAt;
+  tx.begin(&uart);
+  if (sc.adaptive) tx.setPeriodUs(dmxFrameIntervalUs(sc.channels, sc.maxFps));
+
+  uint64_t endUs = (uint64_t)(seconds * 1e6);
+  uint64_t nextSubmit = 0;
+  uint8_t frame[DMX_MAX_CHANNELS];
+  uint8_t v = 0;
+  std::vector<double> submitNs;
+  submitNs.reserve((size_t)(endUs / sc.submitIntervalUs) + 1);
+
+  while (uart.now < endUs) {
+    if (uart.timerArmed && uart.timerDue <= nextSubmit) {
+      uart.now = uart.timerDue;
+      uart.timerArmed = false;
+      tx.onTimer();
+    } else {
+      uart.now = nextSubmit;
+      memset(frame, ++v, sc.channels);
+      submitAt[v] = uart.now;
+      auto t0 = Clock::now();
+      tx.submit(frame, sc.channels);
+      auto t1 = Clock::now();
+      submitNs.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+      nextSubmit += sc.submitIntervalUs;
+    }
+  }
+
+  DmxTxStats st;
+  tx.getStats(st);
+  std::sort(submitNs.begin(), submitNs.end());
+  double p50 = submitNs.empty() ? 0 : submitNs[submitNs.size() / 2];
+  double pmax = submitNs.empty() ? 0 : submitNs.back();
+  double ideal = 1e6 / dmxFrameIntervalUs(sc.channels, sc.maxFps);
+
+  printf("[BENCH] %-20s refresh=%6.1f Hz (žica max %.1f) interval=%8.1f us jitter=%6.1f us maxdev=%5u us\n",
+         sc.name, st.refreshHz, ideal, st.intervalUs, st.jitterUs, st.maxDevUs);
+  printf("[BENCH] %-20s frame-i=%u prepisani=%u frame=%u us break>=%u us MAB>=%u us\n",
+         sc.name, st.frames, st.dropped, st.frameUs, uart.minBreak, uart.minMab);
+  printf("[BENCH] %-20s submit(): p50=%.0f ns max=%.0f ns | kršitve=%ld raztrgani=%ld vrstni red=%ld\n",
+         sc.name, p50, pmax, uart.violations, uart.torn, uart.outOfOrder);
+  printf("[BENCH] %-20s latenca submit→konec frame-a: povprečje=%.0f us max=%llu us\n",
+         sc.name, uart.latCount ? (double)uart.latSum / uart.latCount : 0.0,
+         (unsigned long long)uart.latMax);
+
+  return (uart.violations || uart.torn || uart.outOfOrder || st.frames == 0) ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 10.0;
+  int fail = 0;
+  for (const Scenario& sc : SCENARIOS) fail |= runScenario(sc, seconds);
+  return fail;
+}
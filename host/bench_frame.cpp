@@ -0,0 +1,465 @@
+// ============================================================================
+//  bench_frame — časi celotnega frame-a pod tipičnimi show obremenitvami
+//
+//  Vsak scenarij zgradi patch iz pravih profilov (data/profiles), nastavi
+//  efekte in nato N frame-ov (25 ms lažne ure na frame) meri stopnje:
+//    artnet_in     — onArtNetData() (samo ArtNet scenarij)
+//    sound_update  — SoundEngine::update() (FFT, ko so novi vzorci)
+//    mixer_update  — celoten MixerEngine::update()
+//    frame_read    — readFrame() (kot izhodi v loop())
+//    frame_total   — vse zgoraj
+//  Za vsako stopnjo p50/p99/max/mean v ns, plus alokacije na frame
+//  (malloc/new v niti frame-a) in koraki mixerja iz metrics.h histogramov.
+//  Rezultat je JSON za primerjavo med zagoni.
+//
+//  Uporaba: bench_frame [--frames N] [--warmup N] [--scenario ime[,ime]]
+//                       [--profiles dir] [--out datoteka.json] [--list]
+// ============================================================================
+
+#include "fixture_engine.h"
+#include "mixer_engine.h"
+#include "scene_engine.h"
+#include "sound_engine.h"
+#include "audio_input.h"
+#include "lfo_engine.h"
+#include "shape_engine.h"
+#include "metrics.h"
+#include "frame_clock.h"
+#include "host_clock.h"
+#include "driver/i2s.h"
+#include "bench_common.h"
+#include <LittleFS.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifndef DMX_PROFILES_DIR
+#define DMX_PROFILES_DIR "data/profiles"
+#endif
+
+namespace fs_ = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+// ============================================================================
+//  ŠTETJE ALOKACIJ (samo nit, ki poganja frame-e)
+// ============================================================================
+
+static thread_local bool     t_countAllocs = false;
+static thread_local uint32_t t_allocs = 0;
+
+static inline void noteAlloc() { if (t_countAllocs) t_allocs++; }
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void* malloc(size_t n) { noteAlloc(); return __libc_malloc(n); }
+void* calloc(size_t n, size_t s) { noteAlloc(); return __libc_calloc(n, s); }
+void* realloc(void* p, size_t n) { noteAlloc(); return __libc_realloc(p, n); }
+}
+#define BENCH_MALLOC_HOOKED 1
+#endif
+
+void* operator new(size_t n) {
+#if !defined(BENCH_MALLOC_HOOKED)
+  noteAlloc();
+#endif
+  void* p = malloc(n);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// ============================================================================
+//  ENGINE-I (kot v firmware-u)
+// ============================================================================
+
+static FixtureEngine  fixtures;
+static SceneEngine    scenes;
+static MixerEngine    mixer;
+static AudioInput     audio;
+static SoundEngine    sound;
+static LfoEngine      lfo;
+static ShapeGenerator shapes;
+
+// Sintetičen signal: kick 2 Hz (120 BPM) + bas 80 Hz + hi-hat šum
+static float synthAudio(uint64_t n, uint32_t rate) {
+  double t = (double)n / rate;
+  double beatT = fmod(t, 0.5);
+  double kick = exp(-beatT * 30.0) * sin(2.0 * M_PI * 60.0 * beatT);
+  double bass = 0.3 * sin(2.0 * M_PI * 80.0 * t);
+  uint32_t h = (uint32_t)(n * 2654435761u);
+  double hat = (fmod(t, 0.25) < 0.03) ? 0.15 * ((h >> 8) / 8388608.0 - 1.0) : 0.0;
+  return (float)(0.6 * kick + bass + hat);
+}
+
+enum Stage { ST_ARTNET, ST_SOUND, ST_MIXER, ST_READ, ST_TOTAL, ST_COUNT };
+static const char* STAGE_NAMES[ST_COUNT] = {
+  "artnet_in", "sound_update", "mixer_update", "frame_read", "frame_total"
+};
+
+struct Scenario {
+  const char* name;
+  const char* description;
+  void (*setup)();
+  bool artnet;      // Vsak frame pošlje ArtNet paket
+  bool audio;       // Zaženi sintetičen avdio vhod
+};
+
+// ============================================================================
+//  POMOŽNE ZA PATCH
+// ============================================================================
+
+static uint16_t nextAddr = 1;
+
+// Doda do count fixture-ov profila; skupine po vrsti (i % 4)
+static void patchFixtures(const char* profileId, int count) {
+  const FixtureProfile* p = fixtures.findProfile(profileId);
+  if (!p) {
+    fprintf(stderr, "[BENCH] Profil %s ni najden, uporabim prvega\n", profileId);
+    p = fixtures.getProfile(0);
+    if (!p) return;
+  }
+  for (int i = 0; i < count && fixtures.getFixtureCount() < MAX_FIXTURES; i++) {
+    if (nextAddr + p->channelCount - 1 > DMX_MAX_CHANNELS) break;
+    char name[20];
+    snprintf(name, sizeof(name), "%.12s %d", p->name, i + 1);
+    int n = fixtures.getFixtureCount();
+    fixtures.addFixture(name, p->id, nextAddr, (uint8_t)(1 << (n % 4)), true);
+    nextAddr += p->channelCount;
+  }
+}
+
+static void setBaseLook() {
+  mixer.switchToLocal();
+  for (int a = 1; a <= DMX_MAX_CHANNELS; a++) mixer.setChannel(a, (uint8_t)((a * 37) & 0xFF));
+  mixer.setMasterDimmer(230);
+  mixer.setGroupDimmer(1, 180);
+}
+
+// ============================================================================
+//  SCENARIJI
+// ============================================================================
+
+static void setupMovingHeadsFx() {
+  patchFixtures("varytec-hero-340fx__16ch", MAX_FIXTURES);
+  setBaseLook();
+
+  static const uint8_t targets[MAX_LFOS] = {
+    LFO_TGT_DIM, LFO_TGT_PAN, LFO_TGT_TILT, LFO_TGT_R, LFO_TGT_G, LFO_TGT_B, LFO_TGT_PAN, LFO_TGT_TILT
+  };
+  for (int i = 0; i < MAX_LFOS; i++) {
+    LfoInstance l = {};
+    l.waveform = i % 4;
+    l.target = targets[i];
+    l.rate = 0.2f + 0.3f * i;
+    l.depth = 0.5f;
+    l.phase = 0.25f * (i % 4);
+    l.fixtureMask = 0xFFFFFF;
+    l.symmetry = i % 4;
+    lfo.addLfo(l);
+  }
+  for (int i = 0; i < MAX_SHAPES; i++) {
+    ShapeInstance s = {};
+    s.type = i;
+    s.rate = 0.25f + 0.1f * i;
+    s.sizeX = 0.3f;
+    s.sizeY = 0.2f;
+    s.phase = 0.5f;
+    s.fixtureMask = 0x3F << (6 * i);
+    shapes.addShape(s);
+  }
+}
+
+static void patchMixedRig() {
+  patchFixtures("varytec-hero-340fx__16ch", 8);
+  patchFixtures("par-rgbw-multi__7ch", 8);
+  patchFixtures("flash-pro-14x10w__14ch", 8);
+}
+
+static void setupSoundEasyPro() {
+  patchMixedRig();
+  setBaseLook();
+
+  STLEasyConfig ez = sound.getEasyConfig();
+  ez.enabled = true;
+  ez.beatSync = true;
+  for (int i = 0; i < MAX_FIXTURES; i++) ez.zones[i] = i % 4;
+  sound.setEasyConfig(ez);
+
+  for (int r = 0; r < STL_MAX_RULES; r++) {
+    STLRule rule = {};
+    rule.active = true;
+    rule.fixtureIdx = r * 3;
+    rule.channelIdx = 0;
+    rule.freqLow = 40 + r * 400;
+    rule.freqHigh = 400 + r * 1200;
+    rule.outMin = 0;
+    rule.outMax = 255;
+    rule.curve = r % 4;
+    rule.attackMs = 2;
+    rule.decayMs = 20;
+    sound.setRule(r, rule);
+  }
+}
+
+static void setupManualBeatGroups() {
+  patchMixedRig();
+  setBaseLook();
+
+  ManualBeatConfig mb = sound.getManualBeatConfig();
+  mb.enabled = true;
+  mb.source = BSRC_MANUAL;
+  mb.bpm = 128;
+  mb.program = MBPROG_CHASE;
+  mb.colorEnabled = true;
+  mb.symmetry = SYM_CENTER_OUT;
+  static const uint8_t grpProg[4] = { MBPROG_RAINBOW, MBPROG_WAVE, MBPROG_STROBE, MBPROG_SCANNER };
+  for (int g = 0; g < 4; g++) {
+    mb.groupOverrides[g].program = grpProg[g];
+    mb.groupOverrides[g].subdiv = GROUP_BEAT_INHERIT;
+    mb.groupOverrides[g].intensity = 80;
+  }
+  sound.setManualBeatConfig(mb);
+}
+
+static void setupSceneCrossfade() {
+  patchMixedRig();
+  setBaseLook();
+
+  uint8_t a[DMX_MAX_CHANNELS], b[DMX_MAX_CHANNELS];
+  for (int i = 0; i < DMX_MAX_CHANNELS; i++) { a[i] = (uint8_t)(i * 13); b[i] = (uint8_t)(255 - i * 7); }
+  scenes.saveScene(0, "A", a);
+  scenes.saveScene(1, "B", b);
+  mixer.recallScene(0, 0);
+  // Dovolj dolg fade, da traja čez vse merjene frame-e
+  mixer.recallScene(1, 3600000);
+}
+
+static void setupArtNetPassthrough() {
+  patchMixedRig();
+  mixer.switchToArtNet();
+  mixer.setMasterDimmer(200);
+  mixer.setGroupDimmer(2, 128);
+}
+
+static const Scenario SCENARIOS[] = {
+  { "moving_heads_fx",    "24 moving heads, vseh 8 LFO + 4 shape",              setupMovingHeadsFx,     false, false },
+  { "sound_easy_pro",     "Sound easy mode + 8 pro pravil, sintetičen avdio",    setupSoundEasyPro,      false, true  },
+  { "manual_beat_groups", "Manual beat (chase) + override za 4 skupine",         setupManualBeatGroups,  false, false },
+  { "scene_crossfade",    "Crossfade med scenama v teku",                        setupSceneCrossfade,    false, false },
+  { "artnet_passthrough", "ArtNet vhod vsak frame, master + group dimmer",       setupArtNetPassthrough, true,  false },
+};
+static const int SCENARIO_COUNT = sizeof(SCENARIOS) / sizeof(SCENARIOS[0]);
+
+// ============================================================================
+//  MERITEV
+// ============================================================================
+
+struct StageStats { double p50, p99, max, mean; };
+
+static StageStats summarize(std::vector<double>& v) {
+  StageStats s = { 0, 0, 0, 0 };
+  if (v.empty()) return s;
+  std::sort(v.begin(), v.end());
+  double sum = 0;
+  for (double x : v) sum += x;
+  s.p50 = v[(v.size() - 1) / 2];
+  s.p99 = v[(size_t)((v.size() - 1) * 0.99)];
+  s.max = v.back();
+  s.mean = sum / v.size();
+  return s;
+}
+
+// Profili, ki jih uporabljajo scenariji (FixtureEngine naloži največ MAX_PROFILES)
+static const char* BENCH_PROFILES[] = { BENCH_HEAD_PROFILE, BENCH_PAR_PROFILE, "flash-pro-14x10w.json" };
+
+static void initEngines(const fs_::path& root, const char* profDir) {
+  benchRoot(root, profDir, BENCH_PROFILES, 3);
+  hostClockSetUs(1000000);
+
+  benchEngines(fixtures, scenes, &mixer);
+  sound.begin(&audio, &fixtures);
+  lfo.begin(&fixtures);
+  shapes.begin(&fixtures);
+  mixer.addStage(&sound, STAGE_ORDER_SOUND, STAGE_BUDGET_SOUND, MET_MIX_SOUND);
+  mixer.addStage(&lfo, STAGE_ORDER_LFO, STAGE_BUDGET_LFO, MET_MIX_LFO);
+  mixer.addStage(&shapes, STAGE_ORDER_SHAPE, STAGE_BUDGET_SHAPE, MET_MIX_SHAPE);
+  nextAddr = 1;
+}
+
+static std::string runScenario(const Scenario& sc, const fs_::path& root, const char* profDir,
+                               int frames, int warmup) {
+  initEngines(root, profDir);
+  if (sc.audio) {
+    hostI2sSetGenerator(synthAudio);
+    audio.begin(2);
+  }
+  sc.setup();
+
+  std::vector<double> t[ST_COUNT];
+  for (int s = 0; s < ST_COUNT; s++) t[s].reserve(frames);
+  std::vector<uint32_t> allocs;
+  allocs.reserve(frames);
+
+  uint8_t artIn[DMX_MAX_CHANNELS];
+  DmxFrame frame;
+
+  for (int f = -warmup; f < frames; f++) {
+    if (f == 0) metricsReset();
+    for (int i = 0; i < DMX_MAX_CHANNELS; i++) artIn[i] = (uint8_t)(i + f);
+    hostClockAdvanceUs(FRAME_PERIOD_US);
+    // Avdio nit mora dohiteti lažno uro (izven meritve), sicer FFT ne dobi vzorcev
+    if (sc.audio) hostI2sWaitCaughtUp(100);
+
+    t_allocs = 0;
+    t_countAllocs = true;
+    auto t0 = Clock::now();
+    if (sc.artnet) mixer.onArtNetData(artIn, DMX_MAX_CHANNELS);
+    auto t1 = Clock::now();
+    sound.update();
+    auto t2 = Clock::now();
+    mixer.update(FRAME_PERIOD_US * 1e-6f);
+    auto t3 = Clock::now();
+    mixer.readFrame(frame);
+    auto t4 = Clock::now();
+    t_countAllocs = false;
+
+    if (f < 0) continue;
+    auto ns = [](Clock::time_point a, Clock::time_point b) {
+      return std::chrono::duration<double, std::nano>(b - a).count();
+    };
+    if (sc.artnet) t[ST_ARTNET].push_back(ns(t0, t1));
+    t[ST_SOUND].push_back(ns(t1, t2));
+    t[ST_MIXER].push_back(ns(t2, t3));
+    t[ST_READ].push_back(ns(t3, t4));
+    t[ST_TOTAL].push_back(ns(t0, t4));
+    allocs.push_back(t_allocs);
+  }
+
+  if (sc.audio) {
+    audio.stop();
+    hostI2sSetGenerator(nullptr);
+  }
+
+  uint64_t allocTotal = 0;
+  uint32_t allocMax = 0;
+  for (uint32_t a : allocs) { allocTotal += a; allocMax = std::max(allocMax, a); }
+
+  const PatchMap* pm = fixtures.getPatchMap();
+  char buf[512];
+  std::string js = "    {\n";
+  snprintf(buf, sizeof(buf),
+           "      \"name\": \"%s\",\n      \"description\": \"%s\",\n"
+           "      \"fixtures\": %d,\n      \"highest_address\": %d,\n      \"frames\": %d,\n",
+           sc.name, sc.description, fixtures.getFixtureCount(), pm ? pm->highestAddr : 0, frames);
+  js += buf;
+  js += "      \"stages\": {\n";
+  bool first = true;
+  for (int s = 0; s < ST_COUNT; s++) {
+    if (t[s].empty()) continue;
+    StageStats st = summarize(t[s]);
+    snprintf(buf, sizeof(buf),
+             "%s        \"%s\": { \"p50_ns\": %.0f, \"p99_ns\": %.0f, \"max_ns\": %.0f, \"mean_ns\": %.0f }",
+             first ? "" : ",\n", STAGE_NAMES[s], st.p50, st.p99, st.max, st.mean);
+    js += buf;
+    first = false;
+    fprintf(stderr, "[BENCH] %-20s %-13s p50=%8.0f p99=%8.0f max=%9.0f ns\n",
+            sc.name, STAGE_NAMES[s], st.p50, st.p99, st.max);
+  }
+  // Koraki znotraj update() — iz istih histogramov kot /api/metrics
+  js += "\n      },\n      \"mixer_stages\": {\n";
+  first = true;
+  double nsPerCycle = 1000.0 / metricsCyclesPerUs();
+  for (uint8_t m = MET_MIX_CROSSFADE; m <= MET_MIX_TOTAL; m++) {
+    StageHistogram h;
+    if (!metricsGet(m, h)) continue;
+    uint32_t n = 0;
+    for (int b = 0; b <= METRICS_BUCKETS; b++) n += h.counts[b];
+    if (!n) continue;
+    snprintf(buf, sizeof(buf), "%s        \"%s\": { \"count\": %u, \"mean_ns\": %.0f, \"max_ns\": %.0f }",
+             first ? "" : ",\n", metricsStageName(m), n,
+             (double)h.sumCycles / n * nsPerCycle, h.maxCycles * nsPerCycle);
+    js += buf;
+    first = false;
+  }
+  snprintf(buf, sizeof(buf),
+           "\n      },\n      \"alloc_per_frame\": { \"mean\": %.3f, \"max\": %u, \"total\": %llu }\n    }",
+           frames ? (double)allocTotal / frames : 0.0, allocMax, (unsigned long long)allocTotal);
+  js += buf;
+  fprintf(stderr, "[BENCH] %-20s alokacije/frame: mean=%.3f max=%u\n",
+          sc.name, frames ? (double)allocTotal / frames : 0.0, allocMax);
+  return js;
+}
+
+// ============================================================================
+//  MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+  int frames = 2000, warmup = 100;
+  std::string only, outPath;
+  const char* profDir = DMX_PROFILES_DIR;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--frames" && i + 1 < argc)        frames = atoi(argv[++i]);
+    else if (a == "--warmup" && i + 1 < argc)   warmup = atoi(argv[++i]);
+    else if (a == "--scenario" && i + 1 < argc) only = argv[++i];
+    else if (a == "--profiles" && i + 1 < argc) profDir = argv[++i];
+    else if (a == "--out" && i + 1 < argc)      outPath = argv[++i];
+    else if (a == "--list") {
+      for (int s = 0; s < SCENARIO_COUNT; s++) printf("%-20s %s\n", SCENARIOS[s].name, SCENARIOS[s].description);
+      return 0;
+    } else {
+      fprintf(stderr, "Uporaba: %s [--frames N] [--warmup N] [--scenario ime[,ime]] "
+                      "[--profiles dir] [--out datoteka.json] [--list]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  Serial.setQuiet(true);
+  metricsBegin();
+  fs_::path root = fs_::temp_directory_path() / "bench_frame";
+
+  std::string json = "{\n  \"bench\": \"frame_pipeline\",\n";
+  json += "  \"frame_interval_us\": 25000,\n";
+  json += "  \"frames\": " + std::to_string(frames) + ",\n";
+  json += "  \"scenarios\": [\n";
+  bool first = true;
+  int ran = 0;
+  for (int s = 0; s < SCENARIO_COUNT; s++) {
+    if (!only.empty() && ("," + only + ",").find(std::string(",") + SCENARIOS[s].name + ",") == std::string::npos) continue;
+    if (!first) json += ",\n";
+    json += runScenario(SCENARIOS[s], root, profDir, frames, warmup);
+    first = false;
+    ran++;
+  }
+  json += "\n  ]\n}\n";
+
+  std::error_code ec;
+  fs_::remove_all(root, ec);
+
+  if (!ran) { fprintf(stderr, "[BENCH] Ni scenarija: %s (glej --list)\n", only.c_str()); return 2; }
+
+  if (outPath.empty()) {
+    fputs(json.c_str(), stdout);
+  } else {
+    FILE* f = fopen(outPath.c_str(), "w");
+    if (!f) { fprintf(stderr, "[BENCH] Ne morem pisati %s\n", outPath.c_str()); return 1; }
+    fputs(json.c_str(), f);
+    fclose(f);
+  }
+  return 0;
+}
@@ -0,0 +1,101 @@
+// ============================================================================
+//  bench_frame_clock — FrameClock proti simuliranemu timerju in frame tasku
+//
+//  Diskretna simulacija v µs: periodičen timer (zakasnitev dispatch-a kot
+//  esp_timer task), frame task, ki se zbudi z zakasnitvijo (WiFi/višje
+//  prioritete) in dela naključno dolgo, občasno dlje od periode.
+//  Preverja:
+//    - vsota dt == prevzeti tick-i × perioda (čas efektov = čas izhoda)
+//    - frame-i + izpuščeni == tick-i timerja
+//  Poroča: takt, jitter, zamudo, izpuščene frame-e in število sestav mixerja
+//  na izhodni frame proti stari loop() poti (vTaskDelay(1) → ~1 ms).
+//
+//  Uporaba: bench_frame_clock [sekunde]
+//  Izhodna koda 0 = dt in štetje tick-ov se ujemata.
+// ============================================================================
+
+#include "frame_clock.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+static uint32_t rng = 12345;
+static uint32_t rnd(uint32_t n) { rng = rng * 1664525u + 1013904223u; return n ? (rng >> 8) % n : 0; }
+
+struct Scenario {
+  const char* name;
+  uint32_t dispatchMaxUs;   // esp_timer task zakasnitev
+  uint32_t wakeMaxUs;       // Zakasnitev zbujanja frame taska
+  uint32_t workMinUs, workMaxUs;
+  uint32_t stallEvery;      // Vsak n-ti frame dela stallUs (0 = nikoli)
+  uint32_t stallUs;
+};
+
+static const Scenario SCENARIOS[] = {
+  { "idle",        50,   100,  300,  800,  0,     0 },
+  { "show",        150,  500,  2000, 6000, 0,     0 },
+  { "wifi_stalls", 300,  2000, 2000, 6000, 200,   60000 },
+};
+
+static int runScenario(const Scenario& sc, double seconds) {
+  const uint32_t P = FRAME_PERIOD_US;
+  const uint64_t end = (uint64_t)(seconds * 1e6);
+  FrameClock clk;
+  clk.begin(P, 0);
+
+  uint64_t nextTick = P;          // Nominalni čas naslednjega tick-a
+  uint64_t taskFreeAt = 0;        // Task je zaseden do tega časa
+  uint64_t tickCount = 0, takenTicks = 0;
+  double dtSum = 0;
+  uint32_t frames = 0;
+
+  while (nextTick < end) {
+    uint64_t fired = nextTick + rnd(sc.dispatchMaxUs + 1);
+    clk.onTick((uint32_t)fired);
+    tickCount++;
+    nextTick += P;
+
+    // Task se zbudi po tick-u, ko je prost; če je zaseden do naslednjega
+    // tick-a, ta tick prevzame skupaj z naslednjim
+    uint64_t wake = fired + rnd(sc.wakeMaxUs + 1);
+    if (wake < taskFreeAt) wake = taskFreeAt;
+    if (wake >= nextTick + sc.dispatchMaxUs) continue;
+
+    float dt;
+    uint32_t n = clk.beginFrame((uint32_t)wake, dt);
+    if (!n) continue;
+    takenTicks += n;
+    dtSum += dt;
+    frames++;
+    uint32_t work = sc.workMinUs + rnd(sc.workMaxUs - sc.workMinUs + 1);
+    if (sc.stallEvery && frames % sc.stallEvery == 0) work = sc.stallUs;
+    taskFreeAt = wake + work;
+    clk.endFrame((uint32_t)taskFreeAt);
+  }
+
+  FrameClockStats st;
+  clk.getStats(st);
+  double dtExpected = takenTicks * (double)P * 1e-6;
+  bool dtOk = fabs(dtSum - dtExpected) < 1e-3 * (1 + dtExpected);
+  // Izpuščeni zadnji tick-i (po koncu simulacije) niso napaka
+  bool countOk = (uint64_t)st.frames + st.missed <= tickCount && tickCount - (st.frames + st.missed) <= 2;
+
+  // Stara pot: mixer.update() vsak loop (vTaskDelay(1) = 1 ms), izhod vsakih P µs
+  double oldComposes = P / 1000.0;
+
+  printf("[BENCH] %-12s takt=%6.2f Hz interval=%8.1f us jitter=%7.1f us zamuda max=%6u us\n",
+         sc.name, st.rateHz, st.intervalUs, st.jitterUs, st.maxLateUs);
+  printf("[BENCH] %-12s frame-i=%u izpuščeni=%u prekoračeni=%u delo max=%u us\n",
+         sc.name, st.frames, st.missed, st.overruns, st.maxWorkUs);
+  printf("[BENCH] %-12s dt vsota=%.3f s (tick-i × perioda %.3f s) %s | sestave/izhodni frame: 1 (prej ~%.0f)\n",
+         sc.name, dtSum, dtExpected, (dtOk && countOk) ? "OK" : "NEUJEMANJE", oldComposes);
+
+  return (dtOk && countOk && st.frames > 0) ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 30.0;
+  int fail = 0;
+  for (const Scenario& sc : SCENARIOS) fail |= runScenario(sc, seconds);
+  return fail;
+}
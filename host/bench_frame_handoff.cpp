@@ -0,0 +1,123 @@
+// ============================================================================
+//  bench_frame_handoff — obremenitveni test objave frame-a (readFrame)
+//
+//  Pisalec (ena nit) kliče onArtNetData() + update() v zanki; vsak vhodni
+//  frame ima vseh 512 bajtov enakih, zato je raztrgan frame takoj viden.
+//  Bralec (druga nit) kliče readFrame() in preverja:
+//    - vsi bajti enaki (ni raztrganih frame-ov)
+//    - seq monotono narašča
+//  Za primerjavo isto naredi še z neposrednim branjem getDmxOutput().
+//  Poroča latenco readFrame() (p50/p99/max) in čas držanja mutexa v update().
+//
+//  Uporaba: bench_frame_handoff [sekunde]
+//  Izhodna koda 0 = brez raztrganih frame-ov prek readFrame().
+// ============================================================================
+
+#include "fixture_engine.h"
+#include "mixer_engine.h"
+#include "scene_engine.h"
+#include "host_clock.h"
+#include "bench_common.h"
+#include <LittleFS.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+namespace fs_ = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static FixtureEngine fixtures;
+static SceneEngine   scenes;
+static MixerEngine   mixer;
+
+static std::atomic<bool> running{true};
+
+static bool uniform(const uint8_t* d) {
+  for (int i = 1; i < DMX_MAX_CHANNELS; i++) if (d[i] != d[0]) return false;
+  return true;
+}
+
+static double pct(std::vector<double>& v, double p) {
+  if (v.empty()) return 0;
+  size_t k = (size_t)(p * (v.size() - 1));
+  std::nth_element(v.begin(), v.begin() + k, v.end());
+  return v[k];
+}
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+
+  fs_::path root = fs_::temp_directory_path() / "bench_frame_handoff";
+  Serial.setQuiet(true);
+  benchRoot(root, nullptr);
+  hostClockSetUs(1000000);
+
+  // Brez patcha: izhodni korak pusti ArtNet vhod nespremenjen
+  benchEngines(fixtures, scenes, &mixer);
+  hostClockAdvanceUs(2000000);   // Iztek mode fade-a
+
+  std::vector<double> holdNs;
+  holdNs.reserve(1 << 20);
+  long written = 0;
+
+  std::thread writer([&] {
+    uint8_t in[DMX_MAX_CHANNELS];
+    uint8_t v = 0;
+    while (running.load(std::memory_order_relaxed)) {
+      memset(in, ++v, sizeof(in));
+      mixer.onArtNetData(in, DMX_MAX_CHANNELS);
+      hostClockAdvanceUs(1000);
+      auto t0 = Clock::now();
+      mixer.update();
+      auto t1 = Clock::now();
+      if (holdNs.size() < holdNs.capacity())
+        holdNs.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+      written++;
+    }
+  });
+
+  // --- Bralec: readFrame() ---
+  std::vector<double> readNs;
+  readNs.reserve(1 << 20);
+  long reads = 0, torn = 0, backwards = 0, rawReads = 0, rawTorn = 0;
+  uint32_t lastSeq = 0;
+  DmxFrame frame;
+  uint8_t raw[DMX_MAX_CHANNELS];
+
+  auto end = Clock::now() + std::chrono::duration<double>(seconds);
+  while (Clock::now() < end) {
+    auto t0 = Clock::now();
+    mixer.readFrame(frame);
+    auto t1 = Clock::now();
+    if (readNs.size() < readNs.capacity())
+      readNs.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+    reads++;
+    if (!uniform(frame.data)) torn++;
+    if ((int32_t)(frame.seq - lastSeq) < 0) backwards++;
+    lastSeq = frame.seq;
+
+    // Primerjava: neposredno branje delovnega bufferja brez locka
+    memcpy(raw, mixer.getDmxOutput(), DMX_MAX_CHANNELS);
+    rawReads++;
+    if (!uniform(raw)) rawTorn++;
+  }
+  running = false;
+  writer.join();
+
+  printf("[BENCH] frame-i zapisani=%ld, branja=%ld\n", written, reads);
+  printf("[BENCH] readFrame(): raztrgani=%ld, seq nazaj=%ld\n", torn, backwards);
+  printf("[BENCH] readFrame() latenca: p50=%.0f ns p99=%.0f ns max=%.0f ns\n",
+         pct(readNs, 0.5), pct(readNs, 0.99), pct(readNs, 1.0));
+  printf("[BENCH] update() (čas držanja mutexa): p50=%.0f ns p99=%.0f ns max=%.0f ns\n",
+         pct(holdNs, 0.5), pct(holdNs, 0.99), pct(holdNs, 1.0));
+  printf("[BENCH] getDmxOutput() brez locka (primerjava): raztrgani=%ld od %ld\n", rawTorn, rawReads);
+
+  std::error_code ec;
+  fs_::remove_all(root, ec);
+  return (torn || backwards) ? 1 : 0;
+}
@@ -0,0 +1,237 @@
+// ============================================================================
+//  bench_journal — persistenca mixer stanja: checkpoint + dnevnik sprememb
+//
+//  Regije kot v MixerEngine z dvema univerzama (2 × 512 ročnih vrednosti,
+//  master, group dimmerji). Delovna obremenitev: seje s faderji (nekaj
+//  kanalov), master/group, občasen recall scene (velik del univerze).
+//  Po vsakem shranjevanju (kot saveStateNow) se občasno preveri, da nov
+//  nalagalnik vrne natanko referenčno stanje.
+//  Poroča: zapisani bajti proti spremenjenim in proti staremu prepisu
+//  /mixer.bin + /mixer_u.bin, p50/max trajanje sync() s kompakcijo.
+//  Preveri: dnevnik, odrezan na naključnem mestu, naloži zadnje celo stanje;
+//  dnevnik stare generacije se ignorira.
+//
+//  Uporaba: bench_journal [--saves N]
+//  Izhodna koda 0 = ujemanje.
+// ============================================================================
+
+#include "state_journal.h"
+#include "bench_common.h"
+#include <LittleFS.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace fs_ = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static BenchRng rnd{4242};
+
+static int failures = 0;
+#define CHECK(c, ...) do { if (!(c)) { printf("[BENCH] NAPAKA: " __VA_ARGS__); printf("\n"); failures++; } } while (0)
+
+static const char* CKPT = "/mixer.bin";
+static const char* JNL  = "/mixer.jnl";
+
+struct State {
+  uint8_t u0[DMX_MAX_CHANNELS];
+  uint8_t u1[DMX_MAX_CHANNELS];
+  uint8_t master;
+  uint8_t groups[MAX_GROUPS];
+
+  void reset() { memset(u0, 0, sizeof(u0)); memset(u1, 0, sizeof(u1)); master = 255; memset(groups, 255, sizeof(groups)); }
+  bool operator==(const State& o) const { return memcmp(this, &o, sizeof(State)) == 0; }
+};
+
+static void attach(StateJournal& j, State& s) {
+  j.begin(CKPT, JNL);
+  j.addRegion(0, s.u0, DMX_MAX_CHANNELS);
+  j.addRegion(0x40, &s.master, 1);
+  j.addRegion(0x41, s.groups, MAX_GROUPS);
+  j.addRegion(1, s.u1, DMX_MAX_CHANNELS);
+}
+
+static bool loadInto(State& s, JournalStats* st = nullptr) {
+  static StateJournal j;               // Regije se ob ponovnem begin()/addRegion() samo preusmerijo
+  s.reset();
+  attach(j, s);
+  bool ok = j.load();
+  if (st) j.getStats(*st);
+  return ok;
+}
+
+// Ena "uporabniška" sprememba med dvema shranjevanjema; vrne število spremenjenih bajtov
+static int mutate(State& s) {
+  State before = s;
+  uint32_t k = rnd() % 100;
+  if (k < 70) {                                        // Fader seja: 1-8 sosednjih kanalov
+    uint8_t* u = (rnd() & 1) ? s.u0 : s.u1;
+    int base = rnd() % (DMX_MAX_CHANNELS - 8), n = 1 + rnd() % 8;
+    for (int i = 0; i < n; i++) u[base + i] = rnd() & 0xFF;
+  } else if (k < 85) {
+    s.master = rnd() & 0xFF;
+  } else if (k < 95) {
+    s.groups[rnd() % MAX_GROUPS] = rnd() & 0xFF;
+  } else {                                             // Recall scene: pol univerze
+    uint8_t* u = (rnd() & 1) ? s.u0 : s.u1;
+    for (int i = 0; i < DMX_MAX_CHANNELS; i++) if (rnd() & 1) u[i] = rnd() & 0xFF;
+  }
+  const uint8_t* a = (const uint8_t*)&before;
+  const uint8_t* b = (const uint8_t*)&s;
+  int changed = 0;
+  for (size_t i = 0; i < sizeof(State); i++) changed += a[i] != b[i];
+  return changed;
+}
+
+// ============================================================================
+//  MERITEV
+// ============================================================================
+
+static void runWorkload(int saves) {
+  LittleFS.remove(CKPT);
+  LittleFS.remove(JNL);
+  State s;
+  s.reset();
+  StateJournal j;
+  attach(j, s);
+  j.checkpoint();
+  LittleFS.resetStats();
+
+  uint64_t changedBytes = 0;
+  std::vector<double> lat;
+  for (int i = 0; i < saves; i++) {
+    changedBytes += mutate(s);
+    auto t0 = Clock::now();
+    j.sync();
+    lat.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+    if (i % 50 == 49 || i == saves - 1) {
+      State r;
+      loadInto(r);
+      CHECK(r == s, "ponovno nalaganje po %d shranjevanjih != referenca", i + 1);
+    }
+  }
+
+  JournalStats st;
+  j.getStats(st);
+  uint64_t written = LittleFS.bytesWritten;
+  // Stara pot: /mixer.bin (2 + skupine + 512) in /mixer_u.bin (1 + 512 na univerzo) ob vsakem shranjevanju
+  uint64_t oldWritten = (uint64_t)saves * ((2 + MAX_GROUPS + DMX_MAX_CHANNELS) + (1 + DMX_MAX_CHANNELS));
+  std::sort(lat.begin(), lat.end());
+
+  printf("[BENCH] %d shranjevanj: %u v dnevnik, %u checkpointov (dnevnik do %u B)\n",
+         saves, (unsigned)st.appends, (unsigned)st.checkpoints, JOURNAL_MAX_BYTES);
+  printf("[BENCH] flash: %llu B zapisanih za %llu spremenjenih B (%.1fx) | stari prepis %llu B (%.1fx manj)\n",
+         (unsigned long long)written, (unsigned long long)changedBytes,
+         changedBytes ? (double)written / changedBytes : 0.0, (unsigned long long)oldWritten,
+         written ? (double)oldWritten / written : 0.0);
+  printf("[BENCH] sync(): p50 %.1f us, p99 %.1f us, max %.1f us (host FS, s kompakcijo)\n",
+         lat[lat.size() / 2], lat[lat.size() * 99 / 100], lat.back());
+}
+
+// Prekinjen zapis: dnevnik odrezan kjerkoli → stanje po zadnjem celem zapisu
+static void runTornTail(int trials) {
+  for (int t = 0; t < trials; t++) {
+    LittleFS.remove(CKPT);
+    LittleFS.remove(JNL);
+    State s;
+    s.reset();
+    StateJournal j;
+    attach(j, s);
+    j.checkpoint();
+
+    // Samo majhne spremembe, da ostanejo v dnevniku
+    std::vector<State> states{ s };
+    std::vector<uint32_t> ends{ 0 };
+    for (int i = 0; i < 20; i++) {
+      uint8_t* u = (rnd() & 1) ? s.u0 : s.u1;
+      u[rnd() % DMX_MAX_CHANNELS] = rnd() & 0xFF;
+      s.master = rnd() & 0xFF;
+      j.sync();
+      JournalStats st;
+      j.getStats(st);
+      states.push_back(s);
+      ends.push_back(st.journalBytes);
+    }
+
+    fs_::path hp = LittleFS.hostPath(JNL);
+    uint32_t size = (uint32_t)fs_::file_size(hp);
+    uint32_t cut = rnd() % (size + 1);
+    fs_::resize_file(hp, cut);
+    size_t k = 0;                                      // Zadnji zapis, ki je v celoti pred rezom
+    for (size_t i = 1; i < ends.size(); i++) if (ends[i] <= cut) k = i;
+
+    State r;
+    JournalStats st;
+    CHECK(loadInto(r, &st), "prekinjen (%u/%u B): load", cut, size);
+    CHECK(r == states[k], "prekinjen (%u/%u B): stanje != zapis %zu", cut, size, k);
+    bool torn = cut != ends[k] && cut > 8;
+    CHECK(st.tornTail == torn, "prekinjen (%u/%u B): tornTail=%d", cut, size, st.tornTail);
+
+    // Naslednji sync zapiše checkpoint; nato se stanje naloži brez napak
+    static StateJournal w;
+    State cur = r;
+    attach(w, cur);
+    w.load();
+    cur.u0[0] ^= 1;
+    w.sync();
+    State r2;
+    CHECK(loadInto(r2, &st) && r2 == cur && !st.tornTail, "prekinjen: po popravku");
+  }
+}
+
+// Izpad med kompakcijo: nov checkpoint je zapisan, star dnevnik še obstaja
+static void runStaleGeneration() {
+  LittleFS.remove(CKPT);
+  LittleFS.remove(JNL);
+  State s;
+  s.reset();
+  StateJournal j;
+  attach(j, s);
+  j.checkpoint();
+  s.u0[10] = 77;
+  j.sync();
+  std::vector<uint8_t> old;
+  {
+    File f = LittleFS.open(JNL, "r");
+    old.resize(f.size());
+    f.read(old.data(), old.size());
+    f.close();
+  }
+  s.u0[10] = 5;
+  s.master = 9;
+  j.checkpoint();
+  File f = LittleFS.open(JNL, "w");
+  f.write(old.data(), old.size());
+  f.close();
+
+  State r;
+  JournalStats st;
+  CHECK(loadInto(r, &st), "stara generacija: load");
+  CHECK(r == s && st.replayed == 0, "stara generacija: dnevnik ni bil ignoriran (u0[10]=%d)", r.u0[10]);
+  CHECK(!LittleFS.exists(JNL), "stara generacija: dnevnik ni odstranjen");
+}
+
+int main(int argc, char** argv) {
+  int saves = 2000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--saves") && i + 1 < argc) saves = atoi(argv[++i]);
+  }
+
+  fs_::path root = fs_::temp_directory_path() / "bench_journal";
+  std::error_code ec;
+  fs_::remove_all(root, ec);
+  Serial.setQuiet(true);
+  LittleFS.setRoot(root.c_str());
+  LittleFS.begin();
+
+  runWorkload(saves);
+  runTornTail(200);
+  runStaleGeneration();
+
+  printf("[BENCH] %s\n", failures ? "NEUJEMANJE" : "OK");
+  return failures ? 1 : 0;
+}
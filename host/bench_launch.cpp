@@ -0,0 +1,305 @@
+// ============================================================================
+//  bench_launch — kvantizirani ukazi (LaunchQueue) proti idealni beat mreži
+//
+//  Diskretna simulacija v µs: idealna beat mreža (tempo se lahko spremeni),
+//  beat ura, vzorčena vsakih ~11.6 ms kot audio task (faza z ms
+//  kvantizacijo), frame-i vsakih FRAME_PERIOD_US z jitterjem, delo frame-a,
+//  DMX paket (512 slotov) in dodatna zakasnitev fixture-a. Ukazi prihajajo
+//  naključno s kvanti 1 / 4 / 16 beatov.
+//  Preveri: luč zasveti na meji kvanta (beat % kvant == 0), napaka do beata
+//  največ pol periode frame-a (+ rezerva za vzorčenje ure in jitter), nobena
+//  dosegljiva meja ni preskočena, sprememba tempa med čakanjem, poravnava na
+//  takt pri Link (barBeat), skok števca nazaj, brez ure = takoj, več ukazov
+//  na isti meji v vrstnem redu prihoda.
+//  Poroča: |napaka| p50/p99/max proti izvedbi brez kompenzacije zakasnitve
+//  in brez kvantizacije (takoj, do najbližje meje).
+//
+//  Uporaba: bench_launch [sekunde]
+//  Izhodna koda 0 = vse meje zadete.
+// ============================================================================
+
+#include "launch_queue.h"
+#include "frame_clock.h"
+#include "bench_common.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static BenchRng rnd{2203};
+static uint32_t rndN(uint32_t n) { return n ? rnd() % n : 0; }
+
+static int failures = 0;
+#define CHECK(c, ...) do { if (!(c)) { printf("[BENCH] NAPAKA: " __VA_ARGS__); printf("\n"); failures++; } } while (0)
+
+static const uint32_t PERIOD_US   = FRAME_PERIOD_US;
+static const uint32_t SAMPLE_US   = 11610;        // Audio task (512 vzorcev @ 44.1 kHz)
+static const uint32_t PACKET_US   = 22700;        // Break + MAB + 513 slotov
+static const uint32_t FIXTURE_US  = 8000;         // Dodatna zakasnitev (nastavljena)
+static const uint32_t JITTER_US   = 2000;         // Zbujanje frame taska
+static const uint32_t WORK_MIN_US = 1500, WORK_MAX_US = 5000;
+// Rezerva nad pol periode: ms faza ure, jitter zbujanja, raztros dela proti EMA
+static const double   MARGIN_US   = 1000 + JITTER_US + (WORK_MAX_US - WORK_MIN_US);
+
+// ============================================================================
+//  IDEALNA MREŽA — odseki s konstantnim tempom
+// ============================================================================
+
+struct TempoSeg { double t0; double pos0; double intervalUs; };
+
+struct Grid {
+  std::vector<TempoSeg> segs;
+  int8_t barOffset = -1;            // ≥ 0: Link, takt se začne pri (beat + off) % 4 == 0
+
+  void reset(double intervalUs) { segs.assign(1, { 0.0, 0.0, intervalUs }); }
+  void setTempo(double t, double intervalUs) { segs.push_back({ t, pos(t), intervalUs }); }
+  const TempoSeg& segAt(double t) const {
+    size_t i = segs.size() - 1;
+    while (i > 0 && segs[i].t0 > t) i--;
+    return segs[i];
+  }
+  double pos(double t) const { const TempoSeg& s = segAt(t); return s.pos0 + (t - s.t0) / s.intervalUs; }
+  double beatTime(double b) const {
+    size_t i = segs.size() - 1;
+    while (i > 0 && segs[i].pos0 > b) i--;
+    return segs[i].t0 + (b - segs[i].pos0) * segs[i].intervalUs;
+  }
+  double intervalAt(double t) const { return segAt(t).intervalUs; }
+};
+
+// Posnetek ure, kot ga objavi SoundEngine: števec, faza z ms kvantizacijo
+static BeatClock sampleClock(const Grid& g, uint64_t t, int32_t countOffset) {
+  BeatClock c = {};
+  double p = g.pos((double)t);
+  double iv = g.intervalAt((double)t);
+  double whole = floor(p);
+  double elapsedMs = floor((p - whole) * iv / 1000.0);
+  c.valid = true;
+  c.beatCount = (uint32_t)((int64_t)whole + countOffset);
+  c.phase = (float)(elapsedMs * 1000.0 / iv);
+  c.sampleUs = (uint32_t)t;
+  c.intervalUs = (uint32_t)iv;
+  c.barBeat = g.barOffset >= 0 ? (int8_t)(((int64_t)whole + g.barOffset) % BEATS_PER_BAR) : -1;
+  return c;
+}
+
+// ============================================================================
+//  SIMULACIJA
+// ============================================================================
+
+struct Issued {
+  uint64_t arriveUs;
+  uint8_t  quantum;
+  bool     fired = false;
+  uint64_t lightUs = 0;            // Frame start + delo + paket + fixture
+};
+
+struct Sim {
+  LaunchQueue q;
+  std::vector<Issued> issued;
+  uint64_t curLightUs = 0;
+};
+
+static void simExec(const LaunchItem& it, void* ctx) {
+  Sim* s = (Sim*)ctx;
+  Issued& x = s->issued[it.arg];
+  CHECK(!x.fired, "ukaz %d izveden dvakrat", it.arg);
+  x.fired = true;
+  x.lightUs = s->curLightUs;
+}
+
+struct RunCfg {
+  const char* name;
+  double   seconds;
+  double   bpm;
+  double   bpmChange;              // > 0: nov tempo na polovici
+  int8_t   barOffset;              // Link
+  bool     compensate;             // false = brez zakasnitve (stara pot)
+  int32_t  countJumpAt;            // > 0: frame, kjer števec skoči nazaj
+};
+
+static double pct(std::vector<double> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, (size_t)(p * (v.size() - 1) + 0.5))];
+}
+
+// Vrne |napake| do meje (µs); preverja samo, ko je kompenzacija vklopljena
+static std::vector<double> runSim(const RunCfg& rc, double* immediateOut) {
+  Sim s;
+  s.q.begin(simExec, &s);
+  if (rc.compensate) s.q.setExtraLatencyUs(FIXTURE_US);
+  Grid g;
+  g.reset(60e6 / rc.bpm);
+  g.barOffset = rc.barOffset;
+
+  const uint64_t end = (uint64_t)(rc.seconds * 1e6);
+  const uint64_t startAt = 2000000;                // EMA zakasnitve se ujame
+  uint64_t nextArrival = startAt + rndN(400000);
+  uint64_t lastSample = 0;
+  BeatClock clk = sampleClock(g, 0, 0);
+  int32_t countOffset = 0;
+  bool tempoChanged = false;
+  std::vector<double> immErr;
+
+  for (uint64_t n = 1; ; n++) {
+    uint64_t frameStart = n * PERIOD_US + rndN(JITTER_US);
+    if (frameStart >= end) break;
+
+    if (rc.bpmChange > 0 && !tempoChanged && frameStart > end / 2) {
+      g.setTempo((double)frameStart - 1, 60e6 / rc.bpmChange);
+      tempoChanged = true;
+    }
+    if (rc.countJumpAt > 0 && n == (uint64_t)rc.countJumpAt) countOffset = -1000;
+
+    // Zadnji posnetek audio taska pred začetkom frame-a
+    while (lastSample + SAMPLE_US <= frameStart) {
+      lastSample += SAMPLE_US;
+      clk = sampleClock(g, lastSample, countOffset);
+    }
+
+    // Ukazi, ki so prišli od prejšnjega frame-a (WebSocket pod lockom)
+    while (nextArrival <= frameStart) {
+      static const uint8_t QS[] = { 1, 4, 16 };
+      Issued x;
+      x.arriveUs = nextArrival;
+      x.quantum = QS[rndN(3)];
+      s.issued.push_back(x);
+      bool ok = s.q.enqueue(LA_SCENE, x.quantum, (int16_t)(s.issued.size() - 1));
+      CHECK(ok, "polna vrsta");
+      // Neposredna izvedba (brez kvanta): luč ob naslednjem frame-u
+      double immLight = (double)frameStart + (WORK_MIN_US + WORK_MAX_US) / 2 + PACKET_US + FIXTURE_US;
+      double b = round(g.pos(immLight) / x.quantum) * x.quantum;
+      immErr.push_back(fabs(immLight - g.beatTime(b)));
+      nextArrival += 300000 + rndN(1500000);
+    }
+
+    uint32_t work = WORK_MIN_US + rndN(WORK_MAX_US - WORK_MIN_US + 1);
+    s.curLightUs = frameStart + work + PACKET_US + FIXTURE_US;
+    s.q.tick((uint32_t)frameStart, PERIOD_US, clk);
+    if (rc.compensate) s.q.noteOutputLatencyUs(work + PACKET_US);
+  }
+
+  std::vector<double> errs;
+  for (size_t i = 0; i < s.issued.size(); i++) {
+    const Issued& x = s.issued[i];
+    if (!x.fired) continue;                          // Meja po koncu simulacije
+    double b = round(g.pos((double)x.lightUs));
+    double err = (double)x.lightUs - g.beatTime(b);
+    errs.push_back(fabs(err));
+    if (!rc.compensate) continue;
+
+    // Števec po skoku ni več poravnan z idealno mrežo — preveri samo fazo
+    bool jumped = rc.countJumpAt > 0 && x.lightUs >= (uint64_t)rc.countJumpAt * PERIOD_US;
+    // Link: takt se začne pri (beat + off) % 4 == 0, fraze štejejo od istega sidra
+    int64_t anchor = rc.barOffset >= 0 ? (BEATS_PER_BAR - rc.barOffset % BEATS_PER_BAR) % BEATS_PER_BAR : 0;
+    int64_t bi = (int64_t)b - anchor;
+    if (!jumped) {
+      CHECK(bi % x.quantum == 0, "%s: ukaz %zu (kvant %u) na beatu %lld", rc.name, i, x.quantum, (long long)b);
+      // Prejšnja meja je bila ob prihodu nedosegljiva (izhod bi bil že prepozen)
+      double latency = (WORK_MIN_US + WORK_MAX_US) / 2 + PACKET_US + FIXTURE_US;
+      double prev = g.beatTime(b - x.quantum);
+      CHECK(prev < (double)x.arriveUs + latency + PERIOD_US + MARGIN_US,
+            "%s: ukaz %zu preskočil mejo (prihod %.1f ms, prejšnja meja %.1f ms)",
+            rc.name, i, x.arriveUs / 1e3, prev / 1e3);
+    }
+    CHECK(fabs(err) <= PERIOD_US * 0.5 + MARGIN_US,
+          "%s: ukaz %zu napaka %.0f us (beat %.0f)", rc.name, i, err, b);
+  }
+  LaunchStats st;
+  s.q.getStats(st);
+  if (rc.compensate) {
+    CHECK(st.immediate == 0, "%s: %u ukazov brez ure", rc.name, st.immediate);
+    CHECK(!errs.empty(), "%s: noben ukaz", rc.name);
+  }
+  if (immediateOut) *immediateOut = pct(immErr, 0.5);
+  printf("[BENCH] %-18s ukazi=%4zu |napaka| p50=%6.1f p99=%6.1f max=%6.1f ms zakasnitev=%5.1f ms pozni=%u\n",
+         rc.name, errs.size(), pct(errs, 0.5) / 1e3, pct(errs, 0.99) / 1e3,
+         errs.empty() ? 0.0 : *std::max_element(errs.begin(), errs.end()) / 1e3,
+         st.latencyUs / 1e3, st.late);
+  return errs;
+}
+
+// ============================================================================
+//  ROBNI PRIMERI
+// ============================================================================
+
+static std::vector<int> fired;
+static void recExec(const LaunchItem& it, void*) { fired.push_back(it.arg); }
+
+static void runEdgeCases() {
+  LaunchQueue q;
+  q.begin(recExec, nullptr);
+
+  // Brez ure: takoj, v vrstnem redu prihoda
+  BeatClock none = {};
+  fired.clear();
+  q.enqueue(LA_SCENE, 4, 1);
+  q.enqueue(LA_CUE_GO, 16, 2);
+  q.tick(1000, PERIOD_US, none);
+  CHECK(fired.size() == 2 && fired[0] == 1 && fired[1] == 2, "brez ure ni takoj");
+
+  // Kvant 0 = takoj tudi z uro
+  BeatClock clk = {};
+  clk.valid = true; clk.beatCount = 10; clk.phase = 0.1f; clk.sampleUs = 0; clk.intervalUs = 500000; clk.barBeat = -1;
+  fired.clear();
+  q.enqueue(LA_PROGRAM, 0, 3);
+  q.tick(0, PERIOD_US, clk);
+  CHECK(fired.size() == 1, "kvant 0 ni takoj");
+
+  // Dva ukaza na isto mejo (takt): oba v istem frame-u, po prihodu; beat prej ne
+  fired.clear();
+  q.enqueue(LA_PB_GO, 4, 7);
+  q.enqueue(LA_PB_RELEASE, 1, 8);              // Beat 11 — prej
+  q.enqueue(LA_SCENE, 4, 9);
+  uint32_t t = 0;
+  size_t atBeat11 = 0;
+  for (; t < 2000000 && fired.size() < 3; t += PERIOD_US) {
+    q.tick(t, PERIOD_US, clk);
+    if (fired.size() == 1 && !atBeat11) atBeat11 = t;
+  }
+  CHECK(fired.size() == 3 && fired[0] == 8 && fired[1] == 7 && fired[2] == 9, "vrstni red na isti meji");
+  CHECK(atBeat11 > 0 && atBeat11 < t, "beat pred taktom");
+  CHECK(q.pendingCount() == 0, "vrsta ni prazna");
+
+  // Polna vrsta
+  for (int i = 0; i < LAUNCH_MAX_PENDING; i++) q.enqueue(LA_SCENE, 16, i);
+  CHECK(!q.enqueue(LA_SCENE, 16, 99), "polna vrsta sprejela");
+  q.cancelAll();
+  CHECK(q.pendingCount() == 0, "cancelAll");
+  LaunchStats st;
+  q.getStats(st);
+  CHECK(st.dropped == 1, "dropped=%u", st.dropped);
+  printf("[BENCH] robni primeri        %s\n", failures ? "NEUJEMANJE" : "OK");
+}
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 600.0;
+
+  runEdgeCases();
+
+  std::vector<RunCfg> runs = {
+    { "128bpm",          seconds, 128, 0,   -1, true,  0 },
+    { "tempo 128->140",  seconds, 128, 140, -1, true,  0 },
+    { "link takt",       seconds, 124, 0,   2,  true,  0 },
+    { "skok stevca",     seconds, 128, 0,   -1, true,  (int32_t)(seconds * 1e6 / PERIOD_US / 2) },
+  };
+  std::vector<double> base;
+  double immediateP50 = 0;
+  for (const RunCfg& rc : runs) {
+    std::vector<double> e = runSim(rc, &immediateP50);
+    if (&rc == &runs[0]) base = e;
+  }
+
+  // Primerjava: ista mreža brez kompenzacije zakasnitve
+  rnd.s = 2203;
+  RunCfg raw = { "brez kompenzacije", seconds, 128, 0, -1, false, 0 };
+  std::vector<double> u = runSim(raw, nullptr);
+  printf("[BENCH] |napaka| p50: kvantizirano %.1f ms | brez kompenzacije %.1f ms | takoj (do najbližje meje) %.1f ms\n",
+         pct(base, 0.5) / 1e3, pct(u, 0.5) / 1e3, immediateP50 / 1e3);
+  CHECK(pct(base, 0.5) < pct(u, 0.5), "kompenzacija ne izboljša napake");
+
+  printf("[BENCH] %s\n", failures ? "NEUJEMANJE" : "OK");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,153 @@
+// ============================================================================
+//  bench_merge — HTP/LTP spajanje virov (mergeKernel) proti skalarni referenci
+//
+//  Trije viri (ArtNet, lokalno, OSC) se vsak frame naključno spremenijo na
+//  delu kanalov; množica sodelujočih virov se občasno zamenja (timeout,
+//  prioriteta). Referenca je naivna implementacija z vejitvami po kanalu in
+//  časovnim žigom zadnje spremembe. Izhod in LTP lastnik morata biti enaka.
+//  Poroča čas na frame za kernel in referenco (512 kanalov).
+//  Dodatno: LFO na lokalnem izhodu (ročne vrednosti mirujejo), ArtNet premika
+//  LTP kanal — lastnik mora ostati ArtNet, izhod njegova vrednost.
+//
+//  Uporaba: bench_merge [frame-i]
+//  Izhodna koda 0 = ujemanje.
+// ============================================================================
+
+#include "merge_engine.h"
+#include "bench_common.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using Clock = std::chrono::steady_clock;
+
+static BenchRng rnd{12345};
+
+// ============================================================================
+//  REFERENCA
+// ============================================================================
+
+struct RefState {
+  uint8_t  last[MERGE_SRC_COUNT][DMX_MAX_CHANNELS];
+  uint8_t  owner[DMX_MAX_CHANNELS];
+  uint8_t  part;
+};
+
+static void refMerge(RefState& st, const uint8_t* const src[MERGE_SRC_COUNT], uint8_t part,
+                     const uint8_t* htp, uint8_t* out) {
+  if (part != st.part) {
+    int first = MERGE_SRC_LOCAL;
+    for (int s = 0; s < MERGE_SRC_COUNT; s++) if (part & (1 << s)) { first = s; break; }
+    for (int i = 0; i < DMX_MAX_CHANNELS; i++) {
+      if (!(part & (1 << st.owner[i]))) st.owner[i] = first;
+    }
+    st.part = part;
+  }
+  for (int i = 0; i < DMX_MAX_CHANNELS; i++) {
+    for (int s = 0; s < MERGE_SRC_COUNT; s++) {
+      if ((part & (1 << s)) && src[s][i] != st.last[s][i]) st.owner[i] = s;
+      st.last[s][i] = src[s][i];
+    }
+    if (htp[i]) {
+      uint8_t m = 0;
+      for (int s = 0; s < MERGE_SRC_COUNT; s++) {
+        if ((part & (1 << s)) && src[s][i] > m) m = src[s][i];
+      }
+      out[i] = m;
+    } else {
+      out[i] = src[st.owner[i]][i];
+    }
+  }
+}
+
+// ============================================================================
+//  MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+  long frames = argc > 1 ? atol(argv[1]) : 20000;
+
+  static MergeBuffers mb;
+  static RefState ref;
+  mergeInit(mb);
+  memset(&ref, 0, sizeof(ref));
+  memset(ref.owner, MERGE_SRC_LOCAL, sizeof(ref.owner));
+
+  // Vsak tretji kanal HTP (intensity), ostali LTP
+  for (int i = 0; i < DMX_MAX_CHANNELS; i++) mb.htp[i] = (i % 3 == 0) ? 0xFF : 0x00;
+
+  static uint8_t buf[MERGE_SRC_COUNT][DMX_MAX_CHANNELS];
+  memset(buf, 0, sizeof(buf));
+  const uint8_t* const src[MERGE_SRC_COUNT] = { buf[0], buf[1], buf[2] };
+  uint8_t out[DMX_MAX_CHANNELS], refOut[DMX_MAX_CHANNELS];
+  uint8_t part = (1 << MERGE_SRC_LOCAL);
+  long mismatches = 0;
+  double kernelNs = 0, refNs = 0;
+
+  for (long f = 0; f < frames; f++) {
+    // Vsak vir spremeni nekaj kanalov (ArtNet več, OSC malo)
+    static const int CHANGES[MERGE_SRC_COUNT] = { 64, 16, 4 };
+    for (int s = 0; s < MERGE_SRC_COUNT; s++) {
+      for (int k = 0; k < CHANGES[s]; k++) buf[s][rnd() % DMX_MAX_CHANNELS] = (uint8_t)rnd();
+    }
+    if (f % 500 == 0) part = (uint8_t)(1 + rnd() % 7);
+
+    auto t0 = Clock::now();
+    mergeKernel(mb, src, part, out, DMX_MAX_CHANNELS);
+    auto t1 = Clock::now();
+    refMerge(ref, src, part, mb.htp, refOut);
+    auto t2 = Clock::now();
+    kernelNs += std::chrono::duration<double, std::nano>(t1 - t0).count();
+    refNs    += std::chrono::duration<double, std::nano>(t2 - t1).count();
+
+    if (memcmp(out, refOut, DMX_MAX_CHANNELS) != 0 || memcmp(mb.owner, ref.owner, DMX_MAX_CHANNELS) != 0) {
+      if (mismatches < 5) printf("[BENCH] Razlika: frame %ld (part=0x%02X)\n", f, part);
+      mismatches++;
+    }
+  }
+
+  // Sprostitev: ArtNet potekel → HTP max, LTP v lasti ArtNet-a
+  uint8_t local[DMX_MAX_CHANNELS];
+  memcpy(local, buf[MERGE_SRC_LOCAL], DMX_MAX_CHANNELS);
+  mergeRelease(mb, MERGE_SRC_ARTNET, buf[MERGE_SRC_ARTNET], local, DMX_MAX_CHANNELS);
+  long releaseErr = 0;
+  for (int i = 0; i < DMX_MAX_CHANNELS; i++) {
+    uint8_t a = buf[MERGE_SRC_ARTNET][i], l = buf[MERGE_SRC_LOCAL][i];
+    uint8_t e = mb.htp[i] ? (a > l ? a : l) : (mb.owner[i] == MERGE_SRC_ARTNET ? a : l);
+    if (local[i] != e) releaseErr++;
+  }
+
+  // LFO + ArtNet na LTP kanalu: zaznava lokalnega vira na ročnih vrednostih
+  static MergeBuffers lb;
+  mergeInit(lb);
+  memset(lb.htp, 0x00, sizeof(lb.htp));   // Vse LTP
+  static uint8_t art[DMX_MAX_CHANNELS], manual[DMX_MAX_CHANNELS], localOut[DMX_MAX_CHANNELS], osc[DMX_MAX_CHANNELS];
+  memset(art, 0, sizeof(art)); memset(manual, 0, sizeof(manual)); memset(osc, 0, sizeof(osc));
+  const uint8_t* const lsrc[MERGE_SRC_COUNT] = { art, localOut, osc };
+  const uint8_t lpart = (1 << MERGE_SRC_ARTNET) | (1 << MERGE_SRC_LOCAL);
+  const int PAN = 10;
+  manual[PAN] = 100;
+  long lfoErr = 0;
+  for (int f = 0; f < 200; f++) {
+    if (f == 5) art[PAN] = 40;                   // ArtNet prevzame kanal
+    if (f >= 5 && f % 20 == 0) art[PAN] += 3;    // ... in ga še premika
+    memcpy(localOut, manual, DMX_MAX_CHANNELS);
+    localOut[PAN] = (uint8_t)(manual[PAN] + (f * 7) % 50);   // LFO overlay
+    mergeKernel(lb, lsrc, lpart, out, DMX_MAX_CHANNELS, manual);
+    if (f >= 5 && (lb.owner[PAN] != MERGE_SRC_ARTNET || out[PAN] != art[PAN])) lfoErr++;
+    if (f < 5 && out[PAN] != localOut[PAN]) lfoErr++;   // Pred ArtNet-om: lokalni izhod z LFO
+  }
+  // Premik ročnega faderja vrne kanal lokalnemu viru (z LFO na izhodu)
+  manual[PAN] = 120;
+  memcpy(localOut, manual, DMX_MAX_CHANNELS);
+  localOut[PAN] = 133;
+  mergeKernel(lb, lsrc, lpart, out, DMX_MAX_CHANNELS, manual);
+  if (lb.owner[PAN] != MERGE_SRC_LOCAL || out[PAN] != 133) lfoErr++;
+
+  printf("[BENCH] frame-i=%ld neujemanja=%ld sprostitev napak=%ld LFO/LTP napak=%ld\n",
+         frames, mismatches, releaseErr, lfoErr);
+  printf("[BENCH] mergeKernel: %.0f ns/frame, referenca: %.0f ns/frame (512 kanalov, 3 viri)\n",
+         kernelNs / frames, refNs / frames);
+  return (mismatches || releaseErr || lfoErr) ? 1 : 0;
+}
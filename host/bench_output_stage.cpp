@@ -0,0 +1,354 @@
+// ============================================================================
+//  bench_output_stage — primerjava fuzioniranega izhodnega koraka MixerEngine
+//  z referenčno večprehodno implementacijo (limits → dimmer → blackout →
+//  flash, kot je bila v MixerEngine::update pred fuzijo).
+//
+//  Patchi se naključno (deterministično po seedu) sestavijo iz pravih
+//  profilov v data/profiles. Za vsak frame se primerja celoten izhod.
+//  ArtNet je pripet, zato spajanje virov izhoda ne spremeni; izhod mora
+//  biti bajt-identičen, tudi po ročnem preklopu na lokalno in nazaj.
+//  Pan/tilt omejitve so občasno obrnjene (min > max); remap16 se preveri še
+//  izčrpno proti int64 referenci.
+//
+//  Uporaba: bench_output_stage [profiles_dir] [patches] [frames]
+//  Izhodna koda 0 = ujemanje, 1 = razlika.
+// ============================================================================
+
+#include "fixture_engine.h"
+#include "mixer_engine.h"
+#include "scene_engine.h"
+#include "host_clock.h"
+#include "value16.h"
+#include "bench_common.h"
+#include <LittleFS.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+
+#ifndef DMX_PROFILES_DIR
+#define DMX_PROFILES_DIR "data/profiles"
+#endif
+
+namespace fs_ = std::filesystem;
+
+static FixtureEngine fixtures;
+static SceneEngine   scenes;
+static MixerEngine   mixer;
+
+// Stanje, ki ga bench nastavi v mixerju in ga referenca potrebuje
+struct StageInput {
+  uint8_t master;
+  uint8_t groupDim[MAX_GROUPS];
+  bool    blackout;
+  bool    flash;
+  uint8_t flashLevel;
+};
+
+// ============================================================================
+//  REFERENCA — večprehodna pot (hoja po profilih za vsak kanal)
+// ============================================================================
+
+// Fine kanal coarse kanala ch (hoja po profilu), -1 = ni para.
+// n-ti pan_fine/tilt_fine spada k n-temu pan/tilt; "fine": true k prejšnjemu kanalu.
+static int refFineOf(int fi, int ch) {
+  const ChannelDef* def = fixtures.fixtureChannel(fi, ch);
+  if (!def || def->fine) return -1;
+  uint8_t chCount = fixtures.fixtureChannelCount(fi);
+  if (def->type == CH_PAN || def->type == CH_TILT) {
+    uint8_t fineType = (def->type == CH_PAN) ? CH_PAN_FINE : CH_TILT_FINE;
+    int n = 0;
+    for (int c = 0; c < ch; c++) if (fixtures.fixtureChannel(fi, c)->type == def->type) n++;
+    for (int c = 0; c < chCount; c++) {
+      if (fixtures.fixtureChannel(fi, c)->type != fineType) continue;
+      if (n-- == 0) return c;
+    }
+    return -1;
+  }
+  const ChannelDef* next = fixtures.fixtureChannel(fi, ch + 1);
+  if (next && next->fine && next->type != CH_PAN_FINE && next->type != CH_TILT_FINE) return ch + 1;
+  return -1;
+}
+
+static bool refIsFine(int fi, int ch) {
+  for (int c = 0; c < fixtures.fixtureChannelCount(fi); c++) if (refFineOf(fi, c) == ch) return true;
+  return false;
+}
+
+// Pan/Tilt: invert + omejitve; par kot 16-bit vrednost
+static void refPanTilt(uint8_t* out) {
+  for (int i = 0; i < MAX_FIXTURES; i++) {
+    const PatchEntry* fx = fixtures.getFixture(i);
+    if (!fx || !fx->active || fx->profileIndex < 0) continue;
+    bool hasLimits = (fx->panMin > 0 || fx->panMax < 255 ||
+                      fx->tiltMin > 0 || fx->tiltMax < 255);
+    if (!fx->invertPan && !fx->invertTilt && !hasLimits) continue;
+
+    uint8_t chCount = fixtures.fixtureChannelCount(i);
+    for (int ch = 0; ch < chCount; ch++) {
+      const ChannelDef* def = fixtures.fixtureChannel(i, ch);
+      if (!def) continue;
+      uint16_t addr = fx->dmxAddress + ch - 1;
+      if (addr >= DMX_MAX_CHANNELS) continue;
+      bool pan = (def->type == CH_PAN || def->type == CH_PAN_FINE);
+      bool inv = pan ? fx->invertPan : fx->invertTilt;
+      uint8_t lo = pan ? fx->panMin : fx->tiltMin;
+      uint8_t hi = pan ? fx->panMax : fx->tiltMax;
+      if (def->type == CH_PAN || def->type == CH_TILT) {
+        int fc = refFineOf(i, ch);
+        if (fc >= 0) {
+          uint16_t faddr = fx->dmxAddress + fc - 1;
+          uint32_t v = (out[addr] << 8) | out[faddr];
+          if (inv) v = 65535 - v;
+          if (lo > 0 || hi < 255) v = (uint32_t)(lo * 257 + ((int64_t)v * ((hi - lo) * 257)) / 65535);
+          out[addr] = v >> 8;
+          out[faddr] = v & 0xFF;
+        } else {
+          uint8_t val = out[addr];
+          if (inv) val = 255 - val;
+          if (lo > 0 || hi < 255) val = lo + ((uint16_t)val * (hi - lo)) / 255;
+          out[addr] = val;
+        }
+      } else if ((def->type == CH_PAN_FINE || def->type == CH_TILT_FINE) && !refIsFine(i, ch)) {
+        if (inv) out[addr] = 255 - out[addr];   // Fine brez coarse-a
+      }
+    }
+  }
+}
+
+static void refDimmer(uint8_t* out, const StageInput& in) {
+  bool allMax = (in.master == 255);
+  for (int g = 0; g < MAX_GROUPS; g++) if (in.groupDim[g] < 255) allMax = false;
+  if (allMax) return;
+
+  for (int i = 0; i < MAX_FIXTURES; i++) {
+    const PatchEntry* fx = fixtures.getFixture(i);
+    if (!fx || !fx->active || fx->profileIndex < 0) continue;
+    uint8_t grpDim = 255;
+    for (int g = 0; g < MAX_GROUPS; g++) {
+      if ((fx->groupMask & (1 << g)) && in.groupDim[g] < grpDim) grpDim = in.groupDim[g];
+    }
+    if (grpDim == 255 && in.master == 255) continue;
+
+    uint8_t chCount = fixtures.fixtureChannelCount(i);
+    for (int ch = 0; ch < chCount; ch++) {
+      const ChannelDef* def = fixtures.fixtureChannel(i, ch);
+      if (!def || def->type != CH_INTENSITY) continue;
+      uint16_t addr = fx->dmxAddress + ch - 1;
+      if (addr >= DMX_MAX_CHANNELS) continue;
+      int fc = refFineOf(i, ch);
+      if (fc >= 0) {
+        uint16_t faddr = fx->dmxAddress + fc - 1;
+        uint32_t val = (out[addr] << 8) | out[faddr];
+        if (grpDim < 255) val = (val * grpDim) / 255;
+        if (in.master < 255) val = (val * in.master) / 255;
+        out[addr] = val >> 8;
+        out[faddr] = val & 0xFF;
+        continue;
+      }
+      uint16_t val = out[addr];
+      if (grpDim < 255) val = (val * grpDim) / 255;
+      if (in.master < 255) val = (val * in.master) / 255;
+      out[addr] = (uint8_t)val;
+    }
+  }
+}
+
+static bool isBlackoutType(uint8_t t) {
+  return t == CH_INTENSITY || t == CH_COLOR_R || t == CH_COLOR_G ||
+         t == CH_COLOR_B || t == CH_COLOR_W || t == CH_COLOR_A ||
+         t == CH_COLOR_UV || t == CH_STROBE || t == CH_COLOR_L ||
+         t == CH_COLOR_C || t == CH_COLOR_WW;
+}
+
+static void refBlackoutFlash(uint8_t* out, const StageInput& in) {
+  for (int pass = 0; pass < 2; pass++) {
+    if (pass == 0 && !in.blackout) continue;
+    if (pass == 1 && !in.flash) continue;
+    for (int i = 0; i < MAX_FIXTURES; i++) {
+      const PatchEntry* fx = fixtures.getFixture(i);
+      if (!fx || !fx->active || fx->profileIndex < 0) continue;
+      uint8_t chCount = fixtures.fixtureChannelCount(i);
+      for (int ch = 0; ch < chCount; ch++) {
+        const ChannelDef* def = fixtures.fixtureChannel(i, ch);
+        if (!def) continue;
+        uint16_t addr = fx->dmxAddress + ch - 1;
+        if (addr >= DMX_MAX_CHANNELS) continue;
+        // Fine bajt sledi svojemu coarse kanalu (flash → flashLevel*257)
+        int fc = refFineOf(i, ch);
+        uint16_t faddr = (fc >= 0) ? fx->dmxAddress + fc - 1 : addr;
+        if (pass == 0 && isBlackoutType(def->type)) out[addr] = out[faddr] = 0;
+        if (pass == 1 && def->type == CH_INTENSITY) out[addr] = out[faddr] = in.flashLevel;
+      }
+    }
+  }
+}
+
+// ============================================================================
+//  PATCH IZ PRAVIH PROFILOV
+// ============================================================================
+
+static BenchRng rnd{1};
+
+static void buildRandomPatch() {
+  for (int i = 0; i < MAX_FIXTURES; i++) fixtures.removeFixture(i);
+
+  int profiles = fixtures.getProfileCount();
+  uint16_t addr = 1 + rnd() % 8;
+  for (int i = 0; i < MAX_FIXTURES && profiles > 0; i++) {
+    const FixtureProfile* p = fixtures.getProfile(rnd() % profiles);
+    if (addr + p->channelCount - 1 > DMX_MAX_CHANNELS) break;
+    char name[20];
+    snprintf(name, sizeof(name), "FX%d", i);
+    uint8_t groups = rnd() & ((1 << MAX_GROUPS) - 1);
+    if (rnd() % 4 == 0) groups = 0;
+    fixtures.addFixture(name, p->id, addr, groups, false);
+
+    PatchEntry* e = fixtures.getFixtureMut(i);
+    e->invertPan  = rnd() % 3 == 0;
+    e->invertTilt = rnd() % 3 == 0;
+    if (rnd() % 2) { e->panMin = rnd() % 100; e->panMax = 155 + rnd() % 101; }
+    if (rnd() % 2) { e->tiltMin = rnd() % 100; e->tiltMax = 155 + rnd() % 101; }
+    // Obrnjen obseg (min > max): 16-bit par ne sme preliti v unsigned aritmetiki
+    if (rnd() % 5 == 0) { uint8_t t = e->panMin; e->panMin = e->panMax; e->panMax = t; }
+    if (rnd() % 5 == 0) { uint8_t t = e->tiltMin; e->tiltMin = e->tiltMax; e->tiltMax = t; }
+    addr += p->channelCount + (rnd() % 3 == 0 ? rnd() % 10 : 0);
+  }
+  fixtures.rebuildPatchMap();
+}
+
+static StageInput randomStage() {
+  StageInput in;
+  bool full = rnd() % 4 == 0;   // Vsi dimmerji na max → hitra pot
+  in.master = full ? 255 : (uint8_t)rnd();
+  for (int g = 0; g < MAX_GROUPS; g++) in.groupDim[g] = (full || rnd() % 2) ? 255 : (uint8_t)rnd();
+  in.blackout   = rnd() % 5 == 0;
+  in.flash      = rnd() % 7 == 0;
+  in.flashLevel = (uint8_t)rnd();
+  return in;
+}
+
+static void applyStage(const StageInput& in) {
+  mixer.setMasterDimmer(in.master);
+  for (int g = 0; g < MAX_GROUPS; g++) mixer.setGroupDimmer(g, in.groupDim[g]);
+  if (in.blackout) mixer.blackout(); else mixer.unBlackout();
+  mixer.setFlash(in.flash, in.flashLevel);
+}
+
+// ============================================================================
+//  MAIN
+// ============================================================================
+
+// remap16 proti int64 referenci za vse vrednosti, tudi obrnjen obseg (lo > hi)
+static long checkRemap16() {
+  static const uint8_t LIM[][2] = { {0, 255}, {20, 200}, {200, 20}, {255, 0}, {99, 100}, {100, 99}, {7, 7} };
+  long err = 0;
+  for (const auto& lh : LIM) {
+    int64_t lo = lh[0] * 257, hi = lh[1] * 257;
+    for (uint32_t v = 0; v <= 65535; v++) {
+      int64_t e = lo + ((int64_t)v * (hi - lo)) / 65535;
+      if (remap16((uint16_t)v, lh[0], lh[1]) != e) err++;
+    }
+  }
+  return err;
+}
+
+int main(int argc, char** argv) {
+  const char* profDir = argc > 1 ? argv[1] : DMX_PROFILES_DIR;
+  int patches = argc > 2 ? atoi(argv[2]) : 50;
+  int frames  = argc > 3 ? atoi(argv[3]) : 200;
+
+  long remapErr = checkRemap16();
+  printf("[BENCH] remap16 (tudi min > max): napak=%ld\n", remapErr);
+  if (remapErr) return 1;
+
+  // Začasen LittleFS koren s kopijo profilov
+  fs_::path root = fs_::temp_directory_path() / "bench_output_stage";
+  Serial.setQuiet(true);
+  benchRoot(root, profDir);
+  hostClockSetUs(1000000);
+
+  benchEngines(fixtures, scenes, &mixer);
+  if (fixtures.getProfileCount() == 0) {
+    printf("[BENCH] Ni profilov v %s\n", profDir);
+    return 1;
+  }
+
+  uint8_t in[DMX_MAX_CHANNELS], ref[DMX_MAX_CHANNELS];
+  long exactFrames = 0, mismatches = 0;
+  double fusedNs = 0, refNs = 0;
+  long timedFrames = 0;
+  rnd.s = 12345;
+
+  for (int p = 0; p < patches; p++) {
+    buildRandomPatch();
+
+    // Pripet ArtNet: lokalne vrednosti ne sodelujejo v spajanju
+    mixer.switchToArtNet();
+
+    for (int f = 0; f < frames; f++) {
+      // Vsakih 100 frame-ov: preklop na lokalno in nazaj (brez crossfade-a)
+      if (f % 100 == 50) {
+        mixer.switchToLocal();
+        mixer.switchToArtNet();
+      }
+
+      for (int i = 0; i < DMX_MAX_CHANNELS; i++) in[i] = (uint8_t)rnd();
+      StageInput st = randomStage();
+      applyStage(st);
+      mixer.onArtNetData(in, DMX_MAX_CHANNELS);
+      hostClockAdvanceUs(25000);
+
+      mixer.update();
+
+      memcpy(ref, in, DMX_MAX_CHANNELS);
+      refPanTilt(ref);
+      refDimmer(ref, st);
+      refBlackoutFlash(ref, st);
+
+      const uint8_t* out = mixer.getDmxOutput();
+      int diffMax = 0;
+      for (int i = 0; i < DMX_MAX_CHANNELS; i++) {
+        int d = abs((int)out[i] - (int)ref[i]);
+        if (d > diffMax) diffMax = d;
+      }
+      exactFrames++;
+      if (diffMax > 0) {
+        if (mismatches < 5) printf("[BENCH] Razlika: patch %d frame %d (max %d)\n", p, f, diffMax);
+        mismatches++;
+      }
+    }
+
+    // --- Časovna meritev: fiksno stanje dimmerjev (brez markDirty → brez
+    // shranjevanja v LittleFS med merjenjem) ---
+    StageInput st = randomStage();
+    st.master = 200;
+    applyStage(st);
+    hostClockAdvanceUs(5000000);   // > SAVE_DEBOUNCE_MS: shranjevanje se izvede tu
+    mixer.update();
+    for (int f = 0; f < frames; f++) {
+      mixer.onArtNetData(in, DMX_MAX_CHANNELS);
+      hostClockAdvanceUs(25000);
+      auto t0 = std::chrono::steady_clock::now();
+      mixer.update();
+      auto t1 = std::chrono::steady_clock::now();
+      memcpy(ref, in, DMX_MAX_CHANNELS);
+      refPanTilt(ref);
+      refDimmer(ref, st);
+      refBlackoutFlash(ref, st);
+      auto t2 = std::chrono::steady_clock::now();
+      fusedNs += std::chrono::duration<double, std::nano>(t1 - t0).count();
+      refNs   += std::chrono::duration<double, std::nano>(t2 - t1).count();
+      timedFrames++;
+    }
+  }
+
+  printf("[BENCH] patchi=%d frame-i=%ld\n", patches, exactFrames);
+  printf("[BENCH] neujemanja=%ld\n", mismatches);
+  printf("[BENCH] update() s fuzioniranim korakom: %.0f ns/frame, referenca (samo večprehodno post-procesiranje): %.0f ns/frame\n",
+         fusedNs / timedFrames, refNs / timedFrames);
+
+  std::error_code ec;
+  fs_::remove_all(root, ec);
+  return mismatches ? 1 : 0;
+}
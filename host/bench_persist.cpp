@@ -0,0 +1,204 @@
+// ============================================================================
+//  bench_persist — zapisi v LittleFS na persist tasku namesto na klicočem
+//
+//  Simuliran flash (LittleFS.writeLatencyUs na odprtje in write()). Frame
+//  nit teče s fiksno periodo in vsak frame vzame "mixer" lock; web nit pod
+//  istim lockom shranjuje sceno in cue list (kot WebSocket handler), frame
+//  nit občasno sproži autosave. Najprej sinhrono (stara pot), nato s
+//  persist taskom.
+//  Poroča: zamuda frame-a (p99/max), čas pod lockom v web niti.
+//  Preveri: združevanje zaporednih zapisov iste datoteke, vrstni red
+//  zapis/brisanje, pregrada persistFlush(), zavrnitev po persistShutdown().
+//
+//  Uporaba: bench_persist [--latency-us N]
+//  Izhodna koda 0 = ujemanje.
+// ============================================================================
+
+#include "persist.h"
+#include "bench_common.h"
+#include <LittleFS.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fs_ = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static BenchRng rnd{777};
+
+static int failures = 0;
+#define CHECK(c, ...) do { if (!(c)) { printf("[BENCH] NAPAKA: " __VA_ARGS__); printf("\n"); failures++; } } while (0)
+
+static std::mutex mixLock;
+static uint8_t mixState[DMX_MAX_CHANNELS];
+
+static std::vector<uint8_t> readFile(const char* path) {
+  std::vector<uint8_t> out;
+  File f = LittleFS.open(path, "r");
+  if (!f) return out;
+  out.resize(f.size());
+  f.read(out.data(), out.size());
+  f.close();
+  return out;
+}
+
+// Kot MixerEngine::persistState(): posnetek pod lockom, zapis brez
+static void autosave(void*) {
+  uint8_t copy[DMX_MAX_CHANNELS];
+  {
+    std::lock_guard<std::mutex> lk(mixLock);
+    memcpy(copy, mixState, sizeof(copy));
+  }
+  File f = LittleFS.open("/mixer.bin", "w");
+  if (f) { f.write(copy, sizeof(copy)); f.close(); }
+}
+
+// ============================================================================
+//  FRAME + WEB NIT
+// ============================================================================
+
+static double pct(std::vector<double>& v, int p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, v.size() * p / 100)];
+}
+
+static void runLoad(const char* label, int frames, uint32_t periodUs) {
+  std::atomic<bool> stop{false};
+  std::vector<double> webHold;
+  char scene[24 + DMX_MAX_CHANNELS] = "Scena";
+  std::vector<uint8_t> cues(2048, '{');
+
+  std::thread web([&]() {
+    int n = 0;
+    while (!stop.load()) {
+      std::this_thread::sleep_for(std::chrono::microseconds(periodUs * 2 + rnd() % periodUs));
+      auto t0 = Clock::now();
+      {
+        std::lock_guard<std::mutex> lk(mixLock);
+        // WebSocket "scene_save" / "cue_upd" pod mixer lockom
+        PersistSeg segs[2] = { { scene, 24 }, { mixState, DMX_MAX_CHANNELS } };
+        char path[24];
+        snprintf(path, sizeof(path), "/scenes/%02d.bin", n % 4);
+        persistWriteV(path, segs, 2);
+        if (n % 3 == 0) persistWrite("/cuelist.json", cues.data(), cues.size());
+      }
+      webHold.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+      n++;
+    }
+  });
+
+  std::vector<double> late;
+  auto next = Clock::now();
+  for (int i = 0; i < frames; i++) {
+    next += std::chrono::microseconds(periodUs);
+    std::this_thread::sleep_until(next);
+    {
+      std::lock_guard<std::mutex> lk(mixLock);
+      mixState[rnd() % DMX_MAX_CHANNELS] = rnd() & 0xFF;
+    }
+    if (i % 40 == 39) persistCall(autosave, nullptr);     // checkAutoSave()
+    late.push_back(std::chrono::duration<double, std::micro>(Clock::now() - next).count());
+  }
+  stop.store(true);
+  web.join();
+  persistFlush();
+
+  double webMax = webHold.empty() ? 0 : *std::max_element(webHold.begin(), webHold.end());
+  double lateMax = late.empty() ? 0 : *std::max_element(late.begin(), late.end());
+  printf("[BENCH] %-6s frame zamuda p50 %7.0f us, p99 %7.0f us, max %7.0f us | web pod lockom max %7.0f us (%zu shranjevanj)\n",
+         label, pct(late, 50), pct(late, 99), lateMax, webMax, webHold.size());
+  if (persistIsAsync()) {
+    CHECK(webMax < LittleFS.writeLatencyUs, "%s: web nit pod lockom čaka na flash (%.0f us)", label, webMax);
+  }
+}
+
+// ============================================================================
+//  SEMANTIKA
+// ============================================================================
+
+static void runSemantics() {
+  // Združevanje: 100 zaporednih zapisov iste datoteke → zadnji, malo zapisov
+  PersistStats a, b;
+  persistGetStats(a);
+  char buf[64];
+  for (int i = 0; i < 100; i++) {
+    int n = snprintf(buf, sizeof(buf), "{\"v\":%d}", i);
+    persistWrite("/sound.bin", buf, n);
+  }
+  CHECK(persistFlush(), "pregrada: timeout");
+  persistGetStats(b);
+  std::vector<uint8_t> got = readFile("/sound.bin");
+  CHECK(std::string(got.begin(), got.end()) == "{\"v\":99}", "združevanje: ni zadnja vsebina");
+  uint32_t writes = b.writes - a.writes;
+  CHECK(writes <= 5, "združevanje: %u zapisov za 100 zahtev", writes);
+  printf("[BENCH] Združevanje: 100 zahtev → %u zapis(ov), %u združenih\n", writes, b.coalesced - a.coalesced);
+
+  // Zapis → brisanje → zapis (ista pot) in zapis → brisanje
+  const uint8_t v1[3] = { 1, 2, 3 }, v2[2] = { 9, 9 };
+  persistWrite("/scenes/07.bin", v1, 3);
+  persistRemove("/scenes/07.bin");
+  persistWrite("/scenes/07.bin", v2, 2);
+  persistWrite("/scenes/08.bin", v1, 3);
+  persistRemove("/scenes/08.bin");
+  CHECK(persistFlush(), "pregrada: timeout");
+  CHECK(readFile("/scenes/07.bin") == std::vector<uint8_t>(v2, v2 + 2), "zapis/brisanje/zapis: napačna vsebina");
+  CHECK(!LittleFS.exists("/scenes/08.bin"), "zapis/brisanje: datoteka obstaja");
+
+  // Pregrada: vse oddane zahteve so na disku ob vrnitvi
+  for (int i = 0; i < 12; i++) {
+    char path[24];
+    snprintf(path, sizeof(path), "/f%02d.bin", i);
+    uint8_t d[8];
+    memset(d, i, sizeof(d));
+    persistWrite(path, d, sizeof(d));
+  }
+  CHECK(persistFlush(), "pregrada: timeout");
+  for (int i = 0; i < 12; i++) {
+    char path[24];
+    snprintf(path, sizeof(path), "/f%02d.bin", i);
+    std::vector<uint8_t> d = readFile(path);
+    CHECK(d.size() == 8 && d[7] == i, "pregrada: %s manjka", path);
+  }
+
+  // Po zaustavitvi (pred formatom/restartom) se nič več ne zapiše
+  CHECK(persistShutdown(), "zaustavitev: timeout");
+  CHECK(!persistWrite("/late.bin", v1, 3), "zaustavitev: zahteva sprejeta");
+  std::this_thread::sleep_for(std::chrono::milliseconds(PERSIST_COALESCE_MS + 50));
+  CHECK(!LittleFS.exists("/late.bin"), "zaustavitev: datoteka zapisana");
+}
+
+int main(int argc, char** argv) {
+  uint32_t latencyUs = 4000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--latency-us") && i + 1 < argc) latencyUs = atoi(argv[++i]);
+  }
+
+  fs_::path root = fs_::temp_directory_path() / "bench_persist";
+  std::error_code ec;
+  fs_::remove_all(root, ec);
+  Serial.setQuiet(true);
+  LittleFS.setRoot(root.c_str());
+  LittleFS.begin();
+  LittleFS.mkdir("/scenes");
+  LittleFS.writeLatencyUs = latencyUs;
+  printf("[BENCH] Simuliran flash: %u us na odprtje/write()\n", latencyUs);
+
+  persistBegin();
+  runLoad("sinhr.", 400, 5000);                            // Pred persistStartTask(): stara pot
+  persistStartTask(0, 1);
+  runLoad("task", 400, 5000);
+
+  LittleFS.writeLatencyUs = 0;
+  runSemantics();
+
+  printf("[BENCH] %s\n", failures ? "NEUJEMANJE" : "OK");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,396 @@
+// ============================================================================
+//  bench_playback — hkratni playbacki/submasterji s HTP/LTP spajanjem
+//
+//  Referenca je neposredna pot: za vsak playback vseh 512 naslovov, lastništvo
+//  LTP kanala po fixture-u (sodeluje, če ima v sceni kaj ≠ 0), HTP samo z
+//  vrednostjo, playbacki po vrsti aktivacije, ki jo bench vodi sam. Naključni
+//  ukazi (fader, GO/release, flash, dodelitev, prepis scene, HTP maska) in
+//  po vsakem primerjava izhoda z referenco.
+//  Poroča: ns na frame za MAX_PLAYBACKS aktivnih playbackov, redka pot proti
+//  referenci.
+//  Preveri: ujemanje po korakih, LTP zadnji aktivirani zmaga, ovojnica
+//  GO/release doseže cilj točno po fade času (monotono), prepis scene se
+//  pozna v naslednjem frame-u, brez aktivnih playbackov stopnja ni aktivna,
+//  premik faderja ne piše (zapis šele po zamiku, enkrat za vse premike).
+//
+//  Uporaba: bench_playback [--steps N] [--frames N] [--profiles dir]
+//  Izhodna koda 0 = ujemanje.
+// ============================================================================
+
+#include "playback_engine.h"
+#include "fixture_engine.h"
+#include "scene_engine.h"
+#include "mixer_engine.h"
+#include "value16.h"
+#include "persist.h"
+#include "host_clock.h"
+#include "bench_common.h"
+#include <LittleFS.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#ifndef DMX_PROFILES_DIR
+#define DMX_PROFILES_DIR "data/profiles"
+#endif
+
+namespace fs_ = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static BenchRng rnd{2107};
+
+static int failures = 0;
+#define CHECK(c, ...) do { if (!(c)) { printf("[BENCH] NAPAKA: " __VA_ARGS__); printf("\n"); failures++; } } while (0)
+
+static FixtureEngine  fixtures;
+static SceneEngine    scenes;
+static MixerEngine    mixer;
+static PlaybackEngine pbs;
+
+static const int BENCH_SCENES = 10;
+static const float DT = 0.025f;                  // 40 Hz
+
+// ============================================================================
+//  REFERENCA — stanje, ki ga bench vodi neodvisno od enginea
+// ============================================================================
+
+struct RefPb {
+  int      slot = -1;
+  uint8_t  level = 0;
+  bool     on = true;
+  bool     flash = false;
+  uint32_t seq = 0;
+};
+
+static RefPb ref[MAX_PLAYBACKS];
+static uint32_t refSeq = 0;
+
+static uint32_t refLevel16(const RefPb& r) {
+  if (r.slot < 0) return 0;
+  if (r.flash) return 65536;
+  if (!r.on) return 0;
+  return r.level * 257 + (r.level >> 7);
+}
+
+static void referenceFrame(const uint8_t* in, uint8_t* out) {
+  memcpy(out, in, DMX_MAX_CHANNELS);
+  const PatchMap* m = fixtures.getPatchMap();
+  uint32_t mask = mixer.getHtpMask();
+
+  int order[MAX_PLAYBACKS];
+  for (int i = 0; i < MAX_PLAYBACKS; i++) order[i] = i;
+  std::stable_sort(order, order + MAX_PLAYBACKS, [](int a, int b) { return ref[a].seq < ref[b].seq; });
+
+  for (int k = 0; k < MAX_PLAYBACKS; k++) {
+    const RefPb& r = ref[order[k]];
+    uint32_t l = refLevel16(r);
+    const Scene* sc = scenes.getScene(r.slot);
+    if (!l || !sc) continue;
+    const uint8_t* v = sc->dmx;
+
+    // Sodelujoči fixture-i: karkoli ≠ 0 na njihovih naslovih
+    std::vector<bool> part(MAX_FIXTURES, false);
+    for (int a = 0; a < DMX_MAX_CHANNELS; a++) {
+      int f = m ? m->addr[a].fixture : -1;
+      if (f >= 0 && v[a]) part[f] = true;
+    }
+
+    for (int a = 0; a < DMX_MAX_CHANNELS; a++) {
+      int f = m ? m->addr[a].fixture : -1;
+      uint8_t type = f >= 0 ? m->addr[a].type : (uint8_t)CH_GENERIC;
+      bool htp = mask & (1UL << type);
+      if (f >= 0 && m->addr[a].partner != PATCH_NONE) continue;   // Pari spodaj
+      bool owned = f >= 0 ? (part[f] && (!htp || v[a])) : v[a] != 0;
+      if (!owned) continue;
+      if (htp) out[a] = std::max<int>(out[a], (v[a] * l) >> 16);
+      else out[a] = (uint8_t)(out[a] + ((((int32_t)v[a] - out[a]) * (int32_t)l) >> 16));
+    }
+    for (int p = 0; m && p < m->pairCount; p++) {
+      const PatchPair& pp = m->pairs[p];
+      if (!part[pp.fixture]) continue;
+      bool htp = mask & (1UL << pp.type);
+      uint16_t v16 = get16(v, pp.coarse, pp.fine), o = get16(out, pp.coarse, pp.fine);
+      if (htp) {
+        if (!v16) continue;
+        uint16_t x = (uint16_t)(((uint64_t)v16 * l) >> 16);
+        if (x > o) put16(out, pp.coarse, pp.fine, x);
+      } else {
+        put16(out, pp.coarse, pp.fine, lerp16(o, v16, l));
+      }
+    }
+  }
+}
+
+// ============================================================================
+//  PATCH + SCENE
+// ============================================================================
+
+static const char* BENCH_PROFILES[] = { BENCH_HEAD_PROFILE, BENCH_PAR_PROFILE };
+
+static void randomScene(int slot) {
+  uint8_t dmx[DMX_MAX_CHANNELS];
+  // Redka scena: nekaj blokov (fixture-i) z vrednostmi, ostalo ničle
+  memset(dmx, 0, sizeof(dmx));
+  int blocks = 2 + rnd() % 6;
+  for (int b = 0; b < blocks; b++) {
+    int start = rnd() % DMX_MAX_CHANNELS, len = 1 + rnd() % 24;
+    for (int a = start; a < start + len && a < DMX_MAX_CHANNELS; a++) dmx[a] = (rnd() % 4) ? rnd() & 0xFF : 0;
+  }
+  char name[16];
+  snprintf(name, sizeof(name), "PB %d", slot);
+  scenes.saveScene(slot, name, dmx);
+}
+
+static void patchRig(const fs_::path& root, const char* profDir) {
+  benchRoot(root, profDir, BENCH_PROFILES, 2);
+  benchEngines(fixtures, scenes, &mixer);
+  benchPatchRig(fixtures, 40, true);
+  if (!fixtures.getFixtureCount())
+    fprintf(stderr, "[BENCH] Profili niso naloženi — samo nepatchani naslovi (HTP po CH_GENERIC)\n");
+  const PatchMap* m = fixtures.getPatchMap();
+  printf("[BENCH] Patch: %d fixture-ov, %d 16-bit parov, %d playbackov\n",
+         fixtures.getFixtureCount(), m ? m->pairCount : 0, MAX_PLAYBACKS);
+
+  for (int s = 0; s < BENCH_SCENES; s++) randomScene(s);
+  pbs.begin(&fixtures, &scenes, &mixer);
+}
+
+// ============================================================================
+//  UKAZI — engine + referenca (pravila aktivacije za LTP vrstni red)
+// ============================================================================
+
+static void doAssign(int i, int slot) {
+  pbs.assign(i, slot);
+  ref[i].slot = slot;
+  ref[i].on = true;
+  if (slot >= 0 && ref[i].level) ref[i].seq = ++refSeq;
+}
+
+static void doLevel(int i, uint8_t level) {
+  if (level && !ref[i].level) ref[i].seq = ++refSeq;
+  ref[i].level = level;
+  pbs.setLevel(i, level);
+}
+
+static void doGo(int i) {
+  if (ref[i].slot < 0) return;
+  pbs.go(i, 0);
+  ref[i].on = true;
+  ref[i].seq = ++refSeq;
+}
+
+static void doRelease(int i) {
+  pbs.release(i, 0);
+  ref[i].on = false;
+}
+
+static void doFlash(int i, bool on) {
+  if (ref[i].slot < 0) return;
+  if (on && !ref[i].flash) ref[i].seq = ++refSeq;
+  ref[i].flash = on;
+  pbs.setFlash(i, on);
+}
+
+static void engineFrame(const uint8_t* in, uint8_t* out) {
+  memcpy(out, in, DMX_MAX_CHANNELS);
+  if (!pbs.isActive()) return;
+  pbs.prepare(DT);
+  pbs.apply(in, out);
+}
+
+// ============================================================================
+//  PREVERJANJA
+// ============================================================================
+
+static void runRandom(int steps) {
+  uint8_t in[DMX_MAX_CHANNELS], out[DMX_MAX_CHANNELS], exp[DMX_MAX_CHANNELS];
+  int mism = 0;
+  for (int step = 0; step < steps; step++) {
+    int i = rnd() % MAX_PLAYBACKS;
+    switch (rnd() % 10) {
+      case 0: case 1: case 2: doLevel(i, (rnd() % 3) ? rnd() & 0xFF : 0); break;
+      case 3: doGo(i); break;
+      case 4: doRelease(i); break;
+      case 5: doFlash(i, !ref[i].flash); break;
+      case 6: doAssign(i, (rnd() % 8) ? (int)(rnd() % BENCH_SCENES) : -1); break;
+      case 7: randomScene(rnd() % BENCH_SCENES); break;
+      case 8: mixer.setHtpMask((rnd() & 1) ? MERGE_HTP_DEFAULT : (MERGE_HTP_DEFAULT | (1UL << CH_GENERIC))); break;
+      default: break;
+    }
+    for (int a = 0; a < DMX_MAX_CHANNELS; a++) in[a] = rnd() & 0xFF;
+    engineFrame(in, out);
+    referenceFrame(in, exp);
+    if (memcmp(out, exp, sizeof(out))) {
+      if (mism++ < 3) {
+        int a = 0;
+        while (out[a] == exp[a]) a++;
+        printf("[BENCH] NAPAKA: korak %d, naslov %d: %u, referenca %u\n", step, a + 1, out[a], exp[a]);
+      }
+    }
+  }
+  CHECK(mism == 0, "naključni ukazi: %d/%d korakov se ne ujema z referenco", mism, steps);
+  printf("[BENCH] Naključni ukazi: %d korakov, %d neujemanj\n", steps, mism);
+
+  for (int i = 0; i < MAX_PLAYBACKS; i++) { doFlash(i, false); doLevel(i, 0); doAssign(i, -1); }
+  CHECK(!pbs.isActive(), "brez playbackov je stopnja aktivna");
+}
+
+// Dva playbacka z istim LTP kanalom: zadnji dvignjen / GO zmaga
+static void runLtpOrder() {
+  mixer.setHtpMask(MERGE_HTP_DEFAULT);
+  uint8_t a[DMX_MAX_CHANNELS] = {}, b[DMX_MAX_CHANNELS] = {};
+  const PatchMap* m = fixtures.getPatchMap();
+  int ch = 0;
+  while (ch < DMX_MAX_CHANNELS - 1 && m && m->addr[ch].fixture >= 0 &&
+         ((MERGE_HTP_DEFAULT >> m->addr[ch].type) & 1 || m->addr[ch].partner != PATCH_NONE)) ch++;
+  a[ch] = 40;
+  b[ch] = 200;
+  scenes.saveScene(BENCH_SCENES, "LTP A", a);
+  scenes.saveScene(BENCH_SCENES + 1, "LTP B", b);
+  doAssign(0, BENCH_SCENES);
+  doAssign(1, BENCH_SCENES + 1);
+
+  uint8_t in[DMX_MAX_CHANNELS] = {}, out[DMX_MAX_CHANNELS];
+  doLevel(0, 255);
+  doLevel(1, 255);
+  engineFrame(in, out);
+  CHECK(out[ch] == 200, "LTP: zadnji dvignjen (B) ne zmaga: %u", out[ch]);
+  doGo(0);
+  engineFrame(in, out);
+  CHECK(out[ch] == 40, "LTP: GO na A ne prevzame: %u", out[ch]);
+  doRelease(0);
+  engineFrame(in, out);
+  CHECK(out[ch] == 200, "LTP: po release A ne ostane B: %u", out[ch]);
+
+  // Prepis scene B se pozna v naslednjem frame-u (generacija scen)
+  b[ch] = 99;
+  scenes.saveScene(BENCH_SCENES + 1, "LTP B", b);
+  engineFrame(in, out);
+  CHECK(out[ch] == 99, "prepis scene: izhod %u, pričakovano 99", out[ch]);
+
+  for (int i = 0; i < 2; i++) { doLevel(i, 0); doAssign(i, -1); }
+}
+
+// GO/release s fade časom: monotono, cilj točno po fade času (40 Hz)
+static void runEnvelope() {
+  doAssign(0, 0);
+  doLevel(0, 255);
+  pbs.release(0, 0);
+  uint8_t in[DMX_MAX_CHANNELS] = {}, out[DMX_MAX_CHANNELS];
+  engineFrame(in, out);
+
+  const uint32_t fadeMs = 1000;
+  const int frames = fadeMs / 25;
+  pbs.go(0, fadeMs);
+  uint32_t prev = 0;
+  bool mono = true;
+  int reached = -1;
+  for (int f = 1; f <= frames + 2; f++) {
+    engineFrame(in, out);
+    uint32_t e = pbs.get(0)->env16;
+    if (e < prev) mono = false;
+    if (e == 65536 && reached < 0) reached = f;
+    prev = e;
+  }
+  CHECK(mono, "GO ovojnica ni monotona");
+  CHECK(reached == frames, "GO: poln nivo v frame-u %d, pričakovano %d", reached, frames);
+  CHECK(pbs.outputLevel(0) == 255, "GO: izhodni nivo %u", pbs.outputLevel(0));
+
+  pbs.release(0, fadeMs);
+  mono = true;
+  reached = -1;
+  for (int f = 1; f <= frames + 2; f++) {
+    engineFrame(in, out);
+    uint32_t e = pbs.get(0)->env16;
+    if (e > prev) mono = false;
+    if (e == 0 && reached < 0) reached = f;
+    prev = e;
+  }
+  CHECK(mono, "release ovojnica ni monotona");
+  CHECK(reached == frames, "release: nič v frame-u %d, pričakovano %d", reached, frames);
+  CHECK(!pbs.isActive(), "po release je stopnja aktivna");
+
+  doLevel(0, 0);
+  doAssign(0, -1);
+}
+
+// ============================================================================
+//  MERITEV
+// ============================================================================
+
+static void runTiming(int frames) {
+  mixer.setHtpMask(MERGE_HTP_DEFAULT);
+  for (int i = 0; i < MAX_PLAYBACKS; i++) {
+    doAssign(i, i % BENCH_SCENES);
+    doLevel(i, 64 + rnd() % 192);
+  }
+  uint8_t in[DMX_MAX_CHANNELS], out[DMX_MAX_CHANNELS], exp[DMX_MAX_CHANNELS];
+  for (int a = 0; a < DMX_MAX_CHANNELS; a++) in[a] = rnd() & 0xFF;
+
+  double tNew = 0, tRef = 0;
+  int mism = 0;
+  for (int f = 0; f < frames; f++) {
+    if (f % 8 == 0) doLevel(f % MAX_PLAYBACKS, 1 + rnd() % 255);     // Faderji se premikajo
+    auto t0 = Clock::now();
+    engineFrame(in, out);
+    auto t1 = Clock::now();
+    referenceFrame(in, exp);
+    auto t2 = Clock::now();
+    tNew += std::chrono::duration<double, std::nano>(t1 - t0).count();
+    tRef += std::chrono::duration<double, std::nano>(t2 - t1).count();
+    if (memcmp(out, exp, sizeof(out))) mism++;
+  }
+  CHECK(mism == 0, "meritev: %d frame-ov se ne ujema z referenco", mism);
+  printf("[BENCH] %d aktivnih playbackov: %8.0f ns/frame (referenca %8.0f ns, %.1fx)\n",
+         pbs.activeCount(), tNew / frames, tRef / frames, tNew > 0 ? tRef / tNew : 0.0);
+}
+
+// Drsnik faderja: brez zapisa med premikanjem, en zapis po mirovanju
+static void runSaveDebounce() {
+  pbs.checkAutoSave();
+  hostClockAdvanceUs(20000000);
+  pbs.checkAutoSave();                               // Morebitna sprememba iz prejšnjih faz
+  PersistStats before, mid, after;
+  persistGetStats(before);
+  for (int n = 0; n < 500; n++) {
+    pbs.setLevel(n % MAX_PLAYBACKS, (uint8_t)(n * 7));
+    hostClockAdvanceUs(5000);
+    pbs.checkAutoSave();
+  }
+  persistGetStats(mid);
+  hostClockAdvanceUs(3000000);
+  pbs.checkAutoSave();
+  persistGetStats(after);
+  // Zahteve persist-u (callback + zapis JSON-a)
+  printf("[BENCH] 500 premikov faderja: %u zahtev za zapis med premikanjem, %u po mirovanju\n",
+         (unsigned)(mid.requests - before.requests), (unsigned)(after.requests - mid.requests));
+  CHECK(mid.requests == before.requests, "fader: %u zahtev med premikanjem",
+        (unsigned)(mid.requests - before.requests));
+  CHECK(after.requests > mid.requests, "fader: po mirovanju ni zapisa");
+}
+
+int main(int argc, char** argv) {
+  int steps = 4000, frames = 2000;
+  const char* profDir = DMX_PROFILES_DIR;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--steps") && i + 1 < argc) steps = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--frames") && i + 1 < argc) frames = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--profiles") && i + 1 < argc) profDir = argv[++i];
+  }
+
+  Serial.setQuiet(true);
+  patchRig(fs_::temp_directory_path() / "bench_playback", profDir);
+
+  runRandom(steps);
+  runLtpOrder();
+  runEnvelope();
+  runTiming(frames);
+  runSaveDebounce();
+
+  printf("[BENCH] %s\n", failures ? "NEUJEMANJE" : "OK");
+  return failures ? 1 : 0;
+}
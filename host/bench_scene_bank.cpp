@@ -0,0 +1,286 @@
+// ============================================================================
+//  bench_scene_bank — banka scen: 512 slotov, indeks ob zagonu, LRU cache
+//
+//  Preveden s konfiguracijo ESP32-S3 (MAX_SCENES 512, cache 64). Scene so
+//  realistične: nekaj fixture-ov z vrednostmi, ostalo ničle. Faze:
+//    - selitev starih /scenes/NN.bin v banko
+//    - polnjenje vseh slotov prek persist taska
+//    - zagon: prebrani bajti == indeks (ne vsebine scen)
+//    - recall z delovnim naborom (show): zadetki, zgrešitve (branje na
+//      persist tasku, frame samo zahteva), čas
+//    - prepisovanje in brisanje → stiskanje datoteke, nato zagon
+//    - prekinjen zapis (podatki dodani, indeks ne) → stara vsebina
+//  Vsak recall in vsak zagon se primerja z referenco.
+//  Poroča: velikost na flash-u proti 536 B/sceno, zagon (bajti, odprtja),
+//  delež zadetkov, čas get() ob zadetku/zgrešitvi, čakanje na sceno,
+//  branja na persist tasku, stiskanja.
+//
+//  Uporaba: bench_scene_bank [recall-ov]
+//  Izhodna koda 0 = vsebina se ujema.
+// ============================================================================
+
+#include "scene_bank.h"
+#include "persist.h"
+#include "frame_clock.h"
+#include "bench_common.h"
+#include <LittleFS.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace fs_ = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static BenchRng rnd{2402};
+
+static int failures = 0;
+#define CHECK(c, ...) do { if (!(c)) { printf("[BENCH] NAPAKA: " __VA_ARGS__); printf("\n"); failures++; } } while (0)
+
+struct RefScene {
+  bool    valid = false;
+  char    name[MAX_SCENE_NAME_LEN] = {};
+  uint8_t dmx[DMX_MAX_CHANNELS] = {};
+};
+
+static SceneBank bank;
+static std::vector<RefScene> ref(MAX_SCENES);
+
+// 24 fixture-ov po 16 kanalov; scena prižge nekaj od njih
+static void makeScene(uint8_t* dmx) {
+  memset(dmx, 0, DMX_MAX_CHANNELS);
+  int lit = 1 + rnd() % 12;
+  for (int k = 0; k < lit; k++) {
+    int base = (rnd() % 24) * 16;
+    int used = 4 + rnd() % 12;
+    for (int c = 0; c < used; c++) dmx[base + c] = (uint8_t)(1 + rnd() % 255);
+  }
+}
+
+static void putRef(int slot, const char* name, const uint8_t* dmx) {
+  RefScene& r = ref[slot];
+  r.valid = true;
+  memset(r.name, 0, sizeof(r.name));
+  strlcpy(r.name, name, sizeof(r.name));
+  memcpy(r.dmx, dmx, DMX_MAX_CHANNELS);
+}
+
+// Banka == referenca (obstoj, ime, vsebina prek read())
+static int verifyAll(const char* phase) {
+  int bad = 0;
+  Scene sc;
+  for (int i = 0; i < MAX_SCENES; i++) {
+    const RefScene& r = ref[i];
+    if (bank.exists(i) != r.valid) { bad++; continue; }
+    if (!r.valid) continue;
+    if (!bank.read(i, sc) || strcmp(sc.name, r.name) != 0 || memcmp(sc.dmx, r.dmx, DMX_MAX_CHANNELS) != 0) bad++;
+  }
+  CHECK(bad == 0, "%s: %d slotov se ne ujema z referenco", phase, bad);
+  return bad;
+}
+
+static std::vector<uint8_t> readFile(const char* path) {
+  std::vector<uint8_t> out;
+  File f = LittleFS.open(path, "r");
+  if (!f) return out;
+  out.resize(f.size());
+  f.read(out.data(), out.size());
+  f.close();
+  return out;
+}
+
+static void writeFile(const char* path, const std::vector<uint8_t>& data) {
+  File f = LittleFS.open(path, "w");
+  if (f) { f.write(data.data(), data.size()); f.close(); }
+}
+
+static double pct(std::vector<double>& v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[(size_t)(p * (v.size() - 1))];
+}
+
+int main(int argc, char** argv) {
+  int recalls = argc > 1 ? atoi(argv[1]) : 200000;
+  Serial.setQuiet(true);
+  fs_::path root = fs_::temp_directory_path() / "bench_scene_bank";
+  std::error_code ec;
+  fs_::remove_all(root, ec);
+  fs_::create_directories(root, ec);
+  LittleFS.setRoot(root.c_str());
+  LittleFS.begin();
+  LittleFS.mkdir(PATH_SCENES_DIR);
+  const char* idxPath = PATH_SCENES_DIR "/bank.idx";
+
+  // --- Selitev: 20 scen v stari obliki ---
+  uint8_t dmx[DMX_MAX_CHANNELS];
+  for (int i = 0; i < 20; i++) {
+    char path[32], name[MAX_SCENE_NAME_LEN] = {};
+    snprintf(path, sizeof(path), "%s/%02d.bin", PATH_SCENES_DIR, i);
+    snprintf(name, sizeof(name), "Stara %d", i);
+    makeScene(dmx);
+    File f = LittleFS.open(path, "w");
+    f.write((const uint8_t*)name, MAX_SCENE_NAME_LEN);
+    f.write(dmx, DMX_MAX_CHANNELS);
+    f.close();
+    putRef(i, name, dmx);
+  }
+  bank.begin();
+  CHECK(bank.count() == 20, "selitev: %d scen", bank.count());
+  CHECK(!LittleFS.exists(PATH_SCENES_DIR "/00.bin"), "selitev: stara datoteka ostala");
+  verifyAll("selitev");
+
+  // --- Polnjenje vseh slotov prek persist taska ---
+  persistBegin();
+  persistStartTask(0, 1);
+  auto t0 = Clock::now();
+  for (int i = 0; i < MAX_SCENES; i++) {
+    char name[MAX_SCENE_NAME_LEN];
+    snprintf(name, sizeof(name), "Scena %03d", i);
+    makeScene(dmx);
+    CHECK(bank.store(i, name, dmx), "store %d", i);
+    putRef(i, name, dmx);
+  }
+  double storeMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+  CHECK(persistFlush(), "pregrada: timeout");
+  SceneBankStats st;
+  bank.getStats(st);
+  CHECK(st.pending == 0, "po pregradi še %u čakajočih", (unsigned)st.pending);
+  uint32_t rawBytes = MAX_SCENES * (MAX_SCENE_NAME_LEN + DMX_MAX_CHANNELS);
+  printf("[BENCH] %d scen: store %.1f ms (RAM takoj), podatki %u B + indeks %u B = %.1f%% od %u B (536 B/sceno)\n",
+         MAX_SCENES, storeMs, (unsigned)st.dataBytes, (unsigned)st.indexBytes,
+         100.0 * (st.dataBytes + st.indexBytes) / rawBytes, (unsigned)rawBytes);
+
+  // --- Zagon: samo indeks ---
+  LittleFS.resetStats();
+  t0 = Clock::now();
+  bank.begin();
+  double bootMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+  bank.getStats(st);
+  printf("[BENCH] zagon: %.2f ms, prebranih %llu B v %u odprtjih (indeks %u B; vse scene bi bile %u B)\n",
+         bootMs, (unsigned long long)LittleFS.bytesRead, (unsigned)LittleFS.openForRead,
+         (unsigned)st.indexBytes, (unsigned)rawBytes);
+  CHECK(LittleFS.bytesRead == st.indexBytes, "zagon prebral %llu B, indeks %u B",
+        (unsigned long long)LittleFS.bytesRead, (unsigned)st.indexBytes);
+  CHECK(st.used == MAX_SCENES && st.cached == 0, "zagon: %u scen, %u v cache-u", (unsigned)st.used, (unsigned)st.cached);
+  verifyAll("zagon");
+  bank.getStats(st);
+  CHECK(st.cached == 0 && st.hits == 0 && st.misses == 0, "read() je spremenil cache");
+
+  // --- Recall: delovni nabor show-a (cue lista, playbacki) + občasno karkoli ---
+  const int WORKING = 40;
+  int work[WORKING];
+  for (int i = 0; i < WORKING; i++) work[i] = rnd() % MAX_SCENES;
+  // Zgrešitev vrne nullptr (branje na persist tasku); "frame-i" po 1 ms
+  // prevzemajo prebrane scene, dokler get() ne vrne scene
+  std::vector<double> hitNs, missNs, waitMs;
+  hitNs.reserve(recalls);
+  int wrong = 0;
+  LittleFS.resetStats();
+  for (int n = 0; n < recalls; n++) {
+    int slot = (rnd() % 100 < 90) ? work[rnd() % WORKING] : (int)(rnd() % MAX_SCENES);
+    uint32_t missesBefore = 0;
+    { SceneBankStats s; bank.getStats(s); missesBefore = s.misses; }
+    auto a = Clock::now();
+    const Scene* sc = bank.get(slot);
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - a).count();
+    SceneBankStats s;
+    bank.getStats(s);
+    (s.misses != missesBefore ? missNs : hitNs).push_back(ns);
+    if (!sc) {
+      while (!sc && std::chrono::duration<double, std::milli>(Clock::now() - a).count() < SCENE_LOAD_TIMEOUT_MS) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+        bank.adopt();
+        sc = bank.get(slot);
+      }
+      waitMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - a).count());
+    }
+    if (!sc || strcmp(sc->name, ref[slot].name) != 0 || memcmp(sc->dmx, ref[slot].dmx, DMX_MAX_CHANNELS) != 0) wrong++;
+  }
+  CHECK(wrong == 0, "recall: %d napačnih vsebin", wrong);
+  bank.getStats(st);
+  double hitRate = 100.0 * st.hits / (st.hits + st.misses);
+  double hitMax = hitNs.empty() ? 0 : *std::max_element(hitNs.begin(), hitNs.end());
+  printf("[BENCH] recall %d (90%% iz %d scen): zadetki %.1f%%, get() zadetek p50 %.0f ns / p99 %.0f ns / max %.1f us, "
+         "zgrešitev na frame-u p50 %.1f us / p99 %.1f us, scena na voljo p50 %.1f ms / p99 %.1f ms (%llu B s flash-a)\n",
+         recalls, WORKING, hitRate, pct(hitNs, 0.5), pct(hitNs, 0.99), hitMax / 1e3,
+         pct(missNs, 0.5) / 1e3, pct(missNs, 0.99) / 1e3, pct(waitMs, 0.5), pct(waitMs, 0.99),
+         (unsigned long long)LittleFS.bytesRead);
+  CHECK(hitRate > 85.0, "delež zadetkov %.1f%%", hitRate);
+  CHECK(hitMax < FRAME_PERIOD_US * 1000.0, "zadetek %.0f ns > frame", hitMax);
+  double missMax = missNs.empty() ? 0 : *std::max_element(missNs.begin(), missNs.end());
+  printf("[BENCH] branj na persist tasku %u, get() brez scene %u\n", (unsigned)st.loads, (unsigned)st.deferred);
+  CHECK(st.loads >= st.misses, "zgrešitve niso brane na persist tasku (%u / %u)", (unsigned)st.loads, (unsigned)st.misses);
+  CHECK(missMax < FRAME_PERIOD_US * 1000.0, "zgrešitev na frame-u %.0f ns > frame", missMax);
+
+  // --- Prepisovanje in brisanje → stiskanje ---
+  uint32_t peak = 0;
+  for (int n = 0; n < 4000; n++) {
+    int slot = rnd() % MAX_SCENES;
+    if (rnd() % 10 == 0) {
+      bank.remove(slot);
+      ref[slot] = RefScene();
+    } else if (rnd() % 10 == 0 && ref[slot].valid) {
+      char name[MAX_SCENE_NAME_LEN];
+      snprintf(name, sizeof(name), "Preim %d", n);
+      CHECK(bank.rename(slot, name), "rename %d", slot);
+      strlcpy(ref[slot].name, name, sizeof(ref[slot].name));
+    } else {
+      char name[MAX_SCENE_NAME_LEN];
+      snprintf(name, sizeof(name), "V%d", n);
+      makeScene(dmx);
+      bank.store(slot, name, dmx);
+      putRef(slot, name, dmx);
+    }
+    // Frame task vmes bere iz cache-a
+    int w = work[rnd() % WORKING];
+    const Scene* sc = bank.get(w);                 // nullptr = bere se (preverjeno zgoraj)
+    if (ref[w].valid && sc && memcmp(sc->dmx, ref[w].dmx, DMX_MAX_CHANNELS) != 0) wrong++;
+    if (!ref[w].valid && sc) wrong++;
+    if (n % 200 == 199) {
+      persistFlush();
+      bank.getStats(st);
+      if (st.dataBytes > peak) peak = st.dataBytes;
+    }
+  }
+  CHECK(wrong == 0, "recall med prepisovanjem: %d napačnih", wrong);
+  CHECK(persistFlush(), "pregrada: timeout");
+  bank.getStats(st);
+  printf("[BENCH] 4000 prepisov/brisanj: %u stiskanj, podatki %u B (žive %u B, vrh %u B), napake %u\n",
+         (unsigned)st.compactions, (unsigned)st.dataBytes, (unsigned)st.liveBytes, (unsigned)peak, (unsigned)st.failed);
+  CHECK(st.compactions > 0, "ni stiskanja");
+  CHECK(st.dataBytes <= 4 + 2 * st.liveBytes + SCENE_BANK_FLUSH_BYTES * 4 || st.dataBytes <= SCENE_BANK_COMPACT_MIN,
+        "datoteka %u B pri %u B živih", (unsigned)st.dataBytes, (unsigned)st.liveBytes);
+  CHECK(st.failed == 0 && st.readErrors == 0, "napake zapisa/branja");
+  int files = 0;
+  for (auto& e : fs_::directory_iterator(root / "scenes", ec)) { (void)e; files++; }
+  CHECK(files == 2, "v /scenes %d datotek (pričakovano indeks + ena podatkovna)", files);
+  bank.begin();
+  verifyAll("zagon po stiskanju");
+
+  // --- Prekinjen zapis: podatki dodani, indeks ostane star ---
+  int slot = 7;
+  bank.getStats(st);
+  RefScene before = ref[slot];
+  std::vector<uint8_t> oldIdx = readFile(idxPath);
+  makeScene(dmx);
+  bank.store(slot, "Izpad", dmx);
+  persistFlush();
+  writeFile(idxPath, oldIdx);                      // Izpad pred preimenovanjem novega indeksa
+  bank.begin();
+  ref[slot] = before;
+  verifyAll("izpad pred indeksom");
+  // Banka po izpadu normalno piše naprej (nadaljuje za odrezanim zapisom)
+  bank.store(slot, "Po izpadu", dmx);
+  putRef(slot, "Po izpadu", dmx);
+  persistFlush();
+  bank.begin();
+  verifyAll("zapis po izpadu");
+
+  persistShutdown();
+  printf("[BENCH] %s\n", failures ? "NEUJEMANJE" : "OK");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,338 @@
+// ============================================================================
+//  bench_scene_patch — scene, relativne na fixture: premik patcha, delni priklic
+//
+//  Patch iz pravih profilov (moving head 16ch s 16-bit pan/tilt, RGBW par v
+//  načinu 7ch). Naključne scene: nekaj prižganih fixture-ov (vsi njihovi
+//  kanali) + nepatchani naslovi na koncu univerze; polovica delnih. Nato se
+//  patch premeša (novi naslovi, obraten vrstni red, vrzeli) in pari
+//  preklopijo v način 11ch. Referenca vodi vrednosti po fixture-u in kanal
+//  novega načina poišče sama (k-ti kanal istega tipa).
+//  Preveri:
+//    - pred premikom in po njem priklic (takojšen in s fade-om skozi
+//      MixerEngine::update) zapiše vrednosti fixture-a na njegove trenutne
+//      naslove, brez ponovnega shranjevanja; tudi scene, ki so že v cache-u
+//      (prevod ob spremembi generacije patcha), in po ponovnem branju s flash-a
+//    - cela scena kanale, ki jih ne določa, postavi na 0; delna jih pusti,
+//      tudi med fade-om
+//    - zapis scene z enim fixture-om = 1 + 2 + 2 × kanali (sorazmeren vsebini)
+//    - delna scena iz ročno nastavljenih kanalov določa tudi eksplicitno 0
+//      (fader na 0) in nič drugega zunaj teh fixture-ov
+//  Poroča: B na sceno proti 512 B sliki in RLE, čas prevoda scene.
+//
+//  Uporaba: bench_scene_patch [--scenes N] [--profiles dir]
+//  Izhodna koda 0 = vse scene sledijo patchu.
+// ============================================================================
+
+#include "fixture_engine.h"
+#include "scene_engine.h"
+#include "mixer_engine.h"
+#include "snapshot_history.h"
+#include "bench_common.h"
+#include <LittleFS.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#ifndef DMX_PROFILES_DIR
+#define DMX_PROFILES_DIR "data/profiles"
+#endif
+
+namespace fs_ = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static BenchRng rnd{2501};
+
+static int failures = 0;
+#define CHECK(c, ...) do { if (!(c)) { printf("[BENCH] NAPAKA: " __VA_ARGS__); printf("\n"); failures++; } } while (0)
+
+static FixtureEngine fixtures;
+static SceneEngine   scenes;
+static MixerEngine   mixer;
+
+static const char* BENCH_PROFILES[] = { BENCH_HEAD_PROFILE, BENCH_PAR_PROFILE };
+static const char* HEAD_ID = BENCH_HEAD_ID;
+static const char* PAR_ID  = BENCH_PAR_ID;
+static const char* PAR_ID2 = "par-rgbw-multi__11ch";
+static const int RAW_BASE = 500;                   // Nepatchani naslovi (0-based) do konca univerze
+static const int RAW_N = DMX_MAX_CHANNELS - RAW_BASE;
+static const float DT = 0.025f;
+
+// ============================================================================
+//  REFERENCA — vrednosti po fixture-u in kanalu, ne po naslovu
+// ============================================================================
+
+struct RefScene {
+  bool    partial;
+  bool    lit[MAX_FIXTURES];
+  uint8_t val[MAX_FIXTURES][MAX_CHANNELS_PER_FX];
+  uint8_t raw[RAW_N];
+};
+
+static std::vector<RefScene> ref;
+static uint8_t savedTypes[MAX_FIXTURES][MAX_CHANNELS_PER_FX];   // Tipi kanalov ob shranjevanju
+static uint8_t savedCount[MAX_FIXTURES];
+
+static void snapshotTypes() {
+  for (int f = 0; f < MAX_FIXTURES; f++) {
+    savedCount[f] = fixtures.fixtureChannelCount(f);
+    for (int c = 0; c < savedCount[f]; c++) savedTypes[f][c] = (uint8_t)fixtures.fixtureChannel(f, c)->type;
+  }
+}
+
+// Pričakovano stanje po priklicu scene iz stanja cur (trenutni patch)
+static void expected(const RefScene& r, const uint8_t* cur, uint8_t* out, bool* defined) {
+  memcpy(out, cur, DMX_MAX_CHANNELS);
+  memset(defined, 0, DMX_MAX_CHANNELS * sizeof(bool));
+  const PatchMap* m = fixtures.getPatchMap();
+  for (int f = 0; f < MAX_FIXTURES && m; f++) {
+    const PatchSpan& sp = m->fixtureSpan[f];
+    if (!r.lit[f] || !sp.count) continue;
+    for (int c = 0; c < sp.count; c++) {
+      uint8_t t = (uint8_t)fixtures.fixtureChannel(f, c)->type;
+      int nth = 0;
+      for (int k = 0; k < c; k++) nth += fixtures.fixtureChannel(f, k)->type == t;
+      for (int k = 0; k < savedCount[f]; k++) {
+        if (savedTypes[f][k] != t || nth--) continue;
+        out[sp.start + c] = r.val[f][k];
+        defined[sp.start + c] = true;
+        break;
+      }
+    }
+  }
+  for (int i = 0; i < RAW_N; i++) {
+    if (!r.raw[i]) continue;
+    out[RAW_BASE + i] = r.raw[i];
+    defined[RAW_BASE + i] = true;
+  }
+  if (r.partial) return;
+  for (int a = 0; a < DMX_MAX_CHANNELS; a++) {
+    if (!defined[a]) out[a] = 0;
+  }
+}
+
+// ============================================================================
+//  PATCH + SCENE
+// ============================================================================
+
+static void patchRig(const fs_::path& root, const char* profDir) {
+  benchRoot(root, profDir, BENCH_PROFILES, 2);
+  benchEngines(fixtures, scenes, &mixer);
+  benchPatchRig(fixtures, 20, false);
+  if (!fixtures.getFixtureCount())
+    fprintf(stderr, "[BENCH] Profili niso naloženi — samo nepatchani naslovi\n");
+  snapshotTypes();
+}
+
+static void saveScene(int slot, int litMax) {
+  RefScene r = {};
+  r.partial = slot & 1;
+  uint8_t dmx[DMX_MAX_CHANNELS] = {};
+  const PatchMap* m = fixtures.getPatchMap();
+  int lit = 1 + rnd() % litMax;
+  for (int k = 0; k < lit && m && m->spanCount; k++) {
+    const PatchSpan& sp = m->spans[rnd() % m->spanCount];
+    r.lit[sp.fixture] = true;
+    for (int c = 0; c < sp.count; c++) {
+      uint8_t v = (rnd() % 3) ? (uint8_t)rnd() : 0;                 // Tudi ničle (pan 0)
+      if (c == 0 && !v) v = 1 + rnd() % 255;
+      r.val[sp.fixture][c] = v;
+      dmx[sp.start + c] = v;
+    }
+  }
+  for (int i = 0; i < RAW_N; i++) {
+    r.raw[i] = (rnd() % 4 == 0) ? (uint8_t)(1 + rnd() % 255) : 0;
+    dmx[RAW_BASE + i] = r.raw[i];
+  }
+  char name[16];
+  snprintf(name, sizeof(name), "%s %d", r.partial ? "Delna" : "Cela", slot);
+  scenes.saveScene(slot, name, dmx, r.partial);
+  ref[slot] = r;
+}
+
+// Novi naslovi v obratnem vrstnem redu z vrzelmi, pari v način 11ch
+static void repatch() {
+  uint16_t addr = 40;
+  for (int f = MAX_FIXTURES - 1; f >= 0; f--) {
+    const PatchEntry* e = fixtures.getFixture(f);
+    if (!e || !e->active) continue;
+    PatchEntry n = *e;
+    if (!strcmp(n.profileId, PAR_ID)) strlcpy(n.profileId, PAR_ID2, sizeof(n.profileId));
+    const FixtureProfile* p = fixtures.findProfile(n.profileId);
+    n.dmxAddress = addr;
+    fixtures.updateFixture(f, n);
+    addr += (p ? p->channelCount : 1) + 3;
+  }
+}
+
+// ============================================================================
+//  PRIKLIC
+// ============================================================================
+
+static void fillManual(uint8_t* cur) {
+  for (int a = 0; a < DMX_MAX_CHANNELS; a++) {
+    cur[a] = (uint8_t)rnd();
+    mixer.setChannel(a + 1, cur[a]);
+  }
+}
+
+static int recallAll(const char* phase, int scenesN) {
+  int bad = 0;
+  uint8_t cur[DMX_MAX_CHANNELS], exp[DMX_MAX_CHANNELS];
+  bool defined[DMX_MAX_CHANNELS];
+  for (int s = 0; s < scenesN; s++) {
+    const RefScene& r = ref[s];
+
+    // Takojšen
+    fillManual(cur);
+    expected(r, cur, exp, defined);
+    mixer.lock();
+    bool ok = mixer.recallScene(s, 0);
+    mixer.unlock();
+    const uint8_t* mv = mixer.getManualValues();
+    int diff = 0;
+    for (int a = 0; a < DMX_MAX_CHANNELS; a++) diff += mv[a] != exp[a];
+    if (!ok || diff) {
+      if (!bad++) CHECK(false, "%s: scena %d (%s) takojšen priklic, %d naslovov narobe", phase, s,
+                        r.partial ? "delna" : "cela", diff);
+      continue;
+    }
+
+    // Fade: delna scena nedoločenih kanalov ne sme premakniti niti vmes
+    fillManual(cur);
+    expected(r, cur, exp, defined);
+    mixer.lock();
+    mixer.recallScene(s, 300 + rnd() % 400);
+    mixer.unlock();
+    int frames = 0, leak = 0;
+    while (mixer.isSceneCrossfading() && frames < 100) {
+      mixer.update(DT);
+      frames++;
+      for (int a = 0; r.partial && a < DMX_MAX_CHANNELS; a++) leak += !defined[a] && mv[a] != cur[a];
+    }
+    diff = 0;
+    for (int a = 0; a < DMX_MAX_CHANNELS; a++) diff += mv[a] != exp[a];
+    if (diff || leak || mixer.isSceneCrossfading()) {
+      if (!bad++) CHECK(false, "%s: scena %d (%s) fade, %d naslovov narobe, %d premikov nedoločenih", phase, s,
+                        r.partial ? "delna" : "cela", diff, leak);
+    }
+  }
+  return bad;
+}
+
+int main(int argc, char** argv) {
+  int scenesN = 40;
+  const char* profDir = DMX_PROFILES_DIR;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--scenes") && i + 1 < argc) scenesN = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--profiles") && i + 1 < argc) profDir = argv[++i];
+  }
+  if (scenesN < 2) scenesN = 2;
+  if (scenesN > MAX_SCENES) scenesN = MAX_SCENES;
+  Serial.setQuiet(true);
+  patchRig(fs_::temp_directory_path() / "bench_scene_patch", profDir);
+  const PatchMap* m = fixtures.getPatchMap();
+  printf("[BENCH] Patch: %d fixture-ov (%d naslovov), %d scen (pol delnih), cache %d scen\n",
+         fixtures.getFixtureCount(), m ? m->highestAddr : 0, scenesN, SCENE_CACHE_LINES);
+
+  // --- Velikost zapisa ---
+  ref.resize(scenesN);
+  for (int s = 0; s < scenesN; s++) saveScene(s, s < scenesN / 2 ? 2 : 6);
+  SceneBankStats bs;
+  scenes.getBankStats(bs);
+  size_t rleBytes = 0;
+  Scene sc;
+  for (int s = 0; s < scenesN; s++) {
+    if (scenes.readScene(s, sc)) rleBytes += snapRleSize(sc.dmx);
+  }
+  printf("[BENCH] zapis: %.1f B/sceno (512 B slika, RLE %.1f B)\n",
+         (double)bs.liveBytes / scenesN, (double)rleBytes / scenesN);
+
+  if (m && m->spanCount) {
+    const PatchSpan& sp = m->spans[0];
+    uint8_t one[DMX_MAX_CHANNELS] = {};
+    one[sp.start] = 255;
+    size_t len = sceneEncode(one, SCENE_FULL, &fixtures, nullptr);
+    CHECK(len == 1 + 2 + 2 * (size_t)sp.count, "en fixture (%d kanalov): %zu B", sp.count, len);
+    uint8_t zero[DMX_MAX_CHANNELS] = {};
+    printf("[BENCH] en fixture (%d kanalov): %zu B, prazna scena %zu B\n", sp.count, len,
+           sceneEncode(zero, SCENE_FULL, &fixtures, nullptr));
+  }
+
+  // --- Priklic pred premikom ---
+  recallAll("pred premikom", scenesN);
+
+  // --- Premik + menjava načina; scene v cache-u se morajo prevesti same ---
+  int warm = scenesN < SCENE_CACHE_LINES ? scenesN : SCENE_CACHE_LINES;
+  for (int s = 0; s < warm; s++) scenes.getScene(s);                 // Prve, ki jih priklic zadane
+  scenes.getBankStats(bs);
+  uint32_t recompBefore = bs.recompiles;
+  uint32_t gen = fixtures.getPatchGeneration();
+  repatch();
+  CHECK(!fixtures.getFixtureCount() || fixtures.getPatchGeneration() != gen, "generacija patcha se ni spremenila");
+  m = fixtures.getPatchMap();
+  printf("[BENCH] nov patch: obraten vrstni red od naslova 40, pari 7ch → 11ch (%d naslovov)\n",
+         m ? m->highestAddr : 0);
+  recallAll("po premiku", scenesN);
+  scenes.getBankStats(bs);
+  CHECK(!fixtures.getFixtureCount() || bs.recompiles - recompBefore == (uint32_t)warm,
+        "prevodov v cache-u %u, pričakovano %d", (unsigned)(bs.recompiles - recompBefore), warm);
+  printf("[BENCH] prevodi po premiku (vrstice v cache-u): %u\n", (unsigned)(bs.recompiles - recompBefore));
+
+  // --- Po ponovnem branju s flash-a (isti patch) ---
+  scenes.begin();
+  recallAll("po ponovnem zagonu", scenesN);
+
+  // --- Delna scena z eksplicitno ničlo (ročno nastavljeni kanali) ---
+  if (m && m->spanCount >= 2) {
+    const PatchSpan& sa = m->spans[0];
+    const PatchSpan& sb = m->spans[1];
+    mixer.lock();
+    mixer.recallScene(1, 0);                                          // Priklic počisti ročne posege
+    CHECK(mixer.getTouchedCount() == 0, "po priklicu %u ročnih kanalov", mixer.getTouchedCount());
+    mixer.setFixtureChannel(sa.fixture, 0, 0);
+    mixer.setFixtureChannel(sb.fixture, 1, 77);
+    CHECK(mixer.getTouchedCount() == 2, "ročnih kanalov %u, pričakovano 2", mixer.getTouchedCount());
+    mixer.saveCurrentAsScene(0, "Eksplicitna 0", true);
+    CHECK(mixer.getTouchedCount() == 0, "po shranjevanju %u ročnih kanalov", mixer.getTouchedCount());
+    uint8_t cur[DMX_MAX_CHANNELS];
+    for (int a = 0; a < DMX_MAX_CHANNELS; a++) {
+      cur[a] = (uint8_t)(1 + rnd() % 255);
+      mixer.setChannel(a + 1, cur[a]);
+    }
+    mixer.recallScene(0, 0);
+    const uint8_t* mv = mixer.getManualValues();
+    CHECK(mv[sa.start] == 0, "eksplicitna 0: %u", mv[sa.start]);
+    CHECK(mv[sb.start + 1] == 77, "ročni kanal: %u", mv[sb.start + 1]);
+    mixer.unlock();
+    int leak = 0;
+    if (scenes.readScene(0, sc)) {
+      for (int a = 0; a < DMX_MAX_CHANNELS; a++) {
+        bool inFx = (a >= sa.start && a < sa.start + sa.count) || (a >= sb.start && a < sb.start + sb.count);
+        if (!inFx && (sceneDefines(sc, a) || mv[a] != cur[a])) leak++;
+      }
+      CHECK(!leak, "delna scena iz ročnih kanalov: %d naslovov zunaj fixture-ov", leak);
+    } else {
+      CHECK(false, "delna scena z eksplicitno 0 ni shranjena");
+    }
+    printf("[BENCH] delna scena iz ročnih kanalov: %u kanalov določenih, eksplicitna 0 ohranjena\n",
+           sc.definedCount);
+  }
+
+  // --- Čas prevoda ---
+  uint8_t full[DMX_MAX_CHANNELS];
+  for (int a = 0; a < DMX_MAX_CHANNELS; a++) full[a] = 1 + rnd() % 255;
+  std::vector<uint8_t> enc(sceneEncode(full, SCENE_FULL, &fixtures, nullptr));
+  sceneEncode(full, SCENE_FULL, &fixtures, enc.data());
+  const int reps = 20000;
+  auto t0 = Clock::now();
+  for (int i = 0; i < reps; i++) sceneCompile(enc.data(), enc.size(), &fixtures, sc);
+  double us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count() / reps;
+  CHECK(sc.definedCount == DMX_MAX_CHANNELS, "prevod cele univerze: %u kanalov", sc.definedCount);
+  printf("[BENCH] prevod cele univerze (%zu B, %u kanalov): %.2f us\n", enc.size(), sc.definedCount, us);
+
+  printf("[BENCH] %s\n", failures ? "NEUJEMANJE" : "OK");
+  return failures ? 1 : 0;
+}
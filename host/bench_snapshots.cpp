@@ -0,0 +1,256 @@
+// ============================================================================
+//  bench_snapshots — zgodovina stanj: keyframe + XOR/RLE delte
+//
+//  Vir stanj je ArtNet posnetek (surovi 512-bajtni frame-i, --capture) ali
+//  sintetična predstava: RGBW pari s chase-om in fade-i, moving heade s
+//  pan/tilt (fine) in gobo, prazen preostanek univerze, cue vsakih nekaj s.
+//  Snapshot se vzame ob naključnih "preklopih virov" (1-60 s).
+//  Preveri: decode(idx) == referenca za vse ohranjene, ponovno nalaganje iz
+//  datoteke, obnovitev po prekinjenem zadnjem zapisu, stara oblika datoteke.
+//  Poroča: ohranjeni snapshoti, razmerje stiskanja, encode/decode čas,
+//  zapisani bajti na flash proti prepisu celotne datoteke.
+//
+//  Uporaba: bench_snapshots [--capture posnetek.bin] [--snaps N]
+//  Izhodna koda 0 = ujemanje.
+// ============================================================================
+
+#include "snapshot_history.h"
+#include "bench_common.h"
+#include <LittleFS.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace fs_ = std::filesystem;
+using Clock = std::chrono::steady_clock;
+using Frame = std::vector<uint8_t>;
+
+static BenchRng rnd{12345};
+
+static int failures = 0;
+#define CHECK(c, ...) do { if (!(c)) { printf("[BENCH] NAPAKA: " __VA_ARGS__); printf("\n"); failures++; } } while (0)
+
+// ============================================================================
+//  SINTETIČNA PREDSTAVA (40 fps)
+// ============================================================================
+
+struct Show {
+  static const int PARS = 12, PAR_CH = 6, HEADS = 4, HEAD_CH = 16;
+  float target[DMX_MAX_CHANNELS] = {}, cur[DMX_MAX_CHANNELS] = {};
+  int   frame = 0, nextCue = 0;
+  float chasePhase = 0;
+
+  void cue() {
+    for (int p = 0; p < PARS; p++) {
+      int a = p * PAR_CH;
+      target[a] = (rnd() % 3) ? 255 : 0;                  // Dimmer
+      for (int c = 1; c <= 4; c++) target[a + c] = (rnd() % 2) ? (float)(rnd() & 0xFF) : 0;
+      target[a + 5] = 0;                                   // Strobe
+    }
+    for (int h = 0; h < HEADS; h++) {
+      int a = 100 + h * HEAD_CH;
+      for (int c = 0; c < 4; c++) target[a + c] = (float)(rnd() & 0xFF);    // Pan/tilt + fine
+      target[a + 5] = 255;                                                   // Dimmer
+      target[a + 6] = (float)(rnd() % 8) * 16;                               // Gobo
+      target[a + 8] = (float)(rnd() % 12) * 20;                              // Barvno kolo
+    }
+    nextCue = frame + 40 * (4 + rnd() % 12);
+  }
+
+  void step(Frame& out) {
+    if (frame >= nextCue) cue();
+    chasePhase += 0.05f;
+    for (int i = 0; i < DMX_MAX_CHANNELS; i++) cur[i] += (target[i] - cur[i]) * 0.08f;   // Fade
+    out.assign(DMX_MAX_CHANNELS, 0);
+    for (int i = 0; i < DMX_MAX_CHANNELS; i++) out[i] = (uint8_t)lroundf(cur[i]);
+    // Chase po parih na dimmerju
+    for (int p = 0; p < PARS; p++) {
+      float s = 0.5f + 0.5f * sinf(chasePhase + p * 0.6f);
+      out[p * PAR_CH] = (uint8_t)(out[p * PAR_CH] * s);
+    }
+    frame++;
+  }
+};
+
+static std::vector<Frame> loadCapture(const char* path) {
+  std::vector<Frame> frames;
+  FILE* f = fopen(path, "rb");
+  if (!f) { fprintf(stderr, "[BENCH] Ne morem odpreti %s\n", path); return frames; }
+  Frame fr(DMX_MAX_CHANNELS);
+  while (fread(fr.data(), 1, DMX_MAX_CHANNELS, f) == DMX_MAX_CHANNELS) frames.push_back(fr);
+  fclose(f);
+  return frames;
+}
+
+// Snapshoti ob naključnih preklopih (1-60 s pri 40 fps)
+static std::vector<Frame> pickSnapshots(const std::vector<Frame>& capture, int n) {
+  std::vector<Frame> snaps;
+  if (!capture.empty()) {
+    size_t i = 0;
+    while ((int)snaps.size() < n) {
+      snaps.push_back(capture[i % capture.size()]);
+      i += 40 + rnd() % (40 * 59);
+    }
+    return snaps;
+  }
+  Show show;
+  Frame fr;
+  while ((int)snaps.size() < n) {
+    int skip = 40 + rnd() % (40 * 59);
+    for (int k = 0; k < skip; k++) show.step(fr);
+    snaps.push_back(fr);
+  }
+  return snaps;
+}
+
+// ============================================================================
+//  MERITEV
+// ============================================================================
+
+static void verifyAll(const SnapshotHistory& h, const std::vector<Frame>& snaps, size_t added, const char* what) {
+  uint8_t out[DMX_MAX_CHANNELS];
+  for (int idx = 0; idx < h.count(); idx++) {
+    bool ok = h.decode(idx, out);
+    CHECK(ok && memcmp(out, snaps[added - 1 - idx].data(), DMX_MAX_CHANNELS) == 0,
+          "%s: decode(%d) != referenca", what, idx);
+    if (!ok) return;
+  }
+}
+
+static void runPool(const char* label, uint16_t poolBytes, const std::vector<Frame>& snaps) {
+  const char* path = "/snaps.bin";
+  LittleFS.remove(path);
+  LittleFS.resetStats();
+
+  SnapshotHistory h;
+  h.begin(poolBytes);
+  double encNs = 0, encMax = 0;
+  for (size_t i = 0; i < snaps.size(); i++) {
+    auto t0 = Clock::now();
+    h.add(snaps[i].data(), (uint32_t)i * 1000, (i & 1) ? 'A' : 'L');
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+    encNs += ns;
+    encMax = std::max(encMax, ns);
+    h.syncFile(path);                                  // Kot saveStateNow po vsakem snapshotu
+  }
+  verifyAll(h, snaps, snaps.size(), label);
+
+  uint8_t out[DMX_MAX_CHANNELS];
+  double decNs = 0, decMax = 0;
+  for (int idx = 0; idx < h.count(); idx++) {
+    auto t0 = Clock::now();
+    h.decode(idx, out);
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+    decNs += ns;
+    decMax = std::max(decMax, ns);
+  }
+
+  SnapshotCodecStats st;
+  h.getStats(st);
+  uint64_t written = LittleFS.bytesWritten;
+  // Stara pot: celotna datoteka (2 + 3 × 518) ob vsakem shranjevanju
+  uint64_t oldWritten = (uint64_t)snaps.size() * (2 + 3 * (DMX_MAX_CHANNELS + 6));
+
+  // Ponovno nalaganje
+  SnapshotHistory r;
+  r.begin(poolBytes);
+  CHECK(r.loadFile(path), "%s: loadFile", label);
+  CHECK(r.count() == h.count(), "%s: naloženih %d, pričakovano %d", label, r.count(), h.count());
+  verifyAll(r, snaps, snaps.size(), "reload");
+
+  // Prekinjen zadnji zapis: obdrži vse razen zadnjega
+  {
+    fs_::path hp = LittleFS.hostPath(path);
+    auto size = fs_::file_size(hp);
+    fs_::resize_file(hp, size - 3);
+    SnapshotHistory t;
+    t.begin(poolBytes);
+    CHECK(t.loadFile(path), "%s: loadFile (prekinjen)", label);
+    CHECK(t.count() >= 1 && t.needsSync(), "%s: prekinjen zapis ni zaznan", label);
+    verifyAll(t, snaps, snaps.size() - 1, "prekinjen");
+    t.syncFile(path);
+    SnapshotHistory u;
+    u.begin(poolBytes);
+    u.loadFile(path);
+    CHECK(u.count() == t.count(), "%s: po popravku %d != %d", label, u.count(), t.count());
+  }
+
+  printf("[BENCH] %-6s pool %5u B: ohranjenih %2u (keyframe %u) | %5u B za %6u B surovih (%.1fx)\n",
+         label, poolBytes, st.count, st.keyframes, st.poolBytes, st.rawBytes,
+         st.poolBytes ? (double)st.rawBytes / st.poolBytes : 0.0);
+  printf("[BENCH] %-6s encode %.1f us (max %.1f) | decode %.1f us (max %.1f, do %d delt)\n",
+         label, encNs / snaps.size() / 1000, encMax / 1000, h.count() ? decNs / h.count() / 1000 : 0.0,
+         decMax / 1000, SNAP_KEYFRAME_EVERY - 1);
+  printf("[BENCH] %-6s flash: %llu B zapisanih za %zu snapshotov (stari prepis 3 kopij: %llu B, %.1fx)\n",
+         label, (unsigned long long)written, snaps.size(), (unsigned long long)oldWritten,
+         written ? (double)oldWritten / written : 0.0);
+}
+
+// Stara oblika (/snaps.bin: [count][head] + 3 × polna kopija) se pretvori
+static void runMigration(const std::vector<Frame>& snaps) {
+  const char* path = "/snaps.bin";
+  File f = LittleFS.open(path, "w");
+  uint8_t hdr[2] = { 3, 1 };                           // Krožni buffer: najstarejši v slotu 1
+  f.write(hdr, 2);
+  const int order[3] = { 2, 0, 1 };                    // slot → zaporedje
+  for (int slot = 0; slot < 3; slot++) {
+    f.write(snaps[order[slot]].data(), DMX_MAX_CHANNELS);
+    uint32_t ts = order[slot];
+    f.write((uint8_t*)&ts, 4);
+    uint8_t tail[2] = { 1, 'L' };
+    f.write(tail, 2);
+  }
+  f.close();
+  SnapshotHistory h;
+  h.begin();
+  CHECK(h.loadFile(path) && h.count() == 3, "stara oblika: naloženih %d", h.count());
+  verifyAll(h, snaps, 3, "stara oblika");
+  CHECK(h.needsSync(), "stara oblika: ni označena za prepis");
+}
+
+int main(int argc, char** argv) {
+  const char* capture = nullptr;
+  int n = 200;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--capture") && i + 1 < argc) capture = argv[++i];
+    else if (!strcmp(argv[i], "--snaps") && i + 1 < argc) n = atoi(argv[++i]);
+  }
+
+  fs_::path root = fs_::temp_directory_path() / "bench_snapshots";
+  std::error_code ec;
+  fs_::remove_all(root, ec);
+  Serial.setQuiet(true);
+  LittleFS.setRoot(root.c_str());
+  LittleFS.begin();
+
+  std::vector<Frame> cap;
+  if (capture) {
+    cap = loadCapture(capture);
+    if (cap.empty()) return 1;
+    printf("[BENCH] Posnetek: %zu frame-ov\n", cap.size());
+  }
+  std::vector<Frame> snaps = pickSnapshots(cap, n);
+
+  // Kodek: najslabši primer (naključni literal + posamezne ničle) mora v SNAP_RLE_MAX
+  {
+    uint8_t x[DMX_MAX_CHANNELS];
+    size_t worst = 0;
+    for (int k = 0; k < 20000; k++) {
+      for (int i = 0; i < DMX_MAX_CHANNELS; i++) x[i] = (rnd() % (2 + k % 4)) ? (rnd() | 1) : 0;
+      worst = std::max(worst, snapRleSize(x));
+    }
+    CHECK(worst <= SNAP_RLE_MAX, "RLE %zu > SNAP_RLE_MAX", worst);
+  }
+
+  runPool("DRAM", 1408, snaps);
+  runPool("PSRAM", 16384, snaps);
+  runMigration(snaps);
+
+  printf("[BENCH] %s\n", failures ? "NEUJEMANJE" : "OK");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+// ============================================================================
+//  bench_undo — UndoHistory (delte v obroču) proti polnim kopijam stanja
+//
+//  Naključna seja operaterja: potegi fejderjev (več vrednosti v hitrem
+//  zaporedju → en korak po mirovanju), master/group dimmerji, recall scen
+//  (del kanalov naenkrat) ter undo/redo. Referenca hrani celotno stanje po
+//  vsakem zaprtem koraku. Po vsakem undo/redo mora biti stanje enako
+//  referenci; izrinjeni koraki smejo samo skrajšati zgodovino.
+//  Poroča: čas zapisa koraka proti memcpy celotnega stanja, bajte na korak
+//  in število korakov, ki jih obroč obdrži.
+//
+//  Uporaba: bench_undo [operacije]
+//  Izhodna koda 0 = ujemanje.
+// ============================================================================
+
+#include "undo_history.h"
+#include "bench_common.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static BenchRng rnd{12345};
+
+struct State {
+  uint8_t dmx[DMX_MAX_CHANNELS];
+  uint8_t master;
+  uint8_t groups[MAX_GROUPS];
+  bool operator==(const State& o) const { return memcmp(this, &o, sizeof(State)) == 0; }
+};
+
+static State st;
+static UndoHistory hist;
+static uint32_t nowMs = 0;
+
+// Referenca: stanja po zaprtih korakih, ref[cursor] = trenutno
+static std::vector<State> ref;
+static size_t refCursor = 0;
+static int failures = 0;
+
+static double commitNs = 0, fullCopyNs = 0;
+static uint32_t commits = 0, bytesTotal = 0, bytesSteps = 0;
+
+static void closeStep(bool viaPoll) {
+  uint32_t before = hist.usedBytes();
+  auto t0 = Clock::now();
+  if (viaPoll) { nowMs += UNDO_COALESCE_MS; hist.poll(nowMs, false); }
+  else hist.commit();
+  auto t1 = Clock::now();
+  if (hist.pending()) { printf("[BENCH] NAPAKA: korak ni zaprt\n"); failures++; }
+
+  if (st == ref[refCursor]) return;                 // Brez spremembe ni koraka
+  commitNs += std::chrono::duration<double, std::nano>(t1 - t0).count();
+  commits++;
+  if (hist.usedBytes() > before) { bytesTotal += hist.usedBytes() - before; bytesSteps++; }   // Brez izrivanja
+  ref.resize(refCursor + 1);
+  ref.push_back(st);
+  refCursor++;
+
+  // Baseline: stari pushUndo je kopiral celotno stanje ob vsaki akciji
+  static State copy;
+  auto c0 = Clock::now();
+  memcpy(&copy, &st, sizeof(State));
+  asm volatile("" : : "r"(&copy) : "memory");
+  fullCopyNs += std::chrono::duration<double, std::nano>(Clock::now() - c0).count();
+}
+
+static void faderDrag() {
+  uint16_t ch = rnd() % DMX_MAX_CHANNELS;
+  int moves = 3 + rnd() % 20;
+  for (int i = 0; i < moves; i++) {
+    hist.touch(ch, nowMs);
+    st.dmx[ch] = rnd() & 0xFF;
+    nowMs += 20 + rnd() % 60;                       // Hitro zaporedje → isti korak
+    hist.poll(nowMs, false);
+  }
+  closeStep(true);
+}
+
+static void dimmerDrag() {
+  bool master = rnd() & 1;
+  uint16_t slot = master ? UNDO_SLOT_MASTER : UNDO_SLOT_GROUP + rnd() % MAX_GROUPS;
+  uint8_t* v = master ? &st.master : &st.groups[slot - UNDO_SLOT_GROUP];
+  for (int i = 0; i < 10; i++) {
+    hist.touch(slot, nowMs);
+    *v = rnd() & 0xFF;
+    nowMs += 30;
+  }
+  closeStep(true);
+}
+
+static void sceneRecall() {
+  uint8_t next[DMX_MAX_CHANNELS];
+  memcpy(next, st.dmx, sizeof(next));
+  int start = rnd() % DMX_MAX_CHANNELS;
+  int n = 16 + rnd() % 160;                         // Tipična scena: del patcha
+  for (int i = 0; i < n && start + i < DMX_MAX_CHANNELS; i++) next[start + i] = rnd() & 0xFF;
+  hist.commit();
+  hist.touchDiff(st.dmx, next, nowMs);
+  memcpy(st.dmx, next, sizeof(next));
+  closeStep(false);
+}
+
+static void checkState(const char* op) {
+  if (!(st == ref[refCursor])) {
+    printf("[BENCH] NAPAKA po %s: stanje != referenca (korak %zu)\n", op, refCursor);
+    failures++;
+  }
+}
+
+int main(int argc, char** argv) {
+  int ops = argc > 1 ? atoi(argv[1]) : 20000;
+  memset(&st, 0, sizeof(st));
+  st.master = 255;
+  memset(st.groups, 255, sizeof(st.groups));
+  if (!hist.begin({ st.dmx, &st.master, st.groups })) return 1;
+  ref.push_back(st);
+
+  uint32_t undos = 0, redos = 0, maxDepth = 0;
+  for (int i = 0; i < ops; i++) {
+    uint32_t r = rnd() % 100;
+    if (r < 45) faderDrag();
+    else if (r < 55) dimmerDrag();
+    else if (r < 70) sceneRecall();
+    else if (r < 88) {
+      bool ok = hist.undo();
+      if (ok) {
+        if (refCursor == 0) { printf("[BENCH] NAPAKA: undo čez začetek\n"); failures++; continue; }
+        refCursor--; undos++;
+        checkState("undo");
+      }
+    } else {
+      bool ok = hist.redo();
+      bool refOk = refCursor + 1 < ref.size();
+      if (ok != refOk) { printf("[BENCH] NAPAKA: redo=%d, referenca=%d\n", ok, refOk); failures++; continue; }
+      if (ok) { refCursor++; redos++; checkState("redo"); }
+    }
+    // Izrinjeni koraki: zgodovina je lahko krajša, nikoli daljša od reference
+    if (hist.undoDepth() > refCursor) { printf("[BENCH] NAPAKA: globina %u > %zu\n", hist.undoDepth(), refCursor); failures++; }
+    if (hist.undoDepth() > maxDepth) maxDepth = hist.undoDepth();
+  }
+
+  // Undo do konca obroča, nato redo nazaj do vrha
+  State top = st;
+  int back = 0;
+  while (hist.undo()) { refCursor--; back++; checkState("undo (do konca)"); }
+  while (hist.redo()) { refCursor++; checkState("redo (nazaj)"); }
+  if (!(st == top)) { printf("[BENCH] NAPAKA: redo se ne vrne na vrh\n"); failures++; }
+
+  printf("[BENCH] koraki=%u undo=%u redo=%u | obroč %u B, %u korakov max, globina max=%u, ob koncu %d\n",
+         commits, undos, redos, UNDO_RING_BYTES, UNDO_MAX_STEPS, maxDepth, back);
+  printf("[BENCH] zapis koraka: %.0f ns (memcpy stanja %zu B: %.0f ns) | %.1f B/korak (polna kopija %zu B)\n",
+         commits ? commitNs / commits : 0.0, sizeof(State), commits ? fullCopyNs / commits : 0.0,
+         bytesSteps ? (double)bytesTotal / bytesSteps : 0.0, sizeof(State));
+  printf("[BENCH] %s\n", failures ? "NEUJEMANJE" : "OK");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// ============================================================================
+//  Arduino shim za host (Linux) build
+//  Samo podmnožica, ki jo uporabljajo engine datoteke.
+// ============================================================================
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <cmath>
+#include <string>
+#include <algorithm>
+
+#include "host_clock.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#define F(s) (s)
+
+// Kot ESP32 Arduino core: min/max iz std
+using std::min;
+using std::max;
+
+// --- Čas (lažna ura) ---
+inline unsigned long millis() { return (unsigned long)(hostClockNowUs() / 1000ULL); }
+inline unsigned long micros() { return (unsigned long)hostClockNowUs(); }
+inline void delay(uint32_t ms) { hostClockAdvanceMs(ms); }
+inline void delayMicroseconds(uint32_t us) { hostClockAdvanceUs(us); }
+inline uint32_t getCpuFrequencyMhz() { return 240; }   // Glej esp_cpu.h
+
+// --- Naključna števila (deterministična, seed prek randomSeed) ---
+void randomSeed(unsigned long seed);
+long random(long howBig);
+long random(long howSmall, long howBig);
+
+// --- PSRAM (host: navaden heap) ---
+inline bool psramFound() { return false; }
+inline void* ps_malloc(size_t size) { return malloc(size); }
+
+// --- GPIO (no-op) ---
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+#define LOW          0
+#define HIGH         1
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int  digitalRead(uint8_t) { return HIGH; }
+
+// --- strlcpy (glibc < 2.38 ga nima) ---
+#if !defined(__GLIBC__) || (__GLIBC__ < 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38)
+inline size_t strlcpy(char* dst, const char* src, size_t size) {
+  size_t len = strlen(src);
+  if (size) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+#endif
+
+// ============================================================================
+//  String — ovoj okoli std::string
+// ============================================================================
+
+class String {
+public:
+  String() {}
+  String(const char* s) : _s(s ? s : "") {}
+  String(const std::string& s) : _s(s) {}
+  String(char c) : _s(1, c) {}
+  String(int v) : _s(std::to_string(v)) {}
+  String(unsigned int v) : _s(std::to_string(v)) {}
+  String(long v) : _s(std::to_string(v)) {}
+  String(unsigned long v) : _s(std::to_string(v)) {}
+  String(float v, int dec = 2) { char b[32]; snprintf(b, sizeof(b), "%.*f", dec, v); _s = b; }
+  String(double v, int dec = 2) { char b[32]; snprintf(b, sizeof(b), "%.*f", dec, v); _s = b; }
+
+  const char* c_str() const { return _s.c_str(); }
+  unsigned int length() const { return (unsigned int)_s.size(); }
+  bool isEmpty() const { return _s.empty(); }
+  bool reserve(unsigned int n) { _s.reserve(n); return true; }
+
+  String& operator+=(const String& o) { _s += o._s; return *this; }
+  String& operator+=(const char* o) { _s += o ? o : ""; return *this; }
+  String& operator+=(char c) { _s += c; return *this; }
+  friend String operator+(const String& a, const String& b) { return String(a._s + b._s); }
+  friend String operator+(const String& a, const char* b) { return String(a._s + (b ? b : "")); }
+  friend String operator+(const char* a, const String& b) { return String(std::string(a ? a : "") + b._s); }
+  bool operator==(const String& o) const { return _s == o._s; }
+  bool operator==(const char* o) const { return _s == (o ? o : ""); }
+  bool operator!=(const String& o) const { return _s != o._s; }
+  char operator[](unsigned int i) const { return i < _s.size() ? _s[i] : 0; }
+
+  bool startsWith(const String& p) const { return _s.compare(0, p._s.size(), p._s) == 0; }
+  bool endsWith(const String& p) const {
+    return _s.size() >= p._s.size() && _s.compare(_s.size() - p._s.size(), p._s.size(), p._s) == 0;
+  }
+  int indexOf(char c, unsigned int from = 0) const { size_t p = _s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+  int indexOf(const String& s, unsigned int from = 0) const { size_t p = _s.find(s._s, from); return p == std::string::npos ? -1 : (int)p; }
+  int lastIndexOf(char c) const { size_t p = _s.rfind(c); return p == std::string::npos ? -1 : (int)p; }
+  String substring(unsigned int from) const { return from >= _s.size() ? String() : String(_s.substr(from)); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from >= _s.size() || to <= from) return String();
+    return String(_s.substr(from, to - from));
+  }
+  long toInt() const { return atol(_s.c_str()); }
+  float toFloat() const { return (float)atof(_s.c_str()); }
+
+  // ArduinoJson Writer/Reader vmesnik
+  size_t write(uint8_t c) { _s += (char)c; return 1; }
+  size_t write(const uint8_t* b, size_t n) { _s.append((const char*)b, n); return n; }
+
+private:
+  std::string _s;
+};
+
+// ============================================================================
+//  Serial — izpis na stdout (utišljiv za benchmark)
+// ============================================================================
+
+class HardwareSerial {
+public:
+  void begin(unsigned long) {}
+  void setQuiet(bool q) { _quiet = q; }
+  size_t print(const char* s) { if (!_quiet) fputs(s, stdout); return strlen(s); }
+  size_t print(const String& s) { return print(s.c_str()); }
+  size_t print(int v) { return printf("%d", v); }
+  size_t println(const char* s = "") { if (!_quiet) { fputs(s, stdout); fputc('\n', stdout); } return strlen(s) + 1; }
+  size_t println(const String& s) { return println(s.c_str()); }
+  size_t println(int v) { return printf("%d\n", v); }
+  size_t printf(const char* fmt, ...) {
+    if (_quiet) return 0;
+    va_list ap; va_start(ap, fmt);
+    int n = vprintf(fmt, ap);
+    va_end(ap);
+    return n > 0 ? (size_t)n : 0;
+  }
+  void flush() { fflush(stdout); }
+  operator bool() const { return true; }
+private:
+  bool _quiet = false;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef HOST_LITTLEFS_H
+#define HOST_LITTLEFS_H
+
+// ============================================================================
+//  LittleFS shim za host build
+//  Datotečni sistem je preslikan v navaden direktorij (privzeto ./littlefs,
+//  ali HOST_LITTLEFS_ROOT). Šteje zapisane bajte za merjenje obrabe flash-a.
+// ============================================================================
+
+#include <Arduino.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+struct HostFileImpl;
+
+class File {
+public:
+  File() {}
+  explicit File(std::shared_ptr<HostFileImpl> impl) : _impl(impl) {}
+
+  explicit operator bool() const;
+  int    read();
+  size_t read(uint8_t* buf, size_t len);
+  size_t readBytes(char* buf, size_t len) { return read((uint8_t*)buf, len); }
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t len);
+  size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t print(const String& s) { return print(s.c_str()); }
+  size_t println(const char* s = "") { size_t n = print(s); return n + write('\n'); }
+  int    available();
+  int    peek();
+  size_t size() const;
+  size_t position() const;
+  bool   seek(uint32_t pos);
+  void   flush();
+  void   close();
+  const char* name() const;
+  const char* path() const;
+  bool   isDirectory() const;
+  File   openNextFile();
+
+private:
+  std::shared_ptr<HostFileImpl> _impl;
+};
+
+class HostLittleFS {
+public:
+  bool begin(bool formatOnFail = false, const char* basePath = "/littlefs",
+             uint8_t maxOpenFiles = 10, const char* partitionLabel = "spiffs");
+  void end() {}
+  bool format();
+
+  File open(const char* path, const char* mode = FILE_READ, bool create = false);
+  File open(const String& path, const char* mode = FILE_READ, bool create = false) {
+    return open(path.c_str(), mode, create);
+  }
+  bool exists(const char* path);
+  bool exists(const String& path) { return exists(path.c_str()); }
+  bool mkdir(const char* path);
+  bool mkdir(const String& path) { return mkdir(path.c_str()); }
+  bool remove(const char* path);
+  bool remove(const String& path) { return remove(path.c_str()); }
+  bool rename(const char* from, const char* to);
+  bool rename(const String& from, const String& to) { return rename(from.c_str(), to.c_str()); }
+  bool rmdir(const char* path);
+  size_t totalBytes() const { return 1536 * 1024; }
+  size_t usedBytes();
+
+  // --- Samo host ---
+  void setRoot(const char* dir);
+  const char* root() const { return _root.c_str(); }
+  std::string hostPath(const char* path) const;
+
+  // Statistika za benchmark (obraba / write amplification)
+  uint64_t bytesWritten = 0;     // Vsi zapisani bajti
+  uint32_t writeCalls = 0;       // Klici write()
+  uint32_t openForWrite = 0;     // Odprtja za pisanje ("w"/"a"/"r+")
+  uint32_t truncations = 0;      // Odprtja "w" (prepis cele datoteke)
+  uint64_t bytesRead = 0;        // Prebrani bajti (zagon, branje ob zgrešitvi)
+  uint32_t openForRead = 0;      // Odprtja datotek samo za branje
+  void resetStats() { bytesWritten = 0; writeCalls = 0; openForWrite = 0; truncations = 0; bytesRead = 0; openForRead = 0; }
+  uint32_t writeLatencyUs = 0;   // Simuliran flash: realno spanje ob odprtju za pisanje in vsakem write()
+
+private:
+  std::string _root;
+};
+
+extern HostLittleFS LittleFS;
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef HOST_DRIVER_I2S_H
+#define HOST_DRIVER_I2S_H
+
+// ============================================================================
+//  I2S shim — brez generatorja na hostu ni avdio vhoda: install vrne napako,
+//  zato AudioInput::begin() vrne false in SoundEngine teče brez FFT vhoda.
+//  Z hostI2sSetGenerator() i2s_read vrača sintetični signal v tempu lažne ure.
+// ============================================================================
+
+#include <cstddef>
+#include <cstdint>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef int i2s_port_t;
+#define I2S_NUM_0 0
+
+typedef enum { I2S_MODE_MASTER = 1, I2S_MODE_SLAVE = 2, I2S_MODE_TX = 4, I2S_MODE_RX = 8 } i2s_mode_t;
+typedef enum { I2S_BITS_PER_SAMPLE_16BIT = 16, I2S_BITS_PER_SAMPLE_32BIT = 32 } i2s_bits_per_sample_t;
+typedef enum { I2S_CHANNEL_FMT_RIGHT_LEFT = 0, I2S_CHANNEL_FMT_ONLY_LEFT = 4 } i2s_channel_fmt_t;
+typedef enum { I2S_COMM_FORMAT_STAND_I2S = 1 } i2s_comm_format_t;
+#define ESP_INTR_FLAG_LEVEL1 (1 << 1)
+#define I2S_PIN_NO_CHANGE    (-1)
+
+typedef struct {
+  i2s_mode_t mode;
+  uint32_t sample_rate;
+  i2s_bits_per_sample_t bits_per_sample;
+  i2s_channel_fmt_t channel_format;
+  i2s_comm_format_t communication_format;
+  int intr_alloc_flags;
+  int dma_buf_count;
+  int dma_buf_len;
+  bool use_apll;
+  bool tx_desc_auto_clear;
+  int fixed_mclk;
+} i2s_config_t;
+
+typedef struct {
+  int bck_io_num;
+  int ws_io_num;
+  int data_out_num;
+  int data_in_num;
+} i2s_pin_config_t;
+
+// Generator vrne vzorec (-1.0 .. 1.0) za zaporedni indeks pri dani frekvenci vzorčenja
+typedef float (*HostI2sGenerator)(uint64_t sampleIndex, uint32_t sampleRate);
+void hostI2sSetGenerator(HostI2sGenerator gen);
+// Počakaj (realno, največ timeoutMs), da bralec prebere vse vzorce do trenutne lažne ure
+bool hostI2sWaitCaughtUp(uint32_t timeoutMs);
+
+esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t* cfg, int queueSize, void* queue);
+esp_err_t i2s_driver_uninstall(i2s_port_t port);
+esp_err_t i2s_set_pin(i2s_port_t port, const i2s_pin_config_t* pins);
+esp_err_t i2s_read(i2s_port_t port, void* dest, size_t size, size_t* bytesRead, TickType_t ticks);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef HOST_DSPS_FFT2R_H
+#define HOST_DSPS_FFT2R_H
+
+// ============================================================================
+//  ESP-DSP shim: prenosljiv radix-2 FFT (kompleksni, interleaved re/im)
+//  Enaka semantika kot ESP-DSP: dsps_fft2r_fc32 da bit-reversed izhod,
+//  dsps_bit_rev_fc32 ga preuredi v naravni vrstni red.
+// ============================================================================
+
+#include "esp_err.h"
+
+esp_err_t dsps_fft2r_init_fc32(float* table, int tableSize);
+void      dsps_fft2r_deinit_fc32();
+esp_err_t dsps_fft2r_fc32(float* data, int n);
+esp_err_t dsps_bit_rev_fc32(float* data, int n);
+
+#endif
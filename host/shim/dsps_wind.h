@@ -0,0 +1,10 @@
+#ifndef HOST_DSPS_WIND_H
+#define HOST_DSPS_WIND_H
+
+#include <cmath>
+
+inline void dsps_wind_hann_f32(float* window, int len) {
+  for (int i = 0; i < len; i++) window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / (len - 1));
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef HOST_ESP_CPU_H
+#define HOST_ESP_CPU_H
+
+// ============================================================================
+//  esp_cpu shim — števec ciklov iz steady_clock (realni čas, ne lažna ura),
+//  skaliran na 240 MHz kot getCpuFrequencyMhz() v Arduino.h shimu.
+// ============================================================================
+
+#include <chrono>
+#include <cstdint>
+
+inline uint32_t esp_cpu_get_cycle_count() {
+  uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  return (uint32_t)(ns * 240 / 1000);
+}
+
+#endif
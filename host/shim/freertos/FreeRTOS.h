@@ -0,0 +1,30 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// ============================================================================
+//  FreeRTOS shim za host build (tipi + makroji, 1 tick = 1 ms)
+// ============================================================================
+
+#include <cstdint>
+
+typedef uint32_t TickType_t;
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define pdFALSE           0
+#define pdTRUE            1
+#define pdFAIL            0
+#define pdPASS            1
+#define portMAX_DELAY     ((TickType_t)0xFFFFFFFFUL)
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define tskNO_AFFINITY    0x7FFFFFFF
+
+#define portMUX_TYPE                 int
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(m)        ((void)(m))
+#define portEXIT_CRITICAL(m)         ((void)(m))
+#define IRAM_ATTR
+
+#endif
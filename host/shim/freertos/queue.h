@@ -0,0 +1,16 @@
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+// Vrsta s kopiranjem elementov fiksne velikosti (kot FreeRTOS)
+struct HostQueue;
+typedef HostQueue* QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t    xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks);
+BaseType_t    xQueueReceive(QueueHandle_t q, void* out, TickType_t ticks);
+UBaseType_t   uxQueueMessagesWaiting(QueueHandle_t q);
+void          vQueueDelete(QueueHandle_t q);
+
+#endif
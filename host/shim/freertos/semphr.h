@@ -0,0 +1,16 @@
+#ifndef HOST_FREERTOS_SEMPHR_H
+#define HOST_FREERTOS_SEMPHR_H
+
+#include "freertos/FreeRTOS.h"
+
+// Mutex / binarni semafor na osnovi std::mutex + condition_variable
+struct HostSemaphore;
+typedef HostSemaphore* SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+BaseType_t        xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks);
+BaseType_t        xSemaphoreGive(SemaphoreHandle_t s);
+void              vSemaphoreDelete(SemaphoreHandle_t s);
+
+#endif
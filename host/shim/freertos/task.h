@@ -0,0 +1,23 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+// Taski so na hostu std::thread-i (afiniteta jedra se ignorira)
+struct HostTask;
+typedef HostTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack,
+                                   void* param, UBaseType_t prio, TaskHandle_t* handle,
+                                   BaseType_t core);
+void       vTaskDelete(TaskHandle_t task);
+void       vTaskDelay(TickType_t ticks);       // Realno spanje (lažna ura se NE premakne)
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+// Task notifikacije (števni semafor na task)
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t   ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+
+#endif
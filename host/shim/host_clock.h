@@ -0,0 +1,17 @@
+#ifndef HOST_CLOCK_H
+#define HOST_CLOCK_H
+
+#include <cstdint>
+
+// ============================================================================
+//  Lažna ura za host build
+//  millis()/micros() vračata čas te ure, zato je časovnica frame-ov
+//  deterministična. Benchmark/simulacija jo premika ročno.
+// ============================================================================
+
+uint64_t hostClockNowUs();
+void     hostClockSetUs(uint64_t us);
+void     hostClockAdvanceUs(uint64_t us);
+void     hostClockAdvanceMs(uint32_t ms);
+
+#endif
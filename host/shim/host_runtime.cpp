@@ -0,0 +1,501 @@
+// ============================================================================
+//  Implementacija host shimov: ura, naključna števila, Serial, FreeRTOS
+//  (std::thread/mutex), LittleFS (direktorij), ESP-DSP FFT in I2S generator.
+// ============================================================================
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "dsps_fft2r.h"
+#include "driver/i2s.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <pthread.h>
+
+namespace fs_ = std::filesystem;
+
+// ============================================================================
+//  LAŽNA URA
+// ============================================================================
+
+static std::atomic<uint64_t> _clockUs{0};
+
+uint64_t hostClockNowUs() { return _clockUs.load(std::memory_order_relaxed); }
+void hostClockSetUs(uint64_t us) { _clockUs.store(us, std::memory_order_relaxed); }
+void hostClockAdvanceUs(uint64_t us) { _clockUs.fetch_add(us, std::memory_order_relaxed); }
+void hostClockAdvanceMs(uint32_t ms) { _clockUs.fetch_add((uint64_t)ms * 1000ULL, std::memory_order_relaxed); }
+
+// ============================================================================
+//  NAKLJUČNA ŠTEVILA (xorshift32 — deterministično med zagoni)
+// ============================================================================
+
+static uint32_t _rngState = 0x12345678;
+
+void randomSeed(unsigned long seed) { _rngState = seed ? (uint32_t)seed : 0x12345678; }
+
+static uint32_t nextRandom() {
+  uint32_t x = _rngState;
+  x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+  _rngState = x;
+  return x;
+}
+
+long random(long howBig) {
+  if (howBig <= 0) return 0;
+  return (long)(nextRandom() % (uint32_t)howBig);
+}
+
+long random(long howSmall, long howBig) {
+  if (howSmall >= howBig) return howSmall;
+  return howSmall + random(howBig - howSmall);
+}
+
+HardwareSerial Serial;
+
+// ============================================================================
+//  FREERTOS — taski, mutexi, vrste
+// ============================================================================
+
+struct HostTask {
+  std::thread thread;
+  std::mutex mtx;
+  std::condition_variable cv;
+  uint32_t notifyCount = 0;
+};
+
+static thread_local HostTask* _currentTask = nullptr;
+
+struct TaskStart { TaskFunction_t fn; void* param; HostTask* task; };
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char*, uint32_t, void* param,
+                                   UBaseType_t, TaskHandle_t* handle, BaseType_t) {
+  HostTask* t = new HostTask();
+  TaskStart start = { fn, param, t };
+  if (handle) *handle = t;
+  t->thread = std::thread([start]() {
+    _currentTask = start.task;
+    start.fn(start.param);
+  });
+  t->thread.detach();
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  // Na hostu niti ni mogoče prisilno ustaviti: NULL = konec trenutne niti
+  if (task == nullptr || task == _currentTask) pthread_exit(nullptr);
+}
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount() { return (TickType_t)millis(); }
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return _currentTask; }
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  if (!task) return pdFAIL;
+  { std::lock_guard<std::mutex> lk(task->mtx); task->notifyCount++; }
+  task->cv.notify_one();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  HostTask* t = _currentTask;
+  if (!t) return 0;
+  std::unique_lock<std::mutex> lk(t->mtx);
+  if (ticks == portMAX_DELAY) t->cv.wait(lk, [t] { return t->notifyCount > 0; });
+  else t->cv.wait_for(lk, std::chrono::milliseconds(ticks), [t] { return t->notifyCount > 0; });
+  uint32_t n = t->notifyCount;
+  if (n) t->notifyCount = clearOnExit ? 0 : n - 1;
+  return n;
+}
+
+struct HostSemaphore {
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool available;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new HostSemaphore{ {}, {}, true }; }
+SemaphoreHandle_t xSemaphoreCreateBinary() { return new HostSemaphore{ {}, {}, false }; }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+  if (!s) return pdFAIL;
+  std::unique_lock<std::mutex> lk(s->mtx);
+  if (ticks == portMAX_DELAY) s->cv.wait(lk, [s] { return s->available; });
+  else if (!s->cv.wait_for(lk, std::chrono::milliseconds(ticks), [s] { return s->available; })) return pdFAIL;
+  s->available = false;
+  return pdPASS;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+  if (!s) return pdFAIL;
+  { std::lock_guard<std::mutex> lk(s->mtx); s->available = true; }
+  s->cv.notify_one();
+  return pdPASS;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t s) { delete s; }
+
+struct HostQueue {
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::deque<std::vector<uint8_t>> items;
+  size_t length;
+  size_t itemSize;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  HostQueue* q = new HostQueue();
+  q->length = length;
+  q->itemSize = itemSize;
+  return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks) {
+  if (!q) return pdFAIL;
+  std::unique_lock<std::mutex> lk(q->mtx);
+  auto hasRoom = [q] { return q->items.size() < q->length; };
+  if (ticks == portMAX_DELAY) q->cv.wait(lk, hasRoom);
+  else if (!q->cv.wait_for(lk, std::chrono::milliseconds(ticks), hasRoom)) return pdFAIL;
+  const uint8_t* p = (const uint8_t*)item;
+  q->items.emplace_back(p, p + q->itemSize);
+  q->cv.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* out, TickType_t ticks) {
+  if (!q) return pdFAIL;
+  std::unique_lock<std::mutex> lk(q->mtx);
+  auto hasItem = [q] { return !q->items.empty(); };
+  if (ticks == portMAX_DELAY) q->cv.wait(lk, hasItem);
+  else if (!q->cv.wait_for(lk, std::chrono::milliseconds(ticks), hasItem)) return pdFAIL;
+  memcpy(out, q->items.front().data(), q->itemSize);
+  q->items.pop_front();
+  q->cv.notify_all();
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+  if (!q) return 0;
+  std::lock_guard<std::mutex> lk(q->mtx);
+  return (UBaseType_t)q->items.size();
+}
+
+void vQueueDelete(QueueHandle_t q) { delete q; }
+
+// ============================================================================
+//  LITTLEFS (direktorij na hostu)
+// ============================================================================
+
+HostLittleFS LittleFS;
+
+struct HostFileImpl {
+  FILE* fp = nullptr;
+  bool isDir = false;
+  std::string path;        // LittleFS pot ("/scenes/00.bin")
+  std::string name;        // Samo ime
+  std::vector<std::string> entries;
+  size_t nextEntry = 0;
+  ~HostFileImpl() { if (fp) fclose(fp); }
+};
+
+static std::string baseName(const std::string& p) {
+  size_t s = p.rfind('/');
+  return s == std::string::npos ? p : p.substr(s + 1);
+}
+
+void HostLittleFS::setRoot(const char* dir) { _root = dir ? dir : ""; }
+
+std::string HostLittleFS::hostPath(const char* path) const {
+  std::string p = path ? path : "/";
+  if (p.empty() || p[0] != '/') p = "/" + p;
+  return _root + p;
+}
+
+bool HostLittleFS::begin(bool, const char*, uint8_t, const char*) {
+  if (_root.empty()) {
+    const char* env = getenv("HOST_LITTLEFS_ROOT");
+    _root = env ? env : "./littlefs";
+  }
+  std::error_code ec;
+  fs_::create_directories(_root, ec);
+  return !ec;
+}
+
+bool HostLittleFS::format() {
+  std::error_code ec;
+  fs_::remove_all(_root, ec);
+  fs_::create_directories(_root, ec);
+  return !ec;
+}
+
+File HostLittleFS::open(const char* path, const char* mode, bool) {
+  std::string hp = hostPath(path);
+  std::error_code ec;
+  auto impl = std::make_shared<HostFileImpl>();
+  impl->path = path ? path : "/";
+  impl->name = baseName(impl->path);
+
+  if (fs_::is_directory(hp, ec)) {
+    impl->isDir = true;
+    for (auto& e : fs_::directory_iterator(hp, ec)) impl->entries.push_back(e.path().filename().string());
+    std::sort(impl->entries.begin(), impl->entries.end());
+    return File(impl);
+  }
+
+  bool writing = mode && (mode[0] == 'w' || mode[0] == 'a' || strchr(mode, '+'));
+  if (writing) {
+    fs_::create_directories(fs_::path(hp).parent_path(), ec);
+    openForWrite++;
+    if (mode[0] == 'w') truncations++;
+    if (writeLatencyUs) std::this_thread::sleep_for(std::chrono::microseconds(writeLatencyUs));
+  } else {
+    openForRead++;
+  }
+  std::string m = mode ? mode : "r";
+  if (m.find('b') == std::string::npos) m += "b";
+  impl->fp = fopen(hp.c_str(), m.c_str());
+  if (!impl->fp) return File();
+  return File(impl);
+}
+
+bool HostLittleFS::exists(const char* path) {
+  std::error_code ec;
+  return fs_::exists(hostPath(path), ec);
+}
+
+bool HostLittleFS::mkdir(const char* path) {
+  std::error_code ec;
+  fs_::create_directories(hostPath(path), ec);
+  return !ec;
+}
+
+bool HostLittleFS::remove(const char* path) {
+  std::error_code ec;
+  return fs_::remove(hostPath(path), ec);
+}
+
+bool HostLittleFS::rmdir(const char* path) { return remove(path); }
+
+bool HostLittleFS::rename(const char* from, const char* to) {
+  std::error_code ec;
+  fs_::rename(hostPath(from), hostPath(to), ec);
+  return !ec;
+}
+
+size_t HostLittleFS::usedBytes() {
+  size_t total = 0;
+  std::error_code ec;
+  for (auto& e : fs_::recursive_directory_iterator(_root, ec)) {
+    if (e.is_regular_file(ec)) total += (size_t)e.file_size(ec);
+  }
+  return total;
+}
+
+File::operator bool() const { return _impl && (_impl->fp || _impl->isDir); }
+
+int File::read() {
+  if (!_impl || !_impl->fp) return -1;
+  int c = fgetc(_impl->fp);
+  if (c != EOF) LittleFS.bytesRead++;
+  return c == EOF ? -1 : c;
+}
+
+size_t File::read(uint8_t* buf, size_t len) {
+  if (!_impl || !_impl->fp) return 0;
+  size_t n = fread(buf, 1, len, _impl->fp);
+  LittleFS.bytesRead += n;
+  return n;
+}
+
+size_t File::write(const uint8_t* buf, size_t len) {
+  if (!_impl || !_impl->fp) return 0;
+  size_t n = fwrite(buf, 1, len, _impl->fp);
+  LittleFS.bytesWritten += n;
+  LittleFS.writeCalls++;
+  if (LittleFS.writeLatencyUs) std::this_thread::sleep_for(std::chrono::microseconds(LittleFS.writeLatencyUs));
+  return n;
+}
+
+int File::available() {
+  if (!_impl || !_impl->fp) return 0;
+  return (int)(size() - position());
+}
+
+int File::peek() {
+  if (!_impl || !_impl->fp) return -1;
+  int c = fgetc(_impl->fp);
+  if (c != EOF) ungetc(c, _impl->fp);
+  return c == EOF ? -1 : c;
+}
+
+size_t File::size() const {
+  if (!_impl || !_impl->fp) return 0;
+  long cur = ftell(_impl->fp);
+  fseek(_impl->fp, 0, SEEK_END);
+  long end = ftell(_impl->fp);
+  fseek(_impl->fp, cur, SEEK_SET);
+  return end < 0 ? 0 : (size_t)end;
+}
+
+size_t File::position() const {
+  if (!_impl || !_impl->fp) return 0;
+  long p = ftell(_impl->fp);
+  return p < 0 ? 0 : (size_t)p;
+}
+
+bool File::seek(uint32_t pos) {
+  if (!_impl || !_impl->fp) return false;
+  return fseek(_impl->fp, (long)pos, SEEK_SET) == 0;
+}
+
+void File::flush() { if (_impl && _impl->fp) fflush(_impl->fp); }
+
+void File::close() {
+  if (_impl && _impl->fp) { fclose(_impl->fp); _impl->fp = nullptr; }
+  _impl.reset();
+}
+
+const char* File::name() const { return _impl ? _impl->name.c_str() : ""; }
+const char* File::path() const { return _impl ? _impl->path.c_str() : ""; }
+bool File::isDirectory() const { return _impl && _impl->isDir; }
+
+File File::openNextFile() {
+  if (!_impl || !_impl->isDir || _impl->nextEntry >= _impl->entries.size()) return File();
+  std::string child = _impl->path;
+  if (child.empty() || child.back() != '/') child += "/";
+  child += _impl->entries[_impl->nextEntry++];
+  return LittleFS.open(child.c_str(), "r");
+}
+
+// ============================================================================
+//  ESP-DSP FFT (radix-2 DIT, vhod v naravnem vrstnem redu → izhod bit-reversed)
+// ============================================================================
+
+static std::vector<float> _twiddle;   // cos/sin pari za N/2 kotov
+static int _twiddleN = 0;
+
+esp_err_t dsps_fft2r_init_fc32(float*, int tableSize) {
+  if (tableSize <= 0 || (tableSize & (tableSize - 1))) return ESP_ERR_INVALID_ARG;
+  _twiddleN = tableSize;
+  _twiddle.resize(tableSize);
+  for (int i = 0; i < tableSize / 2; i++) {
+    float a = 2.0f * (float)M_PI * i / tableSize;
+    _twiddle[2 * i]     = cosf(a);
+    _twiddle[2 * i + 1] = sinf(a);
+  }
+  return ESP_OK;
+}
+
+void dsps_fft2r_deinit_fc32() { _twiddle.clear(); _twiddleN = 0; }
+
+esp_err_t dsps_fft2r_fc32(float* data, int n) {
+  if (n > _twiddleN || (n & (n - 1))) return ESP_ERR_INVALID_ARG;
+  // Decimacija v frekvenci: naravni vhod, bit-reversed izhod (kot ESP-DSP)
+  int stride = _twiddleN / n;
+  for (int len = n; len >= 2; len >>= 1) {
+    int half = len >> 1;
+    int step = stride * (n / len);
+    for (int start = 0; start < n; start += len) {
+      for (int k = 0; k < half; k++) {
+        float wr = _twiddle[2 * (k * step)];
+        float wi = -_twiddle[2 * (k * step) + 1];
+        float* a = &data[2 * (start + k)];
+        float* b = &data[2 * (start + k + half)];
+        float tr = a[0] - b[0], ti = a[1] - b[1];
+        a[0] += b[0]; a[1] += b[1];
+        b[0] = tr * wr - ti * wi;
+        b[1] = tr * wi + ti * wr;
+      }
+    }
+  }
+  return ESP_OK;
+}
+
+esp_err_t dsps_bit_rev_fc32(float* data, int n) {
+  for (int i = 1, j = 0; i < n; i++) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      float tr = data[2 * i], ti = data[2 * i + 1];
+      data[2 * i] = data[2 * j]; data[2 * i + 1] = data[2 * j + 1];
+      data[2 * j] = tr; data[2 * j + 1] = ti;
+    }
+  }
+  return ESP_OK;
+}
+
+// ============================================================================
+//  I2S — sintetični vhod v tempu lažne ure
+//  i2s_read vrne toliko vzorcev, kolikor jih je "prišlo" od zadnjega branja
+//  glede na hostClockNowUs(); če jih ni, realno počaka do 1 ms (brez vrtenja).
+// ============================================================================
+
+static std::atomic<HostI2sGenerator> _i2sGen{nullptr};
+static std::atomic<uint32_t> _i2sRate{0};
+static std::atomic<uint64_t> _i2sProduced{0};
+static uint64_t _i2sStartUs = 0;
+
+static uint64_t i2sDueSamples() {
+  return (hostClockNowUs() - _i2sStartUs) * _i2sRate.load() / 1000000ULL;
+}
+
+void hostI2sSetGenerator(HostI2sGenerator gen) { _i2sGen.store(gen); }
+
+bool hostI2sWaitCaughtUp(uint32_t timeoutMs) {
+  if (!_i2sGen.load() || !_i2sRate.load()) return false;
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  while (_i2sProduced.load() < i2sDueSamples()) {
+    if (std::chrono::steady_clock::now() >= end) return false;
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+esp_err_t i2s_driver_install(i2s_port_t, const i2s_config_t* cfg, int, void*) {
+  if (!_i2sGen.load() || !cfg) return ESP_FAIL;
+  _i2sRate = cfg->sample_rate;
+  _i2sProduced = 0;
+  _i2sStartUs = hostClockNowUs();
+  return ESP_OK;
+}
+
+esp_err_t i2s_driver_uninstall(i2s_port_t) { _i2sRate = 0; return ESP_OK; }
+
+esp_err_t i2s_set_pin(i2s_port_t, const i2s_pin_config_t*) {
+  return _i2sRate ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t i2s_read(i2s_port_t, void* dest, size_t size, size_t* bytesRead, TickType_t ticks) {
+  if (bytesRead) *bytesRead = 0;
+  HostI2sGenerator gen = _i2sGen.load();
+  if (!gen || !_i2sRate) return ESP_FAIL;
+
+  uint64_t produced = _i2sProduced.load();
+  uint64_t due = i2sDueSamples();
+  if (due <= produced) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(std::min<TickType_t>(ticks, 1)));
+    return ESP_OK;
+  }
+  size_t n = std::min<uint64_t>(due - produced, size / sizeof(int32_t));
+  int32_t* out = (int32_t*)dest;
+  for (size_t i = 0; i < n; i++) {
+    float v = gen(produced + i, _i2sRate.load());
+    v = std::max(-1.0f, std::min(1.0f, v));
+    out[i] = (int32_t)(v * 8388607.0f) * 256;   // 24-bit v zgornjih bitih (kot I2S)
+  }
+  _i2sProduced.store(produced + n);
+  if (bytesRead) *bytesRead = n * sizeof(int32_t);
+  return ESP_OK;
+}
@@ -0,0 +1,134 @@
+#include "launch_queue.h"
+#include <math.h>
+
+void LaunchQueue::begin(ExecFn exec, void* ctx) {
+  _exec = exec;
+  _ctx = ctx;
+  _count = 0;
+  _stats = {};
+}
+
+void LaunchQueue::noteOutputLatencyUs(uint32_t us) {
+  if (!_measuredUs) _measuredUs = us;
+  else _measuredUs = (uint32_t)((int32_t)_measuredUs + ((int32_t)us - (int32_t)_measuredUs) / LAUNCH_LATENCY_EMA);
+}
+
+bool LaunchQueue::enqueue(uint8_t action, uint8_t quantum, int16_t arg, uint32_t fadeMs, uint8_t curve) {
+  if (action >= LA_ACTION_COUNT) return false;
+  if (_count >= LAUNCH_MAX_PENDING) {
+    _stats.dropped++;
+    return false;
+  }
+  LaunchItem& it = _items[_count++];
+  it = {};
+  it.action = action;
+  it.quantum = quantum > LAUNCH_MAX_QUANTUM ? LAUNCH_MAX_QUANTUM : quantum;
+  it.arg = arg;
+  it.fadeMs = fadeMs;
+  it.curve = curve;
+  it.seq = ++_seq;
+  _stats.queued++;
+  return true;
+}
+
+void LaunchQueue::cancelAll() {
+  _count = 0;
+}
+
+// ============================================================================
+//  BEAT URA
+//  Pozicija = beatCount + rel; rel (faza + čas od vzorca) ostane majhen, zato
+//  float ne izgubi natančnosti pri dolgem štetju beatov.
+// ============================================================================
+
+static float relBeats(const BeatClock& clk, uint32_t nowUs) {
+  return clk.phase + (float)(int32_t)(nowUs - clk.sampleUs) / (float)clk.intervalUs;
+}
+
+// Prva meja kvanta, ki jo izhod še ujame (beat ≥ zdaj + zakasnitev)
+void LaunchQueue::resolve(LaunchItem& it, uint32_t nowUs, const BeatClock& clk) const {
+  float lead = (float)getLatencyUs() / (float)clk.intervalUs;
+  float ahead = relBeats(clk, nowUs) + lead;
+  int32_t first = (int32_t)floorf(ahead);
+  if ((float)first < ahead) first++;
+  uint32_t b = clk.beatCount + (uint32_t)first;
+
+  // Mreža taktov/fraz: Link pove beat v taktu, sicer šteje od začetka števca.
+  // Sidro je samo ostanek po taktu, da so fraze enake ne glede na takt prihoda.
+  uint32_t anchor = clk.barBeat >= 0 ? (clk.beatCount - (uint32_t)clk.barBeat) % BEATS_PER_BAR : 0;
+  uint32_t off = (b - anchor) % it.quantum;
+  if (off) b += it.quantum - off;
+  it.targetBeat = b;
+  it.resolved = true;
+}
+
+float LaunchQueue::beatsUntil(int i, uint32_t nowUs, const BeatClock& clk) const {
+  if (i < 0 || i >= _count || !_items[i].resolved || !clk.valid || !clk.intervalUs) return -1.0f;
+  return (float)(int32_t)(_items[i].targetBeat - clk.beatCount) - relBeats(clk, nowUs);
+}
+
+// ============================================================================
+//  FRAME
+//  Izhod tega frame-a pride ven ob nowUs + zakasnitev. Ukaz se sproži v
+//  frame-u, ko je to najkasneje pol periode pred beatom — naslednji frame bi
+//  bil dlje od beata.
+// ============================================================================
+
+void LaunchQueue::tick(uint32_t nowUs, uint32_t periodUs, const BeatClock& clk) {
+  if (!_count) return;
+  bool clockOk = clk.valid && clk.intervalUs > 0;
+  float latency = (float)getLatencyUs();
+  _stats.latencyUs = getLatencyUs();
+
+  LaunchItem due[LAUNCH_MAX_PENDING];
+  int nDue = 0;
+  int keep = 0;
+  for (int i = 0; i < _count; i++) {
+    LaunchItem& it = _items[i];
+    bool fire = false;
+    if (!clockOk || !it.quantum) {
+      fire = true;
+      _stats.immediate++;
+    } else {
+      if (!it.resolved) resolve(it, nowUs, clk);
+      float left = (float)(int32_t)(it.targetBeat - clk.beatCount) - relBeats(clk, nowUs);
+      // Števec je skočil nazaj (nov vir, restart) — cilj je predaleč, določi znova
+      if (left > (float)it.quantum + latency / clk.intervalUs + 1.0f) {
+        resolve(it, nowUs, clk);
+        left = (float)(int32_t)(it.targetBeat - clk.beatCount) - relBeats(clk, nowUs);
+      }
+      float errUs = latency - left * (float)clk.intervalUs;    // Izhod − beat
+      if (errUs >= -(float)periodUs * 0.5f) {
+        fire = true;
+        if (errUs > (float)periodUs) _stats.late++;
+        _stats.lastErrUs = (int32_t)errUs;
+        uint32_t absErr = (uint32_t)(errUs < 0 ? -errUs : errUs);
+        if (absErr > _stats.maxAbsErrUs) _stats.maxAbsErrUs = absErr;
+      }
+    }
+    if (fire) due[nDue++] = it;
+    else _items[keep++] = it;
+  }
+  _count = keep;
+
+  // Več ukazov na isti meji: po cilju, nato po prihodu
+  for (int i = 1; i < nDue; i++) {
+    LaunchItem k = due[i];
+    int j = i - 1;
+    while (j >= 0 && ((int32_t)(due[j].targetBeat - k.targetBeat) > 0 ||
+                      (due[j].targetBeat == k.targetBeat && (int32_t)(due[j].seq - k.seq) > 0))) {
+      due[j + 1] = due[j];
+      j--;
+    }
+    due[j + 1] = k;
+  }
+  for (int i = 0; i < nDue; i++) {
+    _stats.fired++;
+    if (_exec) _exec(due[i], _ctx);
+  }
+}
+
+void LaunchQueue::getStats(LaunchStats& out) const {
+  out = _stats;
+  out.latencyUs = getLatencyUs();
+}
@@ -0,0 +1,91 @@
+#ifndef LAUNCH_QUEUE_H
+#define LAUNCH_QUEUE_H
+
+#include "config.h"
+
+// ============================================================================
+//  LaunchQueue — ukazi, kvantizirani na beat / takt / frazo
+//
+//  Ukaz s kvantom N beatov (1 = beat, 4 = takt, 16 = fraza) se ne izvede
+//  ob prihodu, ampak v frame-u, katerega izhod pade najbližje naslednji meji
+//  N beatov. Beat uro da SoundEngine (manual beat, Link, avdio); vrsta jo
+//  ekstrapolira na začetek frame-a. Ukaz gre ven toliko frame-ov prej, kot
+//  traja izhod (izmerjeno: frame do oddaje + DMX paket; nastavljeno: fixture,
+//  omrežje), da luč zasveti na beat in ne za njim. Napaka je največ pol
+//  periode frame-a. Brez beat ure se ukaz izvede takoj.
+//  Izvede ga klicatelj (ExecFn) na frame tasku pod mixer lockom — enako kot
+//  WebSocket ukaze.
+// ============================================================================
+
+#define LAUNCH_MAX_PENDING   16
+#define LAUNCH_MAX_QUANTUM   64       // Beati (16 taktov)
+#define LAUNCH_LATENCY_EMA   16       // Glajenje izmerjene zakasnitve (frame-i)
+
+enum LaunchAction : uint8_t {
+  LA_SCENE = 0,      // arg = slot, fadeMs, curve
+  LA_CUE_GO,
+  LA_CUE_GOTO,       // arg = cue
+  LA_PROGRAM,        // arg = ManualBeatProgram
+  LA_CHAIN,          // arg = 1 start od prvega vnosa, 0 stop
+  LA_PB_GO,          // arg = playback, fadeMs
+  LA_PB_RELEASE,     // arg = playback, fadeMs
+  LA_ACTION_COUNT
+};
+
+struct LaunchItem {
+  uint8_t  action;       // LaunchAction
+  uint8_t  quantum;      // Beati (0 = takoj)
+  int16_t  arg;
+  uint32_t fadeMs;
+  uint8_t  curve;
+  bool     resolved;     // targetBeat določen (prvi tick po prihodu)
+  uint32_t targetBeat;   // Absoluten beat beat ure
+  uint32_t seq;
+};
+
+struct LaunchStats {
+  uint32_t queued;
+  uint32_t fired;
+  uint32_t immediate;    // Brez kvanta ali brez beat ure
+  uint32_t late;         // Izhod več kot frame za beatom (skok ure)
+  uint32_t dropped;      // Polna vrsta
+  int32_t  lastErrUs;    // Pričakovan izhod − beat, zadnji kvantiziran
+  uint32_t maxAbsErrUs;
+  uint32_t latencyUs;    // Trenutna kompenzacija
+};
+
+class LaunchQueue {
+public:
+  typedef void (*ExecFn)(const LaunchItem& item, void* ctx);
+
+  void begin(ExecFn exec, void* ctx);
+  void setExtraLatencyUs(uint32_t us) { _extraUs = us; }
+  void noteOutputLatencyUs(uint32_t us);           // Vsak frame: začetek frame-a → izhod
+  uint32_t getLatencyUs() const { return _measuredUs + _extraUs; }
+
+  // Pod mixer lockom; false = polna vrsta
+  bool enqueue(uint8_t action, uint8_t quantum, int16_t arg = 0, uint32_t fadeMs = 0, uint8_t curve = 0);
+  void cancelAll();
+
+  // Frame task pod mixer lockom, pred mixer.update()
+  void tick(uint32_t nowUs, uint32_t periodUs, const BeatClock& clk);
+
+  int  pendingCount() const { return _count; }
+  const LaunchItem* getPending(int i) const { return (i >= 0 && i < _count) ? &_items[i] : nullptr; }
+  float beatsUntil(int i, uint32_t nowUs, const BeatClock& clk) const;   // < 0 = še ni določen
+  void getStats(LaunchStats& out) const;
+
+private:
+  ExecFn     _exec = nullptr;
+  void*      _ctx = nullptr;
+  LaunchItem _items[LAUNCH_MAX_PENDING];           // Po vrstnem redu prihoda
+  uint8_t    _count = 0;
+  uint32_t   _seq = 0;
+  uint32_t   _measuredUs = 0;
+  uint32_t   _extraUs = 0;
+  LaunchStats _stats = {};
+
+  void resolve(LaunchItem& it, uint32_t nowUs, const BeatClock& clk) const;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "lfo_engine.h"
+#include "value16.h"
 #include <cmath>
 #include <cstring>
 
@@ -40,7 +41,8 @@ void LfoEngine::update(float dt) {
 }
 
 void LfoEngine::applyToOutput(const uint8_t* manualValues, uint8_t* dmxOut) {
-  if (!_fixtures) return;
+  const PatchMap* m = _fixtures ? _fixtures->getPatchMap() : nullptr;
+  if (!m) return;
 
   for (int li = 0; li < MAX_LFOS; li++) {
     if (!_lfos[li].active) continue;
@@ -58,8 +60,8 @@ void LfoEngine::applyToOutput(const uint8_t* manualValues, uint8_t* dmxOut) {
     for (int fi = 0; fi < MAX_FIXTURES; fi++) {
       if (!(lfo.fixtureMask & (1UL << fi))) continue;
 
-      const PatchEntry* fx = _fixtures->getFixture(fi);
-      if (!fx || !fx->active || fx->profileIndex < 0) { fxIdx++; continue; }
+      const PatchSpan& sp = m->fixtureSpan[fi];
+      if (sp.count == 0) { fxIdx++; continue; }
 
       // Per-fixture phase offset za spread/chase efekt
       // Symmetry transform: pretvori fxIdx v spreadIdx
@@ -75,39 +77,14 @@ void LfoEngine::applyToOutput(const uint8_t* manualValues, uint8_t* dmxOut) {
       float fiPhase = fmodf(lfo.currentPhase + lfo.phase * (float)spreadIdx / (float)fxCount, 1.0f);
       float mod = computeWave(lfo.waveform, fiPhase);
 
-      uint8_t chCount = _fixtures->fixtureChannelCount(fi);
-
-      // Za Pan/Tilt: poišči fine kanal za 16-bit modulacijo
-      int fineAddr = -1;
-      if (chType == CH_PAN || chType == CH_TILT) {
-        ChannelType fineType = (chType == CH_PAN) ? CH_PAN_FINE : CH_TILT_FINE;
-        for (int fc = 0; fc < chCount; fc++) {
-          const ChannelDef* fd = _fixtures->fixtureChannel(fi, fc);
-          if (fd && fd->type == fineType) {
-            int fa = fx->dmxAddress + fc;
-            if (fa >= 1 && fa <= DMX_MAX_CHANNELS) fineAddr = fa - 1;
-            break;
-          }
-        }
-      }
+      for (uint16_t addr = sp.start; addr < sp.start + sp.count; addr++) {
+        const PatchAddr& pa = m->addr[addr];
+        if (pa.type != chType || pa.fixture != fi || pa.fine) continue;
 
-      for (int c = 0; c < chCount; c++) {
-        const ChannelDef* def = _fixtures->fixtureChannel(fi, c);
-        if (!def || def->type != chType) continue;
-
-        uint16_t addr = fx->dmxAddress + c;  // 1-based
-        if (addr < 1 || addr > DMX_MAX_CHANNELS) continue;
-        addr--;  // 0-based index
-
-        if (fineAddr >= 0 && (chType == CH_PAN || chType == CH_TILT)) {
-          // 16-bit modulacija: coarse+fine
-          uint16_t base16 = ((uint16_t)manualValues[addr] << 8) | manualValues[fineAddr];
-          float modVal16 = mod * lfo.depth * 32767.5f;
-          int result16 = (int)((float)base16 + modVal16);
-          if (result16 < 0) result16 = 0;
-          if (result16 > 65535) result16 = 65535;
-          dmxOut[addr] = (uint8_t)((result16 >> 8) & 0xFF);
-          dmxOut[fineAddr] = (uint8_t)(result16 & 0xFF);
+        if (pa.partner != PATCH_NONE) {
+          // 16-bit modulacija: coarse+fine (par iz PatchMap)
+          uint16_t base16 = get16(manualValues, addr, pa.partner);
+          put16(dmxOut, addr, pa.partner, offset16(base16, (int32_t)(mod * lfo.depth * 32767.5f)));
         } else {
           // 8-bit modulacija
           float base = (float)manualValues[addr];
@@ -3,6 +3,7 @@
 
 #include "config.h"
 #include "fixture_engine.h"
+#include "output_stage.h"
 
 #define MAX_LFOS 8
 
@@ -21,18 +22,27 @@ struct LfoInstance {
   float    currentPhase;  // Runtime accumulator (0.0 - 1.0)
 };
 
-class LfoEngine {
+class LfoEngine : public OutputStage {
 public:
   void begin(FixtureEngine* fixtures);
   void update(float dt);
   void applyToOutput(const uint8_t* manualValues, uint8_t* dmxOut);
 
+  // OutputStage
+  const char* name() const override { return "lfo"; }
+  uint32_t channelTypes() const override {
+    return (1UL << CH_INTENSITY) | (1UL << CH_PAN) | (1UL << CH_TILT) |
+           (1UL << CH_COLOR_R) | (1UL << CH_COLOR_G) | (1UL << CH_COLOR_B);
+  }
+  void prepare(float dt) override { update(dt); }
+  void apply(const uint8_t* in, uint8_t* out) override { applyToOutput(in, out); }
+
   int  addLfo(const LfoInstance& lfo);
   bool removeLfo(int idx);
   bool updateLfo(int idx, const LfoInstance& lfo);
   const LfoInstance* getLfo(int idx) const;
   int  getActiveCount() const;
-  bool isActive() const;
+  bool isActive() const override;
 
 private:
   FixtureEngine* _fixtures = nullptr;
@@ -0,0 +1,197 @@
+#include "merge_engine.h"
+#include "value16.h"
+
+// ============================================================================
+//  KERNEL
+// ============================================================================
+
+void mergeInit(MergeBuffers& mb) {
+  memset(&mb, 0, sizeof(MergeBuffers));
+  memset(mb.owner, MERGE_SRC_LOCAL, sizeof(mb.owner));
+  mb.htpGeneration = 0xFFFFFFFF;
+}
+
+void mergeBuildHtp(MergeBuffers& mb, const PatchMap* m, uint32_t htpMask) {
+  uint8_t generic = (htpMask & (1UL << CH_GENERIC)) ? 0xFF : 0x00;
+  for (int a = 0; a < DMX_MAX_CHANNELS; a++) {
+    if (!m || m->addr[a].fixture < 0) { mb.htp[a] = generic; continue; }
+    mb.htp[a] = (htpMask & (1UL << m->addr[a].type)) ? 0xFF : 0x00;
+  }
+  mb.pairCount = 0;
+  if (m) {
+    for (int p = 0; p < m->pairCount; p++) {
+      const PatchPair& pp = m->pairs[p];
+      mb.htp[pp.fine] = mb.htp[pp.coarse];
+      mb.pairCoarse[mb.pairCount] = pp.coarse;
+      mb.pairFine[mb.pairCount] = pp.fine;
+      mb.pairCount++;
+    }
+  }
+  mb.htpGeneration = m ? m->generation : 0;
+  mb.htpMask = htpMask;
+}
+
+// LTP lastniki, ki ne sodelujejo več → prvi sodelujoči vir (redko: ob spremembi part)
+static void mergeRetarget(MergeBuffers& mb, uint8_t part, int n) {
+  uint8_t first = MERGE_SRC_LOCAL;
+  for (int s = 0; s < MERGE_SRC_COUNT; s++) if (part & (1 << s)) { first = s; break; }
+  for (int i = 0; i < n; i++) {
+    if (!(part & (1 << mb.owner[i]))) mb.owner[i] = first;
+  }
+}
+
+// Brez vejitev po kanalu: maske 0x00/0xFF in izbire, ki jih prevajalnik
+// prevede v blend/min/max ukaze (SIMD na hostu, brez skokov na Xtensa).
+void mergeKernel(MergeBuffers& mb, const uint8_t* const src[MERGE_SRC_COUNT],
+                 uint8_t part, uint8_t* out, int n, const uint8_t* localSeen) {
+  if (part != mb.part) {
+    mergeRetarget(mb, part, n);
+    mb.part = part;
+  }
+
+  // Lastnika parov pred prehodom (za zaznavo, kateri bajt je zamenjal lastnika)
+  uint8_t preOwner[MAX_PATCH_PAIRS][2];
+  for (int p = 0; p < mb.pairCount; p++) {
+    preOwner[p][0] = mb.owner[mb.pairCoarse[p]];
+    preOwner[p][1] = mb.owner[mb.pairFine[p]];
+  }
+
+  const uint8_t* __restrict a = src[MERGE_SRC_ARTNET];
+  const uint8_t* __restrict l = src[MERGE_SRC_LOCAL];
+  const uint8_t* __restrict o = src[MERGE_SRC_OSC];
+  const uint8_t* __restrict ld = localSeen ? localSeen : l;
+  uint8_t* __restrict sa = mb.seen[MERGE_SRC_ARTNET];
+  uint8_t* __restrict sl = mb.seen[MERGE_SRC_LOCAL];
+  uint8_t* __restrict so = mb.seen[MERGE_SRC_OSC];
+  uint8_t* __restrict own = mb.owner;
+  const uint8_t* __restrict htp = mb.htp;
+  uint8_t* __restrict dst = out;
+  const uint8_t pa = (part & (1 << MERGE_SRC_ARTNET)) ? 0xFF : 0x00;
+  const uint8_t pl = (part & (1 << MERGE_SRC_LOCAL))  ? 0xFF : 0x00;
+  const uint8_t po = (part & (1 << MERGE_SRC_OSC))    ? 0xFF : 0x00;
+
+  for (int i = 0; i < n; i++) {
+    const uint8_t va = a[i], vl = l[i], vo = o[i], dl = ld[i];
+
+    // Sprememba sodelujočega vira prevzame LTP kanal; pri hkratni spremembi
+    // zmaga vir z višjim indeksom (OSC > lokalno > ArtNet)
+    const uint8_t ca = (uint8_t)(va != sa[i] ? 0xFF : 0x00) & pa;
+    const uint8_t cl = (uint8_t)(dl != sl[i] ? 0xFF : 0x00) & pl;
+    const uint8_t co = (uint8_t)(vo != so[i] ? 0xFF : 0x00) & po;
+    uint8_t w = own[i];
+    w = (uint8_t)((w & ~ca) | (MERGE_SRC_ARTNET & ca));
+    w = (uint8_t)((w & ~cl) | (MERGE_SRC_LOCAL  & cl));
+    w = (uint8_t)((w & ~co) | (MERGE_SRC_OSC    & co));
+    own[i] = w;
+    sa[i] = va; sl[i] = dl; so[i] = vo;
+
+    // HTP: max sodelujočih; LTP: vrednost lastnika
+    uint8_t h = va & pa;
+    const uint8_t hl = vl & pl, ho = vo & po;
+    h = h > hl ? h : hl;
+    h = h > ho ? h : ho;
+    const uint8_t lt = (w == MERGE_SRC_ARTNET) ? va : (w == MERGE_SRC_LOCAL) ? vl : vo;
+
+    const uint8_t m = htp[i];
+    dst[i] = (uint8_t)((h & m) | (lt & ~m));
+  }
+
+  // 16-bit pari (malo jih je): skupen lastnik, HTP po celi vrednosti
+  for (int p = 0; p < mb.pairCount; p++) {
+    const uint16_t c = mb.pairCoarse[p], f = mb.pairFine[p];
+    if (c >= n || f >= n) continue;
+    uint8_t w = own[c];
+    if (w == preOwner[p][0] && own[f] != preOwner[p][1]) w = own[f];
+    own[c] = own[f] = w;
+    uint16_t v;
+    if (htp[c]) {
+      v = 0;
+      for (int s = 0; s < MERGE_SRC_COUNT; s++) {
+        if (!(part & (1 << s))) continue;
+        uint16_t sv = get16(src[s], c, f);
+        if (sv > v) v = sv;
+      }
+    } else {
+      v = get16(src[w], c, f);
+    }
+    put16(dst, c, f, v);
+  }
+}
+
+void mergeRelease(const MergeBuffers& mb, uint8_t source, const uint8_t* src,
+                  uint8_t* local, int n) {
+  // HTP pari: max po 16-bit vrednosti, ne po bajtih
+  uint16_t pairV[MAX_PATCH_PAIRS];
+  for (int p = 0; p < mb.pairCount; p++) {
+    uint16_t l = get16(local, mb.pairCoarse[p], mb.pairFine[p]);
+    uint16_t s = get16(src, mb.pairCoarse[p], mb.pairFine[p]);
+    pairV[p] = s > l ? s : l;
+  }
+  for (int i = 0; i < n; i++) {
+    if (mb.htp[i]) { if (src[i] > local[i]) local[i] = src[i]; }
+    else if (mb.owner[i] == source) local[i] = src[i];
+  }
+  for (int p = 0; p < mb.pairCount; p++) {
+    if (mb.htp[mb.pairCoarse[p]]) put16(local, mb.pairCoarse[p], mb.pairFine[p], pairV[p]);
+  }
+}
+
+// ============================================================================
+//  VIRI
+// ============================================================================
+
+void MergeEngine::begin() {
+  for (int s = 0; s < MERGE_SRC_COUNT; s++) {
+    _priority[s] = MERGE_PRIORITY_DEFAULT;
+    _timeoutMs[s] = 0;
+    _lastSeen[s] = 0;
+    _seen[s] = false;
+  }
+  _pinned = MERGE_NO_PIN;
+  _htpMask = MERGE_HTP_DEFAULT;
+}
+
+void MergeEngine::setPriority(uint8_t source, uint8_t priority) {
+  if (source >= MERGE_SRC_COUNT) return;
+  _priority[source] = priority > MERGE_PRIORITY_MAX ? MERGE_PRIORITY_MAX : priority;
+}
+
+uint8_t MergeEngine::getPriority(uint8_t source) const {
+  return source < MERGE_SRC_COUNT ? _priority[source] : 0;
+}
+
+void MergeEngine::setTimeout(uint8_t source, uint32_t ms) {
+  if (source < MERGE_SRC_COUNT) _timeoutMs[source] = ms;
+}
+
+uint32_t MergeEngine::getTimeout(uint8_t source) const {
+  return source < MERGE_SRC_COUNT ? _timeoutMs[source] : 0;
+}
+
+void MergeEngine::touch(uint8_t source, unsigned long nowMs) {
+  if (source >= MERGE_SRC_COUNT) return;
+  _lastSeen[source] = nowMs;
+  _seen[source] = true;
+}
+
+bool MergeEngine::isActive(uint8_t source, unsigned long nowMs) const {
+  if (source >= MERGE_SRC_COUNT || !_seen[source]) return false;
+  return _timeoutMs[source] == 0 || (nowMs - _lastSeen[source]) <= _timeoutMs[source];
+}
+
+unsigned long MergeEngine::getLastSeen(uint8_t source) const {
+  return source < MERGE_SRC_COUNT ? _lastSeen[source] : 0;
+}
+
+uint8_t MergeEngine::participants(unsigned long nowMs) const {
+  // Pripet vir je nad vsemi (prioriteta + 256)
+  uint16_t best = 0;
+  uint8_t mask = 0;
+  for (int s = 0; s < MERGE_SRC_COUNT; s++) {
+    if (!isActive(s, nowMs)) continue;
+    uint16_t p = _priority[s] + (s == _pinned ? 256 : 0);
+    if (!mask || p > best) { best = p; mask = (1 << s); }
+    else if (p == best) mask |= (1 << s);
+  }
+  return mask ? mask : (1 << MERGE_SRC_LOCAL);
+}
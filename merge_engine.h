@@ -0,0 +1,98 @@
+#ifndef MERGE_ENGINE_H
+#define MERGE_ENGINE_H
+
+#include "config.h"
+#include "fixture_engine.h"
+
+// ============================================================================
+//  MERGE — spajanje virov po kanalih (ArtNet, lokalni mixer, OSC)
+//
+//  Vsak vir ima svoj 512-bajtni buffer, prioriteto in timeout. V spajanju
+//  sodelujejo samo aktivni viri z najvišjo prioriteto (kot pri sACN):
+//    - HTP (highest takes precedence): največja vrednost sodelujočih virov
+//    - LTP (latest takes precedence): vrednost vira, ki je kanal zadnji spremenil
+//  Pravilo se izbere po tipu kanala iz PatchMap (privzeto HTP samo intensity).
+//  Sprememba se zazna v samem prehodu (primerjava z zadnjo videno vrednostjo),
+//  zato viri ne rabijo časovnih žigov po kanalih in ne preklapljajo načina.
+// ============================================================================
+
+enum MergeSource : uint8_t {
+  MERGE_SRC_ARTNET = 0,
+  MERGE_SRC_LOCAL  = 1,   // Ročne vrednosti + scene + efekti
+  MERGE_SRC_OSC    = 2,
+  MERGE_SRC_COUNT  = 3
+};
+
+// MERGE_PRIORITY_DEFAULT in MERGE_HTP_DEFAULT sta v config.h (NodeConfig)
+#define MERGE_PRIORITY_MAX      200              // Kot sACN
+#define MERGE_NO_PIN            0xFF
+
+// Stanje spajanja ene univerze
+struct MergeBuffers {
+  uint8_t  osc[DMX_MAX_CHANNELS];                     // Buffer OSC vira
+  uint8_t  seen[MERGE_SRC_COUNT][DMX_MAX_CHANNELS];   // Zadnja videna vrednost vsakega vira
+  uint8_t  owner[DMX_MAX_CHANNELS];                   // LTP lastnik kanala (MergeSource)
+  uint8_t  htp[DMX_MAX_CHANNELS];                     // 0xFF = HTP, 0x00 = LTP
+  uint32_t htpGeneration;                             // PatchMap generacija, iz katere je htp[]
+  uint32_t htpMask;                                   // Maska tipov, iz katere je htp[]
+  uint8_t  part;                                      // Sodelujoči viri ob zadnjem prehodu
+  uint8_t  pairCount;                                 // 16-bit pari: en lastnik, HTP po 16-bit
+  uint16_t pairCoarse[MAX_PATCH_PAIRS];
+  uint16_t pairFine[MAX_PATCH_PAIRS];
+};
+
+// Pripravi buffer (vse LTP lastnike dobi lokalni vir)
+void mergeInit(MergeBuffers& mb);
+
+// htp[] iz tipov kanalov (fine bajt ima pravilo coarse-a); nepatchani naslovi so CH_GENERIC
+void mergeBuildHtp(MergeBuffers& mb, const PatchMap* m, uint32_t htpMask);
+
+// En prehod čez n kanalov. src[s] mora biti veljaven za vse vire (neaktiven
+// vir ima v part bit 0). Ob spremembi part se LTP lastniki, ki ne sodelujejo
+// več, prenesejo na prvi sodelujoči vir. Coarse/fine par ima skupnega lastnika
+// (vir, ki je spremenil katerikoli bajt), HTP primerja 16-bit vrednosti.
+// localSeen: buffer, na katerem se zazna sprememba lokalnega vira (ročne
+// vrednosti pred overlay-i — LFO/sound ne prevzemata LTP kanalov); na izhod gre
+// src[MERGE_SRC_LOCAL]. nullptr = zaznava na src[MERGE_SRC_LOCAL].
+void mergeKernel(MergeBuffers& mb, const uint8_t* const src[MERGE_SRC_COUNT],
+                 uint8_t part, uint8_t* out, int n, const uint8_t* localSeen = nullptr);
+
+// Prispevek vira, ki je potekel, se prenese v lokalne vrednosti (drži zadnjo sliko):
+// HTP kanali max(local, src), LTP kanali v lasti vira → src
+void mergeRelease(const MergeBuffers& mb, uint8_t source, const uint8_t* src,
+                  uint8_t* local, int n);
+
+// ============================================================================
+//  MergeEngine — prioritete, timeouti in aktivnost virov
+// ============================================================================
+
+class MergeEngine {
+public:
+  void begin();
+
+  void setPriority(uint8_t source, uint8_t priority);
+  uint8_t getPriority(uint8_t source) const;
+  void setTimeout(uint8_t source, uint32_t ms);          // 0 = vir ne poteče
+  uint32_t getTimeout(uint8_t source) const;
+  void setHtpMask(uint32_t mask) { _htpMask = mask; }    // bit = ChannelType
+  uint32_t getHtpMask() const { return _htpMask; }
+
+  // Pripet vir ima prednost pred vsemi nepripetimi (ročni preklop operaterja)
+  void setPinned(uint8_t source) { _pinned = source; }  // MERGE_NO_PIN = brez
+  uint8_t getPinned() const { return _pinned; }
+
+  void touch(uint8_t source, unsigned long nowMs);       // Vir je poslal podatke
+  bool isActive(uint8_t source, unsigned long nowMs) const;
+  uint8_t participants(unsigned long nowMs) const;       // Bitmask sodelujočih virov
+  unsigned long getLastSeen(uint8_t source) const;
+
+private:
+  uint8_t  _priority[MERGE_SRC_COUNT];
+  uint32_t _timeoutMs[MERGE_SRC_COUNT];
+  unsigned long _lastSeen[MERGE_SRC_COUNT];
+  bool     _seen[MERGE_SRC_COUNT];
+  uint8_t  _pinned = MERGE_NO_PIN;
+  uint32_t _htpMask = MERGE_HTP_DEFAULT;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "metrics.h"
+
+// ============================================================================
+//  HISTOGRAMI
+//  Zapisuje samo frame task (runFrame/sendUniverseOutputs), bere web task. Števci so
+//  32-bitni (atomarno branje na Xtensa), zato je lahko izpis med dvema
+//  zapisoma zamaknjen za en vzorec — za metrike dovolj, brez locka.
+// ============================================================================
+
+static const uint16_t BUCKET_US[METRICS_BUCKETS] = {
+  5, 10, 25, 50, 100, 250, 500, 1000, 2000, 5000, 10000, 25000
+};
+
+static const char* STAGE_NAMES[MET_STAGE_COUNT] = {
+  "mix_crossfade", "mix_sound", "mix_lfo", "mix_shape", "mix_playback", "mix_merge", "mix_output", "mix_total",
+  "artnet_read", "osc_update", "dmx_send", "artnet_out", "sacn_out", "espnow_out",
+  "pixel_map", "web_loop", "loop_total", "frame_total"
+};
+
+static StageHistogram _hist[MET_STAGE_COUNT];
+static uint32_t _bucketCycles[METRICS_BUCKETS];
+static uint32_t _cyclesPerUs = 0;
+
+void metricsBegin() {
+  _cyclesPerUs = getCpuFrequencyMhz();
+  if (_cyclesPerUs == 0) _cyclesPerUs = 240;
+  for (int b = 0; b < METRICS_BUCKETS; b++) _bucketCycles[b] = (uint32_t)BUCKET_US[b] * _cyclesPerUs;
+  metricsReset();
+  Serial.printf("[MET] Metrike %s (%lu MHz)\n", METRICS_ENABLED ? "vklopljene" : "izklopljene",
+                (unsigned long)_cyclesPerUs);
+}
+
+void metricsReset() {
+  memset(_hist, 0, sizeof(_hist));
+}
+
+#if METRICS_ENABLED
+void metricsRecord(uint8_t stage, uint32_t cycles) {
+  if (stage >= MET_STAGE_COUNT || _cyclesPerUs == 0) return;
+  StageHistogram& h = _hist[stage];
+  uint8_t b = 0;
+  while (b < METRICS_BUCKETS && cycles > _bucketCycles[b]) b++;
+  h.counts[b]++;
+  h.sumCycles += cycles;
+  if (cycles > h.maxCycles) h.maxCycles = cycles;
+}
+#endif
+
+bool metricsGet(uint8_t stage, StageHistogram& out) {
+  if (stage >= MET_STAGE_COUNT) return false;
+  out = _hist[stage];
+  return true;
+}
+
+const char* metricsStageName(uint8_t stage) {
+  return stage < MET_STAGE_COUNT ? STAGE_NAMES[stage] : "?";
+}
+
+float metricsBucketUs(uint8_t bucket) {
+  return bucket < METRICS_BUCKETS ? (float)BUCKET_US[bucket] : INFINITY;
+}
+
+uint32_t metricsCyclesPerUs() {
+  return _cyclesPerUs;
+}
+
+// ============================================================================
+//  PROMETHEUS TEXT FORMAT (0.0.4)
+// ============================================================================
+
+void metricsWritePrometheus(String& out) {
+  char line[112];
+  out.reserve(MET_STAGE_COUNT * 1200);
+  out += "# HELP dmx_stage_duration_seconds Trajanje koraka realtime zanke\n"
+         "# TYPE dmx_stage_duration_seconds histogram\n";
+  double cyc = _cyclesPerUs ? (double)_cyclesPerUs * 1e6 : 240e6;
+
+  for (uint8_t s = 0; s < MET_STAGE_COUNT; s++) {
+    StageHistogram h; metricsGet(s, h);
+    const char* n = STAGE_NAMES[s];
+    uint32_t cum = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+      cum += h.counts[b];
+      snprintf(line, sizeof(line), "dmx_stage_duration_seconds_bucket{stage=\"%s\",le=\"%g\"} %lu\n",
+               n, BUCKET_US[b] * 1e-6, (unsigned long)cum);
+      out += line;
+    }
+    cum += h.counts[METRICS_BUCKETS];
+    snprintf(line, sizeof(line), "dmx_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %lu\n",
+             n, (unsigned long)cum);
+    out += line;
+    snprintf(line, sizeof(line), "dmx_stage_duration_seconds_sum{stage=\"%s\"} %.9f\n",
+             n, (double)h.sumCycles / cyc);
+    out += line;
+    snprintf(line, sizeof(line), "dmx_stage_duration_seconds_count{stage=\"%s\"} %lu\n",
+             n, (unsigned long)cum);
+    out += line;
+  }
+
+  out += "# HELP dmx_stage_duration_max_seconds Najdaljse trajanje koraka od zadnjega reseta\n"
+         "# TYPE dmx_stage_duration_max_seconds gauge\n";
+  for (uint8_t s = 0; s < MET_STAGE_COUNT; s++) {
+    snprintf(line, sizeof(line), "dmx_stage_duration_max_seconds{stage=\"%s\"} %.9f\n",
+             STAGE_NAMES[s], (double)_hist[s].maxCycles / cyc);
+    out += line;
+  }
+}
@@ -0,0 +1,76 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "config.h"
+
+// ============================================================================
+//  METRIKE — časi posameznih korakov realtime zanke (frame task)
+//
+//  Cikli CPU (esp_cpu_get_cycle_count) → histogram s fiksnimi predali.
+//  Zapis: ~20 ciklov (2× branje števca + linearno iskanje predala).
+//  Edini pisec je frame task; branje: /api/metrics v Prometheus text formatu.
+//  METRICS_ENABLED=0 → makroji se prevedejo v nič.
+// ============================================================================
+
+#ifndef METRICS_ENABLED
+#define METRICS_ENABLED 1
+#endif
+
+#define METRICS_BUCKETS  12    // Končni predali; +Inf je dodaten
+
+enum MetricStage : uint8_t {
+  // MixerEngine::update()
+  MET_MIX_CROSSFADE = 0,
+  MET_MIX_SOUND,
+  MET_MIX_LFO,
+  MET_MIX_SHAPE,
+  MET_MIX_PLAYBACK,     // Playbacki/submasterji (HTP/LTP nad ročnimi vrednostmi)
+  MET_MIX_MERGE,        // HTP/LTP spajanje virov (ArtNet, lokalno, OSC)
+  MET_MIX_OUTPUT,       // Združen izhodni korak: pan/tilt, dimmer, blackout/flash
+  MET_MIX_TOTAL,
+  // loop()
+  MET_ARTNET_READ,
+  MET_OSC_UPDATE,
+  MET_DMX_SEND,
+  MET_ARTNET_OUT,
+  MET_SACN_OUT,
+  MET_ESPNOW_OUT,
+  MET_PIXEL_MAP,
+  MET_WEB_LOOP,
+  MET_LOOP_TOTAL,
+  // Frame task (frame clock)
+  MET_FRAME_TOTAL,
+  MET_STAGE_COUNT
+};
+
+struct StageHistogram {
+  uint32_t counts[METRICS_BUCKETS + 1];  // Zadnji = +Inf
+  uint64_t sumCycles;
+  uint32_t maxCycles;
+};
+
+#if METRICS_ENABLED
+
+#include <esp_cpu.h>
+
+void metricsRecord(uint8_t stage, uint32_t cycles);
+
+#define METRIC_BEGIN(id)  uint32_t _met_##id = esp_cpu_get_cycle_count()
+#define METRIC_END(id)    metricsRecord(id, esp_cpu_get_cycle_count() - _met_##id)
+
+#else
+
+#define METRIC_BEGIN(id)  do {} while (0)
+#define METRIC_END(id)    do {} while (0)
+
+#endif
+
+void metricsBegin();
+void metricsReset();
+bool metricsGet(uint8_t stage, StageHistogram& out);
+const char* metricsStageName(uint8_t stage);
+float metricsBucketUs(uint8_t bucket);       // Zgornja meja predala v µs
+uint32_t metricsCyclesPerUs();
+void metricsWritePrometheus(String& out);
+
+#endif
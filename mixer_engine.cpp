@@ -1,11 +1,15 @@
 #include "mixer_engine.h"
-#include "sound_engine.h"
-#include "lfo_engine.h"
-#include "shape_engine.h"
+#include "metrics.h"
+#include "value16.h"
+#include "persist.h"
 #include <LittleFS.h>
 
 #define MIXER_STATE_FILE   "/mixer.bin"
 #define MIXER_SNAP_FILE    "/snaps.bin"
+#define MIXER_UNI_FILE     "/mixer_u.bin"   // Stara oblika (pred dnevnikom): dodatne univerze
+#define MIXER_JOURNAL_FILE "/mixer.jnl"     // Spremembe od zadnjega checkpointa (/mixer.bin)
+#define JNL_REGION_MASTER  0x40             // Regije dnevnika: 0..MAX_UNIVERSES-1 = ročne vrednosti
+#define JNL_REGION_GROUPS  0x41
 #define SAVE_DEBOUNCE_MS   3000   // Shrani 3s po zadnji spremembi
 #define SAVE_MAX_WAIT_MS   10000  // Najdlje čakaj 10s
 
@@ -15,31 +19,191 @@ void MixerEngine::begin(FixtureEngine* fixtures, SceneEngine* scenes) {
   memset(_dmxOut, 0, sizeof(_dmxOut));
   memset(_manualValues, 0, sizeof(_manualValues));
   memset(_artnetShadow, 0, sizeof(_artnetShadow));
-  memset(_snapshots, 0, sizeof(_snapshots));
-  _mode = CTRL_ARTNET;
-  _manualOverride = false;
+  memset(_localOut, 0, sizeof(_localOut));
   _blackout = false;
   _masterDimmer = 255;
   memset(_groupDimmers, 255, sizeof(_groupDimmers));
   _lastArtNetPacket = 0;
   _artnetPackets = 0;
-  _snapshotHead = 0;
-  _snapshotCount = 0;
+  _snaps.begin();
   _dirty = false;
-  _undoValid = false;
-  memset(_undoBuffer, 0, sizeof(_undoBuffer));
+  _undo.begin({ _manualValues, &_masterDimmer, _groupDimmers });
+  clearTouched();
   memset(_locateStates, 0, sizeof(_locateStates));
   _lastUpdateMs = millis();
 
   // Mutex za thread-safe dostop med jedroma
   _mtx = xSemaphoreCreateMutex();
+  if (_fixtures) _fixtures->setMapLock(_mtx);      // Zamenjava PatchMap-a med frame-i
+
+  // Spajanje: lokalni vir je vedno aktiven, ArtNet/OSC po prvem paketu
+  _merge.begin();
+  _merge.setTimeout(MERGE_SRC_ARTNET, 10000);
+  _merge.touch(MERGE_SRC_LOCAL, millis());
+  _activeSources = 0;
+  _primary = false;
+  if (!_mb) _mb = (MergeBuffers*)psramPreferMalloc(sizeof(MergeBuffers));
+  if (_mb) mergeInit(*_mb);
+  else Serial.println("[MIX] NAPAKA: ne morem alocirati merge bufferjev!");
+
+  // Persistenca: univerza 0, master in group dimmerji; dodatne univerze v syncUniverses()
+  _journal.begin(MIXER_STATE_FILE, MIXER_JOURNAL_FILE);
+  _journal.addRegion(0, _manualValues, DMX_MAX_CHANNELS);
+  _journal.addRegion(JNL_REGION_MASTER, &_masterDimmer, 1);
+  _journal.addRegion(JNL_REGION_GROUPS, _groupDimmers, MAX_GROUPS);
+
+  // Bufferji za univerze, ki so že patchane (pred loadState)
+  syncUniverses();
 
   // Naloži shranjeno stanje iz LittleFS
   loadState();
+  publishFrame();
 
   Serial.println("[MIX] Mixer inicializiran, čakam ArtNet...");
 }
 
+// ============================================================================
+//  OBJAVA FRAME-A
+//  En pisalec (update() pod lockom), poljubno bralcev brez mutexa.
+//  Bralec kopira zadnji zaključen slot; če ga je pisalec med kopiranjem
+//  začel prepisovati (dva frame-a naprej), poskusi znova. Pisalec, ki je
+//  prekinjen sredi pisanja, bralca nikoli ne blokira — ta bere drugi slot.
+// ============================================================================
+
+void MixerEngine::publishFrame() {
+  uint32_t next = _pubSeq.load(std::memory_order_relaxed) + 1;
+  int slot = next & 1;
+  _pubWriting.store(next, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  uint32_t ts = micros();
+  memcpy(_pubData[slot], _dmxOut, DMX_MAX_CHANNELS);
+  _pubTimestampUs[slot] = ts;
+  for (int u = 1; u < MAX_UNIVERSES; u++) {
+    UniverseBuffers* b = _pool.get(u);
+    if (!b) continue;
+    memcpy(b->pubData[slot], b->out, DMX_MAX_CHANNELS);
+    b->pubTimestampUs[slot] = ts;
+  }
+  _pubSeq.store(next, std::memory_order_release);
+}
+
+void MixerEngine::readFrame(DmxFrame& out) const {
+  for (;;) {
+    uint32_t seq = _pubSeq.load(std::memory_order_acquire);
+    int slot = seq & 1;
+    memcpy(out.data, _pubData[slot], DMX_MAX_CHANNELS);
+    out.timestampUs = _pubTimestampUs[slot];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // Slot prepiše šele frame seq+2
+    uint32_t writing = _pubWriting.load(std::memory_order_relaxed);
+    if ((int32_t)(writing - seq) < 2) { out.seq = seq; return; }
+  }
+}
+
+bool MixerEngine::readFrame(uint8_t universe, DmxFrame& out) const {
+  if (universe == 0) { readFrame(out); return true; }
+  const UniverseBuffers* b = _pool.get(universe);
+  if (!b) return false;
+  for (;;) {
+    uint32_t seq = _pubSeq.load(std::memory_order_acquire);
+    int slot = seq & 1;
+    memcpy(out.data, b->pubData[slot], DMX_MAX_CHANNELS);
+    out.timestampUs = b->pubTimestampUs[slot];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t writing = _pubWriting.load(std::memory_order_relaxed);
+    if ((int32_t)(writing - seq) < 2) { out.seq = seq; return true; }
+  }
+}
+
+// ============================================================================
+//  DODATNE UNIVERZE
+//  Pool samo raste: univerza, ki ostane brez fixture-ov, obdrži bufferje do
+//  ponovnega zagona (bralci na drugih taskih lahko še držijo kazalec).
+// ============================================================================
+
+UniverseBuffers* UniversePool::acquire(uint8_t u) {
+  if (u == 0 || u >= MAX_UNIVERSES) return nullptr;
+  if (_bufs[u]) return _bufs[u];
+  UniverseBuffers* b = (UniverseBuffers*)psramPreferMalloc(sizeof(UniverseBuffers));
+  if (!b) {
+    Serial.printf("[MIX] NAPAKA: ne morem alocirati univerze %d!\n", u);
+    return nullptr;
+  }
+  memset(b, 0, sizeof(UniverseBuffers));
+  mergeInit(b->merge);
+  _bufs[u] = b;         // Objavi šele inicializiran buffer
+  _mask |= (1 << u);
+  Serial.printf("[MIX] Univerza %d alocirana (%u B)\n", u, (unsigned)sizeof(UniverseBuffers));
+  return b;
+}
+
+size_t UniversePool::getBytes() const {
+  size_t n = 0;
+  for (int u = 1; u < MAX_UNIVERSES; u++) if (_bufs[u]) n += sizeof(UniverseBuffers);
+  return n;
+}
+
+void MixerEngine::syncUniverses() {
+  if (!_fixtures) return;
+  _poolGeneration = _fixtures->getPatchGeneration();
+  uint8_t mask = _fixtures->getUniverseMask();
+  for (int u = 1; u < MAX_UNIVERSES; u++) {
+    if (!(mask & (1 << u))) continue;
+    UniverseBuffers* b = _pool.acquire(u);
+    if (b) _journal.addRegion(u, b->manual, DMX_MAX_CHANNELS);   // Že registrirana → samo kazalec
+  }
+}
+
+// Isti sodelujoči viri kot univerza 0. Lokalni vir so samo ročne vrednosti:
+// efekti, scene in sound delujejo samo na univerzi 0.
+void MixerEngine::updateUniverses(uint8_t part) {
+  uint32_t htpMask = _merge.getHtpMask();
+  for (int u = 1; u < MAX_UNIVERSES; u++) {
+    UniverseBuffers* b = _pool.get(u);
+    if (!b) continue;
+    const PatchMap* m = _fixtures->getPatchMap(u);
+    if ((m ? m->generation : 0) != b->merge.htpGeneration || htpMask != b->merge.htpMask) {
+      mergeBuildHtp(b->merge, m, htpMask);
+    }
+    const uint8_t* const src[MERGE_SRC_COUNT] = { b->artnet, b->manual, b->merge.osc };
+    mergeKernel(b->merge, src, part, b->out, DMX_MAX_CHANNELS);
+    applyOutputStage(b->ops, m, b->out, b->out);
+  }
+}
+
+void MixerEngine::latchUniverses() {
+  for (int u = 1; u < MAX_UNIVERSES; u++) {
+    UniverseBuffers* b = _pool.get(u);
+    if (b) memcpy(b->manual, b->artnet, DMX_MAX_CHANNELS);
+  }
+}
+
+uint8_t* MixerEngine::sourceBuffer(uint8_t universe, uint8_t source) {
+  if (source == MERGE_SRC_LOCAL) return manualFor(universe);
+  if (source != MERGE_SRC_OSC) return nullptr;
+  if (universe == 0) return _mb ? _mb->osc : nullptr;
+  UniverseBuffers* b = _pool.get(universe);
+  return b ? b->merge.osc : nullptr;
+}
+
+uint8_t* MixerEngine::manualFor(uint8_t universe) {
+  if (universe == 0) return _manualValues;
+  UniverseBuffers* b = _pool.get(universe);
+  return b ? b->manual : nullptr;
+}
+
+const uint8_t* MixerEngine::getManualValues(uint8_t universe) const {
+  if (universe == 0) return _manualValues;
+  const UniverseBuffers* b = _pool.get(universe);
+  return b ? b->manual : nullptr;
+}
+
+const uint8_t* MixerEngine::getDmxOutput(uint8_t universe) const {
+  if (universe == 0) return _dmxOut;
+  const UniverseBuffers* b = _pool.get(universe);
+  return b ? b->out : nullptr;
+}
+
 // ============================================================================
 //  ARTNET VHOD
 // ============================================================================
@@ -48,98 +212,118 @@ void MixerEngine::onArtNetData(const uint8_t* data, uint16_t length) {
   if (length > DMX_MAX_CHANNELS) length = DMX_MAX_CHANNELS;
 
   lock();
-  // Vedno posodobi senco
+  // Senca je ArtNet vir spajanja; update() jo spoji z ostalimi viri
   memcpy(_artnetShadow, data, length);
-
   _lastArtNetPacket = millis();
+  _merge.touch(MERGE_SRC_ARTNET, _lastArtNetPacket);
   _artnetPackets++;
   _fpsCounter++;
 
-  // Če je v LOCAL_AUTO načinu in pride ArtNet → nazaj na ARTNET
-  if (_mode == CTRL_LOCAL_AUTO) {
-    Serial.println("[MIX] ArtNet paket zaznan → preklop nazaj na ARTNET");
-    // Pravilo 3: Shrani lokalno stanje preden ArtNet prevzame
-    takeSnapshot('L');
-    startModeFade();
-    _mode = CTRL_ARTNET;
-    _manualOverride = false;
-  }
-  // V PRIMARY načinu: ArtNet se ignorira, samo zaznamo prisotnost za notifikacijo
-  else if (_mode == CTRL_LOCAL_PRIMARY) {
-    if (!_artnetDetected) {
-      _artnetDetected = true;
-      _artnetDetectedMs = millis();
-      Serial.println("[MIX] ArtNet zaznan v PRIMARY načinu → notifikacija");
-    }
+  // V PRIMARY načinu: ArtNet ne sodeluje, samo zaznamo prisotnost za notifikacijo
+  if (_primary && !_artnetDetected) {
+    _artnetDetected = true;
+    _artnetDetectedMs = millis();
+    Serial.println("[MIX] ArtNet zaznan v PRIMARY načinu → notifikacija");
   }
-
-  // V ARTNET načinu: podatke kopira update() iz shadow
-  // (onArtNetData samo posodobi shadow, update() aplicira master dimmer)
-  // V LOCAL_MANUAL: ignoriramo ArtNet podatke (razen sence)
   unlock();
 }
 
-void MixerEngine::onArtPoll() {
-  if (_mode == CTRL_LOCAL_AUTO) {
-    Serial.println("[MIX] ArtPoll prejet v LOCAL_AUTO → preklop na ARTNET");
-    takeSnapshot('L');
-    startModeFade();
-    _mode = CTRL_ARTNET;
-    _manualOverride = false;
-  }
-}
-
-void MixerEngine::startModeFade() {
-  memcpy(_modeFadeFrom, _dmxOut, DMX_MAX_CHANNELS);
-  _modeFadeProgress = 0;
-  _modeFadeStart = millis();
-  _modeFading = true;
+void MixerEngine::onArtNetData(uint8_t universe, const uint8_t* data, uint16_t length) {
+  if (universe == 0) { onArtNetData(data, length); return; }
+  UniverseBuffers* b = _pool.get(universe);
+  if (!b) return;   // Nepatchana univerza
+  if (length > DMX_MAX_CHANNELS) length = DMX_MAX_CHANNELS;
+  // Vir ArtNet je skupen vsem univerzam (prioriteta, timeout)
+  lock();
+  memcpy(b->artnet, data, length);
+  _merge.touch(MERGE_SRC_ARTNET, millis());
+  unlock();
 }
 
 // ============================================================================
 //  KRMILNI NAČIN
+//  Ni več izključnega preklopa: ArtNet, lokalni mixer in OSC se spajajo po
+//  kanalih. Ročni preklop samo pripne vir, da prevlada nad ostalimi.
 // ============================================================================
 
-void MixerEngine::switchToLocal() {
-  if (_mode == CTRL_LOCAL_MANUAL) return;
+ControlMode MixerEngine::getMode() const {
+  if (_merge.getPinned() == MERGE_SRC_LOCAL) return _primary ? CTRL_LOCAL_PRIMARY : CTRL_LOCAL_MANUAL;
+  return (_activeSources & (1 << MERGE_SRC_ARTNET)) ? CTRL_ARTNET : CTRL_LOCAL_AUTO;
+}
+
+void MixerEngine::setSourcePriority(uint8_t source, uint8_t priority) {
+  lock();
+  _merge.setPriority(source, priority);
+  unlock();
+}
+
+void MixerEngine::setSourceTimeout(uint8_t source, uint32_t ms) {
+  if (source == MERGE_SRC_LOCAL) return;   // Lokalni vir ne poteče
+  lock();
+  _merge.setTimeout(source, ms);
+  unlock();
+}
 
-  if (_mode == CTRL_ARTNET) {
-    takeSnapshotFrom(_dmxOut, 'A');
+void MixerEngine::setHtpMask(uint32_t mask) {
+  lock();
+  _merge.setHtpMask(mask);
+  unlock();
+}
+
+// Prispevek vira ostane v ročnih vrednostih (HTP max, LTP kanali v lasti vira)
+void MixerEngine::releaseSource(uint8_t source) {
+  if (source == MERGE_SRC_LOCAL) return;
+  const uint8_t* src = (source == MERGE_SRC_ARTNET) ? _artnetShadow : (_mb ? _mb->osc : nullptr);
+  if (_mb && src) mergeRelease(*_mb, source, src, _manualValues, DMX_MAX_CHANNELS);
+  if (_mb && source == MERGE_SRC_OSC) memset(_mb->osc, 0, DMX_MAX_CHANNELS);
+  for (int u = 1; u < MAX_UNIVERSES; u++) {
+    UniverseBuffers* b = _pool.get(u);
+    if (!b) continue;
+    uint8_t* bs = (source == MERGE_SRC_ARTNET) ? b->artnet : b->merge.osc;
+    mergeRelease(b->merge, source, bs, b->manual, DMX_MAX_CHANNELS);
+    if (source == MERGE_SRC_OSC) memset(b->merge.osc, 0, DMX_MAX_CHANNELS);
   }
+  markDirty();
+}
 
-  memcpy(_manualValues, _dmxOut, DMX_MAX_CHANNELS);
-  startModeFade();
-  _mode = CTRL_LOCAL_MANUAL;
-  _manualOverride = true;
+void MixerEngine::pinLocal(bool primary) {
+  // ArtNet je sodeloval → njegov prispevek prevzame mixer
+  if (_activeSources & (1 << MERGE_SRC_ARTNET)) {
+    takeSnapshotFrom(_artnetShadow, 'A');
+    releaseSource(MERGE_SRC_ARTNET);
+  }
+  _merge.setPinned(MERGE_SRC_LOCAL);
+  _primary = primary;
+  _artnetDetected = false;
   markDirty();
+}
+
+void MixerEngine::switchToMerge() {
+  if (_merge.getPinned() == MERGE_NO_PIN) return;
+  _merge.setPinned(MERGE_NO_PIN);
+  _primary = false;
+  _artnetDetected = false;
+  Serial.println("[MIX] Spajanje virov (HTP/LTP po prioriteti)");
+}
+
+void MixerEngine::switchToLocal() {
+  if (_merge.getPinned() == MERGE_SRC_LOCAL && !_primary) return;
+  pinLocal(false);
   Serial.println("[MIX] Ročni preklop na LOKALNO kontrolo");
 }
 
 void MixerEngine::switchToArtNet() {
-  if (_mode == CTRL_ARTNET) return;
-
+  if (_merge.getPinned() == MERGE_SRC_ARTNET) return;
   takeSnapshot('L');
-  startModeFade();
-  _mode = CTRL_ARTNET;
-  _manualOverride = false;
+  _merge.setPinned(MERGE_SRC_ARTNET);
+  _primary = false;
   _artnetDetected = false;
-
-  memcpy(_dmxOut, _artnetShadow, DMX_MAX_CHANNELS);
   Serial.println("[MIX] Ročni preklop na ARTNET kontrolo");
 }
 
 void MixerEngine::switchToPrimaryLocal() {
-  if (_mode == CTRL_LOCAL_PRIMARY) return;
-
-  if (_mode == CTRL_ARTNET) {
-    takeSnapshotFrom(_dmxOut, 'A');
-    memcpy(_manualValues, _dmxOut, DMX_MAX_CHANNELS);
-  }
-  startModeFade();
-  _mode = CTRL_LOCAL_PRIMARY;
-  _manualOverride = true;
-  _artnetDetected = false;
-  markDirty();
+  if (_merge.getPinned() == MERGE_SRC_LOCAL && _primary) return;
+  pinLocal(true);
   Serial.println("[MIX] Preklop na PRIMARY LOKALNO (ArtNet ignoriran, samo obvesti)");
 }
 
@@ -155,39 +339,52 @@ bool MixerEngine::consumeArtNetDetected() {
 //  MIXER OPERACIJE
 // ============================================================================
 
+bool MixerEngine::addStage(OutputStage* stage, uint8_t order, uint32_t budgetUs, uint8_t metric) {
+  lock();
+  bool ok = _stages.add(stage, order, budgetUs, metric);
+  unlock();
+  if (ok) Serial.printf("[MIX] Izhodna stopnja '%s' (red %u)\n", stage->name(), order);
+  return ok;
+}
+
 void MixerEngine::setMasterSpeed(float speed) {
   if (speed < 0.1f) speed = 0.1f;
   if (speed > 4.0f) speed = 4.0f;
   _masterSpeed = speed;
 }
 
-void MixerEngine::setChannel(uint16_t addr, uint8_t value) {
-  if (_mode == CTRL_ARTNET) return;
-  if (addr < 1 || addr > DMX_MAX_CHANNELS) return;
-  if (_scenes && _scenes->isCrossfading()) _scenes->cancelCrossfade();
-  _manualValues[addr - 1] = value;
-  markDirty();
+void MixerEngine::setChannel(uint16_t addr, uint8_t value, uint8_t source) {
+  setUniverseChannel(0, addr, value, source);
 }
 
-void MixerEngine::setFixtureChannel(int fixtureIdx, int ch, uint8_t value) {
-  if (_mode == CTRL_ARTNET || !_fixtures) return;
+void MixerEngine::setFixtureChannel(int fixtureIdx, int ch, uint8_t value, uint8_t source) {
+  if (!_fixtures) return;
   const PatchEntry* fx = _fixtures->getFixture(fixtureIdx);
   if (!fx || !fx->active) return;
   uint8_t chCount = _fixtures->fixtureChannelCount(fixtureIdx);
   if (ch < 0 || ch >= chCount) return;
+  setUniverseChannel(fx->universe, fx->dmxAddress + ch, value, source);  // dmxAddress je 1-based
+}
 
-  // Ročna sprememba prekine crossfade
-  if (_scenes && _scenes->isCrossfading()) _scenes->cancelCrossfade();
-
-  uint16_t addr = fx->dmxAddress + ch;  // dmxAddress je 1-based
-  if (addr >= 1 && addr <= DMX_MAX_CHANNELS) {
-    _manualValues[addr - 1] = value;
-    markDirty();
+// Lokalni vir: ročne vrednosti (persistentne); OSC: lasten buffer (spaja se v update())
+void MixerEngine::setUniverseChannel(uint8_t universe, uint16_t addr, uint8_t value, uint8_t source) {
+  if (addr < 1 || addr > DMX_MAX_CHANNELS) return;
+  uint8_t* vals = sourceBuffer(universe, source);
+  if (!vals) return;
+  if (universe == 0 && source == MERGE_SRC_LOCAL) {
+    _undo.touch(addr - 1, millis());
+    _touched[(addr - 1) >> 5] |= 1UL << ((addr - 1) & 31);
   }
+  vals[addr - 1] = value;
+  if (source != MERGE_SRC_LOCAL) { _merge.touch(source, millis()); return; }
+
+  // Ročna sprememba prekine crossfade (scene so samo na univerzi 0)
+  if (universe == 0 && _scenes && _scenes->isCrossfading()) _scenes->cancelCrossfade();
+  markDirty();
 }
 
 void MixerEngine::setGroupChannel(int groupBit, int ch, uint8_t value) {
-  if (_mode == CTRL_ARTNET || !_fixtures) return;
+  if (!_fixtures) return;
   int indices[MAX_FIXTURES];
   int count = _fixtures->getFixturesInGroup(groupBit, indices, MAX_FIXTURES);
   for (int i = 0; i < count; i++) {
@@ -196,12 +393,14 @@ void MixerEngine::setGroupChannel(int groupBit, int ch, uint8_t value) {
 }
 
 void MixerEngine::setMasterDimmer(uint8_t value) {
+  _undo.touch(UNDO_SLOT_MASTER, millis());
   _masterDimmer = value;
   markDirty();
 }
 
 void MixerEngine::setGroupDimmer(int group, uint8_t value) {
   if (group < 0 || group >= MAX_GROUPS) return;
+  _undo.touch(UNDO_SLOT_GROUP + group, millis());
   _groupDimmers[group] = value;
   markDirty();
 }
@@ -225,102 +424,128 @@ void MixerEngine::setFlash(bool active, uint8_t level) {
 }
 
 // ============================================================================
-//  PAN/TILT OMEJITVE IN INVERT
-//  Aplicira bounding box in obračanje osi za vsak fixture
+//  IZHODNI KORAK
+//  En prehod čez 512 naslovov: pan/tilt invert + omejitve, group/master
+//  dimmer, pametni blackout in flash. Samo celoštevilska
+//  aritmetika; opis operacij se prevede iz PatchMap ob spremembi patcha.
+//  Coarse/fine pari se obdelajo kot 16-bit vrednost in razdelijo ob zapisu.
 // ============================================================================
 
-void MixerEngine::applyPanTiltLimits() {
-  if (!_fixtures) return;
-
-  for (int i = 0; i < MAX_FIXTURES; i++) {
-    const PatchEntry* fx = _fixtures->getFixture(i);
-    if (!fx || !fx->active || fx->profileIndex < 0) continue;
-
-    // Hitri izhod: brez omejitev in brez invertiranja
-    bool hasLimits = (fx->panMin > 0 || fx->panMax < 255 ||
-                      fx->tiltMin > 0 || fx->tiltMax < 255);
-    if (!fx->invertPan && !fx->invertTilt && !hasLimits) continue;
-
-    uint8_t chCount = _fixtures->fixtureChannelCount(i);
-    for (int ch = 0; ch < chCount; ch++) {
-      const ChannelDef* def = _fixtures->fixtureChannel(i, ch);
-      if (!def) continue;
-
-      uint16_t addr = fx->dmxAddress + ch - 1;
-      if (addr >= DMX_MAX_CHANNELS) continue;
-      uint8_t val = _dmxOut[addr];
-
-      if (def->type == CH_PAN) {
-        if (fx->invertPan) val = 255 - val;
-        if (fx->panMin > 0 || fx->panMax < 255) {
-          // Mapiraj 0-255 v panMin-panMax
-          val = fx->panMin + ((uint16_t)val * (fx->panMax - fx->panMin)) / 255;
-        }
-        _dmxOut[addr] = val;
+void MixerEngine::rebuildOutputOps(OutputOps& o, const PatchMap* m) {
+  memset(o.ops, 0, sizeof(o.ops));
+  o.dimSlotCount = 0;
+  o.generation = m ? m->generation : 0;
+  if (!m) return;
+
+  for (int a = 0; a < m->highestAddr; a++) {
+    const PatchAddr& pa = m->addr[a];
+    if (pa.fixture < 0) continue;
+    const PatchEntry* fx = _fixtures->getFixture(pa.fixture);
+    if (!fx) continue;
+    OutOp& op = o.ops[a];
+
+    switch (pa.type) {
+      case CH_PAN:
+      case CH_TILT: {
+        bool pan = (pa.type == CH_PAN);
+        uint8_t lo = pan ? fx->panMin : fx->tiltMin;
+        uint8_t hi = pan ? fx->panMax : fx->tiltMax;
+        if (pan ? fx->invertPan : fx->invertTilt) op.flags |= OUTOP_INVERT;
+        if (lo > 0 || hi < 255) { op.flags |= OUTOP_REMAP; op.lo = lo; op.hi = hi; }
+        break;
       }
-      else if (def->type == CH_PAN_FINE) {
-        if (fx->invertPan) _dmxOut[addr] = 255 - val;
-      }
-      else if (def->type == CH_TILT) {
-        if (fx->invertTilt) val = 255 - val;
-        if (fx->tiltMin > 0 || fx->tiltMax < 255) {
-          val = fx->tiltMin + ((uint16_t)val * (fx->tiltMax - fx->tiltMin)) / 255;
-        }
-        _dmxOut[addr] = val;
-      }
-      else if (def->type == CH_TILT_FINE) {
-        if (fx->invertTilt) _dmxOut[addr] = 255 - val;
+      case CH_PAN_FINE:
+        if (fx->invertPan) op.flags |= OUTOP_INVERT;
+        break;
+      case CH_TILT_FINE:
+        if (fx->invertTilt) op.flags |= OUTOP_INVERT;
+        break;
+      case CH_INTENSITY: {
+        // Isti groupMask → isti slot (največ MAX_FIXTURES različnih)
+        int slot = 0;
+        while (slot < o.dimSlotCount && o.dimSlotMask[slot] != pa.groupMask) slot++;
+        if (slot == o.dimSlotCount) o.dimSlotMask[o.dimSlotCount++] = pa.groupMask;
+        op.dimSlot = slot;
+        op.flags |= OUTOP_DIMMER | OUTOP_BLACKOUT | OUTOP_FLASH;
+        break;
       }
+      // Pametni blackout: intensity + barve + strobe; Pan/Tilt/Gobo teče naprej
+      case CH_COLOR_R: case CH_COLOR_G: case CH_COLOR_B: case CH_COLOR_W:
+      case CH_COLOR_A: case CH_COLOR_UV: case CH_STROBE: case CH_COLOR_L:
+      case CH_COLOR_C: case CH_COLOR_WW:
+        op.flags |= OUTOP_BLACKOUT;
+        break;
+      default:
+        break;
     }
   }
+
+  // 16-bit pari: coarse nosi operacije za oba bajta, fine se samo preskoči
+  for (int p = 0; p < m->pairCount; p++) {
+    const PatchPair& pp = m->pairs[p];
+    o.ops[pp.coarse].flags |= OUTOP_PAIR;
+    o.ops[pp.coarse].fine = pp.fine;
+    o.ops[pp.fine].flags = OUTOP_FINE;
+  }
 }
 
-// ============================================================================
-//  MASTER DIMMER
-//  Aplicira master dimmer samo na kanale tipa INTENSITY
-// ============================================================================
+void MixerEngine::applyOutputStage(OutputOps& o, const PatchMap* m, const uint8_t* src, uint8_t* dst) {
+  if ((m ? m->generation : 0) != o.generation) rebuildOutputOps(o, m);
 
-void MixerEngine::applyMasterDimmer() {
-  if (!_fixtures) return;
+  // Katere operacije so ta frame aktivne
+  uint8_t active = OUTOP_INVERT | OUTOP_REMAP | OUTOP_PAIR | OUTOP_FINE;
+  if (_blackout)    active |= OUTOP_BLACKOUT;
+  if (_flashActive) active |= OUTOP_FLASH;
 
-  // Hitri izhod če so vsi dimerji na max
-  bool allMax = (_masterDimmer == 255);
-  if (allMax) {
+  // Najnižji group dimmer za vsak slot; dimmer preskočimo, če je vse na max
+  uint8_t slotDim[MAX_FIXTURES];
+  bool dimActive = (_masterDimmer < 255);
+  for (int s = 0; s < o.dimSlotCount; s++) {
+    uint8_t d = 255;
     for (int g = 0; g < MAX_GROUPS; g++) {
-      if (_groupDimmers[g] < 255) { allMax = false; break; }
+      if ((o.dimSlotMask[s] & (1 << g)) && _groupDimmers[g] < d) d = _groupDimmers[g];
     }
-    if (allMax) return;
+    slotDim[s] = d;
+    if (d < 255) dimActive = true;
   }
-
-  for (int i = 0; i < MAX_FIXTURES; i++) {
-    const PatchEntry* fx = _fixtures->getFixture(i);
-    if (!fx || !fx->active || fx->profileIndex < 0) continue;
-
-    // Najnižji group dimmer za ta fixture
-    uint8_t grpDim = 255;
-    for (int g = 0; g < MAX_GROUPS; g++) {
-      if ((fx->groupMask & (1 << g)) && _groupDimmers[g] < grpDim) {
-        grpDim = _groupDimmers[g];
-      }
-    }
-
-    if (grpDim == 255 && _masterDimmer == 255) continue;
-
-    uint8_t chCount = _fixtures->fixtureChannelCount(i);
-    for (int ch = 0; ch < chCount; ch++) {
-      const ChannelDef* def = _fixtures->fixtureChannel(i, ch);
-      if (!def) continue;
-
-      if (def->type == CH_INTENSITY) {
-        uint16_t addr = fx->dmxAddress + ch - 1;
-        if (addr < DMX_MAX_CHANNELS) {
-          uint16_t val = _dmxOut[addr];
-          if (grpDim < 255) val = (val * grpDim) / 255;
-          if (_masterDimmer < 255) val = (val * _masterDimmer) / 255;
-          _dmxOut[addr] = (uint8_t)val;
+  if (dimActive) active |= OUTOP_DIMMER;
+
+  const uint8_t master = _masterDimmer;
+  const uint8_t flash = _flashLevel;
+
+  for (int i = 0; i < DMX_MAX_CHANNELS; i++) {
+    const OutOp op = o.ops[i];
+    uint8_t f = op.flags & active;
+    uint32_t v = src[i];
+
+    if (f) {
+      if (f & (OUTOP_PAIR | OUTOP_FINE)) {
+        if (f & OUTOP_PAIR) {
+          uint32_t w = get16(src, i, op.fine);
+          if (f & OUTOP_INVERT) w = 65535 - w;
+          if (f & OUTOP_REMAP)  w = remap16(w, op.lo, op.hi);
+          if (f & OUTOP_DIMMER) {
+            uint8_t gd = slotDim[op.dimSlot];
+            if (gd < 255)     w = scale16(w, gd);
+            if (master < 255) w = scale16(w, master);
+          }
+          if (f & OUTOP_BLACKOUT) w = 0;
+          if (f & OUTOP_FLASH)    w = expand16(flash);
+          put16(dst, i, op.fine, w);
         }
+        continue;
       }
+      if (f & OUTOP_INVERT) v = 255 - v;
+      if (f & OUTOP_REMAP)  v = (uint8_t)(op.lo + ((int)v * (op.hi - op.lo)) / 255);
+      if (f & OUTOP_DIMMER) {
+        uint8_t gd = slotDim[op.dimSlot];
+        if (gd < 255)     v = (v * gd) / 255;
+        if (master < 255) v = (v * master) / 255;
+      }
+      if (f & OUTOP_BLACKOUT) v = 0;
+      if (f & OUTOP_FLASH)    v = flash;   // Flash preglasi blackout
     }
+    dst[i] = (uint8_t)v;
   }
 }
 
@@ -329,95 +554,82 @@ void MixerEngine::applyMasterDimmer() {
 // ============================================================================
 
 void MixerEngine::takeSnapshot(char source) {
-  StateSnapshot& s = _snapshots[_snapshotHead];
-  memcpy(s.dmx, _manualValues, DMX_MAX_CHANNELS);
-  s.timestamp = millis();
-  s.valid = true;
-  s.source = source;
-
-  _snapshotHead = (_snapshotHead + 1) % MAX_STATE_SNAPSHOTS;
-  if (_snapshotCount < MAX_STATE_SNAPSHOTS) _snapshotCount++;
-
-  Serial.printf("[MIX] Snapshot [%c] shranjen (#%d, %d skupaj)\n", source, _snapshotHead, _snapshotCount);
-  markDirty();
+  takeSnapshotFrom(_manualValues, source);
 }
 
 void MixerEngine::takeSnapshotFrom(const uint8_t* data, char source) {
-  StateSnapshot& s = _snapshots[_snapshotHead];
-  memcpy(s.dmx, data, DMX_MAX_CHANNELS);
-  s.timestamp = millis();
-  s.valid = true;
-  s.source = source;
-
-  _snapshotHead = (_snapshotHead + 1) % MAX_STATE_SNAPSHOTS;
-  if (_snapshotCount < MAX_STATE_SNAPSHOTS) _snapshotCount++;
-
-  Serial.printf("[MIX] Snapshot [%c] shranjen (#%d, %d skupaj)\n", source, _snapshotHead, _snapshotCount);
+  _snaps.add(data, millis(), source);
+  Serial.printf("[MIX] Snapshot [%c] shranjen (%d skupaj)\n", source, _snaps.count());
   markDirty();
 }
 
-int MixerEngine::getSnapshotCount() const { return _snapshotCount; }
+int MixerEngine::getSnapshotCount() const { return _snaps.count(); }
 
-const StateSnapshot* MixerEngine::getSnapshot(int idx) const {
-  if (idx < 0 || idx >= _snapshotCount) return nullptr;
-  // idx 0 = najnovejši
-  int realIdx = (_snapshotHead - 1 - idx + MAX_STATE_SNAPSHOTS) % MAX_STATE_SNAPSHOTS;
-  return &_snapshots[realIdx];
+bool MixerEngine::getSnapshotInfo(int idx, uint32_t& ts, char& source) const {
+  return _snaps.info(idx, ts, source);
+}
+
+// idx 0 = najnovejši
+bool MixerEngine::getSnapshot(int idx, StateSnapshot& out) const {
+  uint32_t ts;
+  if (!_snaps.info(idx, ts, out.source) || !_snaps.decode(idx, out.dmx)) return false;
+  out.timestamp = ts;
+  out.valid = true;
+  return true;
 }
 
 void MixerEngine::recallSnapshot(int idx) {
-  const StateSnapshot* s = getSnapshot(idx);
-  if (!s || !s->valid) return;
-  pushUndo();
-  memcpy(_manualValues, s->dmx, DMX_MAX_CHANNELS);
-  // Preklopi na lokalno da vrednosti dejansko ucinokujejo
-  if (_mode == CTRL_ARTNET) {
-    _mode = CTRL_LOCAL_MANUAL;
-    _manualOverride = true;
-  }
+  StateSnapshot s;
+  if (!getSnapshot(idx, s)) return;
+  pushUndo(s.dmx);
+  memcpy(_manualValues, s.dmx, DMX_MAX_CHANNELS);
+  // Pripni lokalno, če ArtNet prevlada — da vrednosti dejansko učinkujejo
+  if (!(_activeSources & (1 << MERGE_SRC_LOCAL))) _merge.setPinned(MERGE_SRC_LOCAL);
   markDirty();
-  Serial.printf("[MIX] Snapshot [%c] #%d obnovljen\n", s->source, idx);
+  Serial.printf("[MIX] Snapshot [%c] #%d obnovljen\n", s.source, idx);
 }
 
 void MixerEngine::recallArtNetShadow() {
+  pushUndo(_artnetShadow);
   memcpy(_manualValues, _artnetShadow, DMX_MAX_CHANNELS);
-  if (_mode == CTRL_ARTNET) {
-    _mode = CTRL_LOCAL_MANUAL;
-    _manualOverride = true;
-  }
+  latchUniverses();
+  if (!(_activeSources & (1 << MERGE_SRC_LOCAL))) _merge.setPinned(MERGE_SRC_LOCAL);
   markDirty();
   Serial.println("[MIX] ArtNet senca obnovljena v mixer");
 }
 
 // ============================================================================
-//  UNDO (en korak)
+//  UNDO / REDO
+//  Fejderji in dimmerji beležijo slote sproti (UndoHistory::touch), skupinske
+//  akcije (scena, snapshot) pred zapisom z pushUndo(next). Locate in prevzem
+//  vira ob timeoutu nista koraka — undo ju prepiše samo na dotaknjenih slotih.
 // ============================================================================
 
 void MixerEngine::pushUndo() {
-  memcpy(_undoBuffer, _manualValues, DMX_MAX_CHANNELS);
-  _undoMaster = _masterDimmer;
-  _undoValid = true;
+  _undo.commit();
 }
 
-bool MixerEngine::undo() {
-  if (!_undoValid) return false;
-  // Swap: trenutno ↔ undo (da lahko "redo" z ponovnim undo)
-  uint8_t tmp[DMX_MAX_CHANNELS];
-  memcpy(tmp, _manualValues, DMX_MAX_CHANNELS);
-  uint8_t tmpMaster = _masterDimmer;
-
-  memcpy(_manualValues, _undoBuffer, DMX_MAX_CHANNELS);
-  _masterDimmer = _undoMaster;
+void MixerEngine::pushUndo(const uint8_t* next) {
+  _undo.commit();
+  _undo.touchDiff(_manualValues, next, millis());
+}
 
-  memcpy(_undoBuffer, tmp, DMX_MAX_CHANNELS);
-  _undoMaster = tmpMaster;
+bool MixerEngine::undo() {
+  // Prekinjen crossfade se zapiše kot del koraka scene in se razveljavi z njim
+  if (_scenes && _scenes->isCrossfading()) _scenes->cancelCrossfade();
+  if (!_undo.undo()) return false;
+  if (!(_activeSources & (1 << MERGE_SRC_LOCAL))) _merge.setPinned(MERGE_SRC_LOCAL);
+  markDirty();
+  Serial.printf("[MIX] Undo (še %u, redo %u)\n", _undo.undoDepth(), _undo.redoDepth());
+  return true;
+}
 
-  if (_mode == CTRL_ARTNET) {
-    _mode = CTRL_LOCAL_MANUAL;
-    _manualOverride = true;
-  }
+bool MixerEngine::redo() {
+  if (_scenes && _scenes->isCrossfading()) _scenes->cancelCrossfade();
+  if (!_undo.redo()) return false;
+  if (!(_activeSources & (1 << MERGE_SRC_LOCAL))) _merge.setPinned(MERGE_SRC_LOCAL);
   markDirty();
-  Serial.println("[MIX] Undo izveden");
+  Serial.printf("[MIX] Redo (undo %u, še %u)\n", _undo.undoDepth(), _undo.redoDepth());
   return true;
 }
 
@@ -427,10 +639,11 @@ bool MixerEngine::undo() {
 
 void MixerEngine::locateFixture(int fi, bool on) {
   if (!_fixtures || fi < 0 || fi >= MAX_FIXTURES) return;
-  if (_mode == CTRL_ARTNET) return;
 
   const PatchEntry* fx = _fixtures->getFixture(fi);
   if (!fx || !fx->active || fx->profileIndex < 0) return;
+  uint8_t* vals = manualFor(fx->universe);
+  if (!vals) return;
 
   uint8_t chCount = _fixtures->fixtureChannelCount(fi);
 
@@ -441,23 +654,23 @@ void MixerEngine::locateFixture(int fi, bool on) {
     for (int c = 0; c < chCount && c < MAX_CHANNELS_PER_FX; c++) {
       uint16_t addr = fx->dmxAddress + c;  // dmxAddress je 1-based
       if (addr < 1 || addr > DMX_MAX_CHANNELS) continue;
-      _locateStates[fi].saved[c] = _manualValues[addr - 1];
+      _locateStates[fi].saved[c] = vals[addr - 1];
 
       const ChannelDef* def = _fixtures->fixtureChannel(fi, c);
       if (!def) continue;
 
       switch (def->type) {
-        case CH_INTENSITY:  _manualValues[addr - 1] = 255; break;
-        case CH_COLOR_R:    _manualValues[addr - 1] = 255; break;
-        case CH_COLOR_G:    _manualValues[addr - 1] = 255; break;
-        case CH_COLOR_B:    _manualValues[addr - 1] = 255; break;
-        case CH_COLOR_W:    _manualValues[addr - 1] = 255; break;
-        case CH_PAN:        _manualValues[addr - 1] = 128; break;
-        case CH_TILT:       _manualValues[addr - 1] = 128; break;
-        case CH_FOCUS:      _manualValues[addr - 1] = 128; break;
-        case CH_ZOOM:       _manualValues[addr - 1] = 255; break;
-        case CH_GOBO:       _manualValues[addr - 1] = 0;   break;
-        case CH_PRISM:      _manualValues[addr - 1] = 0;   break;
+        case CH_INTENSITY:  vals[addr - 1] = 255; break;
+        case CH_COLOR_R:    vals[addr - 1] = 255; break;
+        case CH_COLOR_G:    vals[addr - 1] = 255; break;
+        case CH_COLOR_B:    vals[addr - 1] = 255; break;
+        case CH_COLOR_W:    vals[addr - 1] = 255; break;
+        case CH_PAN:        vals[addr - 1] = 128; break;
+        case CH_TILT:       vals[addr - 1] = 128; break;
+        case CH_FOCUS:      vals[addr - 1] = 128; break;
+        case CH_ZOOM:       vals[addr - 1] = 255; break;
+        case CH_GOBO:       vals[addr - 1] = 0;   break;
+        case CH_PRISM:      vals[addr - 1] = 0;   break;
         default: break;
       }
     }
@@ -467,7 +680,7 @@ void MixerEngine::locateFixture(int fi, bool on) {
     for (int c = 0; c < chCount && c < MAX_CHANNELS_PER_FX; c++) {
       uint16_t addr = fx->dmxAddress + c;
       if (addr < 1 || addr > DMX_MAX_CHANNELS) continue;
-      _manualValues[addr - 1] = _locateStates[fi].saved[c];
+      vals[addr - 1] = _locateStates[fi].saved[c];
     }
     _locateStates[fi].active = false;
     markDirty();
@@ -491,34 +704,79 @@ uint32_t MixerEngine::getLocateMask() const {
 //  SCENE OPERACIJE
 // ============================================================================
 
-bool MixerEngine::saveCurrentAsScene(int slot, const char* name) {
+bool MixerEngine::saveCurrentAsScene(int slot, const char* name, bool partial, const uint32_t* mask) {
   if (!_scenes) return false;
+  // Delna scena: kanali, ki jih je operater nastavil (tudi na 0)
+  if (partial && !mask && getTouchedCount()) mask = _touched;
   // Shrani trenutne manualne vrednosti (brez master dimmer efekta)
-  return _scenes->saveScene(slot, name, _manualValues);
+  bool ok = _scenes->saveScene(slot, name, _manualValues, partial, mask);
+  if (ok && partial) clearTouched();         // Naslednja delna scena se začne prazna
+  return ok;
 }
 
-bool MixerEngine::recallScene(int slot, uint32_t fadeMs) {
+uint16_t MixerEngine::getTouchedCount() const {
+  uint16_t n = 0;
+  for (int w = 0; w < DMX_MAX_CHANNELS / 32; w++) n += __builtin_popcount(_touched[w]);
+  return n;
+}
+
+bool MixerEngine::recallScene(int slot, uint32_t fadeMs, uint8_t curve, const CueTiming* timing) {
   if (!_scenes) return false;
-  if (_mode == CTRL_ARTNET) return false;  // Samo v lokalnem načinu
 
   const Scene* sc = _scenes->getScene(slot);
-  if (!sc) return false;
+  if (!sc) {
+    if (!_scenes->sceneExists(slot)) return false;
+    // Zgrešitev cache-a: frame ne čaka na flash, priklic izvede update()
+    _deferred.slot = (int16_t)slot;
+    _deferred.fadeMs = fadeMs;
+    _deferred.curve = curve;
+    _deferred.hasTiming = timing != nullptr;
+    if (timing) memcpy(_deferred.timing, timing, sizeof(_deferred.timing));
+    _deferred.sinceMs = millis();
+    return true;
+  }
+  _deferred.slot = -1;                       // Novejši priklic nadomesti čakajočega
+  applyRecall(*sc, slot, fadeMs, curve, timing);
+  return true;
+}
+
+void MixerEngine::runDeferredRecall(unsigned long now) {
+  if (_deferred.slot < 0 || !_scenes) return;
+  DeferredRecall d = _deferred;
+  const Scene* sc = _scenes->getScene(d.slot);
+  if (sc) {
+    _deferred.slot = -1;
+    applyRecall(*sc, d.slot, d.fadeMs, d.curve, d.hasTiming ? d.timing : nullptr);
+  } else if (!_scenes->sceneExists(d.slot) || now - d.sinceMs > SCENE_LOAD_TIMEOUT_MS) {
+    _deferred.slot = -1;
+    Serial.printf("[MIX] Scena %d ni prebrana — priklic opuščen\n", d.slot);
+  }
+}
 
-  if (fadeMs == 0) {
+void MixerEngine::applyRecall(const Scene& scene, int slot, uint32_t fadeMs, uint8_t curve,
+                              const CueTiming* timing) {
+  const Scene* sc = &scene;
+  clearTouched();                            // Nova slika: ročni posegi štejejo od tu
+
+  // Cilj: cela scena ali trenutno stanje z določenimi kanali delne scene
+  uint8_t target[DMX_MAX_CHANNELS];
+  memcpy(target, _manualValues, DMX_MAX_CHANNELS);
+  sceneApply(*sc, target);
+
+  if (SceneEngine::timingSpanMs(fadeMs, timing) == 0) {
     // Takojšen recall — brez crossfade
-    pushUndo();
-    memcpy(_manualValues, sc->dmx, DMX_MAX_CHANNELS);
+    pushUndo(target);
+    memcpy(_manualValues, target, DMX_MAX_CHANNELS);
     _scenes->cancelCrossfade();
     markDirty();
     Serial.printf("[MIX] Scena '%s' naložena (takojšen)\n", sc->name);
-    return true;
+    return;
   }
 
-  // Crossfade iz trenutnega stanja v sceno
-  pushUndo();
-  _scenes->startCrossfade(_manualValues, sc->dmx, fadeMs, slot);
+  // Crossfade iz trenutnega stanja v sceno (korak se zapre ob koncu fade-a)
+  pushUndo(target);
+  _scenes->startCrossfade(_manualValues, target, fadeMs, slot, curve, timing);
   Serial.printf("[MIX] Crossfade v sceno '%s' (%d ms)\n", sc->name, fadeMs);
-  return true;
 }
 
 bool MixerEngine::isSceneCrossfading() const {
@@ -541,16 +799,23 @@ void MixerEngine::cancelSceneCrossfade() {
 //  LOOP UPDATE
 // ============================================================================
 
-void MixerEngine::update() {
+void MixerEngine::update(float dt) {
   lock();
+  METRIC_BEGIN(MET_MIX_TOTAL);
   unsigned long now = millis();
 
-  // --- dt za sound ---
-  float dt = (now - _lastUpdateMs) / 1000.0f;
+  // --- dt za efekte: iz frame clock-a, sicer razlika millis() ---
+  if (dt <= 0) {
+    dt = (now - _lastUpdateMs) / 1000.0f;
+    if (dt <= 0 || dt > 1.0f) dt = 0.05f;
+  }
   _lastUpdateMs = now;
-  if (dt <= 0 || dt > 1.0f) dt = 0.05f;
   float scaledDt = dt * _masterSpeed;  // Master Speed vpliva na efekte
 
+  // Nova generacija patcha → morda nova univerza
+  if (_fixtures && _fixtures->getPatchGeneration() != _poolGeneration) syncUniverses();
+  const PatchMap* pm = _fixtures ? _fixtures->getPatchMap() : nullptr;
+
   // --- FPS izračun ---
   if (now - _fpsLastCalc >= 1000) {
     _artnetFps = _fpsCounter;
@@ -558,118 +823,73 @@ void MixerEngine::update() {
     _fpsLastCalc = now;
   }
 
-  // --- ArtNet timeout: preklop na lokalno ---
-  if (_mode == CTRL_ARTNET) {
-    if (_lastArtNetPacket > 0 && (now - _lastArtNetPacket > _artnetTimeoutMs)) {
+  // --- Sodelujoči viri (prioriteta, pripetje, timeout) ---
+  uint8_t part = _merge.participants(now);
+  uint32_t htpMask = _merge.getHtpMask();
+  if (_mb && ((pm ? pm->generation : 0) != _mb->htpGeneration || htpMask != _mb->htpMask)) {
+    mergeBuildHtp(*_mb, pm, htpMask);
+  }
+  if (part != _activeSources) {
+    // Vir, ki je potekel, pusti zadnjo sliko v ročnih vrednostih
+    uint8_t dropped = _activeSources & ~part;
+    if ((dropped & (1 << MERGE_SRC_ARTNET)) && !_merge.isActive(MERGE_SRC_ARTNET, now)) {
       takeSnapshotFrom(_artnetShadow, 'A');
-      Serial.println("[MIX] ArtNet timeout → preklop na LOKALNO (auto)");
-      memcpy(_manualValues, _artnetShadow, DMX_MAX_CHANNELS);
-      markDirty();
-      startModeFade();
-      _mode = CTRL_LOCAL_AUTO;
+      Serial.println("[MIX] ArtNet timeout → vrednosti prevzame lokalni mixer");
+      releaseSource(MERGE_SRC_ARTNET);
     }
-    else if (_lastArtNetPacket == 0 && now > _artnetTimeoutMs) {
-      Serial.println("[MIX] Ni ArtNet-a → preklop na LOKALNO s shranjenim stanjem");
-      startModeFade();
-      _mode = CTRL_LOCAL_AUTO;
+    if ((dropped & (1 << MERGE_SRC_OSC)) && !_merge.isActive(MERGE_SRC_OSC, now)) {
+      Serial.println("[MIX] OSC timeout → vrednosti prevzame lokalni mixer");
+      releaseSource(MERGE_SRC_OSC);
     }
+    // Pravilo 3: shrani lokalno stanje preden ga drug vir izpodrine
+    if (dropped & (1 << MERGE_SRC_LOCAL)) takeSnapshot('L');
+    _activeSources = part;
   }
 
-  // --- Sestavi izhodni buffer ---
-  if (_mode == CTRL_ARTNET) {
-    // FIX: Vedno kopiraj iz shadow → dmxOut pred apliciranjem masterja.
-    // Brez tega se master aplicira dvakrat+ (enkrat za vsak loop brez novega ArtNet paketa).
-    memcpy(_dmxOut, _artnetShadow, DMX_MAX_CHANNELS);
-    applyPanTiltLimits();
-    applyMasterDimmer();
-  }
-  else {
-    // LOCAL modo: preveri crossfade, nato kopiraj v izhod
-    if (_scenes && _scenes->isCrossfading()) {
-      bool wasFading = _scenes->isCrossfading();  // FIX: preberi PRED update
-      _scenes->updateCrossfade(_manualValues);
-      if (wasFading && !_scenes->isCrossfading()) markDirty();
-    }
-    memcpy(_dmxOut, _manualValues, DMX_MAX_CHANNELS);
-
-    // Sound-to-light overlay
-    if (_sound) {
-      _sound->applyToOutput(_manualValues, _dmxOut, scaledDt);
-    }
-
-    // LFO overlay
-    if (_lfo && _lfo->isActive()) {
-      _lfo->update(scaledDt);
-      _lfo->applyToOutput(_manualValues, _dmxOut);
-    }
-
-    // Shape overlay
-    if (_shapes && _shapes->isActive()) {
-      _shapes->update(scaledDt);
-      _shapes->applyToOutput(_manualValues, _dmxOut);
-    }
-
-    applyPanTiltLimits();
-    applyMasterDimmer();
-  }
-
-  // --- Pametni Blackout: nulira samo Intensity + RGBW, Pan/Tilt/Gobo teče naprej ---
-  if (_blackout && _fixtures) {
-    for (int i = 0; i < MAX_FIXTURES; i++) {
-      const PatchEntry* fx = _fixtures->getFixture(i);
-      if (!fx || !fx->active || fx->profileIndex < 0) continue;
-      uint8_t chCount = _fixtures->fixtureChannelCount(i);
-      for (int ch = 0; ch < chCount; ch++) {
-        const ChannelDef* def = _fixtures->fixtureChannel(i, ch);
-        if (!def) continue;
-        uint8_t t = def->type;
-        if (t == CH_INTENSITY || t == CH_COLOR_R || t == CH_COLOR_G ||
-            t == CH_COLOR_B || t == CH_COLOR_W || t == CH_COLOR_A ||
-            t == CH_COLOR_UV || t == CH_STROBE || t == CH_COLOR_L ||
-            t == CH_COLOR_C || t == CH_COLOR_WW) {
-          uint16_t addr = fx->dmxAddress + ch - 1;
-          if (addr < DMX_MAX_CHANNELS) _dmxOut[addr] = 0;
-        }
-      }
-    }
+  // --- Lokalni vir: crossfade scen + overlay-i ---
+  uint32_t dtUs = (uint32_t)lroundf(dt * 1e6f);   // Takt frame clock-a, ne millis()
+  if (_scenes) _scenes->adoptLoaded();            // Scene, prebrane na persist tasku → cache
+  runDeferredRecall(now);
+  if (_scenes && _scenes->isCrossfading()) {
+    METRIC_BEGIN(MET_MIX_CROSSFADE);
+    bool wasFading = _scenes->isCrossfading();  // FIX: preberi PRED update
+    _scenes->updateCrossfade(_manualValues, dtUs);
+    if (wasFading && !_scenes->isCrossfading()) { markDirty(); _undo.commit(); }
+    METRIC_END(MET_MIX_CROSSFADE);
   }
-
-  // --- Flash/Blinder: prisilni override intensity kanalov (preglasi blackout) ---
-  if (_flashActive && _fixtures) {
-    for (int i = 0; i < MAX_FIXTURES; i++) {
-      const PatchEntry* fx = _fixtures->getFixture(i);
-      if (!fx || !fx->active || fx->profileIndex < 0) continue;
-      uint8_t chCount = _fixtures->fixtureChannelCount(i);
-      for (int ch = 0; ch < chCount; ch++) {
-        const ChannelDef* def = _fixtures->fixtureChannel(i, ch);
-        if (!def) continue;
-        uint8_t t = def->type;
-        if (t == CH_INTENSITY) {
-          uint16_t addr = fx->dmxAddress + ch - 1;
-          if (addr < DMX_MAX_CHANNELS) _dmxOut[addr] = _flashLevel;
-        }
-      }
-    }
+  // Auto-follow cue liste na isti uri (nov crossfade steče od naslednjega frame-a)
+  if (_scenes) _scenes->cueTick(this, dtUs);
+  _undo.poll(now, _scenes && _scenes->isCrossfading());
+  memcpy(_localOut, _manualValues, DMX_MAX_CHANNELS);
+
+  // Overlay-i samo, ko lokalni vir sodeluje (sicer jih ni na izhodu)
+  if (part & (1 << MERGE_SRC_LOCAL)) {
+    _stages.run(pm, scaledDt, _manualValues, _localOut, dt);
   }
 
-  // --- Mode crossfade: mehak prehod med načini ---
-  if (_modeFading) {
-    unsigned long elapsed = now - _modeFadeStart;
-    if (elapsed >= _modeFadeMs) {
-      _modeFading = false;
-      _modeFadeProgress = 1.0f;
-    } else {
-      _modeFadeProgress = (float)elapsed / (float)_modeFadeMs;
-      // Lerp: from * (1-t) + to * t
-      float t = _modeFadeProgress;
-      float inv = 1.0f - t;
-      for (int i = 0; i < DMX_MAX_CHANNELS; i++) {
-        _dmxOut[i] = (uint8_t)(inv * _modeFadeFrom[i] + t * _dmxOut[i]);
-      }
-    }
+  // --- Spajanje: ArtNet senca + lokalni vir + OSC → izhod (en prehod) ---
+  // LTP lastništvo lokalnega vira se zazna na ročnih vrednostih: overlay-i
+  // (LFO, sound, shape, playback) se spreminjajo vsak frame in bi sicer
+  // ArtNet-u/OSC-ju sproti kradli LTP kanale
+  METRIC_BEGIN(MET_MIX_MERGE);
+  if (_mb) {
+    const uint8_t* const src[MERGE_SRC_COUNT] = { _artnetShadow, _localOut, _mb->osc };
+    mergeKernel(*_mb, src, part, _dmxOut, DMX_MAX_CHANNELS, _manualValues);
+  } else {
+    memcpy(_dmxOut, _localOut, DMX_MAX_CHANNELS);
   }
+  METRIC_END(MET_MIX_MERGE);
 
-  // Periodično shranjevanje v LittleFS (izven locka — LittleFS je počasen)
+  // Izhodni korak vedno na svežem spoju (master se aplicira natanko enkrat)
+  METRIC_BEGIN(MET_MIX_OUTPUT);
+  applyOutputStage(_outOps, pm, _dmxOut, _dmxOut);
+  METRIC_END(MET_MIX_OUTPUT);
+  updateUniverses(part);
+
+  publishFrame();
+  METRIC_END(MET_MIX_TOTAL);
+
+  // Periodično shranjevanje — samo zahteva, zapiše persist task (core 0)
   unlock();
   checkAutoSave();
 }
@@ -693,45 +913,68 @@ void MixerEngine::checkAutoSave() {
   // Shrani po 3s mirovanja ALI najdlje po 10s od prve spremembe
   if (elapsed >= SAVE_DEBOUNCE_MS ||
       (now - _lastSaveTime > SAVE_MAX_WAIT_MS && _lastSaveTime > 0)) {
-    saveStateNow();
+    _dirty = false;
+    _lastSaveTime = now;
+    persistCall(persistThunk, this);
   }
 }
 
 void MixerEngine::saveStateNow() {
-  // --- Mixer stanje (masterDimmer + groupDimmers + manualValues) ---
-  File f = LittleFS.open(MIXER_STATE_FILE, "w");
-  if (f) {
-    uint8_t header[2] = { 0xAE, _masterDimmer };  // Magic V2 + master
-    f.write(header, 2);
-    f.write(_groupDimmers, MAX_GROUPS);
-    f.write(_manualValues, DMX_MAX_CHANNELS);
-    f.close();
+  _dirty = false;
+  _lastSaveTime = millis();
+  persistCall(persistThunk, this);
+  persistFlush();
+}
+
+// Persist task: posnetek pod lockom (memcpy), zapis na flash brez locka
+void MixerEngine::persistThunk(void* ctx) { ((MixerEngine*)ctx)->persistState(); }
+
+void MixerEngine::persistState() {
+  lock();
+  _journal.capture();
+  bool snaps = _snaps.stageSync();
+  unlock();
+
+  // --- Mixer stanje: samo spremembe v dnevnik, občasno checkpoint ---
+  _journal.commit();
+  // --- Snapshoti: samo novi zapisi na konec datoteke ---
+  if (snaps) _snaps.writeStaged(MIXER_SNAP_FILE);
+
+  JournalStats js;
+  _journal.getStats(js);
+  Serial.printf("[MIX] Stanje shranjeno (dnevnik %u B, %u us)\n",
+                (unsigned)js.journalBytes, (unsigned)js.lastSyncUs);
+}
+
+void MixerEngine::loadState() {
+  // --- Mixer stanje: checkpoint + dnevnik ---
+  if (_journal.load()) {
+    JournalStats js;
+    _journal.getStats(js);
+    Serial.printf("[MIX] Stanje naloženo (master=%d, gen %u, %u zapisov iz dnevnika)\n",
+                  _masterDimmer, (unsigned)js.generation, (unsigned)js.replayed);
+    if (LittleFS.exists(MIXER_UNI_FILE)) LittleFS.remove(MIXER_UNI_FILE);
+  } else {
+    loadLegacyState();
+  }
+  memcpy(_dmxOut, _manualValues, DMX_MAX_CHANNELS);
+  for (int u = 1; u < MAX_UNIVERSES; u++) {
+    UniverseBuffers* b = _pool.get(u);
+    if (b) memcpy(b->out, b->manual, DMX_MAX_CHANNELS);
   }
 
   // --- Snapshoti ---
-  File sf = LittleFS.open(MIXER_SNAP_FILE, "w");
-  if (sf) {
-    uint8_t hdr[2] = { (uint8_t)_snapshotCount, (uint8_t)_snapshotHead };
-    sf.write(hdr, 2);
-    for (int i = 0; i < MAX_STATE_SNAPSHOTS; i++) {
-      sf.write(_snapshots[i].dmx, DMX_MAX_CHANNELS);
-      uint32_t ts = (uint32_t)_snapshots[i].timestamp;
-      sf.write((uint8_t*)&ts, 4);
-      uint8_t valid = _snapshots[i].valid ? 1 : 0;
-      sf.write(&valid, 1);
-      uint8_t src = (uint8_t)_snapshots[i].source;
-      sf.write(&src, 1);
-    }
-    sf.close();
+  if (_snaps.loadFile(MIXER_SNAP_FILE)) {
+    SnapshotCodecStats st;
+    _snaps.getStats(st);
+    Serial.printf("[MIX] Naloženih %u snapshotov (%u B namesto %u B)\n",
+                  (unsigned)st.count, (unsigned)st.poolBytes, (unsigned)st.rawBytes);
   }
-
-  _dirty = false;
-  _lastSaveTime = millis();
-  Serial.println("[MIX] Stanje shranjeno v LittleFS");
 }
 
-void MixerEngine::loadState() {
-  // --- Mixer stanje ---
+// Stara oblika (V2/V1 /mixer.bin + /mixer_u.bin) — prebere se enkrat, prvi
+// sync() jo nadomesti s checkpointom V3
+void MixerEngine::loadLegacyState() {
   File f = LittleFS.open(MIXER_STATE_FILE, "r");
   if (f && f.size() >= (2 + DMX_MAX_CHANNELS)) {
     uint8_t header[2];
@@ -740,13 +983,11 @@ void MixerEngine::loadState() {
       _masterDimmer = header[1];
       f.read(_groupDimmers, MAX_GROUPS);
       f.read(_manualValues, DMX_MAX_CHANNELS);
-      memcpy(_dmxOut, _manualValues, DMX_MAX_CHANNELS);
       Serial.printf("[MIX] Stanje V2 naloženo (master=%d)\n", _masterDimmer);
     } else if (header[0] == 0xAD) {  // V1: brez group dimmers
       _masterDimmer = header[1];
       memset(_groupDimmers, 255, sizeof(_groupDimmers));
       f.read(_manualValues, DMX_MAX_CHANNELS);
-      memcpy(_dmxOut, _manualValues, DMX_MAX_CHANNELS);
       Serial.printf("[MIX] Stanje V1 naloženo (master=%d)\n", _masterDimmer);
     }
     f.close();
@@ -755,31 +996,16 @@ void MixerEngine::loadState() {
     Serial.println("[MIX] Ni shranjega stanja — začnem s praznim");
   }
 
-  // --- Snapshoti ---
-  File sf = LittleFS.open(MIXER_SNAP_FILE, "r");
-  if (sf && sf.size() >= 2) {
-    uint8_t hdr[2];
-    sf.read(hdr, 2);
-    _snapshotCount = hdr[0];
-    _snapshotHead  = hdr[1];
-    if (_snapshotCount > MAX_STATE_SNAPSHOTS) _snapshotCount = MAX_STATE_SNAPSHOTS;
-    if (_snapshotHead >= MAX_STATE_SNAPSHOTS) _snapshotHead = 0;
-
-    for (int i = 0; i < MAX_STATE_SNAPSHOTS; i++) {
-      sf.read(_snapshots[i].dmx, DMX_MAX_CHANNELS);
-      uint32_t ts = 0;
-      sf.read((uint8_t*)&ts, 4);
-      _snapshots[i].timestamp = ts;
-      uint8_t valid = 0;
-      sf.read(&valid, 1);
-      _snapshots[i].valid = (valid == 1);
-      uint8_t src = 'L';
-      sf.read(&src, 1);  // Stare datoteke: prebere 0 → default 'L'
-      _snapshots[i].source = (src == 'A' || src == 'L') ? (char)src : 'L';
+  // --- Dodatne univerze (samo tiste, ki so patchane) ---
+  File uf = LittleFS.open(MIXER_UNI_FILE, "r");
+  if (uf) {
+    uint8_t id;
+    while (uf.read(&id, 1) == 1) {
+      UniverseBuffers* b = _pool.get(id);
+      if (b) uf.read(b->manual, DMX_MAX_CHANNELS);
+      else uf.seek(uf.position() + DMX_MAX_CHANNELS);
     }
-    sf.close();
-    Serial.printf("[MIX] Naloženih %d snapshotov\n", _snapshotCount);
-  } else {
-    if (sf) sf.close();
+    uf.close();
   }
+  _journal.requestCheckpoint();
 }
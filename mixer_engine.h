@@ -4,18 +4,90 @@
 #include "config.h"
 #include "fixture_engine.h"
 #include "scene_engine.h"
+#include "merge_engine.h"
+#include "output_stage.h"
+#include "undo_history.h"
+#include "snapshot_history.h"
+#include "state_journal.h"
 #include <freertos/semphr.h>
+#include <atomic>
+
+// ============================================================================
+//  Fuzioniran izhodni korak — opis operacij za en DMX naslov
+//  Zgradi se iz PatchMap ob spremembi generacije patcha.
+// ============================================================================
+
+#define OUTOP_INVERT    0x01   // 255 - v (pan/tilt in fine)
+#define OUTOP_REMAP     0x02   // lo + v*(hi-lo)/255 (pan/tilt omejitve)
+#define OUTOP_DIMMER    0x04   // Group + master dimmer (intensity)
+#define OUTOP_BLACKOUT  0x08   // Nulira ob blackoutu (intensity, barve, strobe)
+#define OUTOP_FLASH     0x10   // Flash nivo (intensity)
+#define OUTOP_PAIR      0x20   // Coarse 16-bit para: operacije na (coarse<<8)|fine, zapiše oba
+#define OUTOP_FINE      0x40   // Fine 16-bit para: zapiše ga coarse
+
+struct OutOp {
+  uint8_t  flags;    // OUTOP_*
+  uint8_t  lo;       // Spodnja meja za REMAP
+  uint8_t  hi;       // Zgornja meja za REMAP
+  uint8_t  dimSlot;  // Indeks v tabelo group dimmerjev (po unikatnih groupMask)
+  uint16_t fine;     // Naslov fine bajta (samo OUTOP_PAIR)
+};
+
+struct OutputOps {
+  OutOp    ops[DMX_MAX_CHANNELS];
+  uint8_t  dimSlotMask[MAX_FIXTURES];      // groupMask za vsak dimSlot
+  uint8_t  dimSlotCount;
+  uint32_t generation;                     // Generacija PatchMap, iz katere so zgrajeni ops
+};
+
+// ============================================================================
+//  Dodatne univerze (1..MAX_UNIVERSES-1)
+//  Bufferji so v PSRAM in se alocirajo šele, ko je v univerzi patchan fixture.
+//  Univerza 0 ostane v članih MixerEngine (DRAM), zato enouniverzna
+//  konfiguracija ne porabi nič več notranjega RAM-a.
+// ============================================================================
+
+struct UniverseBuffers {
+  uint8_t   out[DMX_MAX_CHANNELS];         // Delovni izhod (pod lockom)
+  uint8_t   manual[DMX_MAX_CHANNELS];      // Ročne vrednosti
+  uint8_t   artnet[DMX_MAX_CHANNELS];      // Senca ArtNet-a
+  MergeBuffers merge;                      // OSC vir + stanje spajanja
+  uint8_t   pubData[2][DMX_MAX_CHANNELS];  // Objava (isti seq kot univerza 0)
+  uint32_t  pubTimestampUs[2];
+  OutputOps ops;
+};
+
+class UniversePool {
+public:
+  UniverseBuffers* get(uint8_t u) const { return (u > 0 && u < MAX_UNIVERSES) ? _bufs[u] : nullptr; }
+  UniverseBuffers* acquire(uint8_t u);     // Alocira ob prvi uporabi (PSRAM), nato ostane
+  uint8_t getMask() const { return _mask; }  // bit u = alocirana
+  size_t  getBytes() const;
+
+private:
+  UniverseBuffers* _bufs[MAX_UNIVERSES] = {};
+  uint8_t _mask = 0;
+};
+
+// ============================================================================
+//  Objavljen DMX frame — konsistentna kopija izhoda za porabnike
+//  (DMX UART, ArtNet/sACN/ESP-NOW izhod, pixel mapper, WebSocket).
+// ============================================================================
 
-class SoundEngine;      // Forward declaration
-class LfoEngine;        // Forward declaration
-class ShapeGenerator;   // Forward declaration
+struct DmxFrame {
+  uint8_t  data[DMX_MAX_CHANNELS];
+  uint32_t seq;           // Zaporedna številka (0 = še ni objavljen)
+  uint32_t timestampUs;   // micros() ob objavi
+};
 
 class MixerEngine {
 public:
   void begin(FixtureEngine* fixtures, SceneEngine* scenes);
-  void setSoundEngine(SoundEngine* sound) { _sound = sound; }
-  void setLfoEngine(LfoEngine* lfo) { _lfo = lfo; }
-  void setShapeGenerator(ShapeGenerator* shapes) { _shapes = shapes; }
+
+  // --- Izhodne stopnje lokalnega vira (sound, LFO, shape, ...) ---
+  bool addStage(OutputStage* stage, uint8_t order, uint32_t budgetUs = 0,
+                uint8_t metric = STAGE_NO_METRIC);       // Pod lockom
+  OutputPipeline& getStages() { return _stages; }        // Spremembe samo pod lock()
 
   // --- Master Speed ---
   void setMasterSpeed(float speed);
@@ -27,24 +99,33 @@ public:
 
   // --- Vhod podatkov ---
   void onArtNetData(const uint8_t* data, uint16_t length);
-  void onArtPoll();
-
-  // --- Krmilni način ---
-  void switchToLocal();           // Ročni preklop na lokalno
-  void switchToArtNet();          // Ročni preklop na ArtNet
-  void switchToPrimaryLocal();    // Preklop na PRIMARY: ArtNet se ignorira, samo obvesti
-  ControlMode getMode() const { return _mode; }
-  bool isManualOverride() const { return _manualOverride; }
-
-  // --- ArtNet timeout ---
-  void setArtNetTimeout(uint32_t ms) { _artnetTimeoutMs = ms; }
+  void onArtNetData(uint8_t universe, const uint8_t* data, uint16_t length);  // 0 = primarna
+
+  // --- Krmilni način (prednastavitve spajanja virov) ---
+  void switchToMerge();           // Brez pripetja: viri se spajajo po prioriteti (HTP/LTP)
+  void switchToLocal();           // Pripni lokalni vir (prispevek ArtNet-a se prenese v mixer)
+  void switchToArtNet();          // Pripni ArtNet (lokalno prevzame šele po timeoutu)
+  void switchToPrimaryLocal();    // Kot switchToLocal, ArtNet samo obvesti
+  ControlMode getMode() const;    // Izpeljan iz pripetja in aktivnih virov (UI, LED)
+  bool isManualOverride() const { return _merge.getPinned() == MERGE_SRC_LOCAL; }
+
+  // --- Viri spajanja ---
+  void setArtNetTimeout(uint32_t ms) { setSourceTimeout(MERGE_SRC_ARTNET, ms); }
+  void setSourcePriority(uint8_t source, uint8_t priority);
+  void setSourceTimeout(uint8_t source, uint32_t ms);
+  void setHtpMask(uint32_t mask);                 // bit = ChannelType, ostali kanali LTP
+  uint32_t getHtpMask() const { return _merge.getHtpMask(); }
+  uint8_t getActiveSources() const { return _activeSources; }  // Sodelujoči viri zadnjega frame-a
 
   // --- ArtNet detected flag (za PRIMARY mode notifikacijo) ---
   bool consumeArtNetDetected();
 
-  // --- Mixer operacije (delujejo samo v LOCAL načinu) ---
-  void setChannel(uint16_t addr, uint8_t value);                      // Posamezen kanal (1-512)
-  void setFixtureChannel(int fixtureIdx, int ch, uint8_t value);      // Fixture kanal
+  // --- Mixer operacije (source = lokalni vir ali OSC) ---
+  void setChannel(uint16_t addr, uint8_t value, uint8_t source = MERGE_SRC_LOCAL);   // Posamezen kanal (1-512)
+  void setFixtureChannel(int fixtureIdx, int ch, uint8_t value,
+                         uint8_t source = MERGE_SRC_LOCAL);         // Fixture kanal (v njegovi univerzi)
+  void setUniverseChannel(uint8_t universe, uint16_t addr, uint8_t value,
+                          uint8_t source = MERGE_SRC_LOCAL);
   void setGroupChannel(int groupBit, int ch, uint8_t value);          // Skupina: isti kanal na vseh
   void setMasterDimmer(uint8_t value);
   uint8_t getMasterDimmer() const { return _masterDimmer; }
@@ -55,8 +136,17 @@ public:
   bool isBlackout() const { return _blackout; }
 
   // --- Scene (delegira na SceneEngine) ---
-  bool saveCurrentAsScene(int slot, const char* name);   // Shrani trenutni mixer state kot sceno
-  bool recallScene(int slot, uint32_t fadeMs);            // Recall s crossfade
+  // Shrani trenutni mixer state kot sceno. Delna scena določa kanale iz mask
+  // (bit = naslov), sicer tiste, ki jih je operater nastavil od zadnjega priklica;
+  // brez obojega kanale ≠ 0
+  bool saveCurrentAsScene(int slot, const char* name, bool partial = false, const uint32_t* mask = nullptr);
+  uint16_t getTouchedCount() const;          // Ročno nastavljeni kanali univerze 0 (za delno sceno)
+  void clearTouched() { memset(_touched, 0, sizeof(_touched)); }
+  // Recall s crossfade (FadeCurve, split časi cue-ja). Scena, ki ni v cache-u,
+  // se bere na persist tasku: priklic se izvede v frame-u, ko je prebrana
+  bool recallScene(int slot, uint32_t fadeMs, uint8_t curve = FADE_LINEAR,
+                   const CueTiming* timing = nullptr);
+  bool isRecallPending() const { return _deferred.slot >= 0; }
   bool isSceneCrossfading() const;
   float getSceneCrossfadeProgress() const;
   int   getSceneCrossfadeTarget() const;
@@ -66,14 +156,22 @@ public:
   void takeSnapshot(char source = 'L');  // Shrani manualValues v zgodovino
   void takeSnapshotFrom(const uint8_t* data, char source);  // Shrani specifičen buffer
   int  getSnapshotCount() const;
-  const StateSnapshot* getSnapshot(int idx) const;
+  bool getSnapshotInfo(int idx, uint32_t& ts, char& source) const;   // Brez dekodiranja
+  bool getSnapshot(int idx, StateSnapshot& out) const;               // Rekonstruira (keyframe + delte)
+  void getSnapshotStats(SnapshotCodecStats& out) const { _snaps.getStats(out); }
+  void getJournalStats(JournalStats& out) const { _journal.getStats(out); }
   void recallSnapshot(int idx);                   // Naloži stanje iz zgodovine
   void recallArtNetShadow();                      // Naloži zadnje ArtNet stanje
 
-  // --- Undo ---
-  void pushUndo();       // Shrani trenutno stanje pred spremembo
-  bool undo();           // Obnovi zadnje shranjeno stanje
-  bool hasUndo() const { return _undoValid; }
+  // --- Undo/redo (ročne vrednosti univerze 0 + master + group dimmerji) ---
+  void pushUndo();                      // Zapri odprt korak (meja pred novo akcijo)
+  void pushUndo(const uint8_t* next);   // + zabeleži kanale, ki jih bo next spremenil
+  bool undo();
+  bool redo();
+  bool hasUndo() const { return _undo.hasUndo(); }
+  bool hasRedo() const { return _undo.hasRedo(); }
+  uint16_t getUndoDepth() const { return _undo.undoDepth(); }
+  uint16_t getRedoDepth() const { return _undo.redoDepth(); }
 
   // --- Flash (Blinder) ---
   void setFlash(bool active, uint8_t level = 255);
@@ -85,15 +183,24 @@ public:
   uint32_t getLocateMask() const;
 
   // --- Izhod ---
+  // Delovni buffer: samo pod lock() ali v tasku, ki kliče update()
   const uint8_t* getDmxOutput() const { return _dmxOut; }
+  // Zadnji objavljen frame — brez mutexa, varno iz kateregakoli taska/jedra
+  void readFrame(DmxFrame& out) const;
+  bool readFrame(uint8_t universe, DmxFrame& out) const;   // false = univerza ni alocirana
+  uint32_t getFrameSeq() const { return _pubSeq.load(std::memory_order_acquire); }
   const uint8_t* getManualValues() const { return _manualValues; }
+  const uint8_t* getManualValues(uint8_t universe) const;  // nullptr = ni alocirana
+  const uint8_t* getDmxOutput(uint8_t universe) const;
+  uint8_t getUniverseMask() const { return _pool.getMask() | 1; }
+  size_t  getUniversePoolBytes() const { return _pool.getBytes(); }
 
   // --- Persistenca ---
   void loadState();       // Naloži iz LittleFS ob zagonu
-  void saveStateNow();    // Takoj shrani (za shutdown)
+  void saveStateNow();    // Shrani in počakaj na zapis (shutdown; ne pod lockom)
 
   // --- Loop posodobitev ---
-  void update();                                  // Kliči vsak loop() — upravlja timeout
+  void update(float dt = 0);                      // Enkrat na frame; dt [s] iz frame clock-a (0 = iz millis())
 
   // --- Statistika ---
   float getArtNetFps() const { return _artnetFps; }
@@ -103,24 +210,29 @@ public:
 private:
   FixtureEngine* _fixtures = nullptr;
   SceneEngine*   _scenes = nullptr;
-  SoundEngine*   _sound = nullptr;
-  LfoEngine*     _lfo = nullptr;
-  ShapeGenerator* _shapes = nullptr;
+  OutputPipeline _stages;
 
   // Bufferji
   uint8_t _dmxOut[DMX_MAX_CHANNELS];         // Končni izhod → DMX
   uint8_t _manualValues[DMX_MAX_CHANNELS];   // Ročne (lokalne) vrednosti
   uint8_t _artnetShadow[DMX_MAX_CHANNELS];   // Senca ArtNet-a (vedno posodobljeno)
+  uint8_t _localOut[DMX_MAX_CHANNELS];       // Lokalni vir: ročne vrednosti + sound/LFO/shape
+
+  // Spajanje virov
+  MergeEngine   _merge;
+  MergeBuffers* _mb = nullptr;               // Univerza 0 (PSRAM)
+  uint8_t _activeSources = 0;                // Sodelujoči viri zadnjega frame-a
+  bool    _primary = false;                  // Pripet lokalni vir v PRIMARY načinu
+  void pinLocal(bool primary);
+  void releaseSource(uint8_t source);        // Prispevek vira → ročne vrednosti (vse univerze)
+  uint8_t* sourceBuffer(uint8_t universe, uint8_t source);
 
   // Stanje
-  ControlMode _mode = CTRL_ARTNET;
-  bool _manualOverride = false;
   bool _blackout = false;
   uint8_t _masterDimmer = 255;
   uint8_t _groupDimmers[MAX_GROUPS];
 
   // ArtNet timing
-  uint32_t _artnetTimeoutMs = 10000;
   bool _artnetDetected = false;
   unsigned long _artnetDetectedMs = 0;
   unsigned long _lastArtNetPacket = 0;
@@ -129,10 +241,9 @@ private:
   unsigned long _fpsLastCalc = 0;
   float _artnetFps = 0;
 
-  // Zgodovina stanj (krožni buffer)
-  StateSnapshot _snapshots[MAX_STATE_SNAPSHOTS];
-  int _snapshotHead = 0;  // Naslednji slot za pisanje
-  int _snapshotCount = 0;
+  // Zgodovina stanj (keyframe + XOR/RLE delte v PSRAM)
+  SnapshotHistory _snaps;
+  StateJournal _journal;        // /mixer.bin (checkpoint) + /mixer.jnl
 
   // Persistenca
   bool _dirty = false;
@@ -140,13 +251,39 @@ private:
   unsigned long _lastSaveTime = 0;
   void markDirty();
   void checkAutoSave();
-  void applyMasterDimmer();
-  void applyPanTiltLimits();
-
-  // Undo (1 korak)
-  uint8_t _undoBuffer[DMX_MAX_CHANNELS];
-  uint8_t _undoMaster = 255;
-  bool    _undoValid = false;
+  static void persistThunk(void* ctx);
+  void persistState();                       // Persist task (core 0)
+  void loadLegacyState();                    // Pred dnevnikom: V2/V1 /mixer.bin + /mixer_u.bin
+
+  // Fuzioniran izhodni korak (limits + dimmer + blackout + flash)
+  OutputOps _outOps = {};
+  void rebuildOutputOps(OutputOps& o, const PatchMap* m);
+  void applyOutputStage(OutputOps& o, const PatchMap* m, const uint8_t* src, uint8_t* dst);
+
+  // Dodatne univerze
+  UniversePool _pool;
+  uint32_t _poolGeneration = 0;              // Generacija patcha ob zadnjem syncUniverses()
+  void syncUniverses();                      // Alociraj bufferje za na novo patchane univerze
+  void updateUniverses(uint8_t part);
+  void latchUniverses();                     // manual ← artnet
+  uint8_t* manualFor(uint8_t universe);
+
+  // Undo/redo zgodovina (delte v PSRAM obroču)
+  UndoHistory _undo;
+  uint32_t _touched[DMX_MAX_CHANNELS / 32];  // Bit = naslov, ki ga je operater nastavil (delna scena)
+
+  // Priklic scene, ki čaka na branje s flash-a (slot -1 = ni)
+  struct DeferredRecall {
+    int16_t   slot;
+    uint8_t   curve;
+    bool      hasTiming;
+    uint32_t  fadeMs;
+    uint32_t  sinceMs;
+    CueTiming timing[CUE_TG_COUNT];
+  };
+  DeferredRecall _deferred = { -1, 0, false, 0, 0, {} };
+  void applyRecall(const Scene& sc, int slot, uint32_t fadeMs, uint8_t curve, const CueTiming* timing);
+  void runDeferredRecall(unsigned long now);
 
   // Flash (Blinder)
   bool    _flashActive = false;
@@ -163,14 +300,13 @@ private:
   unsigned long _lastUpdateMs = 0;
   float _masterSpeed = 1.0f;
 
-  // Mode crossfade (prehod med ArtNet ↔ Local)
-  bool     _modeFading = false;
-  uint8_t  _modeFadeFrom[DMX_MAX_CHANNELS];  // Stanje ob preklopu
-  float    _modeFadeProgress = 0;             // 0.0 → 1.0
-  uint32_t _modeFadeMs = 1000;               // Trajanje v ms
-  unsigned long _modeFadeStart = 0;
-
-  void startModeFade();  // Shrani trenutni izhod kot "from"
+  // Objava frame-a: dva slota + števca (seqlock brez čakanja na pisalca).
+  // Pisalec piše v slot (seq+1)&1, bralec bere zadnji zaključen slot seq&1.
+  uint8_t  _pubData[2][DMX_MAX_CHANNELS];
+  uint32_t _pubTimestampUs[2];
+  std::atomic<uint32_t> _pubSeq{0};        // Zadnji zaključen frame
+  std::atomic<uint32_t> _pubWriting{0};    // Frame, ki se trenutno piše
+  void publishFrame();
 };
 
 #endif
@@ -9,22 +9,24 @@ void OscServer::begin(MixerEngine* mixer, FixtureEngine* fixtures, uint16_t port
   Serial.printf("[OSC] Listening on UDP port %d\n", port);
 }
 
-void OscServer::update() {
+bool OscServer::update() {
   int pktSize = _udp.parsePacket();
-  if (pktSize <= 0 || pktSize > OSC_BUF_SIZE) return;
+  if (pktSize <= 0) return false;
+  // Neveljaven paket je vseeno porabljen (naslednji parsePacket ga zavrže)
+  if (pktSize > OSC_BUF_SIZE) return true;
   int len = _udp.read(_buf, OSC_BUF_SIZE);
-  if (len < 8) return;
+  if (len < 8) return true;
 
   // Parse address (null-terminated, 4-byte padded)
   const char* addr = (const char*)_buf;
   int addrLen = strnlen(addr, len);
-  if (addrLen >= len) return;
+  if (addrLen >= len) return true;
   int addrPad = padded(addrLen + 1);
-  if (addrPad >= len) return;
+  if (addrPad >= len) return true;
 
   // Parse type tag string (starts with ',')
   const char* typesRaw = (const char*)(_buf + addrPad);
-  if (typesRaw[0] != ',') return;
+  if (typesRaw[0] != ',') return true;
   const char* types = typesRaw + 1;  // skip comma
   int typesRawLen = strnlen(typesRaw, len - addrPad);
   int typesPad = padded(typesRawLen + 1);
@@ -36,6 +38,7 @@ void OscServer::update() {
   _mixer->lock();
   dispatch(addr, types, args, argLen);
   _mixer->unlock();
+  return true;
 }
 
 float OscServer::readFloat(const uint8_t* p) {
@@ -51,12 +54,13 @@ int32_t OscServer::readInt32(const uint8_t* p) {
 }
 
 void OscServer::dispatch(const char* addr, const char* types, const uint8_t* args, int argLen) {
+  // Kanali gredo v OSC vir spajanja (HTP/LTP z ArtNet-om in lokalnim mixerjem)
   // /dmx/N float(0.0-1.0) → set channel N to value * 255
   if (strncmp(addr, "/dmx/", 5) == 0 && types[0] == 'f' && argLen >= 4) {
     int ch = atoi(addr + 5);
     float val = readFloat(args);
     if (val < 0) val = 0; if (val > 1) val = 1;
-    _mixer->setChannel(ch, (uint8_t)(val * 255.0f));
+    _mixer->setChannel(ch, (uint8_t)(val * 255.0f), MERGE_SRC_OSC);
     return;
   }
 
@@ -74,7 +78,7 @@ void OscServer::dispatch(const char* addr, const char* types, const uint8_t* arg
       for (int c = 0; c < chCount; c++) {
         const ChannelDef* def = _fixtures->fixtureChannel(fi, c);
         if (def && def->type == CH_INTENSITY)
-          _mixer->setFixtureChannel(fi, c, (uint8_t)(val * 255.0f));
+          _mixer->setFixtureChannel(fi, c, (uint8_t)(val * 255.0f), MERGE_SRC_OSC);
       }
     }
     else if (strcmp(sub, "/color") == 0 && argLen >= 12) {
@@ -88,9 +92,9 @@ void OscServer::dispatch(const char* addr, const char* types, const uint8_t* arg
       for (int c = 0; c < chCount; c++) {
         const ChannelDef* def = _fixtures->fixtureChannel(fi, c);
         if (!def) continue;
-        if (def->type == CH_COLOR_R) _mixer->setFixtureChannel(fi, c, (uint8_t)(r * 255));
-        if (def->type == CH_COLOR_G) _mixer->setFixtureChannel(fi, c, (uint8_t)(g * 255));
-        if (def->type == CH_COLOR_B) _mixer->setFixtureChannel(fi, c, (uint8_t)(b * 255));
+        if (def->type == CH_COLOR_R) _mixer->setFixtureChannel(fi, c, (uint8_t)(r * 255), MERGE_SRC_OSC);
+        if (def->type == CH_COLOR_G) _mixer->setFixtureChannel(fi, c, (uint8_t)(g * 255), MERGE_SRC_OSC);
+        if (def->type == CH_COLOR_B) _mixer->setFixtureChannel(fi, c, (uint8_t)(b * 255), MERGE_SRC_OSC);
       }
     }
     return;
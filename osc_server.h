@@ -11,7 +11,7 @@
 class OscServer {
 public:
   void begin(MixerEngine* mixer, FixtureEngine* fixtures, uint16_t port = OSC_PORT);
-  void update();  // Kliči iz loop()
+  bool update();  // En paket; true = paket prebran (kliči v zanki do false)
 private:
   WiFiUDP _udp;
   MixerEngine* _mixer = nullptr;
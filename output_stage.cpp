@@ -0,0 +1,132 @@
+#include "output_stage.h"
+#include "metrics.h"
+#include <esp_cpu.h>
+
+// ============================================================================
+//  REGISTRACIJA
+//  Seznam je majhen (≤ MAX_OUTPUT_STAGES) in urejen po vrstnem redu, zato
+//  run() samo gre po vrsti. Spremembe iz web taska morajo držati mixer lock.
+// ============================================================================
+
+bool OutputPipeline::add(OutputStage* stage, uint8_t order, uint32_t budgetUs, uint8_t metric) {
+  if (!stage || _count >= MAX_OUTPUT_STAGES) return false;
+  for (int i = 0; i < _count; i++) if (_slots[i].stage == stage) return false;
+  StageSlot& s = _slots[_count++];
+  s = {};
+  s.stage = stage;
+  s.order = order;
+  s.enabled = true;
+  s.metric = metric;
+  s.budgetUs = budgetUs;
+  sortSlots();
+  return true;
+}
+
+bool OutputPipeline::remove(OutputStage* stage) {
+  for (int i = 0; i < _count; i++) {
+    if (_slots[i].stage != stage) continue;
+    for (int j = i; j < _count - 1; j++) _slots[j] = _slots[j + 1];
+    _count--;
+    return true;
+  }
+  return false;
+}
+
+int OutputPipeline::find(const char* name) const {
+  if (!name) return -1;
+  for (int i = 0; i < _count; i++) {
+    if (strcmp(_slots[i].stage->name(), name) == 0) return i;
+  }
+  return -1;
+}
+
+bool OutputPipeline::isRelevant(int idx) const {
+  if (idx < 0 || idx >= _count) return false;
+  return (_slots[idx].stage->channelTypes() & _patchTypes) != 0;
+}
+
+bool OutputPipeline::setEnabled(int idx, bool on) {
+  if (idx < 0 || idx >= _count) return false;
+  _slots[idx].enabled = on;
+  return true;
+}
+
+bool OutputPipeline::setOrder(int idx, uint8_t order) {
+  if (idx < 0 || idx >= _count) return false;
+  _slots[idx].order = order;
+  sortSlots();
+  return true;
+}
+
+bool OutputPipeline::setBudget(int idx, uint32_t budgetUs) {
+  if (idx < 0 || idx >= _count) return false;
+  _slots[idx].budgetUs = budgetUs;
+  _slots[idx].overruns = 0;
+  return true;
+}
+
+void OutputPipeline::resetStats() {
+  for (int i = 0; i < _count; i++) {
+    _slots[i].lastUs = _slots[i].maxUs = 0;
+    _slots[i].runs = _slots[i].overruns = 0;
+  }
+}
+
+// Insertion sort — stabilen, da enak red ohrani vrstni red registracije
+void OutputPipeline::sortSlots() {
+  for (int i = 1; i < _count; i++) {
+    StageSlot s = _slots[i];
+    int j = i - 1;
+    while (j >= 0 && _slots[j].order > s.order) { _slots[j + 1] = _slots[j]; j--; }
+    _slots[j + 1] = s;
+  }
+}
+
+// Tipi kanalov v patchu iz seznamov po tipu (samo ob novi generaciji)
+void OutputPipeline::syncPatchTypes(const PatchMap* m) {
+  if (!m) { _patchTypes = STAGE_TYPES_ALL; _patchGen = 0; return; }
+  if (m->generation == _patchGen) return;
+  uint32_t types = 0;
+  for (int t = 0; t < CH_TYPE_COUNT; t++) {
+    if (m->typeStart[t + 1] > m->typeStart[t]) types |= (1UL << t);
+  }
+  _patchTypes = types;
+  _patchGen = m->generation;
+}
+
+// ============================================================================
+//  FRAME
+//  Budget je merilo, ne prekinitev: stopnja vedno konča svoj prehod, prekoračitev
+//  se šteje (in enkrat izpiše), da se vidi, katera stopnja je predraga.
+// ============================================================================
+
+void OutputPipeline::run(const PatchMap* m, float dt, const uint8_t* in, uint8_t* out, float realDt) {
+  syncPatchTypes(m);
+  if (realDt < 0.f) realDt = dt;
+  uint32_t cpu = metricsCyclesPerUs();
+  if (cpu == 0) cpu = 240;
+
+  for (int i = 0; i < _count; i++) {
+    StageSlot& s = _slots[i];
+    if (!s.enabled || !(s.stage->channelTypes() & _patchTypes) || !s.stage->isActive()) continue;
+
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    s.stage->prepare(s.stage->realTime() ? realDt : dt);
+    s.stage->apply(in, out);
+    uint32_t cycles = esp_cpu_get_cycle_count() - t0;
+#if METRICS_ENABLED
+    if (s.metric != STAGE_NO_METRIC) metricsRecord(s.metric, cycles);
+#endif
+
+    uint32_t us = cycles / cpu;
+    s.lastUs = us;
+    if (us > s.maxUs) s.maxUs = us;
+    s.runs++;
+    if (s.budgetUs && us > s.budgetUs) {
+      if (s.overruns++ == 0) {
+        Serial.printf("[MIX] Stopnja '%s' prekoračila budget: %lu µs > %lu µs\n",
+                      s.stage->name(), (unsigned long)us, (unsigned long)s.budgetUs);
+      }
+    }
+  }
+}
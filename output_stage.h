@@ -0,0 +1,80 @@
+#ifndef OUTPUT_STAGE_H
+#define OUTPUT_STAGE_H
+
+#include "config.h"
+#include "fixture_engine.h"
+
+// ============================================================================
+//  IZHODNE STOPNJE — overlay-i lokalnega vira (sound, LFO, shape, ...)
+//  Stopnja se registrira v OutputPipeline z vrstnim redom in budgetom, mixer
+//  je ne pozna po tipu. Neaktivna stopnja ali stopnja, katere tipov kanalov
+//  ni v patchu, se ta frame preskoči v celoti (tudi prepare()).
+// ============================================================================
+
+#define MAX_OUTPUT_STAGES   8
+#define STAGE_TYPES_ALL     0xFFFFFFFFUL    // Stopnja lahko piše poljuben kanal
+#define STAGE_NO_METRIC     0xFF            // Brez histograma v metrics.h
+
+// Privzet vrstni red (manjši = prej) in budget na frame v µs (0 = brez)
+#define STAGE_ORDER_PLAYBACK 5
+#define STAGE_ORDER_SOUND   10
+#define STAGE_ORDER_LFO     20
+#define STAGE_ORDER_SHAPE   30
+#define STAGE_BUDGET_PLAYBACK 500
+#define STAGE_BUDGET_SOUND  1000
+#define STAGE_BUDGET_LFO    300
+#define STAGE_BUDGET_SHAPE  300
+
+class OutputStage {
+public:
+  virtual ~OutputStage() {}
+  virtual const char* name() const = 0;
+  virtual uint32_t channelTypes() const = 0;   // bit = ChannelType, ki ga stopnja lahko zapiše
+  virtual bool isActive() const { return true; }
+  virtual bool realTime() const { return false; }  // prepare() dobi dt brez master speed
+  virtual void prepare(float /*dt*/) {}        // Enkrat na frame pred apply (dt × master speed)
+  virtual void apply(const uint8_t* in, uint8_t* out) = 0;   // in = ročne vrednosti, out = lokalni vir
+};
+
+struct StageSlot {
+  OutputStage* stage;
+  uint8_t  order;
+  bool     enabled;
+  uint8_t  metric;       // MetricStage ali STAGE_NO_METRIC
+  uint32_t budgetUs;     // 0 = brez omejitve
+  uint32_t lastUs;       // Zadnji tek (prepare + apply)
+  uint32_t maxUs;
+  uint32_t runs;
+  uint32_t overruns;     // Frame-i nad budgetom
+};
+
+class OutputPipeline {
+public:
+  // Vstavi po vrstnem redu (enak red → za obstoječimi); false = polno/že registrirana
+  bool add(OutputStage* stage, uint8_t order, uint32_t budgetUs = 0, uint8_t metric = STAGE_NO_METRIC);
+  bool remove(OutputStage* stage);
+
+  int  count() const { return _count; }
+  int  find(const char* name) const;                // -1 = ni
+  const StageSlot* get(int idx) const { return (idx >= 0 && idx < _count) ? &_slots[idx] : nullptr; }
+  bool isRelevant(int idx) const;                   // Stopnja ima v patchu kaj za narediti
+
+  bool setEnabled(int idx, bool on);
+  bool setOrder(int idx, uint8_t order);            // Preuredi; indeksi se lahko spremenijo
+  bool setBudget(int idx, uint32_t budgetUs);
+  void resetStats();
+
+  // Poženi omogočene, aktivne in relevantne stopnje po vrsti
+  // (realDt < 0 = enak dt; uporabijo ga stopnje z realTime())
+  void run(const PatchMap* m, float dt, const uint8_t* in, uint8_t* out, float realDt = -1.f);
+
+private:
+  StageSlot _slots[MAX_OUTPUT_STAGES] = {};
+  uint8_t   _count = 0;
+  uint32_t  _patchTypes = STAGE_TYPES_ALL;          // Tipi kanalov v patchu (brez patcha = vsi)
+  uint32_t  _patchGen = 0;
+  void sortSlots();
+  void syncPatchTypes(const PatchMap* m);
+};
+
+#endif
@@ -0,0 +1,299 @@
+#include "persist.h"
+#include <LittleFS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <atomic>
+
+// ============================================================================
+//  ČAKAJOČE ZAHTEVE
+//  Fiksen seznam (brez alokacij razen kopij vsebine). Ključ je pot (zapis,
+//  brisanje) ali par callback+ctx. Mutex drži samo seznam — nikoli flash.
+// ============================================================================
+
+enum PersistKind : uint8_t { PJ_NONE = 0, PJ_WRITE, PJ_REMOVE, PJ_CALL };
+
+struct PersistJob {
+  PersistKind kind;
+  char        path[PERSIST_MAX_PATH];
+  PersistFn   fn;
+  void*       ctx;
+  uint8_t*    buf;            // PJ_WRITE: lastna kopija (PSRAM)
+  size_t      len;
+  uint32_t    seq;
+  uint32_t    queuedMs;       // Prva (nezdružena) zahteva
+  bool        urgent;         // PJ_CALL brez odloga (persistCallUrgent)
+};
+
+static PersistJob _jobs[PERSIST_MAX_PENDING];
+static SemaphoreHandle_t _mtx = nullptr;
+static SemaphoreHandle_t _doneSem = nullptr;
+static SemaphoreHandle_t _urgentSem = nullptr;   // Prekine čakanje na združevanje
+static TaskHandle_t _task = nullptr;
+static uint32_t _seq = 0;                       // Zadnja oddana zahteva
+static std::atomic<uint32_t> _doneSeq{0};       // Vse do te so zapisane
+static std::atomic<bool> _flushReq{false};
+static std::atomic<bool> _urgentReq{false};     // Čaka nujen klic
+static std::atomic<bool> _closed{false};
+static PersistStats _stats = {};
+
+static void lockJobs()   { if (_mtx) xSemaphoreTake(_mtx, portMAX_DELAY); }
+static void unlockJobs() { if (_mtx) xSemaphoreGive(_mtx); }
+
+void persistBegin() {
+  if (!_mtx) _mtx = xSemaphoreCreateMutex();
+  if (!_doneSem) _doneSem = xSemaphoreCreateBinary();
+  if (!_urgentSem) _urgentSem = xSemaphoreCreateBinary();
+}
+
+bool persistIsAsync() { return _task != nullptr; }
+
+// ============================================================================
+//  IZVEDBA (task ali klicoč task v sinhronem načinu)
+// ============================================================================
+
+static void runJob(const PersistJob& j) {
+  uint32_t t0 = micros();
+  bool ok = true;
+  switch (j.kind) {
+    case PJ_WRITE: {
+      File f = LittleFS.open(j.path, "w");
+      ok = f && f.write(j.buf, j.len) == j.len;
+      if (f) f.close();
+      if (ok) _stats.bytes += j.len;
+      else Serial.printf("[PST] NAPAKA pri pisanju %s\n", j.path);
+      break;
+    }
+    case PJ_REMOVE:
+      if (LittleFS.exists(j.path)) ok = LittleFS.remove(j.path);
+      break;
+    case PJ_CALL:
+      j.fn(j.ctx);
+      break;
+    default:
+      return;
+  }
+  uint32_t us = micros() - t0;
+  _stats.writes++;
+  if (!ok) _stats.failed++;
+  _stats.lastWriteUs = us;
+  if (us > _stats.maxWriteUs) _stats.maxWriteUs = us;
+}
+
+static PersistJob* findJob(PersistKind kind, const char* path, PersistFn fn, void* ctx) {
+  for (int i = 0; i < PERSIST_MAX_PENDING; i++) {
+    PersistJob& j = _jobs[i];
+    if (j.kind == PJ_NONE) continue;
+    if (kind == PJ_CALL ? (j.kind == PJ_CALL && j.fn == fn && j.ctx == ctx)
+                        : (j.kind != PJ_CALL && strcmp(j.path, path) == 0)) return &j;
+  }
+  return nullptr;
+}
+
+// Prevzame buf (PJ_WRITE). Zamenja čakajočo zahtevo z istim ključem.
+static bool enqueue(PersistJob& req) {
+  if (_closed.load()) {
+    _stats.dropped++;
+    free(req.buf);
+    return false;
+  }
+  _stats.requests++;
+  if (!_task) {
+    runJob(req);
+    free(req.buf);
+    return true;
+  }
+
+  lockJobs();
+  PersistJob* j = findJob(req.kind, req.path, req.fn, req.ctx);
+  uint8_t* old = nullptr;
+  if (j) {
+    old = j->buf;
+    req.queuedMs = j->queuedMs;
+    req.urgent = req.urgent || j->urgent;
+    _stats.coalesced++;
+  } else {
+    for (int i = 0; i < PERSIST_MAX_PENDING && !j; i++) if (_jobs[i].kind == PJ_NONE) j = &_jobs[i];
+    if (j) _stats.pending++;
+  }
+  if (j) {
+    req.seq = ++_seq;
+    *j = req;
+  }
+  unlockJobs();
+  free(old);
+
+  if (!j) {
+    // Poln seznam — raje počasen zapis kot izgubljen
+    _stats.overflow++;
+    runJob(req);
+    free(req.buf);
+    return true;
+  }
+  if (req.urgent) {
+    _urgentReq.store(true);
+    xSemaphoreGive(_urgentSem);
+  }
+  xTaskNotifyGive(_task);
+  return true;
+}
+
+bool persistWriteV(const char* path, const PersistSeg* segs, int count) {
+  if (!path || strlen(path) >= PERSIST_MAX_PATH || count > PERSIST_MAX_SEGS) return false;
+  PersistJob req = {};
+  req.kind = PJ_WRITE;
+  strlcpy(req.path, path, sizeof(req.path));
+  for (int i = 0; i < count; i++) req.len += segs[i].len;
+  req.buf = (uint8_t*)psramPreferMalloc(req.len ? req.len : 1);
+  if (!req.buf) {
+    Serial.printf("[PST] NAPAKA: ni pomnilnika za kopijo %s (%u B)\n", path, (unsigned)req.len);
+    return false;
+  }
+  size_t off = 0;
+  for (int i = 0; i < count; i++) {
+    memcpy(req.buf + off, segs[i].data, segs[i].len);
+    off += segs[i].len;
+  }
+  req.queuedMs = millis();
+  return enqueue(req);
+}
+
+bool persistWriteOwned(const char* path, uint8_t* buf, size_t len) {
+  if (!path || strlen(path) >= PERSIST_MAX_PATH || !buf) { free(buf); return false; }
+  PersistJob req = {};
+  req.kind = PJ_WRITE;
+  strlcpy(req.path, path, sizeof(req.path));
+  req.buf = buf;
+  req.len = len;
+  req.queuedMs = millis();
+  return enqueue(req);
+}
+
+bool persistRemove(const char* path) {
+  if (!path || strlen(path) >= PERSIST_MAX_PATH) return false;
+  PersistJob req = {};
+  req.kind = PJ_REMOVE;
+  strlcpy(req.path, path, sizeof(req.path));
+  req.queuedMs = millis();
+  return enqueue(req);
+}
+
+bool persistCall(PersistFn fn, void* ctx) {
+  if (!fn) return false;
+  PersistJob req = {};
+  req.kind = PJ_CALL;
+  req.fn = fn;
+  req.ctx = ctx;
+  req.queuedMs = millis();
+  return enqueue(req);
+}
+
+bool persistCallUrgent(PersistFn fn, void* ctx) {
+  if (!fn) return false;
+  PersistJob req = {};
+  req.kind = PJ_CALL;
+  req.fn = fn;
+  req.ctx = ctx;
+  req.queuedMs = millis();
+  req.urgent = true;
+  return enqueue(req);
+}
+
+// ============================================================================
+//  TASK (core 0)
+// ============================================================================
+
+// Najstarejša čakajoča zahteva (urgentOnly: samo nujni klici); prazen
+// seznam → vse do _seq je zapisano
+static bool takeOldest(PersistJob& out, bool urgentOnly = false) {
+  lockJobs();
+  PersistJob* best = nullptr;
+  bool any = false;
+  for (int i = 0; i < PERSIST_MAX_PENDING; i++) {
+    PersistJob& j = _jobs[i];
+    if (j.kind == PJ_NONE) continue;
+    any = true;
+    if (urgentOnly && !j.urgent) continue;
+    if (!best || (int32_t)(j.seq - best->seq) < 0) best = &j;
+  }
+  if (best) {
+    out = *best;
+    best->kind = PJ_NONE;
+    best->buf = nullptr;
+    _stats.pending--;
+  } else if (!any) {
+    _doneSeq.store(_seq);
+  }
+  unlockJobs();
+  return best != nullptr;
+}
+
+static void runTaken(PersistJob& j) {
+  uint32_t waited = millis() - j.queuedMs;
+  if (waited > _stats.maxQueueMs) _stats.maxQueueMs = waited;
+  runJob(j);
+  free(j.buf);
+}
+
+static void persistTask(void*) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    // Zberi zaporedne zahteve (pregrada čakanje prekine); nujni klici
+    // (branje scene, ki jo čaka frame) gredo vmes brez odloga
+    PersistJob j;
+    for (uint32_t t = 0;; t += 10) {
+      while (_urgentReq.exchange(false))
+        while (takeOldest(j, true)) runTaken(j);
+      if (t >= PERSIST_COALESCE_MS || _flushReq.load()) break;
+      xSemaphoreTake(_urgentSem, pdMS_TO_TICKS(10));
+    }
+
+    while (takeOldest(j)) runTaken(j);
+    xSemaphoreGive(_doneSem);
+  }
+}
+
+bool persistStartTask(uint8_t core, uint8_t priority) {
+  persistBegin();
+  if (_task) return true;
+  if (xTaskCreatePinnedToCore(persistTask, "PERSIST", HAS_PSRAM ? 6144 : 4096, nullptr,
+                              priority, &_task, core) != pdPASS) {
+    _task = nullptr;
+    Serial.println("[PST] NAPAKA: persist task ni ustvarjen — pišem sinhrono");
+    return false;
+  }
+  Serial.printf("[PST] Persist task na core %d\n", core);
+  return true;
+}
+
+bool persistFlush(uint32_t timeoutMs) {
+  if (!_task) return true;
+  lockJobs();
+  uint32_t target = _seq;
+  unlockJobs();
+  if ((int32_t)(_doneSeq.load() - target) >= 0) return true;
+
+  _flushReq.store(true);
+  xTaskNotifyGive(_task);
+  uint32_t waited = 0;
+  while ((int32_t)(_doneSeq.load() - target) < 0 && waited < timeoutMs) {
+    xSemaphoreTake(_doneSem, pdMS_TO_TICKS(10));
+    waited += 10;
+  }
+  _flushReq.store(false);
+  bool ok = (int32_t)(_doneSeq.load() - target) >= 0;
+  if (!ok) Serial.println("[PST] Pregrada: timeout, zapisi še čakajo");
+  return ok;
+}
+
+bool persistShutdown(uint32_t timeoutMs) {
+  bool ok = persistFlush(timeoutMs);
+  _closed.store(true);
+  // Zahteva, oddana med flush-em in zaprtjem, gre še zraven
+  return persistFlush(timeoutMs) && ok;
+}
+
+void persistGetStats(PersistStats& out) {
+  lockJobs();
+  out = _stats;
+  unlockJobs();
+}
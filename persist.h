@@ -0,0 +1,72 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include "config.h"
+
+// ============================================================================
+//  PERSIST — zapisovanje v LittleFS na ločenem tasku (core 0)
+//
+//  Pisalci ne pišejo na flash sami, ampak oddajo zahtevo:
+//    persistWrite()  — nespremenljiva kopija vsebine datoteke (PSRAM);
+//                      persistWriteOwned() prevzame že pripravljen buffer
+//    persistRemove() — brisanje datoteke
+//    persistCall()   — callback na tasku; ta pod svojim lockom vzame
+//                      posnetek stanja in ga zapiše izven locka;
+//                      persistCallUrgent() se izvede brez odloga (branje
+//                      scene, ki jo čaka frame task)
+//  Zahteve za isto datoteko (isti callback) se združijo: obdrži se zadnja.
+//  Task počaka PERSIST_COALESCE_MS po prvi zahtevi (drsniki, zaporedni
+//  ukazi), nato zapiše vse čakajoče. persistFlush() je pregrada pred
+//  restartom/formatom: vrne se, ko so zapisane vse zahteve do klica;
+//  persistShutdown() zatem zavrača nove, da po formatu nič ne ustvari datotek.
+//
+//  Pred persistStartTask() (setup, host benchi) se zahteve izvedejo takoj
+//  na klicočem tasku — vedenje je enako, samo brez odloga.
+// ============================================================================
+
+#define PERSIST_MAX_PENDING   16      // Različne datoteke/callbacki v čakanju
+#define PERSIST_COALESCE_MS   250
+#define PERSIST_MAX_PATH      32
+#define PERSIST_MAX_SEGS      6
+
+typedef void (*PersistFn)(void* ctx);
+
+// Del vsebine datoteke (glava + strukture brez sestavljanja v buffer)
+struct PersistSeg {
+  const void* data;
+  size_t      len;
+};
+
+struct PersistStats {
+  uint32_t requests;
+  uint32_t coalesced;         // Zahteve, ki so nadomestile še nezapisano
+  uint32_t writes;            // Izvedene operacije (zapis, brisanje, callback)
+  uint32_t bytes;             // Zapisani bajti kopij
+  uint32_t failed;
+  uint32_t overflow;          // Poln seznam → izvedeno takoj na klicočem tasku
+  uint32_t dropped;           // Po persistShutdown()
+  uint32_t pending;
+  uint32_t lastWriteUs;
+  uint32_t maxWriteUs;
+  uint32_t maxQueueMs;        // Najdaljši čas od zahteve do zapisa
+};
+
+void persistBegin();
+bool persistStartTask(uint8_t core = 0, uint8_t priority = 1);
+bool persistIsAsync();
+
+bool persistWriteV(const char* path, const PersistSeg* segs, int count);
+inline bool persistWrite(const char* path, const void* data, size_t len) {
+  PersistSeg s = { data, len };
+  return persistWriteV(path, &s, 1);
+}
+bool persistWriteOwned(const char* path, uint8_t* buf, size_t len);   // buf iz psramPreferMalloc, prevzame ga
+bool persistRemove(const char* path);
+bool persistCall(PersistFn fn, void* ctx);
+bool persistCallUrgent(PersistFn fn, void* ctx);
+
+bool persistFlush(uint32_t timeoutMs = 5000);   // false = timeout
+bool persistShutdown(uint32_t timeoutMs = 5000);  // Flush, nato nove zahteve zavrže (restart, format)
+void persistGetStats(PersistStats& out);
+
+#endif
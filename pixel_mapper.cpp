@@ -4,6 +4,7 @@
 
 #include <Adafruit_NeoPixel.h>
 #include <LittleFS.h>
+#include "persist.h"
 
 // Cast helper (strip stored as void* to avoid header dependency in .h)
 #define STRIP ((Adafruit_NeoPixel*)_strip)
@@ -81,39 +82,34 @@ void PixelMapper::modeFixture(const uint8_t* dmxOut, FixtureEngine* fixtures) {
   int ledsPerFx = _cfg.ledCount / targetCount;
   if (ledsPerFx < 1) ledsPerFx = 1;
 
+  const PatchMap* m = fixtures->getPatchMap();
+  if (!m) return;
+
   for (int t = 0; t < targetCount; t++) {
-    const PatchEntry* fx = fixtures->getFixture(targets[t]);
-    if (!fx || !fx->active) continue;
+    if (targets[t] < 0 || targets[t] >= MAX_FIXTURES) continue;
+    const PatchSpan& sp = m->fixtureSpan[targets[t]];
+    if (sp.count == 0) continue;
 
-    // Extract RGB from DMX output
+    // Extract RGB + first dimmer from DMX output (via patch map)
     uint8_t r = 0, g = 0, b = 0;
-    uint8_t chCount = fixtures->fixtureChannelCount(targets[t]);
-    for (int c = 0; c < chCount; c++) {
-      const ChannelDef* cd = fixtures->fixtureChannel(targets[t], c);
-      if (!cd) continue;
-      uint16_t addr = fx->dmxAddress + c - 1;
-      if (addr >= DMX_MAX_CHANNELS) continue;
+    int dimAddr = -1;
+    for (uint16_t addr = sp.start; addr < sp.start + sp.count; addr++) {
+      if (m->addr[addr].fixture != targets[t]) continue;
       uint8_t val = dmxOut[addr];
-      switch (cd->type) {
+      switch (m->addr[addr].type) {
         case CH_COLOR_R: r = val; break;
         case CH_COLOR_G: g = val; break;
         case CH_COLOR_B: b = val; break;
+        case CH_INTENSITY: if (dimAddr < 0) dimAddr = addr; break;
       }
     }
 
     // Apply dimmer if present
-    for (int c = 0; c < chCount; c++) {
-      const ChannelDef* cd = fixtures->fixtureChannel(targets[t], c);
-      if (cd && cd->type == CH_INTENSITY) {
-        uint16_t addr = fx->dmxAddress + c - 1;
-        if (addr < DMX_MAX_CHANNELS) {
-          uint8_t dim = dmxOut[addr];
-          r = (uint16_t)r * dim / 255;
-          g = (uint16_t)g * dim / 255;
-          b = (uint16_t)b * dim / 255;
-        }
-        break;
-      }
+    if (dimAddr >= 0) {
+      uint8_t dim = dmxOut[dimAddr];
+      r = (uint16_t)r * dim / 255;
+      g = (uint16_t)g * dim / 255;
+      b = (uint16_t)b * dim / 255;
     }
 
     uint32_t color = STRIP->Color(r, g, b);
@@ -195,12 +191,9 @@ void PixelMapper::modePulse(SoundEngine* sound, float dt) {
 
 // ── Persistence ──
 void PixelMapper::saveConfig() {
-  File f = LittleFS.open("/pixmap.bin", "w");
-  if (!f) return;
-  uint8_t ver = 1;
-  f.write(&ver, 1);
-  f.write((uint8_t*)&_cfg, sizeof(PixelMapConfig));
-  f.close();
+  static const uint8_t ver = 1;
+  PersistSeg segs[2] = { { &ver, 1 }, { &_cfg, sizeof(PixelMapConfig) } };
+  if (!persistWriteV("/pixmap.bin", segs, 2)) return;
   Serial.println("[PIX] Konfiguracija shranjena");
 }
 
@@ -0,0 +1,350 @@
+#include "playback_engine.h"
+#include "scene_engine.h"
+#include "mixer_engine.h"
+#include "config_store.h"
+#include "value16.h"
+#include "persist.h"
+#include <LittleFS.h>
+
+#define PB_SAVE_DEBOUNCE_MS  3000   // Shrani 3s po zadnjem premiku faderja
+#define PB_SAVE_MAX_WAIT_MS  10000  // Najdlje čakaj 10s
+
+void PlaybackEngine::begin(FixtureEngine* fixtures, SceneEngine* scenes, MixerEngine* mixer) {
+  _fixtures = fixtures;
+  _scenes = scenes;
+  _mixer = mixer;
+  for (int i = 0; i < MAX_PLAYBACKS; i++) {
+    PbEntry* e = _pb[i].entries;
+    _pb[i] = {};
+    _pb[i].entries = e;
+    _pb[i].sceneSlot = -1;
+    _order[i] = i;
+  }
+  _seq = 0;
+  load();
+}
+
+// ============================================================================
+//  KRMILJENJE
+// ============================================================================
+
+bool PlaybackEngine::assign(int pb, int sceneSlot) {
+  if (pb < 0 || pb >= MAX_PLAYBACKS) return false;
+  if (sceneSlot >= MAX_SCENES) return false;
+  Playback& p = _pb[pb];
+  if (sceneSlot >= 0 && !p.entries) {
+    p.entries = (PbEntry*)psramPreferMalloc(DMX_MAX_CHANNELS * sizeof(PbEntry));
+    if (!p.entries) {
+      Serial.printf("[PB] NAPAKA: ni pomnilnika za playback %d\n", pb + 1);
+      return false;
+    }
+  }
+  p.sceneSlot = (int16_t)sceneSlot;
+  p.entryCount = 0;
+  p.stale = sceneSlot >= 0;
+  p.loading = false;
+  p.on = true;
+  p.env16 = 65536;
+  p.fadeUs = 0;
+  if (sceneSlot >= 0 && p.level) touch(p);           // Dvignjen fader prevzame LTP takoj
+  markDirty();
+  return true;
+}
+
+void PlaybackEngine::setLevel(int pb, uint8_t level) {
+  if (pb < 0 || pb >= MAX_PLAYBACKS) return;
+  Playback& p = _pb[pb];
+  if (level == p.level) return;
+  bool rising = p.level == 0;
+  p.level = level;
+  if (rising) touch(p);                              // Fader iz ničle = nova aktivacija
+  markDirty();
+}
+
+// Ovojnica od trenutne vrednosti do cilja; 0 ms = takoj
+static void startEnvelope(Playback& p, bool on, uint32_t fadeMs) {
+  p.on = on;
+  p.envFrom16 = p.env16;
+  p.fadeElapsedUs = 0;
+  p.fadeUs = fadeMs * 1000;
+  if (!p.fadeUs) p.env16 = on ? 65536 : 0;
+}
+
+void PlaybackEngine::go(int pb, uint32_t fadeMs) {
+  if (pb < 0 || pb >= MAX_PLAYBACKS || _pb[pb].sceneSlot < 0) return;
+  startEnvelope(_pb[pb], true, fadeMs);
+  touch(_pb[pb]);
+}
+
+void PlaybackEngine::release(int pb, uint32_t fadeMs) {
+  if (pb < 0 || pb >= MAX_PLAYBACKS) return;
+  startEnvelope(_pb[pb], false, fadeMs);
+}
+
+void PlaybackEngine::setFlash(int pb, bool on) {
+  if (pb < 0 || pb >= MAX_PLAYBACKS || _pb[pb].sceneSlot < 0) return;
+  if (on && !_pb[pb].flash) touch(_pb[pb]);
+  _pb[pb].flash = on;
+}
+
+void PlaybackEngine::releaseAll(uint32_t fadeMs) {
+  for (int i = 0; i < MAX_PLAYBACKS; i++) {
+    _pb[i].flash = false;
+    if (_pb[i].sceneSlot >= 0) startEnvelope(_pb[i], false, fadeMs);
+  }
+}
+
+void PlaybackEngine::touch(Playback& p) {
+  p.ltpSeq = ++_seq;
+  sortOrder();
+}
+
+// Insertion sort po ltpSeq — MAX_PLAYBACKS elementov, kliče se ob aktivaciji
+void PlaybackEngine::sortOrder() {
+  for (int i = 1; i < MAX_PLAYBACKS; i++) {
+    uint8_t k = _order[i];
+    int j = i - 1;
+    while (j >= 0 && (int32_t)(_pb[_order[j]].ltpSeq - _pb[k].ltpSeq) > 0) {
+      _order[j + 1] = _order[j];
+      j--;
+    }
+    _order[j + 1] = k;
+  }
+}
+
+uint32_t PlaybackEngine::level16(const Playback& p) const {
+  if (p.sceneSlot < 0) return 0;
+  if (p.flash) return 65536;
+  uint32_t lv = p.level * 257 + (p.level >> 7);      // 0..65536
+  return (uint32_t)(((uint64_t)lv * p.env16) >> 16);
+}
+
+uint8_t PlaybackEngine::outputLevel(int pb) const {
+  if (pb < 0 || pb >= MAX_PLAYBACKS) return 0;
+  return (uint8_t)((level16(_pb[pb]) * 255 + 32768) >> 16);
+}
+
+int PlaybackEngine::activeCount() const {
+  int n = 0;
+  for (int i = 0; i < MAX_PLAYBACKS; i++) {
+    if (level16(_pb[i])) n++;
+  }
+  return n;
+}
+
+bool PlaybackEngine::isActive() const {
+  for (int i = 0; i < MAX_PLAYBACKS; i++) {
+    const Playback& p = _pb[i];
+    if (p.sceneSlot >= 0 && (p.fadeUs || level16(p))) return true;
+  }
+  return false;
+}
+
+// ============================================================================
+//  SEZNAM KANALOV
+//  Kanali, ki jih scena določa (prevedeni skozi patch — fixture je v sceni,
+//  če je imel ob shranjevanju vsaj en kanal ≠ 0; takrat so njegovi LTP
+//  kanali playbackovi, tudi ničle — npr. pan 0). HTP kanal je v seznamu
+//  samo z vrednostjo > 0, ker ničla pri HTP ničesar ne prispeva.
+//  Nepatchani naslovi: HTP po bitu CH_GENERIC.
+// ============================================================================
+
+void PlaybackEngine::build(Playback& p) {
+  const Scene* sc = _scenes ? _scenes->getScene(p.sceneSlot) : nullptr;
+  if (!sc && _scenes && _scenes->sceneExists(p.sceneSlot)) {
+    // Bere se na persist tasku: do prevzema v cache velja stari seznam
+    uint32_t now = millis();
+    if (!p.loading) { p.loading = true; p.loadSinceMs = now; }
+    p.stale = now - p.loadSinceMs <= SCENE_LOAD_TIMEOUT_MS;
+    if (p.stale) return;
+  }
+  p.loading = false;
+  p.stale = false;
+  p.entryCount = 0;
+  if (!sc || !p.entries) return;
+
+  const uint8_t* v = sc->dmx;
+  const PatchMap* m = _fixtures ? _fixtures->getPatchMap() : nullptr;
+  uint32_t htpMask = _builtHtpMask;
+  uint8_t genericMode = (htpMask & (1UL << CH_GENERIC)) ? PB_HTP : PB_LTP;
+  PbEntry* e = p.entries;
+  uint16_t n = 0;
+
+  for (int w = 0; w < DMX_MAX_CHANNELS / 32; w++) {
+    for (uint32_t bits = sc->defined[w]; bits; bits &= bits - 1) {
+      int a = w * 32 + __builtin_ctz(bits);
+      if (!m || m->addr[a].fixture < 0) {
+        if (genericMode == PB_HTP && !v[a]) continue;
+        e[n++] = { (uint16_t)a, v[a], genericMode };
+        continue;
+      }
+      const PatchAddr& pa = m->addr[a];
+      uint8_t mode = (htpMask & (1UL << pa.type)) ? PB_HTP : PB_LTP;
+      if (pa.partner != PATCH_NONE) {
+        if (pa.fine) continue;                       // Fine gre skupaj s coarse
+        if (mode == PB_HTP && !v[a] && !v[pa.partner]) continue;
+        if (n + 2 > DMX_MAX_CHANNELS) break;
+        e[n++] = { (uint16_t)a, v[a], (uint8_t)(mode | PB_PAIR) };
+        e[n++] = { pa.partner, v[pa.partner], (uint8_t)(mode | PB_PAIR) };
+        continue;
+      }
+      if (mode == PB_HTP && !v[a]) continue;
+      if (n >= DMX_MAX_CHANNELS) break;
+      e[n++] = { (uint16_t)a, v[a], mode };
+    }
+  }
+  p.entryCount = n;
+}
+
+// ============================================================================
+//  FRAME
+// ============================================================================
+
+void PlaybackEngine::prepare(float dt) {
+  uint32_t dtUs = dt > 0.f ? (uint32_t)(dt * 1e6f + 0.5f) : 0;
+  for (int i = 0; i < MAX_PLAYBACKS; i++) {
+    Playback& p = _pb[i];
+    if (!p.fadeUs) continue;
+    p.fadeElapsedUs += dtUs;
+    int32_t target = p.on ? 65536 : 0;
+    if (p.fadeElapsedUs >= p.fadeUs) {
+      p.env16 = target;
+      p.fadeUs = 0;
+    } else {
+      int64_t d = (int64_t)(target - (int32_t)p.envFrom16) * p.fadeElapsedUs / p.fadeUs;
+      p.env16 = (uint32_t)((int32_t)p.envFrom16 + (int32_t)d);
+    }
+  }
+
+  // Patch, scene ali HTP maska spremenjeni → vsi seznami na novo
+  uint32_t patchGen = _fixtures ? _fixtures->getPatchGeneration() : 0;
+  uint32_t sceneGen = _scenes ? _scenes->getGeneration() : 0;
+  uint32_t htpMask  = _mixer ? _mixer->getHtpMask() : MERGE_HTP_DEFAULT;
+  bool all = patchGen != _builtPatchGen || sceneGen != _builtSceneGen || htpMask != _builtHtpMask;
+  _builtPatchGen = patchGen;
+  _builtSceneGen = sceneGen;
+  _builtHtpMask = htpMask;
+  for (int i = 0; i < MAX_PLAYBACKS; i++) {
+    Playback& p = _pb[i];
+    if (p.sceneSlot >= 0 && (all || p.stale)) build(p);
+  }
+}
+
+// HTP: max(izhod, vrednost × nivo). LTP: izhod → vrednost za nivo,
+// playbacki po vrsti aktivacije (zadnji zmaga pri polnem nivoju).
+void PlaybackEngine::apply(const uint8_t* in, uint8_t* out) {
+  (void)in;
+  for (int k = 0; k < MAX_PLAYBACKS; k++) {
+    const Playback& p = _pb[_order[k]];
+    uint32_t l = level16(p);
+    if (!l || !p.entryCount) continue;
+
+    const PbEntry* e = p.entries;
+    const PbEntry* end = e + p.entryCount;
+    while (e < end) {
+      if (e->mode & PB_PAIR) {
+        uint16_t c = e->addr, f = e[1].addr;
+        uint16_t v = ((uint16_t)e->value << 8) | e[1].value;
+        uint16_t o = get16(out, c, f);
+        if (e->mode & PB_HTP) {
+          uint16_t x = (uint16_t)(((uint64_t)v * l) >> 16);
+          if (x > o) put16(out, c, f, x);
+        } else {
+          put16(out, c, f, lerp16(o, v, l));
+        }
+        e += 2;
+        continue;
+      }
+      uint8_t o = out[e->addr];
+      if (e->mode & PB_HTP) {
+        uint8_t x = (uint8_t)((e->value * l) >> 16);
+        if (x > o) out[e->addr] = x;
+      } else {
+        out[e->addr] = (uint8_t)(o + ((((int32_t)e->value - o) * (int32_t)l) >> 16));
+      }
+      e++;
+    }
+  }
+}
+
+// ============================================================================
+//  SHRANJEVANJE — dodelitev scen in faderji ({"pb":[{"s":slot,"l":nivo}]})
+// ============================================================================
+
+bool PlaybackEngine::load() {
+  File f = LittleFS.open(PATH_PLAYBACKS, "r");
+  if (!f) return false;
+  JsonDocument doc;
+  if (deserializeJson(doc, f)) { f.close(); return false; }
+  f.close();
+
+  int i = 0;
+  for (JsonObject o : doc["pb"].as<JsonArray>()) {
+    if (i >= MAX_PLAYBACKS) break;
+    Playback& p = _pb[i++];
+    int slot = o["s"] | -1;
+    if (slot < 0 || slot >= MAX_SCENES) continue;
+    if (!p.entries) p.entries = (PbEntry*)psramPreferMalloc(DMX_MAX_CHANNELS * sizeof(PbEntry));
+    if (!p.entries) continue;
+    p.sceneSlot = (int16_t)slot;
+    p.level = o["l"] | 0;
+    p.on = true;
+    p.env16 = 65536;
+    p.stale = true;
+  }
+  Serial.printf("[PB] Naloženih %d playbackov\n", i);
+  return true;
+}
+
+void PlaybackEngine::markDirty() {
+  if (!_dirty) {
+    _dirty = true;
+    _dirtyMs = millis();
+  }
+}
+
+void PlaybackEngine::checkAutoSave() {
+  if (!_mixer) return;
+  uint32_t now = millis();
+  _mixer->lock();
+  bool due = _dirty && (now - _dirtyMs >= PB_SAVE_DEBOUNCE_MS ||
+                        (_lastSaveMs > 0 && now - _lastSaveMs > PB_SAVE_MAX_WAIT_MS));
+  if (due) {
+    _dirty = false;
+    _lastSaveMs = now;
+  }
+  _mixer->unlock();
+  if (due) persistCall(persistThunk, this);
+}
+
+void PlaybackEngine::saveNow() {
+  if (_mixer) _mixer->lock();
+  bool dirty = _dirty;
+  _dirty = false;
+  _lastSaveMs = millis();
+  if (_mixer) _mixer->unlock();
+  if (dirty) persistCall(persistThunk, this);
+}
+
+// Persist task: posnetek pod mixer lockom, JSON in zapis brez njega
+void PlaybackEngine::persistThunk(void* ctx) { ((PlaybackEngine*)ctx)->persistPlaybacks(); }
+
+void PlaybackEngine::persistPlaybacks() {
+  int16_t slot[MAX_PLAYBACKS];
+  uint8_t level[MAX_PLAYBACKS];
+  if (_mixer) _mixer->lock();
+  for (int i = 0; i < MAX_PLAYBACKS; i++) {
+    slot[i] = _pb[i].sceneSlot;
+    level[i] = _pb[i].level;
+  }
+  if (_mixer) _mixer->unlock();
+
+  JsonDocument doc;
+  JsonArray arr = doc["pb"].to<JsonArray>();
+  for (int i = 0; i < MAX_PLAYBACKS; i++) {
+    JsonObject o = arr.add<JsonObject>();
+    o["s"] = slot[i];
+    o["l"] = level[i];
+  }
+  if (!jsonPersist(PATH_PLAYBACKS, doc)) Serial.println("[PB] NAPAKA: playbacki niso shranjeni");
+}
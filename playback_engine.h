@@ -0,0 +1,104 @@
+#ifndef PLAYBACK_ENGINE_H
+#define PLAYBACK_ENGINE_H
+
+#include "config.h"
+#include "fixture_engine.h"
+#include "output_stage.h"
+
+class SceneEngine;
+class MixerEngine;
+
+// ============================================================================
+//  PlaybackEngine — neodvisni playbacki / submasterji nad ročnimi vrednostmi
+//
+//  Vsak playback ima svojo sceno, fader (nivo), fade ovojnico (GO/release)
+//  in flash. Vsi aktivni se vsak frame spojijo v lokalni vir: intenziteta
+//  (maska HTP mixerja) HTP, ostali kanali LTP — zadnji aktivirani zmaga.
+//  Ob dodelitvi scene ali spremembi patcha/scene se zgradi redek seznam
+//  kanalov, ki jih playback ima (HTP z vrednostjo > 0, LTP kanali fixture-ov,
+//  ki v sceni sodelujejo); frame se dotakne samo teh.
+//  Ovojnica teče v realnem času (brez master speed).
+// ============================================================================
+
+#define PB_LTP   0x00
+#define PB_HTP   0x01
+#define PB_PAIR  0x02            // Coarse 16-bit para; naslednji vnos je fine
+
+struct PbEntry {
+  uint16_t addr;
+  uint8_t  value;
+  uint8_t  mode;                 // PB_*
+};
+
+struct Playback {
+  int16_t  sceneSlot;            // -1 = prazen
+  uint8_t  level;                // Fader 0-255
+  bool     on;                   // GO (ovojnica proti 1) / release (proti 0)
+  bool     flash;                // Drži: poln nivo, brez ovojnice
+  uint32_t env16;                // Ovojnica 0..65536
+  uint32_t envFrom16;
+  uint32_t fadeUs;               // Trajanje trenutnega fade-a ovojnice
+  uint32_t fadeElapsedUs;
+  uint32_t ltpSeq;               // Zadnja aktivacija (LTP vrstni red)
+  PbEntry* entries;              // PSRAM, do DMX_MAX_CHANNELS
+  uint16_t entryCount;
+  bool     stale;                // Seznam je treba zgraditi (scena/patch/HTP maska)
+  bool     loading;              // Scena se bere s flash-a: stari seznam ostane
+  uint32_t loadSinceMs;
+};
+
+class PlaybackEngine : public OutputStage {
+public:
+  void begin(FixtureEngine* fixtures, SceneEngine* scenes, MixerEngine* mixer);
+
+  // OutputStage
+  const char* name() const override { return "playback"; }
+  uint32_t channelTypes() const override { return STAGE_TYPES_ALL; }
+  bool isActive() const override;
+  bool realTime() const override { return true; }
+  void prepare(float dt) override;
+  void apply(const uint8_t* in, uint8_t* out) override;
+
+  // Krmiljenje (pod mixer lockom)
+  bool assign(int pb, int sceneSlot);              // -1 = izprazni
+  void setLevel(int pb, uint8_t level);
+  void go(int pb, uint32_t fadeMs);                // Ovojnica 0 → 1
+  void release(int pb, uint32_t fadeMs);           // Ovojnica → 0
+  void setFlash(int pb, bool on);
+  void releaseAll(uint32_t fadeMs);
+
+  const Playback* get(int pb) const { return (pb >= 0 && pb < MAX_PLAYBACKS) ? &_pb[pb] : nullptr; }
+  uint8_t outputLevel(int pb) const;               // Nivo × ovojnica (flash = 255)
+  int  activeCount() const;
+
+  bool load();
+  // Dodelitve in faderji se shranijo z zamikom (kot stanje mixerja): ukaz
+  // samo označi spremembo, posnetek in JSON naredi persist task
+  void checkAutoSave();                            // Frame task, enkrat na frame
+  void saveNow();                                  // Pred restartom (nato persistFlush)
+
+private:
+  FixtureEngine* _fixtures = nullptr;
+  SceneEngine*   _scenes = nullptr;
+  MixerEngine*   _mixer = nullptr;
+  Playback _pb[MAX_PLAYBACKS] = {};
+  uint8_t  _order[MAX_PLAYBACKS];                  // Po ltpSeq (naraščajoče)
+  uint32_t _seq = 0;
+  uint32_t _builtPatchGen = 0;
+  uint32_t _builtSceneGen = 0;
+  uint32_t _builtHtpMask = 0;
+  bool     _dirty = false;                         // Pod mixer lockom
+  uint32_t _dirtyMs = 0;
+  uint32_t _lastSaveMs = 0;
+
+  void markDirty();
+  static void persistThunk(void* ctx);
+  void persistPlaybacks();                         // Persist task
+
+  void build(Playback& p);
+  void touch(Playback& p);
+  void sortOrder();
+  uint32_t level16(const Playback& p) const;
+};
+
+#endif
@@ -101,6 +101,13 @@ void SacnOutput::_buildHeader() {
 }
 
 void SacnOutput::sendFrame(const uint8_t* data, uint16_t channels) {
+  sendFrame(data, channels, _universe);
+}
+
+// Isti paket za vse univerze: zamenja se samo polje univerze in multicast
+// naslov. Sekvenca je skupna — za vsako univerzo monotono narašča, kar
+// sprejemniki (E1.31 6.7.2) sprejmejo.
+void SacnOutput::sendFrame(const uint8_t* data, uint16_t channels, uint16_t universe) {
   if (!_begun) return;
   if (channels > 512) channels = 512;
 
@@ -136,8 +143,12 @@ void SacnOutput::sendFrame(const uint8_t* data, uint16_t channels) {
   // Copy DMX data (after start code at byte 125)
   memcpy(_packet + 126, data, channels);
 
+  // Universe (framing layer)
+  _packet[113] = (universe >> 8) & 0xFF;
+  _packet[114] = universe & 0xFF;
+
   // Multicast address: 239.255.UHI.ULO
-  IPAddress multicast(239, 255, (_universe >> 8) & 0xFF, _universe & 0xFF);
+  IPAddress multicast(239, 255, (universe >> 8) & 0xFF, universe & 0xFF);
 
   _udp.beginPacket(multicast, SACN_PORT);
   _udp.write(_packet, 126 + channels);
@@ -9,6 +9,7 @@ class SacnOutput {
 public:
   void begin(uint16_t universe);
   void sendFrame(const uint8_t* data, uint16_t channels);
+  void sendFrame(const uint8_t* data, uint16_t channels, uint16_t universe);  // Dodatna univerza
   void setUniverse(uint16_t universe);
 
 private:
@@ -0,0 +1,915 @@
+#include "scene_bank.h"
+#include "snapshot_history.h"
+#include "persist.h"
+#include "crc16.h"
+#include "fixture_engine.h"
+#include <LittleFS.h>
+
+#define SCENE_BANK_INDEX   PATH_SCENES_DIR "/bank.idx"
+#define SCENE_LEGACY_BYTES (MAX_SCENE_NAME_LEN + DMX_MAX_CHANNELS)
+
+static_assert(SCENE_CACHE_LINES < 0xFF, "Vrstica cache-a mora v uint8_t");
+static_assert(SCENE_DATA_MAX <= SCENE_BANK_FLUSH_BYTES, "Scena mora v buffer zapisa");
+static_assert(SNAP_RLE_MAX <= SCENE_DATA_MAX, "Branje stare banke gre v isti buffer");
+
+static void bankFlushCb(void* ctx) { ((SceneBank*)ctx)->flush(); }
+static void bankLoadCb(void* ctx)  { ((SceneBank*)ctx)->loadRequested(); }
+
+// ============================================================================
+//  ZAPIS SCENE
+// ============================================================================
+
+size_t sceneEncode(const uint8_t* dmx, uint8_t flags, const FixtureEngine* fx, uint8_t* out,
+                   const uint32_t* mask) {
+  size_t n = 0;
+  auto put = [&](uint8_t b) { if (out) out[n] = b; n++; };
+  auto want = [&](int a) { return mask ? (mask[a >> 5] & (1UL << (a & 31))) != 0 : dmx[a] != 0; };
+  put(flags);
+  const PatchMap* m = fx ? fx->getPatchMap() : nullptr;
+
+  for (int s = 0; m && s < m->spanCount; s++) {
+    const PatchSpan& sp = m->spans[s];
+    int cc = sp.count < MAX_CHANNELS_PER_FX ? sp.count : MAX_CHANNELS_PER_FX;
+    uint8_t chType[MAX_CHANNELS_PER_FX];
+    uint32_t types = 0;                                      // Tipi kanalov, ki gredo v sceno
+    for (int c = 0; c < cc; c++) {
+      const ChannelDef* ch = fx->fixtureChannel(sp.fixture, c);
+      chType[c] = (ch && ch->type < CH_TYPE_COUNT) ? (uint8_t)ch->type : (uint8_t)CH_GENERIC;
+      if (want(sp.start + c)) types |= mask ? (1UL << chType[c]) : 0xFFFFFFFFUL;
+    }
+    if (!types) continue;
+    int k = 0;
+    for (int c = 0; c < cc; c++) if (types & (1UL << chType[c])) k++;
+    put(sp.fixture);
+    put((uint8_t)k);
+    for (int c = 0; c < cc; c++) {
+      if (!(types & (1UL << chType[c]))) continue;
+      put(chType[c]);
+      put(dmx[sp.start + c]);
+    }
+  }
+
+  // Nepatchani naslovi: zaporedja vrednosti ≠ 0 (z masko: maskirani naslovi)
+  int a = 0;
+  while (a < DMX_MAX_CHANNELS) {
+    if ((m && m->addr[a].fixture >= 0) || !want(a)) { a++; continue; }
+    int start = a;
+    while (a < DMX_MAX_CHANNELS && a - start < 255 && !(m && m->addr[a].fixture >= 0) && want(a)) a++;
+    put(SCENE_REC_RAW);
+    put(start & 0xFF);
+    put(start >> 8);
+    put((uint8_t)(a - start));
+    for (int i = start; i < a; i++) put(dmx[i]);
+  }
+  return n;
+}
+
+static inline void sceneDefine(Scene& out, int a, uint8_t v) {
+  uint32_t bit = 1UL << (a & 31);
+  if (!(out.defined[a >> 5] & bit)) out.definedCount++;
+  out.defined[a >> 5] |= bit;
+  out.dmx[a] = v;
+}
+
+bool sceneCompile(const uint8_t* in, size_t len, const FixtureEngine* fx, Scene& out) {
+  memset(out.dmx, 0, DMX_MAX_CHANNELS);
+  memset(out.defined, 0, sizeof(out.defined));
+  out.definedCount = 0;
+  out.valid = false;
+  if (len < 1) return false;
+  out.flags = in[0];
+  const PatchMap* m = fx ? fx->getPatchMap() : nullptr;
+
+  size_t p = 1;
+  while (p < len) {
+    uint8_t id = in[p++];
+    if (id == SCENE_REC_RAW) {
+      if (p + 3 > len) return false;
+      uint16_t start = (uint16_t)(in[p] | (in[p + 1] << 8));
+      uint8_t k = in[p + 2];
+      p += 3;
+      if (p + k > len || start + k > DMX_MAX_CHANNELS) return false;
+      for (int i = 0; i < k; i++) {
+        int a = start + i;
+        if (!m || m->addr[a].fixture < 0) sceneDefine(out, a, in[p + i]);   // Medtem patchan naslov pripada fixture-u
+      }
+      p += k;
+      continue;
+    }
+
+    if (p + 1 > len) return false;
+    uint8_t k = in[p++];
+    if (p + 2 * (size_t)k > len) return false;
+    const uint8_t* rec = in + p;
+    p += 2 * (size_t)k;
+    if (!m || id >= MAX_FIXTURES || !m->fixtureSpan[id].count) continue;    // Fixture ni (več) patchan
+
+    // k-ti zapis tipa t → k-ti kanal tipa t v trenutnem profilu fixture-a
+    const PatchSpan& sp = m->fixtureSpan[id];
+    uint8_t chType[MAX_CHANNELS_PER_FX], chNth[MAX_CHANNELS_PER_FX];
+    uint8_t seen[CH_TYPE_COUNT] = {};
+    int cc = sp.count < MAX_CHANNELS_PER_FX ? sp.count : MAX_CHANNELS_PER_FX;
+    for (int c = 0; c < cc; c++) {
+      const ChannelDef* ch = fx->fixtureChannel(id, c);
+      chType[c] = ch ? (uint8_t)ch->type : (uint8_t)CH_GENERIC;
+      chNth[c] = chType[c] < CH_TYPE_COUNT ? seen[chType[c]]++ : 0;
+    }
+    memset(seen, 0, sizeof(seen));
+    for (int r = 0; r < k; r++) {
+      uint8_t t = rec[2 * r];
+      if (t >= CH_TYPE_COUNT) continue;
+      uint8_t nth = seen[t]++;
+      for (int c = 0; c < cc; c++) {
+        if (chType[c] != t || chNth[c] != nth) continue;
+        sceneDefine(out, sp.start + c, rec[2 * r + 1]);
+        break;
+      }
+    }
+  }
+  out.valid = true;
+  return true;
+}
+
+void sceneApply(const Scene& sc, uint8_t* dmx) {
+  if (sc.flags & SCENE_FULL) {
+    memcpy(dmx, sc.dmx, DMX_MAX_CHANNELS);
+    return;
+  }
+  for (int w = 0; w < DMX_MAX_CHANNELS / 32; w++) {
+    for (uint32_t bits = sc.defined[w]; bits; bits &= bits - 1) {
+      int a = w * 32 + __builtin_ctz(bits);
+      dmx[a] = sc.dmx[a];
+    }
+  }
+}
+
+// ============================================================================
+//  BANKA
+// ============================================================================
+
+void SceneBank::dataPath(uint8_t file, char* out, size_t n) {
+  snprintf(out, n, "%s/bank%u.dat", PATH_SCENES_DIR, (unsigned)(file & 1));
+}
+
+bool SceneBank::begin() {
+  if (!_mtx) _mtx = xSemaphoreCreateMutex();
+  if (!_idx) {
+    _idx   = (SceneBankEntry*)psramPreferMalloc(sizeof(SceneBankEntry) * MAX_SCENES);
+    _pend  = (Pending*)psramPreferMalloc(sizeof(Pending) * MAX_SCENES);
+    _where = (uint8_t*)psramPreferMalloc(MAX_SCENES);
+    _jobs  = (FlushJob*)psramPreferMalloc(sizeof(FlushJob) * MAX_SCENES);
+    _cache = (CacheLine*)psramPreferMalloc(sizeof(CacheLine) * SCENE_CACHE_LINES);
+    _stage = (StageLine*)psramPreferMalloc(sizeof(StageLine) * SCENE_STAGE_LINES);
+    _rd    = (uint8_t*)psramPreferMalloc(SCENE_DATA_MAX);
+    if (!_idx || !_pend || !_where || !_jobs || !_cache || !_stage || !_rd) {
+      Serial.println("[SCN] NAPAKA: ne morem alocirati banke scen!");
+      free(_idx); free(_pend); free(_where); free(_jobs); free(_cache); free(_stage); free(_rd);
+      _idx = nullptr; _pend = nullptr; _where = nullptr; _jobs = nullptr; _cache = nullptr;
+      _stage = nullptr; _rd = nullptr;
+      return false;
+    }
+    memset(_pend, 0, sizeof(Pending) * MAX_SCENES);
+  }
+  for (int i = 0; i < MAX_SCENES; i++) {
+    free(_pend[i].buf);
+    _pend[i] = {};
+  }
+  memset(_idx, 0, sizeof(SceneBankEntry) * MAX_SCENES);
+  memset(_where, 0xFF, MAX_SCENES);
+  for (int i = 0; i < SCENE_CACHE_LINES; i++) _cache[i].slot = -1;
+  for (int i = 0; i < SCENE_STAGE_LINES; i++) { _stage[i].slot = -1; _stage[i].state = STAGE_FREE; }
+  memset(_want, 0, sizeof(_want));
+  _tick = 0; _seq = 0;
+  _file = 0; _dataBytes = 0; _liveBytes = 0;
+  _indexDirty = false;
+  _rle = false;
+  _stats = {};
+
+  if (!LittleFS.exists(PATH_SCENES_DIR)) LittleFS.mkdir(PATH_SCENES_DIR);
+  bool rle = false;
+  if (!loadIndex(rle)) migrateLegacy();
+  else if (rle) migrateRle();
+
+  Serial.printf("[SCN] Banka: %d scen, %u B podatkov (%u B živih), cache %d scen\n",
+                count(), (unsigned)_dataBytes, (unsigned)_liveBytes, SCENE_CACHE_LINES);
+  return true;
+}
+
+// ============================================================================
+//  INDEKS
+//  Glava: "SCI2" [slotov:2][datoteka:1][0][konec podatkov:4][CRC vnosov:2][0:2]
+//  Vnosi, ki kažejo čez konec podatkov (prekinjen zapis), se zavržejo.
+//  "SCI1" (rle = true): ista glava, vsebine so RLE slike.
+// ============================================================================
+
+bool SceneBank::loadIndex(bool& rle) {
+  File f = LittleFS.open(SCENE_BANK_INDEX, "r");
+  if (!f) return false;
+  uint8_t hdr[SCENE_BANK_HDR_BYTES];
+  bool ok = f.read(hdr, sizeof(hdr)) == sizeof(hdr);
+  rle = ok && memcmp(hdr, SCENE_BANK_MAGIC_RLE, 4) == 0;
+  if (!ok || (!rle && memcmp(hdr, SCENE_BANK_MAGIC, 4) != 0)) {
+    f.close();
+    Serial.println("[SCN] Indeks banke poškodovan");
+    return false;
+  }
+  uint16_t slots, crc;
+  uint32_t end;
+  memcpy(&slots, hdr + 4, 2);
+  memcpy(&end, hdr + 8, 4);
+  memcpy(&crc, hdr + 12, 2);
+
+  // Indeks z več sloti (druga plošča): odvečni se preberejo samo za CRC
+  int keep = slots < MAX_SCENES ? slots : MAX_SCENES;
+  size_t bytes = sizeof(SceneBankEntry) * keep;
+  ok = f.read((uint8_t*)_idx, bytes) == bytes;
+  uint16_t c = crc16((const uint8_t*)_idx, bytes);
+  for (int i = keep; ok && i < slots; i++) {
+    SceneBankEntry e;
+    ok = f.read((uint8_t*)&e, sizeof(e)) == sizeof(e);
+    c = crc16((const uint8_t*)&e, sizeof(e), c);
+  }
+  f.close();
+  if (!ok || c != crc) {
+    memset(_idx, 0, sizeof(SceneBankEntry) * MAX_SCENES);
+    Serial.println("[SCN] Indeks banke poškodovan");
+    return false;
+  }
+  if (slots > MAX_SCENES) Serial.printf("[SCN] Banka ima %u slotov, uporabljenih %d\n", slots, MAX_SCENES);
+
+  _file = hdr[6] & 1;
+  char path[32];
+  dataPath(_file, path, sizeof(path));
+  File d = LittleFS.open(path, "r");
+  _dataBytes = d ? (uint32_t)d.size() : 0;
+  if (d) d.close();
+  if (end > _dataBytes) end = _dataBytes;
+
+  int dropped = 0;
+  for (int i = 0; i < keep; i++) {
+    SceneBankEntry& e = _idx[i];
+    e.name[MAX_SCENE_NAME_LEN - 1] = '\0';
+    if (!e.len) continue;
+    if (e.len > (rle ? SNAP_RLE_MAX : SCENE_DATA_MAX) || e.off < 4 || e.off + e.len > end) {
+      memset(&e, 0, sizeof(e));
+      dropped++;
+      continue;
+    }
+    _liveBytes += e.len;
+  }
+  if (dropped) Serial.printf("[SCN] %d scen zunaj podatkov banke zavrženih\n", dropped);
+  return true;
+}
+
+bool SceneBank::writeIndex() {
+  size_t entries = sizeof(SceneBankEntry) * MAX_SCENES;
+  uint8_t* buf = (uint8_t*)psramPreferMalloc(SCENE_BANK_HDR_BYTES + entries);
+  if (!buf) {
+    lock(); _stats.failed++; unlock();
+    return false;
+  }
+  lock();
+  memcpy(buf + SCENE_BANK_HDR_BYTES, _idx, entries);
+  _indexDirty = false;
+  uint8_t file = _file;
+  uint32_t end = _dataBytes;
+  unlock();
+
+  uint16_t slots = MAX_SCENES;
+  uint16_t crc = crc16(buf + SCENE_BANK_HDR_BYTES, entries);
+  memset(buf, 0, SCENE_BANK_HDR_BYTES);
+  memcpy(buf, SCENE_BANK_MAGIC, 4);
+  memcpy(buf + 4, &slots, 2);
+  buf[6] = file;
+  memcpy(buf + 8, &end, 4);
+  memcpy(buf + 12, &crc, 2);
+
+  // Nov indeks ob strani, nato rename (stari ostane cel ob izpadu)
+  const char* tmp = SCENE_BANK_INDEX ".tmp";
+  File f = LittleFS.open(tmp, "w");
+  bool ok = f && f.write(buf, SCENE_BANK_HDR_BYTES + entries) == SCENE_BANK_HDR_BYTES + entries;
+  if (f) f.close();
+  ok = ok && LittleFS.rename(tmp, SCENE_BANK_INDEX);
+  free(buf);
+  if (!ok) {
+    lock(); _indexDirty = true; _stats.failed++; unlock();
+    Serial.println("[SCN] NAPAKA: zapis indeksa banke");
+  }
+  return ok;
+}
+
+// Prvi zagon z banko: /scenes/NN.bin → banka, nato stare datoteke stran
+void SceneBank::migrateLegacy() {
+  File dir = LittleFS.open(PATH_SCENES_DIR);
+  if (!dir || !dir.isDirectory()) return;
+  uint8_t* raw = (uint8_t*)psramPreferMalloc(SCENE_LEGACY_BYTES);
+  if (!raw) return;
+  int moved = 0;
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+    const char* nm = strrchr(f.name(), '/');
+    nm = nm ? nm + 1 : f.name();
+    char* endp;
+    long slot = strtol(nm, &endp, 10);
+    bool legacy = endp != nm && strcmp(endp, ".bin") == 0 && slot >= 0 && slot < MAX_SCENES;
+    if (legacy && f.read(raw, SCENE_LEGACY_BYTES) == SCENE_LEGACY_BYTES) {
+      char name[MAX_SCENE_NAME_LEN];
+      memcpy(name, raw, MAX_SCENE_NAME_LEN);
+      name[MAX_SCENE_NAME_LEN - 1] = '\0';
+      if (stage((int)slot, name, raw + MAX_SCENE_NAME_LEN, SCENE_FULL)) moved++;
+    }
+    f.close();
+  }
+  dir.close();
+  free(raw);
+  if (!moved) return;
+
+  flush();
+  if (_indexDirty || !LittleFS.exists(SCENE_BANK_INDEX)) return;   // Stare ostanejo do naslednjič
+  char path[32];
+  for (int i = 0; i < MAX_SCENES; i++) {
+    if (!_idx[i].len) continue;
+    snprintf(path, sizeof(path), "%s/%02d.bin", PATH_SCENES_DIR, i);
+    LittleFS.remove(path);
+  }
+  Serial.printf("[SCN] %d scen preseljenih v banko\n", moved);
+}
+
+// Banka "SCI1": RLE slike → zapisi po fixture-ih (cele scene), nov indeks.
+// Do zapisa novega indeksa stari kaže na stare vsebine (dodajanje jih ne
+// prepiše). SCI2 indeks se zapiše šele, ko so zapisani vsi prevedeni sloti —
+// do takrat ima čakajoč slot v _idx še RLE vnos (glej flush()).
+void SceneBank::migrateRle() {
+  uint8_t* dmx = (uint8_t*)psramPreferMalloc(DMX_MAX_CHANNELS);
+  if (!dmx) return;
+  _rle = true;
+  char path[32];
+  dataPath(_file, path, sizeof(path));
+  File f = LittleFS.open(path, "r");
+  int moved = 0, lost = 0;
+  for (int s = 0; s < MAX_SCENES; s++) {
+    SceneBankEntry& e = _idx[s];
+    if (!e.len) continue;
+    memset(dmx, 0, DMX_MAX_CHANNELS);
+    bool ok = f && f.seek(e.off) && f.read(_rd, e.len) == e.len && crc16(_rd, e.len) == e.crc &&
+              snapRleXor(_rd, e.len, dmx);
+    if (ok) ok = stage(s, e.name, dmx, SCENE_FULL);
+    if (ok) { moved++; continue; }
+    _liveBytes -= e.len;                                      // RLE vnos v novem indeksu ne sme ostati
+    memset(&e, 0, sizeof(e));
+    lost++;
+  }
+  if (f) f.close();
+  free(dmx);
+  flush();                                                    // Indeks se zapiše šele po uspešnem dodajanju
+  if (_rle) {
+    Serial.printf("[SCN] Banka SCI1 → SCI2 nedokončana: %d scen čaka na zapis\n", moved);
+    return;                                                   // Na flash-u ostane SCI1, ob zagonu znova
+  }
+  Serial.printf("[SCN] Banka SCI1 → SCI2: %d scen prevedenih po fixture-ih, %d izgubljenih\n", moved, lost);
+}
+
+// ============================================================================
+//  VSEBINA
+// ============================================================================
+
+uint32_t SceneBank::patchGen() const {
+  return _fx ? _fx->getPatchGeneration() : 0;
+}
+
+void SceneBank::setFixtureEngine(const FixtureEngine* fx) {
+  lock();
+  _fx = fx;
+  for (int s = 0; _where && s < MAX_SCENES; s++) dropCached(s);   // Prevedeno brez patcha
+  unlock();
+}
+
+bool SceneBank::stage(int slot, const char* name, const uint8_t* dmx, uint8_t flags, const uint32_t* mask) {
+  if (slot < 0 || slot >= MAX_SCENES || !_idx) return false;
+  size_t len = sceneEncode(dmx, flags, _fx, nullptr, mask);
+  uint8_t* buf = (uint8_t*)psramPreferMalloc(MAX_SCENE_NAME_LEN + len);
+  if (!buf) return false;
+  memset(buf, 0, MAX_SCENE_NAME_LEN);
+  strlcpy((char*)buf, name ? name : "", MAX_SCENE_NAME_LEN);
+  sceneEncode(dmx, flags, _fx, buf + MAX_SCENE_NAME_LEN, mask);
+
+  lock();
+  Pending& p = _pend[slot];
+  free(p.buf);
+  p.buf = buf;
+  p.len = (uint16_t)len;
+  p.crc = crc16(buf + MAX_SCENE_NAME_LEN, len);
+  p.seq = ++_seq;
+  dropCached(slot);                                // Frame prevede čakajoč zapis ob naslednjem get()
+  unlock();
+  return true;
+}
+
+bool SceneBank::store(int slot, const char* name, const uint8_t* dmx, uint8_t flags,
+                      const uint32_t* mask) {
+  if (!stage(slot, name, dmx, flags, mask)) return false;
+  persistCall(bankFlushCb, this);
+  return true;
+}
+
+bool SceneBank::remove(int slot) {
+  if (slot < 0 || slot >= MAX_SCENES || !_idx) return false;
+  lock();
+  Pending& p = _pend[slot];
+  free(p.buf);
+  p = {};
+  SceneBankEntry& e = _idx[slot];
+  bool committed = e.len != 0;
+  if (committed) {
+    _liveBytes -= e.len;
+    memset(&e, 0, sizeof(e));
+    _indexDirty = true;
+  }
+  dropCached(slot);
+  unlock();
+  if (committed) persistCall(bankFlushCb, this);
+  return true;
+}
+
+bool SceneBank::rename(int slot, const char* name) {
+  if (slot < 0 || slot >= MAX_SCENES || !_idx) return false;
+  lock();
+  char* dst = nullptr;
+  bool committed = false;
+  if (_pend[slot].buf) {
+    dst = (char*)_pend[slot].buf;                   // Ime gre v indeks ob zapisu vsebine
+  } else if (_idx[slot].len) {
+    dst = _idx[slot].name;
+    committed = true;
+    _indexDirty = true;
+  }
+  if (dst) {
+    memset(dst, 0, MAX_SCENE_NAME_LEN);
+    strlcpy(dst, name ? name : "", MAX_SCENE_NAME_LEN);
+    uint8_t w = _where[slot];
+    if (w != 0xFF) memcpy(_cache[w].sc.name, dst, MAX_SCENE_NAME_LEN);
+  }
+  unlock();
+  if (committed) persistCall(bankFlushCb, this);
+  return dst != nullptr;
+}
+
+bool SceneBank::exists(int slot) const {
+  if (slot < 0 || slot >= MAX_SCENES || !_idx) return false;
+  return _pend[slot].buf || _idx[slot].len;
+}
+
+bool SceneBank::getName(int slot, char* out) const {
+  if (slot < 0 || slot >= MAX_SCENES || !_idx) return false;
+  lock();
+  bool ok = _pend[slot].buf || _idx[slot].len;
+  if (ok) strlcpy(out, _pend[slot].buf ? (const char*)_pend[slot].buf : _idx[slot].name, MAX_SCENE_NAME_LEN);
+  unlock();
+  return ok;
+}
+
+int SceneBank::count() const {
+  int n = 0;
+  for (int i = 0; i < MAX_SCENES; i++) {
+    if (exists(i)) n++;
+  }
+  return n;
+}
+
+void SceneBank::dropCached(int slot) {
+  _want[slot >> 5] &= ~(1UL << (slot & 31));
+  for (int i = 0; _stage && i < SCENE_STAGE_LINES; i++) {
+    StageLine& st = _stage[i];
+    if (st.slot != slot) continue;
+    st.slot = -1;                                   // LOADING: loader jo zavrže
+    if (st.state == STAGE_READY) st.state = STAGE_FREE;
+  }
+  uint8_t w = _where[slot];
+  if (w == 0xFF) return;
+  _cache[w].slot = -1;
+  _where[slot] = 0xFF;
+}
+
+void SceneBank::noteMiss(SceneMissCtx ctx, uint32_t us) {
+  if (us > _stats.maxMissUs[ctx]) _stats.maxMissUs[ctx] = us;
+}
+
+bool SceneBank::readEntry(uint8_t file, const SceneBankEntry& e, uint8_t* buf) const {
+  char path[32];
+  dataPath(file, path, sizeof(path));
+  File f = LittleFS.open(path, "r");
+  bool ok = f && f.seek(e.off) && f.read(buf, e.len) == e.len;
+  if (f) f.close();
+  return ok && crc16(buf, e.len) == e.crc;
+}
+
+bool SceneBank::compilePending(int slot, Scene& out) {
+  const Pending& p = _pend[slot];
+  memcpy(out.name, p.buf, MAX_SCENE_NAME_LEN);
+  if (sceneCompile(p.buf + MAX_SCENE_NAME_LEN, p.len, _fx, out)) return true;
+  _stats.readErrors++;
+  return false;
+}
+
+// Prosta vrstica ali najdlje neuporabljena (izpraznjena)
+int SceneBank::victim() {
+  int v = 0;
+  for (int i = 0; i < SCENE_CACHE_LINES; i++) {
+    if (_cache[i].slot < 0) { v = i; break; }
+    if (_cache[i].used < _cache[v].used) v = i;
+  }
+  CacheLine& line = _cache[v];
+  if (line.slot >= 0) _where[line.slot] = 0xFF;
+  line.slot = -1;
+  return v;
+}
+
+// Vrstica s sceno, prevedeno skozi trenutni patch; čakajoč zapis se prevede
+// tu (RAM), zapisana scena pride samo z loaderja
+const Scene* SceneBank::cached(int slot) {
+  uint32_t gen = patchGen();
+  uint8_t w = _where[slot];
+  if (w != 0xFF && _cache[w].patchGen == gen) {
+    _cache[w].used = ++_tick;
+    _stats.hits++;
+    return &_cache[w].sc;
+  }
+  if (!_pend[slot].buf) return nullptr;
+  int v = w;
+  if (w != 0xFF) _stats.recompiles++;              // Patch se je spremenil: ista vrstica
+  else v = victim();
+  CacheLine& line = _cache[v];
+  if (!compilePending(slot, line.sc)) {
+    dropCached(slot);
+    return nullptr;
+  }
+  line.slot = (int16_t)slot;
+  line.used = ++_tick;
+  line.patchGen = gen;
+  _where[slot] = (uint8_t)v;
+  return &line.sc;
+}
+
+bool SceneBank::want(int slot) {
+  uint32_t bit = 1UL << (slot & 31);
+  if (_want[slot >> 5] & bit) return false;
+  for (int i = 0; i < SCENE_STAGE_LINES; i++) {
+    const StageLine& st = _stage[i];
+    if (st.slot == slot && st.state != STAGE_FREE) return false;   // Že se bere / čaka na prevzem
+  }
+  _want[slot >> 5] |= bit;
+  return true;
+}
+
+bool SceneBank::wantAny() const {
+  for (int i = 0; i < MAX_SCENES / 32; i++) {
+    if (_want[i]) return true;
+  }
+  return false;
+}
+
+// Prebrane vrstice v cache; vrstica starega patcha ali povožena s store() se
+// zavrže (naslednji get() jo zahteva znova). true = loader čaka na prosto vrstico.
+bool SceneBank::adoptLocked() {
+  uint32_t gen = patchGen();
+  bool freed = false;
+  for (int i = 0; i < SCENE_STAGE_LINES; i++) {
+    StageLine& st = _stage[i];
+    if (st.state != STAGE_READY) continue;
+    int slot = st.slot;
+    st.state = STAGE_FREE;
+    st.slot = -1;
+    freed = true;
+    if (slot < 0 || st.patchGen != gen || _pend[slot].buf) continue;
+    int v = _where[slot];
+    if (v != 0xFF) _stats.recompiles++;
+    else v = victim();
+    CacheLine& line = _cache[v];
+    line.sc = st.sc;
+    line.slot = (int16_t)slot;
+    line.used = ++_tick;
+    line.patchGen = gen;
+    _where[slot] = (uint8_t)v;
+  }
+  return freed && wantAny();
+}
+
+const Scene* SceneBank::get(int slot) {
+  if (slot < 0 || slot >= MAX_SCENES || !_cache) return nullptr;
+  uint32_t t0 = micros();
+  lock();
+  bool more = adoptLocked();
+  const Scene* sc = cached(slot);
+  if (sc || (!_pend[slot].buf && !_idx[slot].len)) {
+    unlock();
+    if (more) persistCallUrgent(bankLoadCb, this);
+    return sc;
+  }
+  // Zgrešitev: branje na persist tasku, frame gre naprej brez scene
+  bool fresh = want(slot);
+  if (fresh) _stats.misses++;
+  unlock();
+  if (fresh || more) persistCallUrgent(bankLoadCb, this);
+
+  lock();
+  more = adoptLocked();                            // Pred persist taskom je branje že opravljeno
+  uint8_t w = _where[slot];
+  if (w != 0xFF && _cache[w].patchGen == patchGen()) {
+    _cache[w].used = ++_tick;
+    sc = &_cache[w].sc;
+  } else {
+    _stats.deferred++;
+  }
+  noteMiss(SCENE_CTX_FRAME, micros() - t0);
+  unlock();
+  if (more) persistCallUrgent(bankLoadCb, this);
+  return sc;
+}
+
+void SceneBank::prefetch(int slot) {
+  if (slot < 0 || slot >= MAX_SCENES || !_cache) return;
+  lock();
+  uint8_t w = _where[slot];
+  bool fresh = !(w != 0xFF && _cache[w].patchGen == patchGen()) && !_pend[slot].buf &&
+               _idx[slot].len && want(slot);
+  unlock();
+  if (fresh) persistCallUrgent(bankLoadCb, this);
+}
+
+void SceneBank::adopt() {
+  if (!_stage) return;
+  lock();
+  bool more = adoptLocked();
+  unlock();
+  if (more) persistCallUrgent(bankLoadCb, this);
+}
+
+// ============================================================================
+//  BRANJE (persist task)
+//  Pod lockom se vzame zahtevan slot, prosta vmesna vrstica in posnetek
+//  vnosa; flash in prevod gresta brez locka. Vrstica je veljavna, če je vmes
+//  ni zavrgel store()/remove() in se patch ni spremenil. Zapis in stiskanje
+//  tečeta na istem tasku, zato posnetek odmika med branjem ostane pravilen.
+// ============================================================================
+
+void SceneBank::loadRequested() {
+  if (!_stage) return;
+  for (;;) {
+    lock();
+    int li = -1, slot = -1;
+    for (int i = 0; i < SCENE_STAGE_LINES && li < 0; i++) {
+      if (_stage[i].state == STAGE_FREE) li = i;
+    }
+    for (int i = 0; li >= 0 && slot < 0 && i < MAX_SCENES / 32; i++) {
+      if (_want[i]) slot = i * 32 + __builtin_ctz(_want[i]);
+    }
+    if (slot < 0) { unlock(); return; }             // Ni zahtev ali ni proste vrstice (adopt() sproži znova)
+    _want[slot >> 5] &= ~(1UL << (slot & 31));
+    const SceneBankEntry e = _idx[slot];
+    if (_pend[slot].buf || !e.len) { unlock(); continue; }   // Čakajoč zapis prevede frame sam
+    StageLine& st = _stage[li];
+    st.slot = (int16_t)slot;
+    st.state = STAGE_LOADING;
+    uint8_t file = _file;
+    uint32_t gen = patchGen();
+    unlock();
+
+    uint32_t t0 = micros();
+    bool ok = readEntry(file, e, _rd);
+    if (ok) {
+      memcpy(st.sc.name, e.name, MAX_SCENE_NAME_LEN);
+      ok = sceneCompile(_rd, e.len, _fx, st.sc);
+    }
+    uint32_t us = micros() - t0;
+
+    lock();
+    _stats.loads++;
+    noteMiss(SCENE_CTX_LOADER, us);
+    if (!ok) {
+      _stats.readErrors++;
+      Serial.printf("[SCN] NAPAKA: branje scene %d iz banke\n", slot);
+    }
+    if (ok && st.slot == slot && gen == patchGen()) {
+      st.patchGen = gen;
+      st.state = STAGE_READY;
+    } else {
+      if (ok && st.slot == slot) want(slot);       // Patch se je vmes spremenil
+      st.slot = -1;
+      st.state = STAGE_FREE;
+    }
+    unlock();
+  }
+}
+
+// Kopija za druge taske: flash brez locka banke, posnetek vnosa pod lockom;
+// stiskanje lahko vmes premakne sceno — takrat še en poskus z novim vnosom
+bool SceneBank::read(int slot, Scene& out) {
+  if (slot < 0 || slot >= MAX_SCENES || !_cache) return false;
+  uint8_t* buf = nullptr;
+  bool ok = false;
+  for (int attempt = 0; attempt < 2 && !ok; attempt++) {
+    lock();
+    uint8_t w = _where[slot];
+    if (w != 0xFF && _cache[w].patchGen == patchGen()) {
+      out = _cache[w].sc;
+      unlock();
+      ok = true;
+      break;
+    }
+    if (_pend[slot].buf) {
+      ok = compilePending(slot, out);
+      unlock();
+      break;
+    }
+    const SceneBankEntry e = _idx[slot];
+    uint8_t file = _file;
+    unlock();
+    if (!e.len) break;
+
+    if (!buf) buf = (uint8_t*)psramPreferMalloc(SCENE_DATA_MAX);
+    if (!buf) break;
+    uint32_t t0 = micros();
+    ok = readEntry(file, e, buf);
+    if (ok) {
+      memcpy(out.name, e.name, MAX_SCENE_NAME_LEN);
+      ok = sceneCompile(buf, e.len, _fx, out);
+    }
+    uint32_t us = micros() - t0;
+
+    lock();
+    noteMiss(SCENE_CTX_READER, us);
+    bool moved = file != _file || memcmp(&e, &_idx[slot], sizeof(e)) != 0;
+    if (!ok && !moved) {
+      _stats.readErrors++;
+      Serial.printf("[SCN] NAPAKA: branje scene %d iz banke\n", slot);
+    }
+    unlock();
+    if (!ok && !moved) break;
+  }
+  free(buf);
+  return ok;
+}
+
+// ============================================================================
+//  ZAPIS (persist task)
+//  Čakajoče vsebine se kopirajo v buffer pod lockom in dodajo na konec
+//  bankN.dat brez locka; indeks se posodobi samo za slote, ki jih vmes ni
+//  nič prepisalo ali izbrisalo (seq). Nato indeks in po potrebi stiskanje.
+// ============================================================================
+
+void SceneBank::flush() {
+  if (!_idx) return;
+  uint8_t* stageBuf = nullptr;
+  for (int pass = 0; pass <= MAX_SCENES; pass++) {
+    lock();
+    if (!stageBuf) stageBuf = (uint8_t*)psramPreferMalloc(SCENE_BANK_FLUSH_BYTES);
+    int n = 0;
+    uint32_t used = 0;
+    for (int s = 0; stageBuf && s < MAX_SCENES; s++) {
+      const Pending& p = _pend[s];
+      if (!p.buf) continue;
+      if (used + p.len > SCENE_BANK_FLUSH_BYTES) break;      // Ostanek v naslednjem krogu
+      memcpy(stageBuf + used, p.buf + MAX_SCENE_NAME_LEN, p.len);
+      _jobs[n++] = { (int16_t)s, p.len, p.crc, p.seq, 0, used };
+      used += p.len;
+    }
+    unlock();
+    if (!n) break;
+
+    char path[32];
+    dataPath(_file, path, sizeof(path));
+    File f = LittleFS.open(path, "a");
+    uint32_t base = f ? (uint32_t)f.size() : 0;
+    bool ok = (bool)f;
+    if (ok && base == 0) {
+      ok = f.write((const uint8_t*)SCENE_DATA_MAGIC, 4) == 4;
+      base = 4;
+    }
+    ok = ok && f.write(stageBuf, used) == used;
+    if (f) f.close();
+
+    lock();
+    _stats.flushes++;
+    if (!ok) {
+      _stats.failed++;
+      unlock();
+      Serial.println("[SCN] NAPAKA: zapis v banko scen");
+      break;                                                  // Ostane v čakanju do naslednjega
+    }
+    for (int j = 0; j < n; j++) {
+      const FlushJob& jb = _jobs[j];
+      Pending& p = _pend[jb.slot];
+      if (!p.buf || p.seq != jb.seq) continue;                // Vmes prepisana/izbrisana
+      SceneBankEntry& e = _idx[jb.slot];
+      _liveBytes -= e.len;
+      memcpy(e.name, p.buf, MAX_SCENE_NAME_LEN);
+      e.off = base + jb.newOff;
+      e.len = jb.len;
+      e.crc = jb.crc;
+      _liveBytes += e.len;
+      free(p.buf);
+      p = {};
+    }
+    _dataBytes = base + used;
+    _indexDirty = true;
+    unlock();
+  }
+  free(stageBuf);
+
+  // Preselitev SCI1: SCI2 indeks samo brez čakajočih slotov (njihov vnos je še RLE)
+  if (_rle) {
+    lock();
+    bool left = false;
+    for (int s = 0; s < MAX_SCENES && !left; s++) left = _pend[s].buf != nullptr;
+    if (!left) { _rle = false; _indexDirty = true; }
+    unlock();
+    if (left) return;
+  }
+  if (_indexDirty && !writeIndex()) return;
+  lock();
+  bool dense = _dataBytes <= SCENE_BANK_COMPACT_MIN || _dataBytes - 4 <= 2 * _liveBytes;
+  unlock();
+  if (!dense) compact();
+}
+
+// Žive vsebine v drugo datoteko, indeks nanjo, stara stran
+bool SceneBank::compact() {
+  lock();
+  int n = 0;
+  for (int s = 0; s < MAX_SCENES; s++) {
+    const SceneBankEntry& e = _idx[s];
+    if (e.len) _jobs[n++] = { (int16_t)s, e.len, e.crc, 0, e.off, 0 };
+  }
+  uint8_t from = _file, to = _file ^ 1;
+  unlock();
+
+  char src[32], dst[32];
+  dataPath(from, src, sizeof(src));
+  dataPath(to, dst, sizeof(dst));
+  uint8_t* buf = (uint8_t*)psramPreferMalloc(SCENE_DATA_MAX);
+  File in = LittleFS.open(src, "r");
+  File out = LittleFS.open(dst, "w");
+  bool ok = buf && in && out && out.write((const uint8_t*)SCENE_DATA_MAGIC, 4) == 4;
+  uint32_t pos = 4;
+  for (int j = 0; ok && j < n; j++) {
+    FlushJob& jb = _jobs[j];
+    if (!in.seek(jb.off) || in.read(buf, jb.len) != jb.len || crc16(buf, jb.len) != jb.crc) {
+      jb.newOff = 0;                                          // Pokvarjena — ne prenese se
+      continue;
+    }
+    ok = out.write(buf, jb.len) == jb.len;
+    jb.newOff = pos;
+    pos += jb.len;
+  }
+  if (in) in.close();
+  if (out) out.close();
+  free(buf);
+  if (!ok) {
+    LittleFS.remove(dst);
+    lock(); _stats.failed++; unlock();
+    Serial.println("[SCN] NAPAKA: stiskanje banke scen");
+    return false;
+  }
+
+  lock();
+  uint32_t before = _dataBytes;
+  for (int j = 0; j < n; j++) {
+    const FlushJob& jb = _jobs[j];
+    SceneBankEntry& e = _idx[jb.slot];
+    if (!e.len || e.off != jb.off) continue;                 // Vmes izbrisana
+    if (jb.newOff) {
+      e.off = jb.newOff;
+    } else {
+      memset(&e, 0, sizeof(e));
+      _stats.readErrors++;
+    }
+  }
+  _liveBytes = 0;
+  for (int s = 0; s < MAX_SCENES; s++) _liveBytes += _idx[s].len;
+  _file = to;
+  _dataBytes = pos;
+  _indexDirty = true;
+  _stats.compactions++;
+  unlock();
+
+  if (!writeIndex()) return false;                            // Stari indeks še kaže na staro datoteko
+  LittleFS.remove(src);
+  Serial.printf("[SCN] Banka stisnjena: %u → %u B\n", (unsigned)before, (unsigned)pos);
+  return true;
+}
+
+void SceneBank::getStats(SceneBankStats& out) const {
+  lock();
+  out = _stats;
+  out.slots = MAX_SCENES;
+  out.cacheLines = SCENE_CACHE_LINES;
+  out.used = out.cached = out.pending = 0;
+  for (int i = 0; _idx && i < MAX_SCENES; i++) {
+    if (_pend[i].buf || _idx[i].len) out.used++;
+    if (_pend[i].buf) out.pending++;
+    if (_where[i] != 0xFF) out.cached++;
+  }
+  out.dataBytes = _dataBytes;
+  out.liveBytes = _liveBytes;
+  out.indexBytes = SCENE_BANK_HDR_BYTES + sizeof(SceneBankEntry) * MAX_SCENES;
+  unlock();
+}
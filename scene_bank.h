@@ -0,0 +1,202 @@
+#ifndef SCENE_BANK_H
+#define SCENE_BANK_H
+
+#include "config.h"
+#include <freertos/semphr.h>
+
+// ============================================================================
+//  SCENE BANK — stotine scen v eni banki, na flash-u stisnjene, v RAM po potrebi
+//
+//  Na flash-u sta dve datoteki v PATH_SCENES_DIR:
+//    bank.idx   — glava + indeks fiksne velikosti (32 B na slot: odmik,
+//                 dolžina, CRC, ime); zagon prebere samo to
+//    bankN.dat  — "SCB1" + vsebine scen (zapis spodaj), nove se samo
+//                 dodajajo na konec
+//  Indeks se prepiše v celoti (tmp + rename), podatki nikoli: vsebina, na
+//  katero kaže zapisan indeks, je ob izpadu vedno cela. Ko mrtvi bajti
+//  (prepisane in izbrisane scene) presežejo žive, se žive prepišejo v drugo
+//  datoteko (bank0 ↔ bank1) in indeks preklopi nanjo.
+//
+//  V RAM je indeks (PSRAM) in LRU cache scen, prevedenih skozi patch. get()
+//  kliče samo frame task oz. WS ukazi pod mixer lockom in nikoli ne bere
+//  flash-a: zadetek vrne vrstico, zgrešitev (ali vrstica starega patcha —
+//  generacija PatchMap-a) odda branje persist tasku in vrne nullptr. Ta
+//  sceno prebere in prevede v vmesno vrstico (SCENE_STAGE_LINES), frame
+//  task jo prevzame v cache z adopt() ali naslednjim get(). Izjema je
+//  čakajoč (še nezapisan) zapis — ta je v RAM in se prevede takoj. Kazalec
+//  velja do naslednjega get()/adopt(). Drugi taski (spletni API) berejo
+//  kopijo z read(), ki cache-a ne spreminja in flash bere brez locka banke.
+//  store()/remove()/rename() takoj veljajo v RAM; zapis opravi persist task.
+//
+//  Stare datoteke /scenes/NN.bin in banka "SCI1" (cela RLE slika) se ob
+//  zagonu preselijo v ta zapis — zato naj bo patch naložen pred begin().
+// ============================================================================
+
+#define SCENE_BANK_MAGIC        "SCI2"
+#define SCENE_BANK_MAGIC_RLE    "SCI1"    // Prejšnja banka: vsebina = RLE 512 B slike
+#define SCENE_DATA_MAGIC        "SCB1"
+#define SCENE_BANK_HDR_BYTES    16
+#define SCENE_BANK_COMPACT_MIN  16384     // Pod to velikostjo podatkov ni stiskanja
+#define SCENE_BANK_FLUSH_BYTES  4096      // Buffer enega dodajanja (več krogov ob uvozu)
+#define SCENE_STAGE_LINES       4         // Prebrane scene, ki čakajo na frame task
+#define SCENE_LOAD_TIMEOUT_MS   2000      // Odložen priklic počaka na branje največ toliko
+
+// ============================================================================
+//  ZAPIS SCENE — redki zapisi, relativni na fixture (ne na naslov)
+//    [flags:1]                                   SCENE_FULL
+//    [fixture:1][n:1] + n × [tip:1][vrednost:1]  kanali fixture-a po vrsti
+//    [0xFF][naslov:2][n:1] + n × [vrednost:1]    nepatchani naslovi
+//  Fixture je v sceni, če ima vsaj en kanal ≠ 0 — takrat so zapisani vsi
+//  njegovi kanali (tudi ničle, npr. pan 0); nepatchani naslovi samo z
+//  vrednostjo. Z masko naslovov (delna scena: kanali, ki jih je operater
+//  nastavil) gredo v sceno natanko maskirani kanali, tudi eksplicitne ničle;
+//  tip, ki se v fixture-u ponovi, se zapiše cel (k-ti zapis ostane k-ti
+//  kanal). k-ti zapis tipa t je k-ti kanal tipa t v profilu, zato
+//  scena preživi premik naslova in drug način (mode) istega profila.
+//  Prevod (sceneCompile) gre skozi PatchMap univerze 0: zapisi fixture-ov,
+//  ki niso več patchani, in nepatchani naslovi, ki jih medtem zaseda
+//  fixture, se izpustijo.
+// ============================================================================
+
+#define SCENE_REC_RAW           0xFF
+#define SCENE_DATA_MAX          (1 + 5 * DMX_MAX_CHANNELS + 2 * MAX_FIXTURES)
+
+class FixtureEngine;
+
+// out nullptr = samo dolžina; mask (bit = naslov, kot Scene::defined) nullptr = kanali ≠ 0
+size_t sceneEncode(const uint8_t* dmx, uint8_t flags, const FixtureEngine* fx, uint8_t* out,
+                   const uint32_t* mask = nullptr);
+bool   sceneCompile(const uint8_t* in, size_t len, const FixtureEngine* fx, Scene& out);
+void   sceneApply(const Scene& sc, uint8_t* dmx);     // Cilj priklica: določeni kanali (SCENE_FULL: vsi)
+
+// Vnos indeksa — enak v RAM in na flash-u (32 B)
+struct SceneBankEntry {
+  uint32_t off;                           // Odmik v bankN.dat
+  uint16_t len;                           // Dolžina zapisa (0 = prazen slot)
+  uint16_t crc;                           // CRC16 zapisa
+  char     name[MAX_SCENE_NAME_LEN];
+};
+static_assert(sizeof(SceneBankEntry) == 32, "Vnos indeksa je 32 B");
+
+// Kje se je plačala zgrešitev (SceneBankStats::maxMissUs)
+enum SceneMissCtx : uint8_t {
+  SCENE_CTX_FRAME = 0,        // get(): samo zahteva (ali prevod čakajočega zapisa)
+  SCENE_CTX_LOADER,           // Persist task: branje s flash-a + prevod
+  SCENE_CTX_READER,           // read() z drugih taskov
+  SCENE_CTX_COUNT
+};
+
+struct SceneBankStats {
+  uint16_t slots;
+  uint16_t used;
+  uint16_t cacheLines;
+  uint16_t cached;
+  uint16_t pending;           // Shranjene, še ne zapisane
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t readErrors;        // Slab CRC ali kratko branje
+  uint32_t dataBytes;         // Velikost aktivne bankN.dat
+  uint32_t liveBytes;         // Od tega vsebina zapisanih scen
+  uint32_t indexBytes;
+  uint32_t flushes;
+  uint32_t compactions;
+  uint32_t failed;
+  uint32_t maxMissUs[SCENE_CTX_COUNT];  // Najdaljša zgrešitev po kontekstu
+  uint32_t recompiles;        // Vrstice, prevedene znova po spremembi patcha
+  uint32_t loads;             // Branja s flash-a na persist tasku
+  uint32_t deferred;          // get() brez scene: čaka na branje
+};
+
+class SceneBank {
+public:
+  bool begin();                               // Naloži indeks (ali preseli stare scene)
+  void setFixtureEngine(const FixtureEngine* fx);
+
+  bool store(int slot, const char* name, const uint8_t* dmx, uint8_t flags = SCENE_FULL,
+             const uint32_t* mask = nullptr);
+  bool remove(int slot);
+  bool rename(int slot, const char* name);
+  bool exists(int slot) const;
+  bool getName(int slot, char* out) const;    // out: MAX_SCENE_NAME_LEN
+  int  count() const;
+
+  const Scene* get(int slot);                 // Frame task / pod mixer lockom; nullptr = ni ali se bere
+  bool read(int slot, Scene& out);            // Kopija s katerega koli taska
+  void prefetch(int slot);                    // Branje v ozadju, brez čakanja
+  void adopt();                               // Frame task: prebrane scene v cache
+  void loadRequested();                       // Persist task: prebere zahtevane scene
+
+  void flush();                               // Persist task: zapiše čakajoče, po potrebi stisne
+  void getStats(SceneBankStats& out) const;
+
+private:
+  struct Pending {
+    uint8_t* buf;                             // [ime 24B][zapis]
+    uint16_t len;                             // Dolžina zapisa
+    uint16_t crc;
+    uint32_t seq;                             // Loči zapis od kasnejšega v isti slot
+  };
+  struct CacheLine {
+    int16_t  slot;                            // -1 = prosta
+    uint32_t used;
+    uint32_t patchGen;                        // Generacija patcha ob prevodu
+    Scene    sc;
+  };
+  enum : uint8_t { STAGE_FREE = 0, STAGE_LOADING, STAGE_READY };
+  struct StageLine {
+    int16_t  slot;                            // -1 = zavržena (remove/store med branjem)
+    uint8_t  state;
+    uint32_t patchGen;
+    Scene    sc;
+  };
+  struct FlushJob {
+    int16_t  slot;
+    uint16_t len;
+    uint16_t crc;
+    uint32_t seq;
+    uint32_t off;                             // Stari odmik (stiskanje)
+    uint32_t newOff;                          // Odmik v bufferju / novi datoteki
+  };
+
+  SemaphoreHandle_t _mtx = nullptr;
+  SceneBankEntry* _idx = nullptr;
+  Pending*   _pend = nullptr;
+  CacheLine* _cache = nullptr;
+  uint8_t*   _where = nullptr;                // Slot → vrstica cache-a (0xFF = ni)
+  FlushJob*  _jobs = nullptr;
+  StageLine* _stage = nullptr;
+  uint32_t   _want[MAX_SCENES / 32] = {};     // Sloti, ki čakajo na branje
+  uint8_t*   _rd = nullptr;                   // Branje zapisa na persist tasku (loader, preselitev)
+  const FixtureEngine* _fx = nullptr;
+  uint32_t   _tick = 0;
+  uint32_t   _seq = 0;
+  uint8_t    _file = 0;                       // Aktivna bankN.dat
+  uint32_t   _dataBytes = 0;
+  uint32_t   _liveBytes = 0;
+  bool       _indexDirty = false;
+  bool       _rle = false;                    // Preselitev SCI1: v _idx so še RLE vnosi čakajočih slotov
+  SceneBankStats _stats = {};
+
+  void lock() const   { if (_mtx) xSemaphoreTake(_mtx, portMAX_DELAY); }
+  void unlock() const { if (_mtx) xSemaphoreGive(_mtx); }
+
+  static void dataPath(uint8_t file, char* out, size_t n);
+  uint32_t patchGen() const;
+  bool stage(int slot, const char* name, const uint8_t* dmx, uint8_t flags, const uint32_t* mask = nullptr);
+  bool loadIndex(bool& rle);
+  void migrateLegacy();
+  void migrateRle();
+  bool writeIndex();
+  bool compact();
+  bool readEntry(uint8_t file, const SceneBankEntry& e, uint8_t* buf) const;   // Brez locka
+  bool compilePending(int slot, Scene& out);  // Pod lockom: čakajoč zapis (RAM)
+  const Scene* cached(int slot);              // Pod lockom: brez branja s flash-a
+  int  victim();
+  bool want(int slot);                        // Pod lockom: true = nova zahteva
+  bool wantAny() const;
+  bool adoptLocked();
+  void dropCached(int slot);                  // Tudi zavrže branje v teku
+  void noteMiss(SceneMissCtx ctx, uint32_t us);
+};
+
+#endif
@@ -1,161 +1,209 @@
 #include "scene_engine.h"
 #include "mixer_engine.h"
+#include "value16.h"
+#include "fade_curve.h"
+#include "config_store.h"
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 
 void SceneEngine::begin() {
-  // Alociraj scene v PSRAM (~10.7 KB)
-  if (!_scenes) {
-    _scenes = (Scene*)psramPreferMalloc(sizeof(Scene) * MAX_SCENES);
-    if (!_scenes) { Serial.println("[SCN] NAPAKA: ne morem alocirati _scenes!"); return; }
-  }
-  memset(_scenes, 0, sizeof(Scene) * MAX_SCENES);
+  XfadeEntry* entries = _cf.entries;
   memset(&_cf, 0, sizeof(_cf));
+  _cf.entries = entries ? entries : (XfadeEntry*)psramPreferMalloc(sizeof(XfadeEntry) * DMX_MAX_CHANNELS);
+  if (!_cf.entries) Serial.println("[SCN] NAPAKA: ne morem alocirati crossfade seznama!");
+  fadeCurvesBegin();
   memset(_cues, 0, sizeof(_cues));
   _cueCount = 0; _cueCurrent = -1; _cueRunning = false;
+  _cueSched.disarm();
 
-  // Ustvari mapo za scene
-  if (!LittleFS.exists(PATH_SCENES_DIR)) {
-    LittleFS.mkdir(PATH_SCENES_DIR);
-  }
-
-  // Naloži vse obstoječe scene
-  int loaded = 0;
-  for (int i = 0; i < MAX_SCENES; i++) {
-    if (loadSlot(i)) loaded++;
-  }
-  Serial.printf("[SCN] Naloženih %d scen\n", loaded);
+  // Zagon prebere samo indeks banke; vsebine ob prvi uporabi
+  _bank.begin();
+  _generation++;
   loadCueList();
 }
 
 // ============================================================================
-//  DATOTEČNE OPERACIJE (binarni format)
-//  Format: [24B ime][512B DMX] = 536B
+//  SCENE CRUD
 // ============================================================================
 
-String SceneEngine::slotPath(int slot) const {
-  char buf[32];
-  snprintf(buf, sizeof(buf), "%s/%02d.bin", PATH_SCENES_DIR, slot);
-  return String(buf);
-}
-
-bool SceneEngine::loadSlot(int slot) {
+bool SceneEngine::saveScene(int slot, const char* name, const uint8_t* dmxData, bool partial,
+                            const uint32_t* mask) {
   if (slot < 0 || slot >= MAX_SCENES) return false;
 
-  File f = LittleFS.open(slotPath(slot), "r");
-  if (!f) { _scenes[slot].valid = false; return false; }
-
-  size_t expected = MAX_SCENE_NAME_LEN + DMX_MAX_CHANNELS;
-  if (f.size() < expected) { f.close(); _scenes[slot].valid = false; return false; }
+  bool ok = _bank.store(slot, name, dmxData, partial ? 0 : SCENE_FULL, partial ? mask : nullptr);
+  if (ok) _generation++;
+  Serial.printf("[SCN] Scena '%s'%s shranjena v slot %d: %s\n",
+                name, partial ? " (delna)" : "", slot, ok ? "OK" : "NAPAKA");
+  return ok;
+}
 
-  f.read((uint8_t*)_scenes[slot].name, MAX_SCENE_NAME_LEN);
-  _scenes[slot].name[MAX_SCENE_NAME_LEN - 1] = '\0';  // Varnostni null
-  f.read(_scenes[slot].dmx, DMX_MAX_CHANNELS);
-  f.close();
+bool SceneEngine::deleteScene(int slot) {
+  if (slot < 0 || slot >= MAX_SCENES) return false;
+  if (!_bank.exists(slot)) return true;
 
-  _scenes[slot].valid = true;
+  _bank.remove(slot);
+  _generation++;
+  Serial.printf("[SCN] Scena slot %d izbrisana\n", slot);
   return true;
 }
 
-bool SceneEngine::saveSlot(int slot) const {
-  if (slot < 0 || slot >= MAX_SCENES) return false;
-
-  File f = LittleFS.open(slotPath(slot), "w");
-  if (!f) return false;
+bool SceneEngine::renameScene(int slot, const char* name) {
+  return _bank.rename(slot, name);
+}
 
-  f.write((const uint8_t*)_scenes[slot].name, MAX_SCENE_NAME_LEN);
-  f.write(_scenes[slot].dmx, DMX_MAX_CHANNELS);
-  f.close();
-  return true;
+int SceneEngine::findFreeSlot() const {
+  for (int i = 0; i < MAX_SCENES; i++) {
+    if (!_bank.exists(i)) return i;
+  }
+  return -1;
 }
 
 // ============================================================================
-//  SCENE CRUD
+//  CROSSFADE
 // ============================================================================
 
-bool SceneEngine::saveScene(int slot, const char* name, const uint8_t* dmxData) {
-  if (slot < 0 || slot >= MAX_SCENES) return false;
-
-  strlcpy(_scenes[slot].name, name, MAX_SCENE_NAME_LEN);
-  memcpy(_scenes[slot].dmx, dmxData, DMX_MAX_CHANNELS);
-  _scenes[slot].valid = true;
-
-  bool ok = saveSlot(slot);
-  Serial.printf("[SCN] Scena '%s' shranjena v slot %d: %s\n",
-                name, slot, ok ? "OK" : "NAPAKA");
-  return ok;
+// Ali je tip kanala "trd" (snap, brez fade-a)?
+// Gobo, Prism, Shutter, Macro, Preset kolesa ne smejo drseti — vmesne vrednosti so grde.
+static const uint32_t SNAP_TYPE_BITS =
+  (1UL << CH_GOBO) | (1UL << CH_SHUTTER) | (1UL << CH_PRISM) |
+  (1UL << CH_MACRO) | (1UL << CH_PRESET);
+
+// Tip kanala → časovna skupina cue-ja (intenziteta še po smeri)
+static uint8_t timingGroup(uint8_t type, bool up) {
+  switch (type) {
+    case CH_INTENSITY:
+      return up ? CUE_TG_INT_UP : CUE_TG_INT_DOWN;
+    case CH_PAN: case CH_PAN_FINE: case CH_TILT: case CH_TILT_FINE:
+      return CUE_TG_POSITION;
+    case CH_COLOR_R: case CH_COLOR_G: case CH_COLOR_B: case CH_COLOR_W: case CH_COLOR_A:
+    case CH_COLOR_UV: case CH_COLOR_L: case CH_COLOR_C: case CH_CCT: case CH_COLOR_WW:
+      return CUE_TG_COLOR;
+    case CH_GOBO: case CH_PRISM: case CH_SHUTTER: case CH_STROBE: case CH_FOCUS: case CH_ZOOM:
+      return CUE_TG_BEAM;
+    default:
+      return CUE_TG_BASE;
+  }
 }
 
-bool SceneEngine::deleteScene(int slot) {
-  if (slot < 0 || slot >= MAX_SCENES) return false;
-
-  _scenes[slot].valid = false;
-  LittleFS.remove(slotPath(slot));
-  Serial.printf("[SCN] Scena slot %d izbrisana\n", slot);
-  return true;
+void SceneEngine::defaultTiming(CueTiming* t) {
+  for (int g = 0; g < CUE_TG_COUNT; g++) t[g] = { CUE_TIME_INHERIT, 0 };
 }
 
-bool SceneEngine::renameScene(int slot, const char* name) {
-  if (slot < 0 || slot >= MAX_SCENES || !_scenes[slot].valid) return false;
-
-  strlcpy(_scenes[slot].name, name, MAX_SCENE_NAME_LEN);
-  return saveSlot(slot);
+static uint32_t groupFadeMs(uint32_t fadeMs, const CueTiming* t, int g) {
+  return (!t || g == CUE_TG_BASE || t[g].fadeMs == CUE_TIME_INHERIT) ? fadeMs : t[g].fadeMs;
 }
 
-int SceneEngine::getSceneCount() const {
-  int count = 0;
-  for (int i = 0; i < MAX_SCENES; i++) {
-    if (_scenes[i].valid) count++;
+uint32_t SceneEngine::timingSpanMs(uint32_t fadeMs, const CueTiming* t) {
+  uint32_t span = fadeMs;
+  for (int g = 0; t && g < CUE_TG_COUNT; g++) {
+    uint32_t end = t[g].delayMs + groupFadeMs(fadeMs, t, g);
+    if (end > span) span = end;
   }
-  return count;
+  return span;
 }
 
-const Scene* SceneEngine::getScene(int slot) const {
-  if (slot < 0 || slot >= MAX_SCENES) return nullptr;
-  return _scenes[slot].valid ? &_scenes[slot] : nullptr;
+// "t": [[fade, zamik], ...] po CueTimingGroup; fade -1 = fadeMs cue-ja
+void SceneEngine::timingFromJson(JsonVariantConst v, CueTiming* t) {
+  defaultTiming(t);
+  JsonArrayConst arr = v.as<JsonArrayConst>();
+  int g = 0;
+  for (JsonArrayConst it : arr) {
+    if (g >= CUE_TG_COUNT) break;
+    int32_t f = it[0] | -1, d = it[1] | 0;
+    t[g].fadeMs = (f < 0) ? CUE_TIME_INHERIT : (uint16_t)(f > CROSSFADE_MAX_MS ? CROSSFADE_MAX_MS : f);
+    t[g].delayMs = (uint16_t)(d < 0 ? 0 : d > CUE_DELAY_MAX_MS ? CUE_DELAY_MAX_MS : d);
+    g++;
+  }
 }
 
-int SceneEngine::findFreeSlot() const {
-  for (int i = 0; i < MAX_SCENES; i++) {
-    if (!_scenes[i].valid) return i;
+bool SceneEngine::timingToJson(JsonObject o, const char* key, const CueTiming* t) {
+  bool custom = false;
+  for (int g = 0; g < CUE_TG_COUNT; g++) custom |= t[g].delayMs || (g != CUE_TG_BASE && t[g].fadeMs != CUE_TIME_INHERIT);
+  if (!custom) return false;
+  JsonArray arr = o[key].to<JsonArray>();
+  for (int g = 0; g < CUE_TG_COUNT; g++) {
+    JsonArray it = arr.add<JsonArray>();
+    it.add(t[g].fadeMs == CUE_TIME_INHERIT ? -1 : (int32_t)t[g].fadeMs);
+    it.add(t[g].delayMs);
   }
-  return -1;
+  return true;
 }
 
-// ============================================================================
-//  CROSSFADE
-// ============================================================================
-
+// Načrt cue-ja: seznam samo spremenjenih kanalov; način (snap, 16-bit par)
+// in časovna skupina se določita tu iz PatchMap-a, ne v vsakem frame-u.
+// Klicoč zagotovi, da outDmx v updateCrossfade() ob začetku vsebuje fromDmx
+// (nespremenjeni kanali ostanejo).
 void SceneEngine::startCrossfade(const uint8_t* fromDmx, const uint8_t* toDmx,
-                                 uint32_t durationMs, int targetSceneIdx) {
-  if (durationMs == 0) {
+                                 uint32_t durationMs, int targetSceneIdx, uint8_t curve,
+                                 const CueTiming* timing) {
+  uint32_t spanMs = timingSpanMs(durationMs, timing);
+  if (spanMs == 0 || !_cf.entries) {
     // Takojšen — ni crossfade-a
     _cf.active = false;
     return;
   }
+  for (int g = 0; g < CUE_TG_COUNT; g++) {
+    _cf.groupDelayUs[g] = timing ? timing[g].delayMs * 1000UL : 0;
+    _cf.groupFadeUs[g] = groupFadeMs(durationMs, timing, g) * 1000UL;
+  }
+
+  const PatchMap* m = _fixtures ? _fixtures->getPatchMap() : nullptr;
+  XfadeEntry* e = _cf.entries;
+  uint16_t n = 0;
+  uint32_t done[DMX_MAX_CHANNELS / 32] = {};       // Naslovi, ki jih pokrije 16-bit par
+
+  // 16-bit pari: coarse+fine kot ena vrednost (sicer fine drsi neodvisno
+  // in počasen pan/tilt fade stopnjuje po coarse korakih)
+  if (m) {
+    for (int p = 0; p < m->pairCount; p++) {
+      const PatchPair& pp = m->pairs[p];
+      if (SNAP_TYPE_BITS & (1UL << pp.type)) continue;
+      if (done[pp.coarse >> 5] & (1UL << (pp.coarse & 31))) continue;
+      if (fromDmx[pp.coarse] == toDmx[pp.coarse] && fromDmx[pp.fine] == toDmx[pp.fine]) continue;
+      bool up = get16(toDmx, pp.coarse, pp.fine) >= get16(fromDmx, pp.coarse, pp.fine);
+      uint16_t g = (uint16_t)timingGroup(pp.type, up) << XF_GROUP_SHIFT;
+      e[n++] = { (uint16_t)(pp.coarse | XF_PAIR16 | g), fromDmx[pp.coarse], toDmx[pp.coarse] };
+      e[n++] = { (uint16_t)(pp.fine | XF_PAIR16 | g), fromDmx[pp.fine], toDmx[pp.fine] };
+      done[pp.coarse >> 5] |= 1UL << (pp.coarse & 31);
+      done[pp.fine >> 5] |= 1UL << (pp.fine & 31);
+    }
+  }
+
+  // Snap kanal: naslov, ki ga kot snap kanal uporablja katerikoli fixture
+  for (int i = 0; i < DMX_MAX_CHANNELS; i++) {
+    if (fromDmx[i] == toDmx[i] || (done[i >> 5] & (1UL << (i & 31)))) continue;
+    bool snap = m && (m->addr[i].typeBits & SNAP_TYPE_BITS);
+    uint8_t type = (m && m->addr[i].fixture >= 0) ? m->addr[i].type : (uint8_t)CH_GENERIC;
+    uint16_t g = (uint16_t)timingGroup(type, toDmx[i] > fromDmx[i]) << XF_GROUP_SHIFT;
+    e[n++] = { (uint16_t)(i | (snap ? XF_SNAP : XF_LINEAR) | g), fromDmx[i], toDmx[i] };
+  }
 
-  memcpy(_cf.fromDmx, fromDmx, DMX_MAX_CHANNELS);
-  memcpy(_cf.toDmx, toDmx, DMX_MAX_CHANNELS);
-  _cf.durationMs = durationMs;
-  _cf.startTime = millis();
+  _cf.entryCount = n;
+  _cf.durationMs = spanMs;
+  _cf.elapsedUs = 0;
+  _cf.curve = curve < FADE_CURVE_COUNT ? curve : (uint8_t)FADE_LINEAR;
   _cf.targetSceneIdx = targetSceneIdx;
   _cf.active = true;
 
-  Serial.printf("[SCN] Crossfade začet: %dms → scena %d\n", durationMs, targetSceneIdx);
+  Serial.printf("[SCN] Crossfade začet: %dms%s %s → scena %d (%u kanalov)\n",
+                spanMs, timing ? " (split)" : "", fadeCurveName(_cf.curve), targetSceneIdx, n);
 }
 
-void SceneEngine::startCrossfadeToScene(int slot, const uint8_t* currentDmx, uint32_t durationMs) {
+void SceneEngine::startCrossfadeToScene(int slot, const uint8_t* currentDmx, uint32_t durationMs, uint8_t curve) {
   const Scene* sc = getScene(slot);
   if (!sc) return;
 
   if (durationMs == 0) {
     // Takojšen recall — brez animacije
     _cf.active = false;
-    // Klicoč bo sam kopiral sc->dmx v mixer
+    // Klicoč bo sam zapisal sceno v mixer (sceneApply)
     return;
   }
 
-  startCrossfade(currentDmx, sc->dmx, durationMs, slot);
+  uint8_t to[DMX_MAX_CHANNELS];
+  memcpy(to, currentDmx, DMX_MAX_CHANNELS);
+  sceneApply(*sc, to);
+  startCrossfade(currentDmx, to, durationMs, slot, curve);
 }
 
 void SceneEngine::cancelCrossfade() {
@@ -164,67 +212,60 @@ void SceneEngine::cancelCrossfade() {
 
 float SceneEngine::getCrossfadeProgress() const {
   if (!_cf.active) return 1.0f;
-  uint32_t elapsed = millis() - _cf.startTime;
-  if (elapsed >= _cf.durationMs) return 1.0f;
-  return (float)elapsed / (float)_cf.durationMs;
-}
-
-// Ali je tip kanala "trd" (snap, brez fade-a)?
-// Gobo, Prism, Shutter, Macro, Preset kolesa ne smejo drseti — vmesne vrednosti so grde.
-static bool isSnapChannel(uint8_t type) {
-  return type == CH_GOBO || type == CH_SHUTTER || type == CH_PRISM ||
-         type == CH_MACRO || type == CH_PRESET;
+  uint64_t durUs = (uint64_t)_cf.durationMs * 1000;
+  if (_cf.elapsedUs >= durUs) return 1.0f;
+  return (float)_cf.elapsedUs / (float)durUs;
 }
 
-bool SceneEngine::updateCrossfade(uint8_t* outDmx) {
+bool SceneEngine::updateCrossfade(uint8_t* outDmx, uint32_t dtUs) {
   if (!_cf.active) return false;
 
-  uint32_t elapsed = millis() - _cf.startTime;
+  _cf.elapsedUs += dtUs;
+  uint64_t durUs = (uint64_t)_cf.durationMs * 1000;
 
-  if (elapsed >= _cf.durationMs) {
-    // Crossfade končan — kopiraj cilj
-    memcpy(outDmx, _cf.toDmx, DMX_MAX_CHANNELS);
+  if (_cf.elapsedUs >= durUs) {
+    // Crossfade končan — cilj samo na kanalih seznama (delna scena ostalih ne povozi)
+    for (uint16_t k = 0; k < _cf.entryCount; k++) {
+      const XfadeEntry& x = _cf.entries[k];
+      outDmx[x.addrMode & XF_ADDR_MASK] = x.to;
+    }
     _cf.active = false;
     Serial.printf("[SCN] Crossfade končan (scena %d)\n", _cf.targetSceneIdx);
     return true;  // Zadnjič vrni true, da klicoč ve, da je končal
   }
 
-  // Linearna interpolacija
-  // out = from + (to - from) × progress
-  // Uporabimo fiksno-vejično za hitrost: progress = elapsed × 256 / duration
-  uint32_t alpha = (elapsed * 256) / _cf.durationMs;  // 0-256
-  if (alpha > 256) alpha = 256;
-
-  // Zgradi snap masko: kateri DMX naslovi so "trdi" kanali (gobo/prism/shutter)
-  // Snap kanali preskočijo na cilj na polovici crossfade-a (alpha >= 128)
-  // namesto da drsijo čez vmesne vrednosti.
-  bool snapMask[DMX_MAX_CHANNELS];
-  memset(snapMask, 0, sizeof(snapMask));
-  if (_fixtures) {
-    for (int fi = 0; fi < MAX_FIXTURES; fi++) {
-      const PatchEntry* fx = _fixtures->getFixture(fi);
-      if (!fx || !fx->active || fx->profileIndex < 0) continue;
-      uint8_t chCount = _fixtures->fixtureChannelCount(fi);
-      for (int ch = 0; ch < chCount; ch++) {
-        const ChannelDef* def = _fixtures->fixtureChannel(fi, ch);
-        if (def && isSnapChannel(def->type)) {
-          uint16_t addr = fx->dmxAddress + ch - 1;
-          if (addr < DMX_MAX_CHANNELS) snapMask[addr] = true;
-        }
-      }
-    }
+  // out = from + (to - from) × alpha, alpha v Q16 (0..65536). Čas in
+  // krivulja se izračunata enkrat na frame za vsako časovno skupino (zamik,
+  // fade); snap kanali preklopijo na polovici okna svoje skupine.
+  uint32_t t16[CUE_TG_COUNT], a16[CUE_TG_COUNT];
+  for (int g = 0; g < CUE_TG_COUNT; g++) {
+    uint64_t d = _cf.groupDelayUs[g], f = _cf.groupFadeUs[g];
+    if (_cf.elapsedUs < d)            t16[g] = 0;
+    else if (_cf.elapsedUs - d >= f)  t16[g] = 65536;
+    else                              t16[g] = (uint32_t)(((_cf.elapsedUs - d) << 16) / f);
+    a16[g] = fadeCurveApply(_cf.curve, t16[g]);
   }
 
-  for (int i = 0; i < DMX_MAX_CHANNELS; i++) {
-    if (snapMask[i]) {
-      // Snap: preskoči na cilj na polovici fada
-      outDmx[i] = (alpha >= 128) ? _cf.toDmx[i] : _cf.fromDmx[i];
-    } else {
-      int16_t diff = (int16_t)_cf.toDmx[i] - (int16_t)_cf.fromDmx[i];
-      outDmx[i] = _cf.fromDmx[i] + (int16_t)((diff * (int32_t)alpha) / 256);
+  const XfadeEntry* e = _cf.entries;
+  const XfadeEntry* end = e + _cf.entryCount;
+  for (; e < end; e++) {
+    uint16_t addr = e->addrMode & XF_ADDR_MASK;
+    uint8_t g = (e->addrMode & XF_GROUP_MASK) >> XF_GROUP_SHIFT;
+    switch (e->addrMode & XF_MODE_MASK) {
+      case XF_SNAP:
+        outDmx[addr] = (t16[g] >= 32768) ? e->to : e->from;
+        break;
+      case XF_PAIR16: {
+        const XfadeEntry* f = ++e;                 // Fine istega para
+        uint16_t v = lerp16((e[-1].from << 8) | f->from, (e[-1].to << 8) | f->to, a16[g]);
+        put16(outDmx, addr, f->addrMode & XF_ADDR_MASK, v);
+        break;
+      }
+      default:
+        outDmx[addr] = (uint8_t)(e->from + ((((int32_t)e->to - e->from) * (int32_t)a16[g]) >> 16));
+        break;
     }
   }
-
   return true;
 }
 
@@ -234,6 +275,7 @@ bool SceneEngine::updateCrossfade(uint8_t* outDmx) {
 
 bool SceneEngine::loadCueList() {
   _cueCount = 0; _cueCurrent = -1; _cueRunning = false;
+  _cueSched.disarm();
   File f = LittleFS.open("/cuelist.json", "r");
   if (!f) return false;
   JsonDocument doc;
@@ -248,6 +290,9 @@ bool SceneEngine::loadCueList() {
     c.fadeMs = o["f"] | (uint16_t)CROSSFADE_DEFAULT_MS;
     c.autoFollowMs = o["a"] | (uint16_t)0;
     strlcpy(c.label, o["l"] | "", sizeof(c.label));
+    c.curve = o["c"] | (uint8_t)FADE_LINEAR;
+    if (c.curve >= FADE_CURVE_COUNT) c.curve = FADE_LINEAR;
+    timingFromJson(o["t"], c.timing);
     _cueCount++;
   }
   Serial.printf("[CUE] Loaded %d cues\n", _cueCount);
@@ -263,21 +308,23 @@ bool SceneEngine::saveCueList() {
     o["f"] = _cues[i].fadeMs;
     o["a"] = _cues[i].autoFollowMs;
     o["l"] = _cues[i].label;
+    if (_cues[i].curve != FADE_LINEAR) o["c"] = _cues[i].curve;
+    timingToJson(o, "t", _cues[i].timing);
   }
-  File f = LittleFS.open("/cuelist.json", "w");
-  if (!f) return false;
-  serializeJson(doc, f);
-  f.close();
-  return true;
+  return jsonPersist("/cuelist.json", doc);
 }
 
-bool SceneEngine::addCue(int8_t sceneSlot, uint16_t fadeMs, uint16_t autoFollowMs, const char* label) {
+bool SceneEngine::addCue(int16_t sceneSlot, uint16_t fadeMs, uint16_t autoFollowMs, const char* label, uint8_t curve,
+                         const CueTiming* timing) {
   if (_cueCount >= MAX_CUES) return false;
   CueEntry& c = _cues[_cueCount];
   c.sceneSlot = sceneSlot;
   c.fadeMs = fadeMs;
   c.autoFollowMs = autoFollowMs;
   strlcpy(c.label, label ? label : "", sizeof(c.label));
+  c.curve = curve < FADE_CURVE_COUNT ? curve : (uint8_t)FADE_LINEAR;
+  if (timing) memcpy(c.timing, timing, sizeof(c.timing));
+  else defaultTiming(c.timing);
   _cueCount++;
   return true;
 }
@@ -290,11 +337,14 @@ bool SceneEngine::removeCue(int index) {
   return true;
 }
 
-bool SceneEngine::updateCue(int index, int8_t sceneSlot, uint16_t fadeMs, uint16_t autoFollowMs, const char* label) {
+bool SceneEngine::updateCue(int index, int16_t sceneSlot, uint16_t fadeMs, uint16_t autoFollowMs, const char* label,
+                            uint8_t curve, const CueTiming* timing) {
   if (index < 0 || index >= _cueCount) return false;
   _cues[index].sceneSlot = sceneSlot;
   _cues[index].fadeMs = fadeMs;
   _cues[index].autoFollowMs = autoFollowMs;
+  _cues[index].curve = curve < FADE_CURVE_COUNT ? curve : (uint8_t)FADE_LINEAR;
+  if (timing) memcpy(_cues[index].timing, timing, sizeof(_cues[index].timing));
   if (label) strlcpy(_cues[index].label, label, sizeof(_cues[index].label));
   return true;
 }
@@ -319,30 +369,49 @@ void SceneEngine::cueBack(MixerEngine* mixer) {
 }
 
 void SceneEngine::cueGoTo(int idx, MixerEngine* mixer) {
+  cueStart(idx, mixer, _cueSched.nowUs(), 0);
+}
+
+// startUs = kdaj bi cue moral začeti na show uri (ročno: zdaj, auto-follow:
+// rok); lateUs = koliko je frame za tem — crossfade začne že toliko naprej
+void SceneEngine::cueStart(int idx, MixerEngine* mixer, uint64_t startUs, uint32_t lateUs) {
   if (idx < 0 || idx >= _cueCount || !mixer) return;
   _cueCurrent = idx;
   const CueEntry& c = _cues[idx];
   if (c.sceneSlot >= 0 && c.sceneSlot < MAX_SCENES) {
-    mixer->recallScene(c.sceneSlot, c.fadeMs);
+    if (mixer->recallScene(c.sceneSlot, c.fadeMs, c.curve, c.timing) && !mixer->isRecallPending() && _cf.active)
+      _cf.elapsedUs = lateUs;
   }
+  // Scena naslednjega cue-ja se bere v ozadju zdaj, da GO ne čaka na flash
+  const CueEntry& n = _cues[idx + 1 < _cueCount ? idx + 1 : 0];
+  if (n.sceneSlot >= 0) _bank.prefetch(n.sceneSlot);
   if (c.autoFollowMs > 0) {
-    _cueWaitAutoFollow = true;
-    _cueAutoFollowAt = millis() + c.fadeMs + c.autoFollowMs;
+    _cueSched.arm(startUs + (uint64_t)(timingSpanMs(c.fadeMs, c.timing) + c.autoFollowMs) * 1000);
     _cueRunning = true;
   } else {
-    _cueWaitAutoFollow = false;
+    _cueSched.disarm();
   }
 }
 
 void SceneEngine::cueStop() {
   _cueRunning = false;
-  _cueWaitAutoFollow = false;
+  _cueSched.disarm();
 }
 
-void SceneEngine::cueUpdateAutoFollow(MixerEngine* mixer) {
-  if (!_cueRunning || !_cueWaitAutoFollow) return;
-  if (millis() >= _cueAutoFollowAt) {
-    _cueWaitAutoFollow = false;
-    cueGo(mixer);
+void SceneEngine::cueTick(MixerEngine* mixer, uint32_t dtUs) {
+  _cueSched.advance(dtUs);
+  if (!_cueRunning || !_cueCount) return;
+  // Več rokov v enem frame-u (kratki cue-ji, izpuščen frame): vsak od svojega roka
+  uint32_t lateUs;
+  for (int n = 0; n < _cueCount && _cueSched.poll(lateUs); n++) {
+    int next = _cueCurrent + 1;
+    if (next >= _cueCount) next = 0;
+    cueStart(next, mixer, _cueSched.nowUs() - lateUs, lateUs);
   }
 }
+
+int32_t SceneEngine::cueFollowRemainingMs() const {
+  if (!_cueRunning || !_cueSched.armed()) return -1;
+  uint64_t now = _cueSched.nowUs(), due = _cueSched.dueUs();
+  return due > now ? (int32_t)((due - now + 999) / 1000) : 0;
+}
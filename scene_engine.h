@@ -3,12 +3,15 @@
 
 #include "config.h"
 #include "fixture_engine.h"
+#include "cue_scheduler.h"
+#include "scene_bank.h"
 
 // ============================================================================
 //  SceneEngine
 //  Upravlja scene (shrani/recall/briši) in crossfade interpolacijo.
-//  Scene so shranjene v LittleFS (/scenes/00.bin ... /scenes/19.bin).
-//  Kompaktni binarni format: 24B ime + 512B DMX = 536B na sceno.
+//  Scene so v banki (SceneBank): indeks v RAM, vsebina stisnjena na flash-u,
+//  v RAM samo LRU cache nazadnje uporabljenih. Vsebina je relativna na
+//  fixture-e in se ob spremembi patcha sama prevede na nove naslove.
 // ============================================================================
 
 class MixerEngine;  // Forward declaration
@@ -16,37 +19,53 @@ class MixerEngine;  // Forward declaration
 class SceneEngine {
 public:
   void begin();
-  void setFixtureEngine(FixtureEngine* fix) { _fixtures = fix; }
+  void setFixtureEngine(FixtureEngine* fix) { _fixtures = fix; _bank.setFixtureEngine(fix); }
 
   // --- Scene CRUD ---
-  bool saveScene(int slot, const char* name, const uint8_t* dmxData);
+  // partial: ob priklicu se zapišejo samo kanali, ki jih scena določa; mask = ti
+  // kanali (bit = naslov, tudi eksplicitne ničle), nullptr = kanali ≠ 0
+  bool saveScene(int slot, const char* name, const uint8_t* dmxData, bool partial = false,
+                 const uint32_t* mask = nullptr);
   bool deleteScene(int slot);
   bool renameScene(int slot, const char* name);
-  int  getSceneCount() const;
-  const Scene* getScene(int slot) const;
+  int  getSceneCount() const { return _bank.count(); }
+  bool sceneExists(int slot) const { return _bank.exists(slot); }
+  bool getSceneName(int slot, char* out) const { return _bank.getName(slot, out); }
+  // Frame task / pod mixer lockom; kazalec velja do naslednjega getScene().
+  // nullptr pri obstoječi sceni = bere se s flash-a, na voljo v enem od naslednjih frame-ov
+  const Scene* getScene(int slot) { return _bank.get(slot); }
+  void adoptLoaded() { _bank.adopt(); }                                     // Frame task
+  bool readScene(int slot, Scene& out) { return _bank.read(slot, out); }   // Kopija, brez cache-a
+  void getBankStats(SceneBankStats& out) const { _bank.getStats(out); }
+  uint32_t getGeneration() const { return _generation; }   // Se poveča ob vsaki spremembi DMX vsebine
 
   // Poišči prvi prosti slot (-1 = polno)
   int findFreeSlot() const;
 
   // --- Crossfade ---
+  // timing: split časi po CueTimingGroup (nullptr = vsi kanali durationMs)
   void startCrossfade(const uint8_t* fromDmx, const uint8_t* toDmx,
-                      uint32_t durationMs, int targetSceneIdx = -1);
-  void startCrossfadeToScene(int slot, const uint8_t* currentDmx, uint32_t durationMs);
+                      uint32_t durationMs, int targetSceneIdx = -1, uint8_t curve = FADE_LINEAR,
+                      const CueTiming* timing = nullptr);
+  void startCrossfadeToScene(int slot, const uint8_t* currentDmx, uint32_t durationMs,
+                             uint8_t curve = FADE_LINEAR);
   void cancelCrossfade();
   bool isCrossfading() const { return _cf.active; }
   float getCrossfadeProgress() const;  // 0.0 → 1.0
   int   getCrossfadeTarget() const { return _cf.targetSceneIdx; }
 
-  // Izračunaj interpolirano stanje — kliči vsak loop()
-  // Vrne true če je crossfade aktiven, in zapiše rezultat v outDmx
-  bool updateCrossfade(uint8_t* outDmx);
+  // Izračunaj interpolirano stanje — kliči vsak frame z dt frame clock-a.
+  // Vrne true če je crossfade aktiven; zapiše samo kanale, ki se spreminjajo.
+  bool updateCrossfade(uint8_t* outDmx, uint32_t dtUs);
 
   // --- Cue List ---
   bool loadCueList();
   bool saveCueList();
-  bool addCue(int8_t sceneSlot, uint16_t fadeMs, uint16_t autoFollowMs, const char* label);
+  bool addCue(int16_t sceneSlot, uint16_t fadeMs, uint16_t autoFollowMs, const char* label,
+              uint8_t curve = FADE_LINEAR, const CueTiming* timing = nullptr);
   bool removeCue(int index);
-  bool updateCue(int index, int8_t sceneSlot, uint16_t fadeMs, uint16_t autoFollowMs, const char* label);
+  bool updateCue(int index, int16_t sceneSlot, uint16_t fadeMs, uint16_t autoFollowMs, const char* label,
+                 uint8_t curve = FADE_LINEAR, const CueTiming* timing = nullptr);   // timing nullptr = ostane
   int  getCueCount() const { return _cueCount; }
   const CueEntry* getCue(int idx) const;
   int  getCurrentCue() const { return _cueCurrent; }
@@ -55,24 +74,30 @@ public:
   void cueBack(MixerEngine* mixer);
   void cueGoTo(int idx, MixerEngine* mixer);
   void cueStop();
-  void cueUpdateAutoFollow(MixerEngine* mixer);
+  // Frame task (mixer update, po crossfade-u) z dt frame clock-a: show ura + auto-follow
+  void cueTick(MixerEngine* mixer, uint32_t dtUs);
+  int32_t cueFollowRemainingMs() const;   // -1 = auto-follow ni v teku
+
+  // --- Split časi cue-ja ---
+  static void defaultTiming(CueTiming* t);
+  static uint32_t timingSpanMs(uint32_t fadeMs, const CueTiming* t);     // Konec zadnje skupine
+  static void timingFromJson(JsonVariantConst v, CueTiming* t);
+  static bool timingToJson(JsonObject o, const char* key, const CueTiming* t);   // false = privzeto, ni zapisano
 
 private:
-  Scene* _scenes = nullptr;
+  SceneBank _bank;
   FixtureEngine* _fixtures = nullptr;
   CrossfadeState _cf;
+  uint32_t _generation = 0;
 
   // Cue List
   CueEntry _cues[MAX_CUES];
   uint8_t  _cueCount = 0;
   int8_t   _cueCurrent = -1;
   bool     _cueRunning = false;
-  bool     _cueWaitAutoFollow = false;
-  unsigned long _cueAutoFollowAt = 0;
+  CueScheduler _cueSched;
 
-  String slotPath(int slot) const;
-  bool loadSlot(int slot);
-  bool saveSlot(int slot) const;
+  void cueStart(int idx, MixerEngine* mixer, uint64_t startUs, uint32_t lateUs);
 };
 
 #endif
@@ -1,4 +1,5 @@
 #include "shape_engine.h"
+#include "value16.h"
 #include <cmath>
 #include <cstring>
 
@@ -56,7 +57,8 @@ void ShapeGenerator::update(float dt) {
 }
 
 void ShapeGenerator::applyToOutput(const uint8_t* manualValues, uint8_t* dmxOut) {
-  if (!_fixtures) return;
+  const PatchMap* m = _fixtures ? _fixtures->getPatchMap() : nullptr;
+  if (!m) return;
 
   for (int si = 0; si < MAX_SHAPES; si++) {
     if (!_shapes[si].active) continue;
@@ -71,37 +73,33 @@ void ShapeGenerator::applyToOutput(const uint8_t* manualValues, uint8_t* dmxOut)
     int fxIdx = 0;
     for (int fi = 0; fi < MAX_FIXTURES; fi++) {
       if (!(shape.fixtureMask & (1UL << fi))) continue;
-      const PatchEntry* fx = _fixtures->getFixture(fi);
-      if (!fx || !fx->active || fx->profileIndex < 0) { fxIdx++; continue; }
+      const PatchSpan& sp = m->fixtureSpan[fi];
+      if (sp.count == 0) { fxIdx++; continue; }
 
       float fiPhase = fmodf(shape.currentPhase + shape.phase * (float)fxIdx / (float)fxCount, 1.0f);
       float panMod, tiltMod;
       computeShape(shape.type, fiPhase, panMod, tiltMod);
 
-      uint8_t chCount = _fixtures->fixtureChannelCount(fi);
-
-      // Poišči Pan/Tilt coarse+fine naslove
+      // Poišči Pan/Tilt coarse naslove; fine je partner iz PatchMap
       int panAddr = -1, panFineAddr = -1;
       int tiltAddr = -1, tiltFineAddr = -1;
-      for (int c = 0; c < chCount; c++) {
-        const ChannelDef* def = _fixtures->fixtureChannel(fi, c);
-        if (!def) continue;
-        int a = fx->dmxAddress + c - 1;  // 0-based
-        if (a < 0 || a >= DMX_MAX_CHANNELS) continue;
-        if (def->type == CH_PAN)       panAddr = a;
-        else if (def->type == CH_PAN_FINE)  panFineAddr = a;
-        else if (def->type == CH_TILT)      tiltAddr = a;
-        else if (def->type == CH_TILT_FINE) tiltFineAddr = a;
+      for (uint16_t a = sp.start; a < sp.start + sp.count; a++) {
+        const PatchAddr& pa = m->addr[a];
+        if (pa.fixture != fi) continue;
+        if (pa.type == CH_PAN && panAddr < 0) {
+          panAddr = a;
+          if (pa.partner != PATCH_NONE) panFineAddr = pa.partner;
+        } else if (pa.type == CH_TILT && tiltAddr < 0) {
+          tiltAddr = a;
+          if (pa.partner != PATCH_NONE) tiltFineAddr = pa.partner;
+        }
       }
 
       // Pan modulacija
       if (panAddr >= 0) {
         if (panFineAddr >= 0) {
-          uint16_t base = ((uint16_t)manualValues[panAddr] << 8) | manualValues[panFineAddr];
-          int result = (int)((float)base + panMod * shape.sizeX * 32767.5f);
-          if (result < 0) result = 0; if (result > 65535) result = 65535;
-          dmxOut[panAddr] = (uint8_t)((result >> 8) & 0xFF);
-          dmxOut[panFineAddr] = (uint8_t)(result & 0xFF);
+          uint16_t base = get16(manualValues, panAddr, panFineAddr);
+          put16(dmxOut, panAddr, panFineAddr, offset16(base, (int32_t)(panMod * shape.sizeX * 32767.5f)));
         } else {
           float base = (float)manualValues[panAddr];
           int result = (int)(base + panMod * shape.sizeX * 127.5f);
@@ -113,11 +111,8 @@ void ShapeGenerator::applyToOutput(const uint8_t* manualValues, uint8_t* dmxOut)
       // Tilt modulacija
       if (tiltAddr >= 0) {
         if (tiltFineAddr >= 0) {
-          uint16_t base = ((uint16_t)manualValues[tiltAddr] << 8) | manualValues[tiltFineAddr];
-          int result = (int)((float)base + tiltMod * shape.sizeY * 32767.5f);
-          if (result < 0) result = 0; if (result > 65535) result = 65535;
-          dmxOut[tiltAddr] = (uint8_t)((result >> 8) & 0xFF);
-          dmxOut[tiltFineAddr] = (uint8_t)(result & 0xFF);
+          uint16_t base = get16(manualValues, tiltAddr, tiltFineAddr);
+          put16(dmxOut, tiltAddr, tiltFineAddr, offset16(base, (int32_t)(tiltMod * shape.sizeY * 32767.5f)));
         } else {
           float base = (float)manualValues[tiltAddr];
           int result = (int)(base + tiltMod * shape.sizeY * 127.5f);
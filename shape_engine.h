@@ -3,6 +3,7 @@
 
 #include "config.h"
 #include "fixture_engine.h"
+#include "output_stage.h"
 
 #define MAX_SHAPES 4
 
@@ -26,18 +27,24 @@ struct ShapeInstance {
   float    currentPhase;  // Runtime accumulator (0.0 - 1.0)
 };
 
-class ShapeGenerator {
+class ShapeGenerator : public OutputStage {
 public:
   void begin(FixtureEngine* fixtures);
   void update(float dt);
   void applyToOutput(const uint8_t* manualValues, uint8_t* dmxOut);
 
+  // OutputStage
+  const char* name() const override { return "shape"; }
+  uint32_t channelTypes() const override { return (1UL << CH_PAN) | (1UL << CH_TILT); }
+  void prepare(float dt) override { update(dt); }
+  void apply(const uint8_t* in, uint8_t* out) override { applyToOutput(in, out); }
+
   int  addShape(const ShapeInstance& shape);
   bool removeShape(int idx);
   bool updateShape(int idx, const ShapeInstance& shape);
   const ShapeInstance* getShape(int idx) const;
   int  getActiveCount() const;
-  bool isActive() const;
+  bool isActive() const override;
 
 private:
   FixtureEngine* _fixtures = nullptr;
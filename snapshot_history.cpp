@@ -0,0 +1,324 @@
+#include "snapshot_history.h"
+#include "crc16.h"
+#include <LittleFS.h>
+
+#define SNAP_FILE_MAGIC   "SNP1"
+#define SNAP_OLD_RECORD   (DMX_MAX_CHANNELS + 6)   // Stara oblika: dmx + ts + valid + src
+
+static_assert(SNAP_HDR_BYTES + SNAP_RLE_MAX <= SNAP_POOL_BYTES, "Keyframe mora v pool");
+
+// ============================================================================
+//  RLE KODEK
+// ============================================================================
+
+size_t snapRleEncode(const uint8_t* x, uint8_t* out) {
+  size_t n = 0;
+  int i = 0;
+  while (i < DMX_MAX_CHANNELS) {
+    if (x[i] == 0) {
+      int r = 1;
+      while (i + r < DMX_MAX_CHANNELS && x[i + r] == 0 && r < 128) r++;
+      if (out) out[n] = r - 1;
+      n++;
+      i += r;
+      continue;
+    }
+    // Dobesedno do para ničel (posamezna ničla je cenejša v literalu)
+    int start = i, r = 0;
+    while (i < DMX_MAX_CHANNELS && r < 128) {
+      if (x[i] == 0 && (i + 1 >= DMX_MAX_CHANNELS || x[i + 1] == 0)) break;
+      i++;
+      r++;
+    }
+    if (out) {
+      out[n] = 0x80 | (r - 1);
+      memcpy(out + n + 1, x + start, r);
+    }
+    n += 1 + r;
+  }
+  return n;
+}
+
+size_t snapRleSize(const uint8_t* x) {
+  return snapRleEncode(x, nullptr);
+}
+
+bool snapRleXor(const uint8_t* in, size_t len, uint8_t* state) {
+  size_t p = 0, i = 0;
+  while (p < len) {
+    uint8_t t = in[p++];
+    if (t < 0x80) {
+      i += t + 1;
+      if (i > DMX_MAX_CHANNELS) return false;
+    } else {
+      size_t r = (t & 0x7F) + 1;
+      if (i + r > DMX_MAX_CHANNELS || p + r > len) return false;
+      for (size_t k = 0; k < r; k++) state[i + k] ^= in[p + k];
+      i += r;
+      p += r;
+    }
+  }
+  return i == DMX_MAX_CHANNELS;
+}
+
+// ============================================================================
+//  POOL
+// ============================================================================
+
+bool SnapshotHistory::begin(uint16_t poolBytes) {
+  if (poolBytes < SNAP_HDR_BYTES + SNAP_RLE_MAX) poolBytes = SNAP_HDR_BYTES + SNAP_RLE_MAX;
+  if (_pool && poolBytes != _poolBytes) { free(_pool); _pool = nullptr; }
+  if (!_pool) _pool = (uint8_t*)psramPreferMalloc(poolBytes);
+  _poolBytes = _pool ? poolBytes : 0;
+  clear();
+  if (!_pool) {
+    Serial.println("[SNAP] NAPAKA: ne morem alocirati zgodovine stanj!");
+    return false;
+  }
+  return true;
+}
+
+void SnapshotHistory::clear() {
+  _used = 0;
+  _count = 0;
+  _sinceKey = 0;
+  _unsynced = 0;
+  _rewrite = true;
+  _fileBytes = 0;
+}
+
+uint16_t SnapshotHistory::recLen(int i) const {
+  const uint8_t* h = _pool + _off[i];
+  return SNAP_HDR_BYTES + (h[0] | (h[1] << 8));
+}
+
+static void writeHeader(uint8_t* h, size_t len, uint8_t flags, uint32_t ts, char source) {
+  h[0] = len & 0xFF;
+  h[1] = len >> 8;
+  h[2] = flags;
+  h[3] = (uint8_t)source;
+  memcpy(h + 4, &ts, 4);
+  uint16_t crc = crc16(h + SNAP_HDR_BYTES, len, crc16(h, 8));
+  h[8] = crc & 0xFF;
+  h[9] = crc >> 8;
+}
+
+void SnapshotHistory::append(const uint8_t* x, size_t encLen, uint8_t flags, uint32_t ts, char source) {
+  uint8_t* h = _pool + _used;
+  snapRleEncode(x, h + SNAP_HDR_BYTES);
+  writeHeader(h, encLen, flags, ts, source);
+  _off[_count++] = _used;
+  _used += SNAP_HDR_BYTES + encLen;
+  _sinceKey = (flags & SNAP_FLAG_KEY) ? 0 : _sinceKey + 1;
+  _unsynced++;
+}
+
+void SnapshotHistory::add(const uint8_t* dmx, uint32_t ts, char source) {
+  if (!_pool) return;
+  uint8_t x[DMX_MAX_CHANNELS];
+  uint8_t flags = 0;
+  if (_count == 0 || _sinceKey + 1 >= SNAP_KEYFRAME_EVERY) {
+    memcpy(x, dmx, DMX_MAX_CHANNELS);
+    flags = SNAP_FLAG_KEY;
+  } else {
+    decode(0, x);
+    for (int i = 0; i < DMX_MAX_CHANNELS; i++) x[i] ^= dmx[i];
+  }
+  size_t enc = snapRleSize(x);
+
+  while (_count && (_used + SNAP_HDR_BYTES + enc > _poolBytes || _count >= SNAP_MAX_COUNT)) {
+    evictOldest();
+  }
+  if (_count == 0 && !(flags & SNAP_FLAG_KEY)) {
+    // Izrinjeno vse, tudi osnova delte
+    memcpy(x, dmx, DMX_MAX_CHANNELS);
+    flags = SNAP_FLAG_KEY;
+    enc = snapRleSize(x);
+  }
+  append(x, enc, flags, ts, source);
+}
+
+// Najstarejši zapis ven; prvi ohranjen zapis mora biti keyframe. Če nov
+// keyframe ne gre v sproščen prostor, se izrine tudi ta delta.
+void SnapshotHistory::evictOldest() {
+  if (!_count) return;
+  uint8_t s[DMX_MAX_CHANNELS];
+  memset(s, 0, sizeof(s));
+  snapRleXor(_pool + _off[0] + SNAP_HDR_BYTES, recLen(0) - SNAP_HDR_BYTES, s);
+
+  int drop = 1;          // Zapisi [0, drop) gredo v celoti ven
+  int rekey = -1;        // Zapis, ki postane keyframe
+  size_t keyEnc = 0;
+  while (drop < _count && !(_pool[_off[drop] + 2] & SNAP_FLAG_KEY)) {
+    snapRleXor(_pool + _off[drop] + SNAP_HDR_BYTES, recLen(drop) - SNAP_HDR_BYTES, s);
+    uint16_t end = _off[drop] + recLen(drop);
+    keyEnc = snapRleSize(s);
+    if (SNAP_HDR_BYTES + keyEnc <= (size_t)_poolBytes - (_used - end)) { rekey = drop; break; }
+    drop++;
+  }
+
+  // Izrinjen zapis, ki še ni v datoteki, pretrga verigo na flash-u
+  if (drop - 1 >= _count - _unsynced) _rewrite = true;
+
+  int removed = (rekey >= 0) ? rekey + 1 : drop;
+  uint16_t from = (removed < _count) ? _off[removed] : _used;
+  size_t keyBytes = 0;
+  uint32_t ts = 0;
+  char src = 'L';
+  if (rekey >= 0) {
+    const uint8_t* h = _pool + _off[rekey];
+    src = (char)h[3];
+    memcpy(&ts, h + 4, 4);
+    keyBytes = SNAP_HDR_BYTES + keyEnc;
+  }
+
+  memmove(_pool + keyBytes, _pool + from, _used - from);
+  int kept = _count - removed;
+  int base = (rekey >= 0) ? 1 : 0;
+  for (int i = 0; i < kept; i++) _off[base + i] = _off[removed + i] - from + keyBytes;
+  if (rekey >= 0) {
+    _off[0] = 0;
+    snapRleEncode(s, _pool + SNAP_HDR_BYTES);
+    writeHeader(_pool, keyEnc, SNAP_FLAG_KEY, ts, src);
+  }
+  _used = _used - from + keyBytes;
+  _count = base + kept;
+  if (_unsynced > _count) _unsynced = _count;
+  if (_count == 0) _sinceKey = 0;
+}
+
+bool SnapshotHistory::info(int idx, uint32_t& ts, char& source) const {
+  if (idx < 0 || idx >= _count) return false;
+  const uint8_t* h = _pool + _off[_count - 1 - idx];
+  source = (char)h[3];
+  memcpy(&ts, h + 4, 4);
+  return true;
+}
+
+bool SnapshotHistory::decode(int idx, uint8_t* out) const {
+  if (idx < 0 || idx >= _count) return false;
+  int target = _count - 1 - idx;
+  int k = target;
+  while (k > 0 && !(_pool[_off[k] + 2] & SNAP_FLAG_KEY)) k--;
+  memset(out, 0, DMX_MAX_CHANNELS);
+  for (int i = k; i <= target; i++) {
+    if (!snapRleXor(_pool + _off[i] + SNAP_HDR_BYTES, recLen(i) - SNAP_HDR_BYTES, out)) return false;
+  }
+  return true;
+}
+
+void SnapshotHistory::getStats(SnapshotCodecStats& out) const {
+  out.count = _count;
+  out.keyframes = 0;
+  for (int i = 0; i < _count; i++) if (_pool[_off[i] + 2] & SNAP_FLAG_KEY) out.keyframes++;
+  out.poolBytes = _used;
+  out.rawBytes = (uint32_t)_count * DMX_MAX_CHANNELS;
+  out.fileBytes = _fileBytes;
+}
+
+// ============================================================================
+//  PERSISTENCA — append-only datoteka
+// ============================================================================
+
+// Pod lockom lastnika: zapisi za datoteko → _stage (nov rep ali cel pool)
+bool SnapshotHistory::stageSync() {
+  if (!_pool || !needsSync()) return false;
+  if (!_stage) _stage = (uint8_t*)psramPreferMalloc(_poolBytes);
+  if (!_stage) return false;
+  uint16_t from = _unsynced ? _off[_count - _unsynced] : _used;
+  _stageRewrite = _rewrite || _fileBytes + (_used - from) > 2u * _poolBytes;
+  if (_stageRewrite) from = 0;
+  _stageLen = _used - from;
+  memcpy(_stage, _pool + from, _stageLen);
+  _staged = true;
+  _unsynced = 0;
+  _rewrite = false;
+  return true;
+}
+
+bool SnapshotHistory::writeStaged(const char* path) {
+  if (!_staged) return true;
+  _staged = false;
+  bool ok;
+  if (_stageRewrite) {
+    // Nova datoteka ob strani, nato rename (stara ostane cela ob izpadu)
+    String tmp = String(path) + ".tmp";
+    File f = LittleFS.open(tmp.c_str(), "w");
+    ok = f && f.write((const uint8_t*)SNAP_FILE_MAGIC, 4) == 4;
+    if (ok && _stageLen) ok = f.write(_stage, _stageLen) == _stageLen;
+    if (f) f.close();
+    ok = ok && LittleFS.rename(tmp.c_str(), path);
+    if (ok) _fileBytes = 4 + _stageLen;
+  } else {
+    File f = LittleFS.open(path, "a");
+    ok = f && f.write(_stage, _stageLen) == _stageLen;
+    if (f) f.close();
+    if (ok) _fileBytes += _stageLen;
+  }
+  if (!ok) _rewrite = true;           // Datoteka ni več v skladu s poolom
+  return ok;
+}
+
+bool SnapshotHistory::loadFile(const char* path) {
+  if (!_pool) return false;
+  File f = LittleFS.open(path, "r");
+  if (!f) return false;
+  size_t size = f.size();
+  uint8_t state[DMX_MAX_CHANNELS];
+  memset(state, 0, sizeof(state));
+  clear();
+
+  char magic[4] = {};
+  if (size >= 4 && f.read((uint8_t*)magic, 4) == 4 && memcmp(magic, SNAP_FILE_MAGIC, 4) == 0) {
+    uint8_t rec[SNAP_HDR_BYTES + SNAP_RLE_MAX];
+    size_t pos = 4;
+    while (f.read(rec, SNAP_HDR_BYTES) == SNAP_HDR_BYTES) {
+      size_t len = rec[0] | (rec[1] << 8);
+      if (len > SNAP_RLE_MAX || f.read(rec + SNAP_HDR_BYTES, len) != len) break;
+      uint16_t crc = crc16(rec + SNAP_HDR_BYTES, len, crc16(rec, 8));
+      if ((rec[8] | (rec[9] << 8)) != crc) break;
+      bool key = rec[2] & SNAP_FLAG_KEY;
+      if (pos == 4 && !key) break;
+      if (key) memset(state, 0, sizeof(state));
+      if (!snapRleXor(rec + SNAP_HDR_BYTES, len, state)) break;
+      uint32_t ts;
+      memcpy(&ts, rec + 4, 4);
+      add(state, ts, (char)rec[3]);
+      pos += SNAP_HDR_BYTES + len;
+    }
+    f.close();
+    _fileBytes = pos;
+    _unsynced = 0;
+    _rewrite = (pos != size);       // Prekinjen zadnji zapis → prepiši čisto datoteko
+    return true;
+  }
+
+  // Stara oblika: [count][head] + N × (dmx, ts, valid, src), krožni buffer
+  if (size > 2 && (size - 2) % SNAP_OLD_RECORD == 0) {
+    int n = (size - 2) / SNAP_OLD_RECORD;
+    uint8_t hdr[2];
+    f.seek(0);
+    f.read(hdr, 2);
+    int count = hdr[0] < n ? hdr[0] : n;
+    int head = hdr[1] < n ? hdr[1] : 0;
+    for (int k = 0; k < count; k++) {
+      int slot = (head - count + k + n) % n;
+      f.seek(2 + slot * SNAP_OLD_RECORD);
+      uint8_t tail[6];
+      f.read(state, DMX_MAX_CHANNELS);
+      f.read(tail, 6);
+      if (tail[4] != 1) continue;
+      uint32_t ts;
+      memcpy(&ts, tail, 4);
+      add(state, ts, (tail[5] == 'A') ? 'A' : 'L');
+    }
+    f.close();
+    _unsynced = 0;
+    _rewrite = true;                // Pretvori v novo obliko ob naslednjem shranjevanju
+    Serial.printf("[SNAP] Stara oblika: pretvorjenih %d snapshotov\n", _count);
+    return true;
+  }
+
+  f.close();
+  return false;
+}
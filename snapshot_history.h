@@ -0,0 +1,88 @@
+#ifndef SNAPSHOT_HISTORY_H
+#define SNAPSHOT_HISTORY_H
+
+#include "config.h"
+
+// ============================================================================
+//  SNAPSHOT HISTORY — zgodovina stanj kot keyframe + XOR/RLE delte
+//
+//  Zapis: [len:2][flags:1][src:1][ts:4][crc:2] + RLE(stanje XOR prejšnje).
+//  Keyframe je XOR proti ničlam (= surovo stanje); vsak SNAP_KEYFRAME_EVERY-ti
+//  zapis je keyframe, da dekodiranje ostane kratko. Zapisi so strnjeni v poolu
+//  (PSRAM); ko zmanjka prostora, se najstarejši izrine in naslednji postane
+//  keyframe. getSnapshot() dekodira šele ob klicu (keyframe + delte naprej).
+//
+//  Na flash-u je ista oblika: "SNP1" + zapisi, novi se samo dodajajo na konec.
+//  Datoteka se prepiše iz poola šele, ko preraste dvojno velikost poola.
+//  Zapis gre prek kopije (stageSync), da lahko piše persist task brez locka.
+//  Nalaganje ustavi prvi zapis s slabim CRC (prekinjen zapis ob izpadu).
+//
+//  RLE žeton: 0x00-0x7F = (t+1) ničel, 0x80-0xFF = (t-0x7F) dobesednih bajtov.
+// ============================================================================
+
+#if HAS_PSRAM
+#define SNAP_POOL_BYTES       16384
+#else
+#define SNAP_POOL_BYTES       1408    // + indeks ≤ prejšnje 3 polne kopije v DRAM
+#endif
+#define SNAP_MAX_COUNT        64
+#define SNAP_KEYFRAME_EVERY   16
+
+#define SNAP_HDR_BYTES        10
+#define SNAP_FLAG_KEY         0x01
+#define SNAP_RLE_MAX          (DMX_MAX_CHANNELS + DMX_MAX_CHANNELS / 32)   // Najslabši primer z rezervo
+
+struct SnapshotCodecStats {
+  uint32_t count;           // Zapisi v poolu
+  uint32_t keyframes;
+  uint32_t poolBytes;       // Zasedeno
+  uint32_t rawBytes;        // count × DMX_MAX_CHANNELS
+  uint32_t fileBytes;       // Velikost datoteke (zadnja znana)
+};
+
+// RLE kodek (prost, da ga meri bench)
+size_t snapRleEncode(const uint8_t* x, uint8_t* out);                       // Vrne dolžino
+size_t snapRleSize(const uint8_t* x);
+bool   snapRleXor(const uint8_t* in, size_t len, uint8_t* state);           // state ^= dekodirano
+
+class SnapshotHistory {
+public:
+  bool begin(uint16_t poolBytes = SNAP_POOL_BYTES);   // Alocira pool (PSRAM)
+  void clear();
+
+  void add(const uint8_t* dmx, uint32_t ts, char source);
+  int  count() const { return _count; }
+  // idx 0 = najnovejši
+  bool info(int idx, uint32_t& ts, char& source) const;
+  bool decode(int idx, uint8_t* out) const;   // Rekonstrukcija iz keyframe-a + delt
+
+  // --- Persistenca ---
+  bool loadFile(const char* path);            // Tudi stara oblika (3 polne kopije)
+  bool syncFile(const char* path) { stageSync(); return writeStaged(path); }   // Doda neshranjene zapise (ali prepiše)
+  // Z drugega taska: stageSync() pod lockom lastnika (memcpy), writeStaged() brez
+  bool stageSync();
+  bool writeStaged(const char* path);
+  bool needsSync() const { return _unsynced || _rewrite; }
+  void getStats(SnapshotCodecStats& out) const;
+
+private:
+  uint8_t* _pool = nullptr;
+  uint16_t _poolBytes = 0;
+  uint16_t _used = 0;
+  uint16_t _off[SNAP_MAX_COUNT];              // Odmiki zapisov, najstarejši prvi
+  uint16_t _count = 0;
+  uint16_t _sinceKey = 0;                     // Zapisi od zadnjega keyframe-a
+  uint16_t _unsynced = 0;                     // Zadnjih n zapisov še ni v datoteki
+  bool     _rewrite = false;                  // Datoteka se ne da nadaljevati → prepis
+  uint32_t _fileBytes = 0;
+  uint8_t* _stage = nullptr;                  // Kopija za zapis (PSRAM, ob prvi uporabi)
+  uint16_t _stageLen = 0;
+  bool     _staged = false;
+  bool     _stageRewrite = false;
+
+  uint16_t recLen(int i) const;
+  void     evictOldest();
+  void     append(const uint8_t* xorData, size_t encLen, uint8_t flags, uint32_t ts, char source);
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "sound_engine.h"
 #include <math.h>
 #include <LittleFS.h>
+#include "persist.h"
 
 // ESP-DSP — hardware-accelerated FFT (Vector ISA on ESP32-S3)
 #include "dsps_fft2r.h"
@@ -122,6 +123,7 @@ void SoundEngine::update() {
     _lastUpdateTime = now;
     updateManualBeat(dt);
   }
+  publishBeatClock();
 }
 
 // ============================================================================
@@ -313,12 +315,56 @@ void SoundEngine::updateBeatSync(float dt) {
   if (_bands.beatDetected) {
     _lastBeatMs = now;
     _beatPhase = 0;
+    _beatCount++;
   } else {
     _beatPhase = fminf(elapsed / _beatIntervalMs, 1.0f);
   }
+  _beatSampleUs = micros();
   _easy.beatPhase = _beatPhase;
 }
 
+// ============================================================================
+//  BEAT URA — posnetek za kvantizacijo ukazov (launch_queue.h)
+//  Manual beat (tudi Link in avdio BPM sync) ima prednost pred avdio beat
+//  sync-om, enako kot pri _beatPhase. Takt poravna samo Link (bar faza).
+// ============================================================================
+
+void SoundEngine::publishBeatClock() {
+  BeatClock c = {};
+  c.barBeat = -1;
+  if (isManualBeatActive() || (_mbCfg.enabled && _mbCfg.source == BSRC_LINK && _link.isEnabled())) {
+    float intervalMs = 60000.0f / getEffectiveBpm();
+    if (intervalMs < 100) intervalMs = 100;
+    c.valid = true;
+    c.beatCount = (uint32_t)_mbBeatCount;
+    c.phase = _mbPhase;
+    c.sampleUs = _mbSampleUs;
+    c.intervalUs = (uint32_t)(intervalMs * 1000.0f);
+    if (_mbCfg.source == BSRC_LINK && _link.isEnabled()) {
+      c.barBeat = (int8_t)((int)(_link.getBarPhase() * BEATS_PER_BAR) % BEATS_PER_BAR);
+    }
+  } else if (_easy.beatSync && _beatIntervalMs >= 200) {
+    c.valid = true;
+    c.beatCount = _beatCount;
+    c.phase = _beatPhase;
+    c.sampleUs = _beatSampleUs;
+    c.intervalUs = (uint32_t)(_beatIntervalMs * 1000.0f);
+  }
+  if (c.phase >= 1.0f) c.phase = 0.999f;
+
+  _clockSeq.fetch_add(1);
+  _clock = c;
+  _clockSeq.fetch_add(1);
+}
+
+void SoundEngine::getBeatClock(BeatClock& out) const {
+  uint32_t s;
+  do {
+    s = _clockSeq.load();
+    out = _clock;
+  } while ((s & 1) || s != _clockSeq.load());
+}
+
 // ============================================================================
 //  ZONE - energija per-fixture
 // ============================================================================
@@ -394,28 +440,30 @@ void SoundEngine::applyEasyMode(const uint8_t* manualValues, uint8_t* dmxOut, fl
     if (!_easy.beatSync) _hueAngle = fmodf(_hueAngle + rotSpeed, 360.0f);
   }
 
-  for (int fi = 0; fi < MAX_FIXTURES; fi++) {
+  const PatchMap* m = _fixtures->getPatchMap();
+  if (!m) return;
+
+  for (int s = 0; s < m->spanCount; s++) {
+    const PatchSpan& sp = m->spans[s];
+    int fi = sp.fixture;
     const PatchEntry* fx = _fixtures->getFixture(fi);
-    if (!fx || !fx->active || fx->profileIndex < 0) continue;
     // FIX: uporabi soundReactive flag iz patcha
-    if (!fx->soundReactive) continue;
+    if (!fx || !fx->soundReactive) continue;
 
-    uint8_t chCount = _fixtures->fixtureChannelCount(fi);
     float amount = _easy.soundAmount;
     SoundZone zone = (SoundZone)_easy.zones[fi];
     float zoneE = getZoneEnergy(zone);
     float fxLevel = 0;
 
-    for (int ch = 0; ch < chCount; ch++) {
-      const ChannelDef* def = _fixtures->fixtureChannel(fi, ch);
-      if (!def) continue;
-      uint16_t addr = fx->dmxAddress + ch - 1;
-      if (addr >= DMX_MAX_CHANNELS) continue;
+    for (uint16_t addr = sp.start; addr < sp.start + sp.count; addr++) {
+      const PatchAddr& pa = m->addr[addr];
+      if (pa.fixture != fi) continue;
+      uint8_t type = pa.type;
 
       float modifier = 0;
 
       // Bass → Intensity (dimmer)
-      if (_easy.bassIntensity && def->type == CH_INTENSITY) {
+      if (_easy.bassIntensity && type == CH_INTENSITY) {
         float bassE = (zone == ZONE_ALL) ? _smoothBass : zoneE;
         modifier = bassE;
         if (_easy.beatBump) modifier = fminf(modifier + _smoothBeat * 0.5f, 1.0f);
@@ -435,18 +483,18 @@ void SoundEngine::applyEasyMode(const uint8_t* manualValues, uint8_t* dmxOut, fl
         // HSV → RGB aproksimacija
         float h6 = hue / 60.0f;
         float frac = h6 - floorf(h6);
-        if (def->type == CH_COLOR_R) {
+        if (type == CH_COLOR_R) {
           if (h6 < 1) modifier = 1.0f;
           else if (h6 < 2) modifier = 1.0f - frac;
           else if (h6 < 4) modifier = 0;
           else if (h6 < 5) modifier = frac;
           else modifier = 1.0f;
-        } else if (def->type == CH_COLOR_G) {
+        } else if (type == CH_COLOR_G) {
           if (h6 < 1) modifier = frac;
           else if (h6 < 3) modifier = 1.0f;
           else if (h6 < 4) modifier = 1.0f - frac;
           else modifier = 0;
-        } else if (def->type == CH_COLOR_B) {
+        } else if (type == CH_COLOR_B) {
           if (h6 < 2) modifier = 0;
           else if (h6 < 3) modifier = frac;
           else if (h6 < 5) modifier = 1.0f;
@@ -456,7 +504,7 @@ void SoundEngine::applyEasyMode(const uint8_t* manualValues, uint8_t* dmxOut, fl
       }
 
       // High → Strobe
-      if (_easy.highStrobe && (def->type == CH_STROBE || def->type == CH_SHUTTER)) {
+      if (_easy.highStrobe && (type == CH_STROBE || type == CH_SHUTTER)) {
         float highE = (zone == ZONE_ALL) ? _smoothHigh : zoneE;
         modifier = highE;
         // Beat sync: strobe samo na beat
@@ -490,7 +538,7 @@ void SoundEngine::applyProMode(const uint8_t* manualValues, uint8_t* dmxOut, flo
     const STLRule& rule = _rules[r];
 
     const PatchEntry* fx = _fixtures->getFixture(rule.fixtureIdx);
-    if (!fx || !fx->active) continue;
+    if (!fx || !fx->active || fx->universe != 0) continue;   // Efekti samo na univerzi 0
 
     int binLow  = (int)(rule.freqLow / freqPerBin);
     int binHigh = (int)(rule.freqHigh / freqPerBin);
@@ -633,9 +681,24 @@ void SoundEngine::tapBeat() {
   // Vsak tap sproži beat
   _mbPhase = 0;
   _mbLastBeatMs = now;
+  _mbSampleUs = micros();
   _mbSmoothBeat = 1.0f;
 }
 
+void SoundEngine::setProgram(uint8_t program) {
+  _mbCfg.program = program;
+  // Reset programsko-specifičnih stanj (kot ob menjavi v chain-u)
+  _mbChaseIdx = 0; _mbStackCount = 0;
+  _mbScanIdx = 0; _mbScanDir = 1;
+}
+
+void SoundEngine::startChain(bool on) {
+  _chain.active = on && _chain.count > 0;
+  _chainIdx = 0;
+  _chainBeatCount = 0;
+  if (_chain.active) setProgram(_chain.entries[0].program);
+}
+
 void SoundEngine::setManualBpm(float bpm) {
   if (bpm < 30) bpm = 30;
   if (bpm > 300) bpm = 300;
@@ -686,6 +749,8 @@ void SoundEngine::updateManualBeat(float dt) {
     newBeat = (_mbPhase >= 1.0f);
   }
 
+  _mbSampleUs = micros();
+
   // Ob novem beatu
   if (newBeat) {
     _mbPhase = 0;
@@ -818,11 +883,14 @@ void SoundEngine::applyManualBeatProgram(const uint8_t* manualValues, uint8_t* d
     }
   }
 
+  const PatchMap* m = _fixtures->getPatchMap();
+  if (!m) return;
+
   for (int si = 0; si < srN; si++) {
     int fi = srFixtures[si];
     const PatchEntry* fx = _fixtures->getFixture(fi);
     if (!fx) continue;
-    uint8_t chCount = _fixtures->fixtureChannelCount(fi);
+    const PatchSpan& sp = m->fixtureSpan[fi];
 
     // Faza 6: Določi efektivni program, phase, state za ta fixture
     int activeGroup = -1;
@@ -967,16 +1035,15 @@ void SoundEngine::applyManualBeatProgram(const uint8_t* manualValues, uint8_t* d
     float fxLevel = 0;
 
     // Apliciraj na DMX kanale
-    for (int ch = 0; ch < chCount; ch++) {
-      const ChannelDef* def = _fixtures->fixtureChannel(fi, ch);
-      if (!def) continue;
-      uint16_t addr = fx->dmxAddress + ch - 1;
-      if (addr >= DMX_MAX_CHANNELS) continue;
+    for (uint16_t addr = sp.start; addr < sp.start + sp.count; addr++) {
+      const PatchAddr& pa = m->addr[addr];
+      if (pa.fixture != fi) continue;
+      uint8_t type = pa.type;
 
       float modifier = 0;
 
       // Intensity kanali
-      if (def->type == CH_INTENSITY) {
+      if (type == CH_INTENSITY) {
         modifier = dimMod;
       }
 
@@ -984,20 +1051,20 @@ void SoundEngine::applyManualBeatProgram(const uint8_t* manualValues, uint8_t* d
       if (_mbCfg.colorEnabled && colorHue >= 0) {
         float h6 = colorHue / 60.0f;
         float frac = h6 - floorf(h6);
-        if (def->type == CH_COLOR_R) {
+        if (type == CH_COLOR_R) {
           if (h6 < 1) modifier = 1.0f;
           else if (h6 < 2) modifier = 1.0f - frac;
           else if (h6 < 4) modifier = 0;
           else if (h6 < 5) modifier = frac;
           else modifier = 1.0f;
           modifier *= dimMod;
-        } else if (def->type == CH_COLOR_G) {
+        } else if (type == CH_COLOR_G) {
           if (h6 < 1) modifier = frac;
           else if (h6 < 3) modifier = 1.0f;
           else if (h6 < 4) modifier = 1.0f - frac;
           else modifier = 0;
           modifier *= dimMod;
-        } else if (def->type == CH_COLOR_B) {
+        } else if (type == CH_COLOR_B) {
           if (h6 < 2) modifier = 0;
           else if (h6 < 3) modifier = frac;
           else if (h6 < 5) modifier = 1.0f;
@@ -1007,7 +1074,7 @@ void SoundEngine::applyManualBeatProgram(const uint8_t* manualValues, uint8_t* d
       }
 
       // Strobe kanali — strobe program jih aktivira
-      if ((def->type == CH_STROBE || def->type == CH_SHUTTER) && prog == MBPROG_STROBE) {
+      if ((type == CH_STROBE || type == CH_SHUTTER) && prog == MBPROG_STROBE) {
         modifier = dimMod;
       }
 
@@ -1070,16 +1137,16 @@ int SoundEngine::getRuleCount() const {
 #define SND_V5_AGC_SIZE   (sizeof(float) * STL_BAND_COUNT + sizeof(float) * 2 + sizeof(BandParam) * STL_BAND_COUNT)  // brez BeatDetectConfig
 
 void SoundEngine::saveConfig() {
-  File f = LittleFS.open(PATH_SOUND_CFG, "w");
-  if (!f) { Serial.println("[SND] Napaka pri pisanju"); return; }
-  uint8_t magic = SND_MAGIC_V6;
-  f.write(&magic, 1);
-  f.write((uint8_t*)&_easy, sizeof(STLEasyConfig));
-  f.write((uint8_t*)_rules, sizeof(_rules));
-  f.write((uint8_t*)&_mbCfg, sizeof(ManualBeatConfig));
-  f.write((uint8_t*)&_chain, sizeof(ProgramChain));
-  f.write((uint8_t*)&_agc, sizeof(STLAgcConfig));
-  f.close();
+  static const uint8_t magic = SND_MAGIC_V6;
+  PersistSeg segs[6] = {
+    { &magic, 1 },
+    { &_easy, sizeof(STLEasyConfig) },
+    { _rules, sizeof(_rules) },
+    { &_mbCfg, sizeof(ManualBeatConfig) },
+    { &_chain, sizeof(ProgramChain) },
+    { &_agc, sizeof(STLAgcConfig) },
+  };
+  if (!persistWriteV(PATH_SOUND_CFG, segs, 6)) { Serial.println("[SND] Napaka pri pisanju"); return; }
   Serial.printf("[SND] Konfiguracija shranjena (V6, agc=%d)\n", sizeof(STLAgcConfig));
 }
 
@@ -5,6 +5,8 @@
 #include "audio_input.h"
 #include "fixture_engine.h"
 #include "link_beat.h"
+#include "output_stage.h"
+#include <atomic>
 
 // ============================================================================
 //  SoundEngine
@@ -12,7 +14,7 @@
 //  Podpira easy mode (preseti + cone) in pro mode (pravila).
 // ============================================================================
 
-class SoundEngine {
+class SoundEngine : public OutputStage {
 public:
   void begin(AudioInput* audio, FixtureEngine* fixtures);
   void update();     // Kliči vsak loop()
@@ -48,10 +50,21 @@ public:
 
   // --- Apliciranje na DMX ---
   void applyToOutput(const uint8_t* manualValues, uint8_t* dmxOut, float dt);
-  bool isActive() const;
+  bool isActive() const override;
+
+  // --- OutputStage (pro mode pravila lahko pišejo poljuben kanal) ---
+  const char* name() const override { return "sound"; }
+  uint32_t channelTypes() const override { return STAGE_TYPES_ALL; }
+  void prepare(float dt) override { _stageDt = dt; }
+  void apply(const uint8_t* in, uint8_t* out) override { applyToOutput(in, out, _stageDt); }
 
   // --- Beat sync ---
   float getBeatPhase() const { return _beatPhase; }
+  void  getBeatClock(BeatClock& out) const;   // Iz katerega koli taska (seqlock)
+
+  // --- Takojšnja menjava programa / start chain-a (launch queue, WS) ---
+  void setProgram(uint8_t program);
+  void startChain(bool on);                   // Od prvega vnosa
 
   // --- Persistenca ---
   void saveConfig();
@@ -63,6 +76,7 @@ public:
 private:
   AudioInput*   _audio = nullptr;
   FixtureEngine* _fixtures = nullptr;
+  float         _stageDt = 0.05f;   // dt iz prepare() za apply()
 
   // FFT
   float _vReal[FFT_SAMPLES];
@@ -98,6 +112,13 @@ private:
   float _beatPhase = 0;
   unsigned long _lastBeatMs = 0;
   float _beatIntervalMs = 500;
+  uint32_t _beatCount = 0;          // Zaznani beati (avdio beat sync)
+  uint32_t _beatSampleUs = 0;       // micros() ob izračunu _beatPhase
+  uint32_t _mbSampleUs = 0;         // micros() ob izračunu _mbPhase
+
+  // Objavljena beat ura: piše update() (core 0), bere frame task
+  BeatClock _clock = {};
+  std::atomic<uint32_t> _clockSeq{0};  // Liho = pisanje v teku
 
   // Smooth vrednosti
   float _smoothBass = 0;
@@ -167,6 +188,7 @@ private:
   void detectBeat(float dt);
   void updateBeatSync(float dt);
   void updateManualBeat(float dt);
+  void publishBeatClock();
   void applyEasyMode(const uint8_t* manualValues, uint8_t* dmxOut, float dt);
   void applyManualBeatProgram(const uint8_t* manualValues, uint8_t* dmxOut, float dt);
   void applyProMode(const uint8_t* manualValues, uint8_t* dmxOut, float dt);
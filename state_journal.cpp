@@ -0,0 +1,270 @@
+#include "state_journal.h"
+#include "crc16.h"
+#include <LittleFS.h>
+
+#define CKPT_MAGIC        0xAF            // V3 (V2 = 0xAE, V1 = 0xAD v mixer_engine.cpp)
+#define JNL_MAGIC         "JNL1"
+#define JNL_HDR_BYTES     8               // magic + generacija
+#define RUN_HDR_BYTES     4               // id + start + n
+
+void StateJournal::begin(const char* checkpointPath, const char* journalPath) {
+  _ckptPath = checkpointPath;
+  _jnlPath = journalPath;
+  _gen = 0;
+  _needCheckpoint = false;
+  _stats = {};
+}
+
+StateJournal::Region* StateJournal::findRegion(uint8_t id) {
+  for (int i = 0; i < _regionCount; i++) if (_regions[i].id == id) return &_regions[i];
+  return nullptr;
+}
+
+bool StateJournal::addRegion(uint8_t id, uint8_t* data, uint16_t len) {
+  Region* r = findRegion(id);
+  if (!r) {
+    if (_regionCount >= JOURNAL_MAX_REGIONS) return false;
+    r = &_regions[_regionCount];
+    r->shadow = (uint8_t*)psramPreferMalloc(len);
+    r->stage = (uint8_t*)psramPreferMalloc(len);
+    if (!r->shadow || !r->stage) { free(r->shadow); free(r->stage); return false; }
+    r->id = id;
+    r->len = len;
+    _regionCount++;
+  } else if (r->len != len) {
+    return false;
+  } else if (r->data == data) {
+    return true;                                   // Že registrirana — senca ostane (nezapisane spremembe)
+  }
+  r->data = data;
+  memcpy(r->shadow, data, len);
+  memcpy(r->stage, data, len);
+  return true;
+}
+
+bool StateJournal::isDirty() const {
+  for (int i = 0; i < _regionCount; i++) {
+    if (memcmp(_regions[i].data, _regions[i].shadow, _regions[i].len) != 0) return true;
+  }
+  return false;
+}
+
+// ============================================================================
+//  NALAGANJE — checkpoint, nato dnevnik iste generacije
+// ============================================================================
+
+bool StateJournal::load() {
+  File f = LittleFS.open(_ckptPath, "r");
+  if (!f) return false;
+  size_t size = f.size();
+  uint8_t hdr[6];
+  if (size < sizeof(hdr) + 2 || f.read(hdr, sizeof(hdr)) != sizeof(hdr) || hdr[0] != CKPT_MAGIC) {
+    f.close();
+    return false;
+  }
+
+  // Prvi prehod: CRC čez celo datoteko, šele nato v regije
+  uint8_t buf[64];
+  uint16_t crc = crc16(hdr, sizeof(hdr));
+  size_t left = size - sizeof(hdr) - 2;
+  while (left) {
+    size_t n = left < sizeof(buf) ? left : sizeof(buf);
+    if (f.read(buf, n) != n) break;
+    crc = crc16(buf, n, crc);
+    left -= n;
+  }
+  uint8_t c[2] = {};
+  f.read(c, 2);
+  if (left || (c[0] | (c[1] << 8)) != crc) {
+    f.close();
+    Serial.println("[JNL] Checkpoint poškodovan — ignoriram");
+    return false;
+  }
+
+  f.seek(sizeof(hdr));
+  for (int k = 0; k < hdr[5]; k++) {
+    uint8_t rh[3];
+    if (f.read(rh, 3) != 3) break;
+    uint16_t len = rh[1] | (rh[2] << 8);
+    Region* r = findRegion(rh[0]);
+    if (r && r->len == len) f.read(r->data, len);
+    else f.seek(f.position() + len);               // Univerza trenutno ni patchana
+  }
+  f.close();
+  memcpy(&_gen, hdr + 1, 4);
+
+  replay(_gen);
+  for (int i = 0; i < _regionCount; i++) {
+    memcpy(_regions[i].shadow, _regions[i].data, _regions[i].len);
+    memcpy(_regions[i].stage, _regions[i].data, _regions[i].len);
+  }
+  _stats.generation = _gen;
+  return true;
+}
+
+bool StateJournal::replay(uint32_t gen) {
+  _stats.journalBytes = 0;
+  File j = LittleFS.open(_jnlPath, "r");
+  if (!j) return true;
+  size_t size = j.size();
+  uint8_t hdr[JNL_HDR_BYTES];
+  uint32_t jgen = ~gen;
+  if (j.read(hdr, JNL_HDR_BYTES) == JNL_HDR_BYTES && memcmp(hdr, JNL_MAGIC, 4) == 0) memcpy(&jgen, hdr + 4, 4);
+  if (jgen != gen) {
+    // Dnevnik prejšnje generacije (izpad med kompakcijo) — že v checkpointu
+    j.close();
+    LittleFS.remove(_jnlPath);
+    return true;
+  }
+
+  uint8_t rec[2 + JOURNAL_MAX_RECORD + 2];
+  size_t pos = JNL_HDR_BYTES;
+  while (pos < size) {
+    if (j.read(rec, 2) != 2) break;
+    size_t len = rec[0] | (rec[1] << 8);
+    if (len > JOURNAL_MAX_RECORD || j.read(rec + 2, len + 2) != len + 2) break;
+    uint16_t crc = crc16(rec, 2 + len);
+    if ((rec[2 + len] | (rec[3 + len] << 8)) != crc) break;
+
+    const uint8_t* p = rec + 2;
+    const uint8_t* end = p + len;
+    while (p + RUN_HDR_BYTES <= end) {
+      uint16_t start = p[1] | (p[2] << 8);
+      uint8_t n = p[3];
+      if (p + RUN_HDR_BYTES + n > end) break;
+      Region* r = findRegion(p[0]);
+      if (r && start + n <= r->len) memcpy(r->data + start, p + RUN_HDR_BYTES, n);
+      p += RUN_HDR_BYTES + n;
+    }
+    pos += 4 + len;
+    _stats.replayed++;
+  }
+  j.close();
+  _stats.journalBytes = pos;
+  if (pos != size) {
+    // Prekinjen zapis: za njim se ne sme dodajati → nov checkpoint ob prvem sync()
+    _stats.tornTail = true;
+    _needCheckpoint = true;
+    Serial.printf("[JNL] Prekinjen zapis v dnevniku (%u od %u B)\n", (unsigned)pos, (unsigned)size);
+  }
+  return true;
+}
+
+// ============================================================================
+//  ZAPIS
+// ============================================================================
+
+// Runi spremenjenih bajtov (kratke vrzeli se prepišejo, cenejše od glave runa)
+size_t StateJournal::buildRecord(uint8_t* out, size_t cap) {
+  size_t n = 0;
+  for (int ri = 0; ri < _regionCount; ri++) {
+    const Region& r = _regions[ri];
+    int i = 0;
+    while (i < r.len) {
+      if (r.stage[i] == r.shadow[i]) { i++; continue; }
+      int start = i, last = i;
+      for (int j = i + 1; j < r.len && j - last <= JOURNAL_RUN_GAP && j - start < 255; j++) {
+        if (r.stage[j] != r.shadow[j]) last = j;
+      }
+      int len = last - start + 1;
+      if (n + RUN_HDR_BYTES + len > cap) return cap + 1;
+      out[n] = r.id;
+      out[n + 1] = start & 0xFF;
+      out[n + 2] = start >> 8;
+      out[n + 3] = len;
+      memcpy(out + n + RUN_HDR_BYTES, r.stage + start, len);
+      n += RUN_HDR_BYTES + len;
+      i = last + 1;
+    }
+  }
+  return n;
+}
+
+void StateJournal::capture() {
+  for (int i = 0; i < _regionCount; i++) memcpy(_regions[i].stage, _regions[i].data, _regions[i].len);
+}
+
+bool StateJournal::commit() {
+  uint32_t t0 = micros();
+  bool ok = true;
+  uint8_t rec[2 + JOURNAL_MAX_RECORD + 2];
+  size_t n = _needCheckpoint ? JOURNAL_MAX_RECORD + 1 : buildRecord(rec + 2, JOURNAL_MAX_RECORD);
+  if (n == 0) return true;
+
+  if (n > JOURNAL_MAX_RECORD || _stats.journalBytes + n + 4 > JOURNAL_MAX_BYTES) {
+    ok = writeCheckpoint();
+  } else {
+    rec[0] = n & 0xFF;
+    rec[1] = n >> 8;
+    uint16_t crc = crc16(rec, 2 + n);
+    rec[2 + n] = crc & 0xFF;
+    rec[3 + n] = crc >> 8;
+
+    bool fresh = _stats.journalBytes == 0;
+    File f = LittleFS.open(_jnlPath, fresh ? "w" : "a");
+    if (!f) return false;
+    if (fresh) {
+      uint8_t hdr[JNL_HDR_BYTES];
+      memcpy(hdr, JNL_MAGIC, 4);
+      memcpy(hdr + 4, &_gen, 4);
+      ok = f.write(hdr, JNL_HDR_BYTES) == JNL_HDR_BYTES;
+    }
+    ok = ok && f.write(rec, n + 4) == n + 4;
+    f.close();
+    if (ok) {
+      _stats.journalBytes += (fresh ? JNL_HDR_BYTES : 0) + n + 4;
+      _stats.appends++;
+      for (int i = 0; i < _regionCount; i++) memcpy(_regions[i].shadow, _regions[i].stage, _regions[i].len);
+    } else {
+      _needCheckpoint = true;       // Rep je morda poškodovan
+    }
+  }
+
+  uint32_t us = micros() - t0;
+  _stats.lastSyncUs = us;
+  if (us > _stats.maxSyncUs) _stats.maxSyncUs = us;
+  return ok;
+}
+
+bool StateJournal::checkpoint() {
+  capture();
+  return writeCheckpoint();
+}
+
+// Celoten stage v nov checkpoint (tmp + rename), nato dnevnik odpade
+bool StateJournal::writeCheckpoint() {
+  for (int i = 0; i < _regionCount; i++) memcpy(_regions[i].shadow, _regions[i].stage, _regions[i].len);
+
+  uint32_t gen = _gen + 1;
+  uint8_t hdr[6] = { CKPT_MAGIC };
+  memcpy(hdr + 1, &gen, 4);
+  hdr[5] = _regionCount;
+
+  String tmp = String(_ckptPath) + ".tmp";
+  File f = LittleFS.open(tmp.c_str(), "w");
+  if (!f) { _needCheckpoint = true; return false; }
+  bool ok = f.write(hdr, sizeof(hdr)) == sizeof(hdr);
+  uint16_t crc = crc16(hdr, sizeof(hdr));
+  for (int i = 0; i < _regionCount && ok; i++) {
+    const Region& r = _regions[i];
+    uint8_t rh[3] = { r.id, (uint8_t)(r.len & 0xFF), (uint8_t)(r.len >> 8) };
+    ok = f.write(rh, 3) == 3 && f.write(r.shadow, r.len) == r.len;
+    crc = crc16(r.shadow, r.len, crc16(rh, 3, crc));
+  }
+  uint8_t c[2] = { (uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8) };
+  ok = ok && f.write(c, 2) == 2;
+  f.close();
+  if (!ok || !LittleFS.rename(tmp.c_str(), _ckptPath)) {
+    _needCheckpoint = true;
+    return false;
+  }
+
+  // Od tu velja nova generacija; star dnevnik bi se ob izpadu tudi ignoriral
+  LittleFS.remove(_jnlPath);
+  _gen = gen;
+  _stats.generation = gen;
+  _stats.journalBytes = 0;
+  _stats.checkpoints++;
+  _needCheckpoint = false;
+  return true;
+}
@@ -0,0 +1,78 @@
+#ifndef STATE_JOURNAL_H
+#define STATE_JOURNAL_H
+
+#include "config.h"
+
+// ============================================================================
+//  STATE JOURNAL — persistenca stanja kot checkpoint + dnevnik sprememb
+//
+//  Stanje so registrirane regije (ročne vrednosti univerz, master, group
+//  dimmerji). sync() primerja regije s senco zadnjega zapisa in na konec
+//  dnevnika doda en zapis s spremenjenimi runi:
+//    [len:2] + [id:1][start:2][n:1][n bajtov]... + [crc:2]
+//  Ko dnevnik preraste JOURNAL_MAX_BYTES (ali je sprememba večja od
+//  JOURNAL_MAX_RECORD), se celotno stanje zapiše v checkpoint (tmp + rename)
+//  z novo generacijo, dnevnik pa začne znova. Dnevnik nosi generacijo
+//  checkpointa, na katerega se nanaša — star dnevnik po izpadu med
+//  kompakcijo se ignorira. Ob zagonu: checkpoint, nato zapisi dnevnika do
+//  prvega s slabim CRC (prekinjen zapis) — tak rep sproži kompakcijo.
+//
+//  Ko piše drug task kot lastnik regij: capture() pod lockom lastnika
+//  (samo memcpy v stage), nato commit() brez locka. sync() = oboje.
+// ============================================================================
+
+#define JOURNAL_MAX_REGIONS   8
+#define JOURNAL_MAX_BYTES     4096    // Dnevnik → kompakcija
+#define JOURNAL_MAX_RECORD    320     // Večja sprememba gre naravnost v checkpoint
+#define JOURNAL_RUN_GAP       4       // Nespremenjeni bajti med runoma, ki se jih splača prepisati
+
+struct JournalStats {
+  uint32_t appends;          // Zapisi v dnevnik
+  uint32_t checkpoints;      // Kompakcije (celoten zapis stanja)
+  uint32_t journalBytes;     // Trenutna velikost dnevnika
+  uint32_t generation;
+  uint32_t lastSyncUs;       // Trajanje zadnjega sync()
+  uint32_t maxSyncUs;
+  uint32_t replayed;         // Zapisi, ponovljeni ob zagonu
+  bool     tornTail;         // Ob zagonu najden prekinjen zapis
+};
+
+class StateJournal {
+public:
+  void begin(const char* checkpointPath, const char* journalPath);
+  bool addRegion(uint8_t id, uint8_t* data, uint16_t len);   // Senca = trenutne vrednosti
+
+  // Checkpoint + dnevnik v registrirane regije. false = ni checkpointa
+  // (klicoč lahko naloži staro obliko in nato zahteva checkpoint()).
+  bool load();
+  void capture();             // Regije → stage (pod lockom lastnika)
+  bool commit();              // Stage proti senci → dnevnik (ali checkpoint)
+  bool sync() { capture(); return commit(); }
+  bool checkpoint();          // Celotno stanje, nova generacija, prazen dnevnik
+  void requestCheckpoint() { _needCheckpoint = true; }
+  bool isDirty() const;       // Regije se razlikujejo od sence (O(bajti))
+  void getStats(JournalStats& out) const { out = _stats; }
+
+private:
+  struct Region {
+    uint8_t  id;
+    uint16_t len;
+    uint8_t* data;
+    uint8_t* stage;            // Posnetek za zapis (PSRAM)
+    uint8_t* shadow;           // Zadnje zapisane vrednosti (PSRAM)
+  };
+  Region   _regions[JOURNAL_MAX_REGIONS];
+  uint8_t  _regionCount = 0;
+  const char* _ckptPath = nullptr;
+  const char* _jnlPath = nullptr;
+  uint32_t _gen = 0;
+  bool     _needCheckpoint = false;
+  JournalStats _stats = {};
+
+  Region*  findRegion(uint8_t id);
+  size_t   buildRecord(uint8_t* out, size_t cap);   // 0 = ni sprememb, >cap = prevelik
+  bool     replay(uint32_t gen);
+  bool     writeCheckpoint();
+};
+
+#endif
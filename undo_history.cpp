@@ -0,0 +1,180 @@
+#include "undo_history.h"
+
+static_assert((UNDO_RING_BYTES & (UNDO_RING_BYTES - 1)) == 0, "UNDO_RING_BYTES mora biti potenca 2");
+static_assert((UNDO_MAX_STEPS & (UNDO_MAX_STEPS - 1)) == 0, "UNDO_MAX_STEPS mora biti potenca 2");
+static_assert(UNDO_SLOTS * 5 <= UNDO_RING_BYTES, "Najdaljši korak mora v obroč");
+
+#define STEP(seq) _steps[(seq) & (UNDO_MAX_STEPS - 1)]
+
+bool UndoHistory::begin(const UndoTarget& t) {
+  _t = t;
+  if (!_ring) _ring = (uint8_t*)psramPreferMalloc(UNDO_RING_BYTES);
+  if (!_steps) _steps = (Step*)psramPreferMalloc(UNDO_MAX_STEPS * sizeof(Step));
+  clear();
+  if (!_ring || !_steps) {
+    Serial.println("[UNDO] NAPAKA: ne morem alocirati zgodovine!");
+    return false;
+  }
+  return true;
+}
+
+void UndoHistory::clear() {
+  _headPos = _tailPos = 0;
+  _oldest = _cursor = _end = 0;
+  resetPending();
+}
+
+void UndoHistory::resetPending() {
+  memset(_touched, 0, sizeof(_touched));
+  _pendingCount = 0;
+}
+
+uint8_t UndoHistory::get(uint16_t slot) const {
+  if (slot < DMX_MAX_CHANNELS) return _t.dmx[slot];
+  if (slot == UNDO_SLOT_MASTER) return *_t.master;
+  return _t.groups[slot - UNDO_SLOT_GROUP];
+}
+
+void UndoHistory::set(uint16_t slot, uint8_t v) {
+  if (slot < DMX_MAX_CHANNELS) _t.dmx[slot] = v;
+  else if (slot == UNDO_SLOT_MASTER) *_t.master = v;
+  else _t.groups[slot - UNDO_SLOT_GROUP] = v;
+}
+
+// ============================================================================
+//  ODPRT KORAK
+// ============================================================================
+
+void UndoHistory::touch(uint16_t slot, uint32_t nowMs) {
+  if (slot >= UNDO_SLOTS) return;
+  _lastTouchMs = nowMs;
+  uint32_t bit = 1UL << (slot & 31);
+  if (_touched[slot >> 5] & bit) return;
+  _touched[slot >> 5] |= bit;
+  _old[slot] = get(slot);
+  _pendingCount++;
+}
+
+void UndoHistory::touchDiff(const uint8_t* before, const uint8_t* after, uint32_t nowMs) {
+  _lastTouchMs = nowMs;
+  for (uint16_t i = 0; i < DMX_MAX_CHANNELS; i++) {
+    if (before[i] == after[i]) continue;
+    uint32_t bit = 1UL << (i & 31);
+    if (_touched[i >> 5] & bit) continue;
+    _touched[i >> 5] |= bit;
+    _old[i] = before[i];
+    _pendingCount++;
+  }
+}
+
+void UndoHistory::poll(uint32_t nowMs, bool hold) {
+  if (_pendingCount && !hold && nowMs - _lastTouchMs >= UNDO_COALESCE_MS) commit();
+}
+
+// ============================================================================
+//  ZAPIS KORAKA — O(dotaknjenih slotov), brez kopije celotnega stanja
+// ============================================================================
+
+bool UndoHistory::commit() {
+  if (!_pendingCount) return false;
+  if (!_ring || !_steps) { resetPending(); return false; }
+
+  // Run-i spremenjenih slotov (dotaknjen in vrednost != stara), naraščajoče.
+  // write=false samo prešteje bajte, write=true zapiše od pos naprej.
+  auto scan = [&](bool write, uint32_t pos, uint16_t& slots) -> uint32_t {
+    uint32_t start = pos;
+    int runStart = -1, runLen = 0;
+    auto flush = [&]() {
+      if (runLen == 0) return;
+      if (write) {
+        putByte(pos, runStart & 0xFF);
+        putByte(pos + 1, runStart >> 8);
+        putByte(pos + 2, runLen);
+        for (int k = 0; k < runLen; k++) {
+          putByte(pos + 3 + k, _old[runStart + k]);
+          putByte(pos + 3 + runLen + k, get(runStart + k));
+        }
+      }
+      pos += 3 + 2 * runLen;
+      slots += runLen;
+      runLen = 0;
+    };
+    for (int w = 0; w < (int)(sizeof(_touched) / 4); w++) {
+      uint32_t bits = _touched[w];
+      while (bits) {
+        int slot = w * 32 + __builtin_ctz(bits);
+        bits &= bits - 1;
+        if (_old[slot] == get(slot)) { flush(); continue; }
+        if (runLen && (slot != runStart + runLen || runLen == 255)) flush();
+        if (!runLen) runStart = slot;
+        runLen++;
+      }
+    }
+    flush();
+    return pos - start;
+  };
+
+  uint16_t slots = 0;
+  uint32_t len = scan(false, 0, slots);
+  if (len == 0) { resetPending(); return false; }   // Vrednosti so se vrnile
+
+  // Nov korak zavrže redo vejo
+  _end = _cursor;
+  _headPos = (_end != _oldest) ? STEP(_end - 1).pos + STEP(_end - 1).len : _tailPos;
+
+  // Prostor: izrini najstarejše korake
+  while (_end != _oldest &&
+         (_headPos + len - _tailPos > UNDO_RING_BYTES || _end - _oldest >= UNDO_MAX_STEPS)) {
+    evictOldest();
+  }
+
+  Step& s = STEP(_end);
+  s.pos = _headPos;
+  s.len = (uint16_t)len;
+  slots = 0;
+  scan(true, _headPos, slots);
+  s.slots = slots;
+  _headPos += len;
+  if (_end == _oldest) _tailPos = s.pos;
+  _end++;
+  _cursor = _end;
+  resetPending();
+  return true;
+}
+
+void UndoHistory::evictOldest() {
+  _oldest++;
+  if ((int32_t)(_cursor - _oldest) < 0) _cursor = _oldest;
+  _tailPos = (_oldest != _end) ? STEP(_oldest).pos : _headPos;
+}
+
+// ============================================================================
+//  UNDO / REDO
+// ============================================================================
+
+void UndoHistory::apply(const Step& s, bool forward) {
+  uint32_t pos = s.pos, end = s.pos + s.len;
+  while (pos < end) {
+    uint16_t start = getByte(pos) | (getByte(pos + 1) << 8);
+    uint8_t n = getByte(pos + 2);
+    uint32_t vals = pos + 3 + (forward ? n : 0);
+    for (int k = 0; k < n; k++) set(start + k, getByte(vals + k));
+    pos += 3 + 2 * n;
+  }
+}
+
+bool UndoHistory::undo() {
+  commit();   // Odprt korak (npr. poteg fejderja) je prvi, ki se razveljavi
+  if (_cursor == _oldest) return false;
+  _cursor--;
+  apply(STEP(_cursor), false);
+  return true;
+}
+
+bool UndoHistory::redo() {
+  commit();   // Prava sprememba po undo zavrže redo
+  if (_cursor == _end) return false;
+  apply(STEP(_cursor), true);
+  _cursor++;
+  return true;
+}
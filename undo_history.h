@@ -0,0 +1,89 @@
+#ifndef UNDO_HISTORY_H
+#define UNDO_HISTORY_H
+
+#include "config.h"
+
+// ============================================================================
+//  UNDO HISTORY — večnivojski undo/redo kot redke delte v krožnem bufferju
+//
+//  Stanje: ročne vrednosti univerze 0 + master + group dimmerji (UNDO_SLOTS).
+//  Ob prvi spremembi slota v koraku se zapomni stara vrednost (O(1)); korak
+//  se zapre ob pushUndo(), undo/redo ali po UNDO_COALESCE_MS mirovanja, tako
+//  da je poteg fejderja en korak. Zapis koraka so samo spremenjeni sloti:
+//    [start:2][n:1][n × stara][n × nova]   (zaporedni sloti v enem runu)
+//  Zapisi so v bajtnem obroču (PSRAM), indeks korakov v svojem obroču.
+//  Najstarejši koraki se izrinejo, nov korak po undo zavrže redo vejo.
+// ============================================================================
+
+#if HAS_PSRAM
+#define UNDO_RING_BYTES     32768   // ~500 korakov scen, tisoče fejder korakov
+#define UNDO_MAX_STEPS      512
+#else
+#define UNDO_RING_BYTES     4096
+#define UNDO_MAX_STEPS      64
+#endif
+#define UNDO_COALESCE_MS    700     // Mirovanje, ki zapre korak (poteg fejderja = 1 korak)
+
+#define UNDO_SLOT_MASTER    DMX_MAX_CHANNELS
+#define UNDO_SLOT_GROUP     (DMX_MAX_CHANNELS + 1)
+#define UNDO_SLOTS          (DMX_MAX_CHANNELS + 1 + MAX_GROUPS)
+
+// Kazalci na stanje, ki ga undo/redo prepisuje
+struct UndoTarget {
+  uint8_t* dmx;       // DMX_MAX_CHANNELS
+  uint8_t* master;
+  uint8_t* groups;    // MAX_GROUPS
+};
+
+class UndoHistory {
+public:
+  bool begin(const UndoTarget& t);            // Alocira obroča (PSRAM)
+  void clear();                               // Zavrže zgodovino in odprt korak
+
+  // Pred spremembo slota (stara vrednost je še v stanju)
+  void touch(uint16_t slot, uint32_t nowMs);
+  // Pred skupinsko spremembo DMX: zabeleži kanale, kjer se before in after razlikujeta
+  void touchDiff(const uint8_t* before, const uint8_t* after, uint32_t nowMs);
+
+  bool commit();                              // Zapri odprt korak (false = brez sprememb)
+  void poll(uint32_t nowMs, bool hold);       // Zapri po mirovanju (hold = npr. crossfade teče)
+
+  bool undo();                                // Stanje pred zadnjim korakom
+  bool redo();
+
+  bool     pending() const { return _pendingCount != 0; }
+  bool     hasUndo() const { return _pendingCount || _cursor != _oldest; }
+  bool     hasRedo() const { return !_pendingCount && _cursor != _end; }
+  uint16_t undoDepth() const { return (uint16_t)(_cursor - _oldest) + (_pendingCount ? 1 : 0); }
+  uint16_t redoDepth() const { return _pendingCount ? 0 : (uint16_t)(_end - _cursor); }
+  uint32_t usedBytes() const { return _headPos - _tailPos; }
+
+private:
+  struct Step {
+    uint32_t pos;      // Monoton odmik v obroču (& maska)
+    uint16_t len;
+    uint16_t slots;    // Število spremenjenih slotov
+  };
+
+  UndoTarget _t = {};
+  uint8_t* _ring = nullptr;                   // UNDO_RING_BYTES
+  Step*    _steps = nullptr;                  // UNDO_MAX_STEPS
+  uint32_t _headPos = 0, _tailPos = 0;        // Bajtni odmiki (konec najnovejšega, začetek najstarejšega)
+  uint32_t _oldest = 0, _cursor = 0, _end = 0; // Zaporedne številke korakov: [oldest, cursor) uveljavljeni
+
+  // Odprt korak: stare vrednosti dotaknjenih slotov
+  uint8_t  _old[UNDO_SLOTS];
+  uint32_t _touched[(UNDO_SLOTS + 31) / 32];
+  uint16_t _pendingCount = 0;
+  uint32_t _lastTouchMs = 0;
+
+  uint8_t  get(uint16_t slot) const;
+  void     set(uint16_t slot, uint8_t v);
+  void     resetPending();
+  void     evictOldest();
+  void     putByte(uint32_t pos, uint8_t v) { _ring[pos & (UNDO_RING_BYTES - 1)] = v; }
+  uint8_t  getByte(uint32_t pos) const { return _ring[pos & (UNDO_RING_BYTES - 1)]; }
+  void     apply(const Step& s, bool forward);
+};
+
+#endif
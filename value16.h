@@ -0,0 +1,52 @@
+#ifndef VALUE16_H
+#define VALUE16_H
+
+#include <stdint.h>
+
+// ============================================================================
+//  16-bit vrednosti coarse/fine parov (PatchPair)
+//  Bufferji ostanejo 8-bitni (512 B); par se prebere kot ena 16-bit vrednost,
+//  obdela (fade, omejitve, dimmer, efekti) in razdeli nazaj šele ob zapisu.
+//  Skupno vsem enginom, da nihče ne ponavlja svoje 16-bit aritmetike.
+// ============================================================================
+
+static inline uint16_t get16(const uint8_t* buf, uint16_t coarse, uint16_t fine) {
+  return ((uint16_t)buf[coarse] << 8) | buf[fine];
+}
+
+static inline void put16(uint8_t* buf, uint16_t coarse, uint16_t fine, uint16_t v) {
+  buf[coarse] = (uint8_t)(v >> 8);
+  buf[fine]   = (uint8_t)(v & 0xFF);
+}
+
+// 8-bit meja → 16-bit (0 → 0, 255 → 65535)
+static inline uint16_t expand16(uint8_t v) {
+  return (uint16_t)(v * 257);
+}
+
+// from + (to - from) * a, a v Q16 (0..65536)
+static inline uint16_t lerp16(uint16_t from, uint16_t to, uint32_t a) {
+  int32_t diff = (int32_t)to - (int32_t)from;
+  return (uint16_t)(from + (int32_t)(((int64_t)diff * a) >> 16));
+}
+
+// lo + v*(hi-lo)/65535 (pan/tilt omejitve na 8-bit mejah; lo > hi = obrnjen obseg)
+static inline uint16_t remap16(uint16_t v, uint8_t lo, uint8_t hi) {
+  uint16_t l = expand16(lo), h = expand16(hi);
+  return (uint16_t)((int32_t)l + (int32_t)(((int64_t)v * ((int32_t)h - (int32_t)l)) / 65535));
+}
+
+// v * d / 255 (8-bit dimmer na 16-bit vrednosti)
+static inline uint16_t scale16(uint16_t v, uint8_t d) {
+  return (uint16_t)(((uint32_t)v * d) / 255);
+}
+
+// base + offset, omejeno na 0..65535 (modulacija efektov)
+static inline uint16_t offset16(uint16_t base, int32_t offset) {
+  int32_t r = (int32_t)base + offset;
+  if (r < 0) r = 0;
+  if (r > 65535) r = 65535;
+  return (uint16_t)r;
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include "web_ui.h"
 #include "config_store.h"
+#include "metrics.h"
+#include "persist.h"
 #include <WiFi.h>
 #include <ArduinoJson.h>
 #include <LittleFS.h>
@@ -17,10 +19,14 @@ static AudioInput*     _aud = nullptr;
 static AsyncWebSocket* _ws  = nullptr;
 static LfoEngine*      _lfo = nullptr;
 static ShapeGenerator* _shapeGen = nullptr;
+static PlaybackEngine* _pbk = nullptr;
+static LaunchQueue*    _lq  = nullptr;
 #if defined(CONFIG_IDF_TARGET_ESP32S3)
 static PixelMapper*    _pxMap = nullptr;
 #endif
 static EspNowDmx*      _espNow = nullptr;
+static DmxOutput*      _dmxOut = nullptr;
+static FrameClock*     _clock = nullptr;
 static unsigned long   _lastWsSend = 0;
 static bool            _dmxMonActive = false;
 static bool            _forceSendState = false;  // Trigger immediate full state broadcast
@@ -31,6 +37,14 @@ static bool            _forceSendState = false;  // Trigger immediate full state
 //  WebSocket handler
 // ============================================================================
 
+// Kvantiziran ukaz ("q" = beati do meje): v vrsto, izvede ga frame task
+static bool launchQ(JsonDocument& doc, uint8_t action, int arg, uint32_t fadeMs = 0, uint8_t curve = 0) {
+  uint8_t q = doc["q"] | 0;
+  if (!q || !_lq) return false;
+  _lq->enqueue(action, q, (int16_t)arg, fadeMs, curve);
+  return true;
+}
+
 static void onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client,
                       AwsEventType type, void* arg, uint8_t* data, size_t len) {
   if (type == WS_EVT_CONNECT) {
@@ -109,21 +123,32 @@ static void onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client,
   else if (strcmp(cmd, "grpdim") == 0) _mix->setGroupDimmer(doc["g"]|0, doc["v"]|255);
   else if (strcmp(cmd, "blackout") == 0) { if(doc["v"]|0) _mix->blackout(); else _mix->unBlackout(); }
   else if (strcmp(cmd, "flash") == 0) _mix->setFlash((doc["v"]|0)!=0, doc["l"]|255);
-  else if (strcmp(cmd, "mode") == 0) { const char* m=doc["v"]; if(m&&strcmp(m,"local")==0) _mix->switchToLocal(); else if(m&&strcmp(m,"artnet")==0) _mix->switchToArtNet(); else if(m&&strcmp(m,"primary_local")==0) _mix->switchToPrimaryLocal(); }
+  else if (strcmp(cmd, "mode") == 0) { const char* m=doc["v"]; if(m&&strcmp(m,"local")==0) _mix->switchToLocal(); else if(m&&strcmp(m,"artnet")==0) _mix->switchToArtNet(); else if(m&&strcmp(m,"primary_local")==0) _mix->switchToPrimaryLocal(); else if(m&&strcmp(m,"merge")==0) _mix->switchToMerge(); }
   else if (strcmp(cmd, "switchToArtnet") == 0) _mix->switchToArtNet();
   else if (strcmp(cmd, "recall") == 0) _mix->recallSnapshot(doc["i"]|0);
   else if (strcmp(cmd, "recall_artnet") == 0) _mix->recallArtNetShadow();
-  else if (strcmp(cmd, "scene_recall") == 0) _mix->recallScene(doc["slot"]|-1, doc["fade"]|CROSSFADE_DEFAULT_MS);
+  else if (strcmp(cmd, "scene_recall") == 0) {
+    int slot = doc["slot"]|-1; uint32_t fade = doc["fade"]|CROSSFADE_DEFAULT_MS; uint8_t curve = doc["curve"]|0;
+    if (!launchQ(doc, LA_SCENE, slot, fade, curve)) _mix->recallScene(slot, fade, curve);
+  }
   else if (strcmp(cmd, "undo") == 0) _mix->undo();
+  else if (strcmp(cmd, "redo") == 0) _mix->redo();
   else if (strcmp(cmd, "locate") == 0) _mix->locateFixture(doc["f"]|0, (doc["on"]|0)!=0);
   else if (strcmp(cmd, "dmxmon") == 0) _dmxMonActive = (doc["on"]|0) != 0;
-  else if (strcmp(cmd, "cue_go") == 0 && _scn) _scn->cueGo(_mix);
+  else if (strcmp(cmd, "cue_go") == 0 && _scn) { if (!launchQ(doc, LA_CUE_GO, 0)) _scn->cueGo(_mix); }
   else if (strcmp(cmd, "cue_back") == 0 && _scn) _scn->cueBack(_mix);
-  else if (strcmp(cmd, "cue_goto") == 0 && _scn) _scn->cueGoTo(doc["i"]|0, _mix);
+  else if (strcmp(cmd, "cue_goto") == 0 && _scn) { if (!launchQ(doc, LA_CUE_GOTO, doc["i"]|0)) _scn->cueGoTo(doc["i"]|0, _mix); }
   else if (strcmp(cmd, "cue_stop") == 0 && _scn) _scn->cueStop();
-  else if (strcmp(cmd, "cue_add") == 0 && _scn) { _scn->addCue(doc["s"]|-1, doc["f"]|1500, doc["a"]|0, doc["l"]|""); _scn->saveCueList(); }
+  else if (strcmp(cmd, "cue_add") == 0 && _scn) { CueTiming t[CUE_TG_COUNT]; SceneEngine::timingFromJson(doc["t"], t); _scn->addCue(doc["s"]|-1, doc["f"]|1500, doc["a"]|0, doc["l"]|"", doc["c"]|0, t); _scn->saveCueList(); }
   else if (strcmp(cmd, "cue_rm") == 0 && _scn) { _scn->removeCue(doc["i"]|0); _scn->saveCueList(); }
-  else if (strcmp(cmd, "cue_upd") == 0 && _scn) { _scn->updateCue(doc["i"]|0, doc["s"]|-1, doc["f"]|1500, doc["a"]|0, doc["l"]|""); _scn->saveCueList(); }
+  else if (strcmp(cmd, "cue_upd") == 0 && _scn) { CueTiming t[CUE_TG_COUNT]; SceneEngine::timingFromJson(doc["t"], t); _scn->updateCue(doc["i"]|0, doc["s"]|-1, doc["f"]|1500, doc["a"]|0, doc["l"]|"", doc["c"]|0, doc["t"].isNull()?nullptr:t); _scn->saveCueList(); }
+  else if (strcmp(cmd, "pb_assign") == 0 && _pbk) _pbk->assign(doc["i"]|0, doc["s"]|-1);
+  else if (strcmp(cmd, "pb_level") == 0 && _pbk) _pbk->setLevel(doc["i"]|0, doc["v"]|0);
+  else if (strcmp(cmd, "pb_go") == 0 && _pbk) { if (!launchQ(doc, LA_PB_GO, doc["i"]|0, doc["f"]|0)) _pbk->go(doc["i"]|0, doc["f"]|0); }
+  else if (strcmp(cmd, "pb_rel") == 0 && _pbk) { if (!launchQ(doc, LA_PB_RELEASE, doc["i"]|0, doc["f"]|0)) _pbk->release(doc["i"]|0, doc["f"]|0); }
+  else if (strcmp(cmd, "pb_flash") == 0 && _pbk) _pbk->setFlash(doc["i"]|0, (doc["on"]|0)!=0);
+  else if (strcmp(cmd, "pb_relall") == 0 && _pbk) _pbk->releaseAll(doc["f"]|0);
+  else if (strcmp(cmd, "launch_cancel") == 0 && _lq) _lq->cancelAll();
   else if (strcmp(cmd, "lfo_add") == 0 && _lfo) {
     LfoInstance l = {}; l.active = true;
     l.waveform = doc["w"] | 0; l.target = doc["tgt"] | 0;
@@ -249,6 +274,9 @@ static void onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client,
   else if (strcmp(cmd, "mb_bpm") == 0 && _snd) {
     _snd->setManualBpm(doc["v"] | 120.0f);
   }
+  else if (strcmp(cmd, "mb_prog") == 0 && _snd) {
+    if (!launchQ(doc, LA_PROGRAM, doc["p"]|0)) _snd->setProgram(doc["p"]|0);
+  }
   else if (strcmp(cmd, "mb_cfg") == 0 && _snd) {
     ManualBeatConfig& mb = _snd->getManualBeatConfig();
     mb.enabled      = (doc["en"]|0) != 0;
@@ -305,6 +333,8 @@ static void onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client,
         ch.count++;
       }
     }
+    // Kvantiziran start: veriga miruje do meje, nato začne od prvega vnosa
+    if (ch.active && launchQ(doc, LA_CHAIN, 1)) ch.active = false;
   }
   // Pixel Mapper commands
   #if defined(CONFIG_IDF_TARGET_ESP32S3)
@@ -331,7 +361,7 @@ static void onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client,
       uint8_t mac[6];
       sscanf(macStr, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
              &mac[0],&mac[1],&mac[2],&mac[3],&mac[4],&mac[5]);
-      _espNow->addPeer(mac, doc["name"] | "Slave");
+      _espNow->addPeer(mac, doc["name"] | "Slave", doc["u"] | 0);
     }
   }
   else if (strcmp(cmd, "now_rm") == 0 && _espNow) {
@@ -356,6 +386,13 @@ static size_t _postLen = 0;
   memcpy(_postBuf+_postLen,data,cpLen); _postLen+=cpLen; _postBuf[_postLen]=0; \
   if(index+len<total)return;
 
+// Pred restartom: mixer stanje + vse čakajoče zapise na flash, nato nič več
+static void flushForRestart() {
+  if (_pbk) _pbk->saveNow();
+  if (_mix) _mix->saveStateNow();
+  persistShutdown();
+}
+
 static void apiGetConfig(AsyncWebServerRequest* req) {
   JsonDocument doc;
   doc["hostname"]=_cfg->hostname; doc["universe"]=_cfg->universe; doc["channelCount"]=_cfg->channelCount;
@@ -368,7 +405,11 @@ static void apiGetConfig(AsyncWebServerRequest* req) {
   doc["staticGw"]=_cfg->staticGw; doc["staticSn"]=_cfg->staticSn; doc["audioSource"]=_cfg->audioSource;
   doc["authEnabled"]=_cfg->authEnabled; doc["authUser"]=_cfg->authUser;
   doc["artnetTimeoutSec"]=_cfg->artnetTimeoutSec; doc["artnetPrimaryMode"]=_cfg->artnetPrimaryMode;
+  doc["artnetPriority"]=_cfg->artnetPriority; doc["localPriority"]=_cfg->localPriority; doc["oscPriority"]=_cfg->oscPriority;
+  doc["oscTimeoutSec"]=_cfg->oscTimeoutSec; doc["htpTypeMask"]=_cfg->htpTypeMask;
   doc["artnetOutEnabled"]=_cfg->artnetOutEnabled; doc["sacnEnabled"]=_cfg->sacnEnabled;
+  doc["dmxRefreshMode"]=_cfg->dmxRefreshMode; doc["dmxMaxFps"]=_cfg->dmxMaxFps;
+  doc["launchLatencyMs"]=_cfg->launchLatencyMs;
   doc["version"]=FW_VERSION " " __DATE__; doc["ip"]=WiFi.localIP().toString(); doc["mac"]=WiFi.macAddress();
   doc["mdns"]=String("http://") + _cfg->hostname + ".local";
   String json; serializeJson(doc,json); req->send(200,"application/json",json);
@@ -402,20 +443,68 @@ static void apiPostConfig(AsyncWebServerRequest* req, uint8_t* data, size_t len,
   if(doc["authPass"].is<const char*>()&&strlen(doc["authPass"])>0) strlcpy(_cfg->authPass,doc["authPass"],sizeof(_cfg->authPass));
   if(!doc["artnetTimeoutSec"].isNull()) _cfg->artnetTimeoutSec=doc["artnetTimeoutSec"]|_cfg->artnetTimeoutSec;
   if(!doc["artnetPrimaryMode"].isNull()) _cfg->artnetPrimaryMode=doc["artnetPrimaryMode"]|false;
+  if(!doc["artnetPriority"].isNull()) _cfg->artnetPriority=doc["artnetPriority"]|_cfg->artnetPriority;
+  if(!doc["localPriority"].isNull()) _cfg->localPriority=doc["localPriority"]|_cfg->localPriority;
+  if(!doc["oscPriority"].isNull()) _cfg->oscPriority=doc["oscPriority"]|_cfg->oscPriority;
+  if(!doc["oscTimeoutSec"].isNull()) _cfg->oscTimeoutSec=doc["oscTimeoutSec"]|_cfg->oscTimeoutSec;
+  if(!doc["htpTypeMask"].isNull()) _cfg->htpTypeMask=doc["htpTypeMask"]|_cfg->htpTypeMask;
   if(!doc["artnetOutEnabled"].isNull()) _cfg->artnetOutEnabled=doc["artnetOutEnabled"]|false;
   if(!doc["sacnEnabled"].isNull()) _cfg->sacnEnabled=doc["sacnEnabled"]|false;
+  if(!doc["dmxRefreshMode"].isNull()) _cfg->dmxRefreshMode=(doc["dmxRefreshMode"]|0)==DMX_REFRESH_ADAPTIVE?DMX_REFRESH_ADAPTIVE:DMX_REFRESH_FIXED;
+  if(!doc["dmxMaxFps"].isNull()) _cfg->dmxMaxFps=doc["dmxMaxFps"]|0;
+  if(!doc["launchLatencyMs"].isNull()) _cfg->launchLatencyMs=doc["launchLatencyMs"]|0;
 
   bool ok=configSave(*_cfg); req->send(200,"application/json",ok?"{\"ok\":true}":"{\"ok\":false}");
-  if(ok){delay(500);ESP.restart();}
+  if(ok){flushForRestart();delay(500);ESP.restart();}
 }
 
+// Vrednosti univerz fixture-ov za en odgovor. Izhod (in ArtNet način) iz
+// objavljenega frame-a (readFrame), ročne vrednosti kopirane pod mixer lockom;
+// vsaka univerza se prebere enkrat, ob prvem fixture-u na njej. frame0 =
+// objavljen frame univerze 0, ki ga klicoč že ima. nullptr = ni alocirana.
+struct UniverseValues {
+  const uint8_t* frame0;
+  bool    output;
+  uint8_t loaded;                              // Bit = univerza prebrana
+  uint8_t avail;                               // Bit = univerza alocirana
+  DmxFrame tmp;
+  uint8_t data[MAX_UNIVERSES][DMX_MAX_CHANNELS];
+
+  void reset(const uint8_t* f0, bool out) { frame0=f0; output=out; loaded=0; avail=0; }
+  const uint8_t* get(uint8_t u) {
+    if (u >= MAX_UNIVERSES) return nullptr;
+    bool out = output || _mix->getMode()==CTRL_ARTNET;
+    if (u == 0 && out) return frame0;
+    uint8_t bit = 1 << u;
+    if (!(loaded & bit)) {
+      loaded |= bit;
+      bool ok;
+      if (out) {
+        ok = _mix->readFrame(u, tmp);
+        if (ok) memcpy(data[u], tmp.data, DMX_MAX_CHANNELS);
+      } else {
+        _mix->lock();
+        const uint8_t* m = _mix->getManualValues(u);
+        ok = m != nullptr;
+        if (ok) memcpy(data[u], m, DMX_MAX_CHANNELS);
+        _mix->unlock();
+      }
+      if (ok) avail |= bit;
+    }
+    return (avail & bit) ? data[u] : nullptr;
+  }
+};
+
 static void apiGetFixtures(AsyncWebServerRequest* req) {
+  static DmxFrame frame; _mix->readFrame(frame);
+  static UniverseValues uv; uv.reset(frame.data,false);
   JsonDocument doc;
   JsonArray fArr=doc["fixtures"].to<JsonArray>();
   for(int i=0;i<MAX_FIXTURES;i++){
     const PatchEntry* fx=_fix->getFixture(i); if(!fx||!fx->active)continue;
     JsonObject o=fArr.add<JsonObject>(); o["idx"]=i; o["name"]=fx->name; o["profileId"]=fx->profileId;
     o["dmxAddress"]=fx->dmxAddress; o["groupMask"]=fx->groupMask; o["soundReactive"]=fx->soundReactive;
+    if(fx->universe>0) o["universe"]=fx->universe;
     if(fx->invertPan) o["invertPan"]=true; if(fx->invertTilt) o["invertTilt"]=true;
     if(fx->panMin>0) o["panMin"]=fx->panMin; if(fx->panMax<255) o["panMax"]=fx->panMax;
     if(fx->tiltMin>0) o["tiltMin"]=fx->tiltMin; if(fx->tiltMax<255) o["tiltMax"]=fx->tiltMax;
@@ -424,11 +513,11 @@ static void apiGetFixtures(AsyncWebServerRequest* req) {
       if(p){
         if(p->zoomMin||p->zoomMax){o["zoomMin"]=p->zoomMin;o["zoomMax"]=p->zoomMax;}
         JsonArray cArr=o["channels"].to<JsonArray>();
-        const uint8_t* vals=(_mix->getMode()==CTRL_ARTNET)?_mix->getDmxOutput():_mix->getManualValues();
+        const uint8_t* vals=uv.get(fx->universe);
         for(int c=0;c<p->channelCount;c++){JsonObject ch=cArr.add<JsonObject>(); ch["name"]=p->channels[c].name;
-          ch["type"]=p->channels[c].type; ch["default"]=p->channels[c].defaultValue;
+          ch["type"]=p->channels[c].type; ch["default"]=p->channels[c].defaultValue; if(p->channels[c].fine) ch["fine"]=true;
           uint16_t addr=fx->dmxAddress+c-1;
-          ch["currentValue"]=(addr<DMX_MAX_CHANNELS)?vals[addr]:0;
+          ch["currentValue"]=(vals&&addr<DMX_MAX_CHANNELS)?vals[addr]:0;
           if(p->channels[c].rangeCount>0){JsonArray rArr=ch["ranges"].to<JsonArray>();
             for(int r=0;r<p->channels[c].rangeCount;r++){JsonObject ro=rArr.add<JsonObject>();
               ro["from"]=p->channels[c].ranges[r].from; ro["to"]=p->channels[c].ranges[r].to; ro["label"]=p->channels[c].ranges[r].label;}}}}}
@@ -446,13 +535,13 @@ static void apiPostFixtures(AsyncWebServerRequest* req, uint8_t* data, size_t le
   JsonDocument doc; if(deserializeJson(doc,_postBuf)){req->send(400,"application/json","{\"ok\":false}");return;}
   const char* action=doc["action"]; bool ok=false;
   if(strcmp(action,"add")==0){JsonObject fx=doc["fixture"];
-    ok=_fix->addFixture(fx["name"]|"?",fx["profileId"]|"",fx["dmxAddress"]|1,fx["groupMask"]|0,fx["soundReactive"]|false);
+    ok=_fix->addFixture(fx["name"]|"?",fx["profileId"]|"",fx["dmxAddress"]|1,fx["groupMask"]|0,fx["soundReactive"]|false,fx["universe"]|0);
     // Apliciraj default vrednosti kanalov (npr. Pan=128, Tilt=128 za center)
     if(ok){
       for(int i=0;i<MAX_FIXTURES;i++){
         const PatchEntry* pe=_fix->getFixture(i);
         if(!pe||!pe->active||pe->profileIndex<0)continue;
-        if(strcmp(pe->profileId,fx["profileId"]|"")!=0||pe->dmxAddress!=(fx["dmxAddress"]|1))continue;
+        if(strcmp(pe->profileId,fx["profileId"]|"")!=0||pe->dmxAddress!=(fx["dmxAddress"]|1)||pe->universe!=(fx["universe"]|0))continue;
         const FixtureProfile* p=_fix->getProfile(pe->profileIndex);
         if(p){for(int c=0;c<p->channelCount;c++){if(p->channels[c].defaultValue)_mix->setFixtureChannel(i,c,p->channels[c].defaultValue);}}
         break;
@@ -466,6 +555,7 @@ static void apiPostFixtures(AsyncWebServerRequest* req, uint8_t* data, size_t le
       if(!doc["fixture"]["name"].isNull()) strlcpy(fx->name, doc["fixture"]["name"]|"", sizeof(fx->name));
       if(!doc["fixture"]["dmxAddress"].isNull()) fx->dmxAddress=doc["fixture"]["dmxAddress"]|1;
       if(!doc["fixture"]["groupMask"].isNull()) fx->groupMask=doc["fixture"]["groupMask"]|0;
+      if(!doc["fixture"]["universe"].isNull()) fx->universe=doc["fixture"]["universe"]|0;
       if(!doc["fixture"]["soundReactive"].isNull()) fx->soundReactive=doc["fixture"]["soundReactive"]|false;
       if(!doc["fixture"]["invertPan"].isNull()) fx->invertPan=doc["fixture"]["invertPan"]|false;
       if(!doc["fixture"]["invertTilt"].isNull()) fx->invertTilt=doc["fixture"]["invertTilt"]|false;
@@ -473,6 +563,7 @@ static void apiPostFixtures(AsyncWebServerRequest* req, uint8_t* data, size_t le
       if(!doc["fixture"]["panMax"].isNull()) fx->panMax=doc["fixture"]["panMax"]|255;
       if(!doc["fixture"]["tiltMin"].isNull()) fx->tiltMin=doc["fixture"]["tiltMin"]|0;
       if(!doc["fixture"]["tiltMax"].isNull()) fx->tiltMax=doc["fixture"]["tiltMax"]|255;
+      _fix->rebuildPatchMap();  // Naslov/skupine so se morda spremenili
       ok=true;
     }
   }
@@ -506,13 +597,15 @@ static void apiPostGroups(AsyncWebServerRequest* req, uint8_t* data, size_t len,
 
 static void apiGetScenes(AsyncWebServerRequest* req) {
   JsonDocument doc; JsonArray arr=doc["scenes"].to<JsonArray>();
-  for(int i=0;i<MAX_SCENES;i++){const Scene* sc=_scn->getScene(i);
-    if(sc){JsonObject o=arr.add<JsonObject>();o["slot"]=i;o["name"]=sc->name;
+  Scene scn; const Scene* sc=&scn;     // Kopija iz banke (cache frame taska ostane)
+  for(int i=0;i<MAX_SCENES;i++){
+    if(_scn->sceneExists(i)&&_scn->readScene(i,scn)){JsonObject o=arr.add<JsonObject>();o["slot"]=i;o["name"]=sc->name;
+      if(!(sc->flags&SCENE_FULL))o["p"]=1;   // Delna: priklic zapiše samo določene kanale
       // Preview: izračunaj barvo za vsak fixture
       JsonArray prev=o["prev"].to<JsonArray>();
       for(int fi=0;fi<MAX_FIXTURES;fi++){
         const PatchEntry* fx=_fix->getFixture(fi);
-        if(!fx||!fx->active||fx->profileIndex<0){prev.add(nullptr);continue;}
+        if(!fx||!fx->active||fx->profileIndex<0||fx->universe>0){prev.add(nullptr);continue;}  // Scene so na univerzi 0
         uint8_t r=0,g=0,b=0,dim=255;
         uint8_t chCnt=_fix->fixtureChannelCount(fi);
         for(int c=0;c<chCnt;c++){
@@ -538,8 +631,13 @@ static void apiPostScenes(AsyncWebServerRequest* req, uint8_t* data, size_t len,
   POST_ACCUM(data,len,index,total)
   JsonDocument doc; if(deserializeJson(doc,_postBuf)){req->send(400,"application/json","{\"ok\":false}");return;}
   const char* action=doc["action"]; bool ok=false; int slot=-1;
-  if(strcmp(action,"save")==0){slot=_scn->findFreeSlot();if(slot>=0)ok=_mix->saveCurrentAsScene(slot,doc["name"]|"Scena");}
-  else if(strcmp(action,"overwrite")==0){slot=doc["slot"]|-1;if(slot>=0)ok=_mix->saveCurrentAsScene(slot,doc["name"]|"Scena");}
+  // Delna scena: "ch" = naslovi (1-512), ki jih scena določa; brez "ch" ročno nastavljeni kanali
+  uint32_t chMask[DMX_MAX_CHANNELS/32]={0}; const uint32_t* mask=nullptr;
+  JsonArray chArr=doc["ch"].as<JsonArray>();
+  if(chArr){for(JsonVariant v:chArr){int a=(v.as<int>())-1;if(a>=0&&a<DMX_MAX_CHANNELS)chMask[a>>5]|=1UL<<(a&31);}mask=chMask;}
+  if(strcmp(action,"save")==0){slot=_scn->findFreeSlot();if(slot>=0)ok=_mix->saveCurrentAsScene(slot,doc["name"]|"Scena",doc["partial"]|false,mask);}
+  else if(strcmp(action,"overwrite")==0){slot=doc["slot"]|-1;if(slot>=0)ok=_mix->saveCurrentAsScene(slot,doc["name"]|"Scena",doc["partial"]|false,mask);}
+  else if(strcmp(action,"untouch")==0){_mix->clearTouched();ok=true;}
   else if(strcmp(action,"rename")==0){slot=doc["slot"]|-1;if(slot>=0)ok=_scn->renameScene(slot,doc["name"]|"");}
   else if(strcmp(action,"delete")==0){slot=doc["slot"]|-1;if(slot>=0)ok=_scn->deleteScene(slot);}
   JsonDocument resp; resp["ok"]=ok; resp["slot"]=slot; String json; serializeJson(resp,json); req->send(200,"application/json",json);
@@ -586,7 +684,7 @@ static void apiPostSoundRules(AsyncWebServerRequest* req, uint8_t* data, size_t
 }
 
 static void apiFactoryReset(AsyncWebServerRequest* req) {
-  LittleFS.format(); req->send(200,"application/json","{\"ok\":true}"); delay(500); ESP.restart();
+  persistShutdown(); LittleFS.format(); req->send(200,"application/json","{\"ok\":true}"); delay(500); ESP.restart();
 }
 
 // ============================================================================
@@ -607,24 +705,120 @@ static String sanitizeFilename(const char* name) {
 }
 
 // Helper: encode 512 bytes DMX → base64 string
-static String dmxToBase64(const uint8_t* dmx) {
+static String dmxToBase64(const uint8_t* dmx, size_t len = DMX_MAX_CHANNELS) {
   size_t olen = 0;
   // First call to get output length
-  mbedtls_base64_encode(NULL, 0, &olen, dmx, DMX_MAX_CHANNELS);
+  mbedtls_base64_encode(NULL, 0, &olen, dmx, len);
   char* buf = (char*)malloc(olen + 1);
   if (!buf) return "";
-  mbedtls_base64_encode((unsigned char*)buf, olen + 1, &olen, dmx, DMX_MAX_CHANNELS);
+  mbedtls_base64_encode((unsigned char*)buf, olen + 1, &olen, dmx, len);
   buf[olen] = '\0';
   String s(buf);
   free(buf);
   return s;
 }
 
-// Helper: decode base64 → 512 bytes DMX
-static bool base64ToDmx(const char* b64, uint8_t* dmx) {
+// Helper: decode base64 → 512 bytes DMX (ali len bajtov, npr. maska delne scene)
+static bool base64ToDmx(const char* b64, uint8_t* dmx, size_t len = DMX_MAX_CHANNELS) {
   size_t olen = 0;
-  int ret = mbedtls_base64_decode(dmx, DMX_MAX_CHANNELS, &olen, (const unsigned char*)b64, strlen(b64));
-  return (ret == 0 && olen == DMX_MAX_CHANNELS);
+  int ret = mbedtls_base64_decode(dmx, len, &olen, (const unsigned char*)b64, strlen(b64));
+  return (ret == 0 && olen == len);
+}
+
+// GET /api/metrics — Prometheus text format: histogrami časov korakov realtime zanke (metrics.h)
+static void apiGetMetrics(AsyncWebServerRequest* req) {
+  String out; metricsWritePrometheus(out);
+  if(_dmxOut){
+    DmxTxStats st; _dmxOut->getStats(st); char line[96];
+    snprintf(line,sizeof(line),"# TYPE dmx_tx_frames_total counter\ndmx_tx_frames_total %lu\n",(unsigned long)st.frames); out+=line;
+    snprintf(line,sizeof(line),"# TYPE dmx_tx_dropped_total counter\ndmx_tx_dropped_total %lu\n",(unsigned long)st.dropped); out+=line;
+    snprintf(line,sizeof(line),"# TYPE dmx_tx_refresh_hz gauge\ndmx_tx_refresh_hz %.2f\n",st.refreshHz); out+=line;
+    snprintf(line,sizeof(line),"# TYPE dmx_tx_interval_seconds gauge\ndmx_tx_interval_seconds %.6f\n",st.intervalUs*1e-6f); out+=line;
+    snprintf(line,sizeof(line),"# TYPE dmx_tx_jitter_seconds gauge\ndmx_tx_jitter_seconds %.6f\n",st.jitterUs*1e-6f); out+=line;
+    snprintf(line,sizeof(line),"# TYPE dmx_tx_frame_seconds gauge\ndmx_tx_frame_seconds %.6f\n",st.frameUs*1e-6f); out+=line;
+  }
+  if(_clock){
+    FrameClockStats fc; _clock->getStats(fc); char line[96];
+    snprintf(line,sizeof(line),"# TYPE frame_clock_frames_total counter\nframe_clock_frames_total %lu\n",(unsigned long)fc.frames); out+=line;
+    snprintf(line,sizeof(line),"# TYPE frame_clock_missed_total counter\nframe_clock_missed_total %lu\n",(unsigned long)fc.missed); out+=line;
+    snprintf(line,sizeof(line),"# TYPE frame_clock_overruns_total counter\nframe_clock_overruns_total %lu\n",(unsigned long)fc.overruns); out+=line;
+    snprintf(line,sizeof(line),"# TYPE frame_clock_rate_hz gauge\nframe_clock_rate_hz %.2f\n",fc.rateHz); out+=line;
+    snprintf(line,sizeof(line),"# TYPE frame_clock_jitter_seconds gauge\nframe_clock_jitter_seconds %.6f\n",fc.jitterUs*1e-6f); out+=line;
+    snprintf(line,sizeof(line),"# TYPE frame_clock_late_max_seconds gauge\nframe_clock_late_max_seconds %.6f\n",fc.maxLateUs*1e-6f); out+=line;
+    snprintf(line,sizeof(line),"# TYPE frame_clock_work_max_seconds gauge\nframe_clock_work_max_seconds %.6f\n",fc.maxWorkUs*1e-6f); out+=line;
+  }
+  if(_mix){
+    char line[96];
+    snprintf(line,sizeof(line),"# TYPE mixer_universes gauge\nmixer_universes %d\n",__builtin_popcount(_mix->getUniverseMask())); out+=line;
+    snprintf(line,sizeof(line),"# TYPE mixer_universe_pool_bytes gauge\nmixer_universe_pool_bytes %u\n",(unsigned)_mix->getUniversePoolBytes()); out+=line;
+    SnapshotCodecStats ss; _mix->getSnapshotStats(ss);
+    snprintf(line,sizeof(line),"# TYPE mixer_snapshots gauge\nmixer_snapshots %u\n",(unsigned)ss.count); out+=line;
+    snprintf(line,sizeof(line),"# TYPE mixer_snapshot_bytes gauge\nmixer_snapshot_bytes %u\n",(unsigned)ss.poolBytes); out+=line;
+    snprintf(line,sizeof(line),"# TYPE mixer_snapshot_raw_bytes gauge\nmixer_snapshot_raw_bytes %u\n",(unsigned)ss.rawBytes); out+=line;
+    PersistStats ps; persistGetStats(ps);
+    snprintf(line,sizeof(line),"# TYPE persist_requests_total counter\npersist_requests_total %u\n",(unsigned)ps.requests); out+=line;
+    snprintf(line,sizeof(line),"# TYPE persist_coalesced_total counter\npersist_coalesced_total %u\n",(unsigned)ps.coalesced); out+=line;
+    snprintf(line,sizeof(line),"# TYPE persist_pending gauge\npersist_pending %u\n",(unsigned)ps.pending); out+=line;
+    snprintf(line,sizeof(line),"# TYPE persist_write_max_seconds gauge\npersist_write_max_seconds %.6f\n",ps.maxWriteUs/1e6); out+=line;
+    if(_scn){
+      SceneBankStats bs; _scn->getBankStats(bs);
+      snprintf(line,sizeof(line),"# TYPE scene_bank_scenes gauge\nscene_bank_scenes %u\n",(unsigned)bs.used); out+=line;
+      snprintf(line,sizeof(line),"# TYPE scene_bank_cache_hits_total counter\nscene_bank_cache_hits_total %u\n",(unsigned)bs.hits); out+=line;
+      snprintf(line,sizeof(line),"# TYPE scene_bank_cache_misses_total counter\nscene_bank_cache_misses_total %u\n",(unsigned)bs.misses); out+=line;
+      out+="# TYPE scene_bank_miss_max_seconds gauge\n";
+      static const char* const missCtx[SCENE_CTX_COUNT]={"frame","loader","reader"};
+      for(int i=0;i<SCENE_CTX_COUNT;i++){
+        snprintf(line,sizeof(line),"scene_bank_miss_max_seconds{ctx=\"%s\"} %.6f\n",missCtx[i],bs.maxMissUs[i]/1e6); out+=line;}
+      snprintf(line,sizeof(line),"# TYPE scene_bank_loads_total counter\nscene_bank_loads_total %u\n",(unsigned)bs.loads); out+=line;
+      snprintf(line,sizeof(line),"# TYPE scene_bank_deferred_total counter\nscene_bank_deferred_total %u\n",(unsigned)bs.deferred); out+=line;
+      snprintf(line,sizeof(line),"# TYPE scene_bank_data_bytes gauge\nscene_bank_data_bytes %u\n",(unsigned)bs.dataBytes); out+=line;
+      snprintf(line,sizeof(line),"# TYPE scene_bank_live_bytes gauge\nscene_bank_live_bytes %u\n",(unsigned)bs.liveBytes); out+=line;
+      snprintf(line,sizeof(line),"# TYPE scene_bank_recompiles_total counter\nscene_bank_recompiles_total %u\n",(unsigned)bs.recompiles); out+=line;
+    }
+    JournalStats js; _mix->getJournalStats(js);
+    snprintf(line,sizeof(line),"# TYPE mixer_journal_appends_total counter\nmixer_journal_appends_total %u\n",(unsigned)js.appends); out+=line;
+    snprintf(line,sizeof(line),"# TYPE mixer_journal_checkpoints_total counter\nmixer_journal_checkpoints_total %u\n",(unsigned)js.checkpoints); out+=line;
+    snprintf(line,sizeof(line),"# TYPE mixer_journal_bytes gauge\nmixer_journal_bytes %u\n",(unsigned)js.journalBytes); out+=line;
+    snprintf(line,sizeof(line),"# TYPE mixer_journal_sync_max_seconds gauge\nmixer_journal_sync_max_seconds %.6f\n",js.maxSyncUs/1e6); out+=line;
+    out+="# TYPE mixer_stage_overruns_total counter\n";
+    _mix->lock(); OutputPipeline& st=_mix->getStages();
+    for(int i=0;i<st.count();i++){const StageSlot* s=st.get(i);
+      snprintf(line,sizeof(line),"mixer_stage_overruns_total{stage=\"%s\"} %lu\n",s->stage->name(),(unsigned long)s->overruns); out+=line;}
+    _mix->unlock();
+  }
+  req->send(200,"text/plain; version=0.0.4",out);
+}
+
+// GET /api/stages — izhodne stopnje lokalnega vira (vrstni red, vklop, budget, časi)
+static void apiGetStages(AsyncWebServerRequest* req) {
+  if(!_mix){req->send(500);return;}
+  JsonDocument doc; JsonArray arr=doc["stages"].to<JsonArray>();
+  _mix->lock(); OutputPipeline& st=_mix->getStages();
+  for(int i=0;i<st.count();i++){const StageSlot* s=st.get(i); JsonObject o=arr.add<JsonObject>();
+    o["name"]=s->stage->name(); o["order"]=s->order; o["enabled"]=s->enabled;
+    o["active"]=s->stage->isActive(); o["relevant"]=st.isRelevant(i);
+    o["budgetUs"]=s->budgetUs; o["lastUs"]=s->lastUs; o["maxUs"]=s->maxUs;
+    o["runs"]=s->runs; o["overruns"]=s->overruns;}
+  _mix->unlock();
+  String json; serializeJson(doc,json); req->send(200,"application/json",json);
+}
+
+// POST /api/stages — {"name":"lfo","enabled":false,"order":15,"budgetUs":500} ali {"action":"reset"}
+static void apiPostStages(AsyncWebServerRequest* req, uint8_t* data, size_t len, size_t index, size_t total) {
+  POST_ACCUM(data,len,index,total)
+  if(!_mix){req->send(500,"application/json","{\"ok\":false}");return;}
+  JsonDocument doc; if(deserializeJson(doc,_postBuf)){req->send(400,"application/json","{\"ok\":false}");return;}
+  bool ok=true;
+  _mix->lock(); OutputPipeline& st=_mix->getStages();
+  if(strcmp(doc["action"]|"","reset")==0) st.resetStats();
+  else{
+    int i=st.find(doc["name"]|""); ok=(i>=0);
+    if(ok&&doc["enabled"].is<bool>()) st.setEnabled(i,doc["enabled"].as<bool>());
+    if(ok&&doc["budgetUs"].is<uint32_t>()) st.setBudget(i,doc["budgetUs"].as<uint32_t>());
+    if(ok&&doc["order"].is<uint8_t>()) st.setOrder(i,doc["order"].as<uint8_t>());   // Zadnje: spremeni indekse
+  }
+  _mix->unlock();
+  req->send(200,"application/json",ok?"{\"ok\":true}":"{\"ok\":false}");
 }
 
 // GET /api/cfglist — seznam konfiguracij + storage info
@@ -716,6 +910,7 @@ static void apiCfgSave(AsyncWebServerRequest* req, uint8_t* data, size_t len, si
     if (fx->panMax < 255) o["panMax"]     = fx->panMax;
     if (fx->tiltMin > 0)  o["tiltMin"]    = fx->tiltMin;
     if (fx->tiltMax < 255)o["tiltMax"]     = fx->tiltMax;
+    if (fx->universe > 0) o["universe"]   = fx->universe;
   }
 
   // --- Groups ---
@@ -727,13 +922,17 @@ static void apiCfgSave(AsyncWebServerRequest* req, uint8_t* data, size_t len, si
 
   // --- Scenes (base64 DMX) ---
   JsonArray sArr = cfg["scenes"].to<JsonArray>();
+  Scene sc;
   for (int i = 0; i < MAX_SCENES; i++) {
-    const Scene* s = _scn->getScene(i);
-    if (!s || !s->valid) continue;
+    if (!_scn->sceneExists(i) || !_scn->readScene(i, sc)) continue;
     JsonObject o = sArr.add<JsonObject>();
     o["slot"] = i;
-    o["name"] = s->name;
-    o["dmx"] = dmxToBase64(s->dmx);
+    o["name"] = sc.name;
+    o["dmx"] = dmxToBase64(sc.dmx);
+    if (!(sc.flags & SCENE_FULL)) {
+      o["p"] = 1;
+      o["def"] = dmxToBase64((const uint8_t*)sc.defined, sizeof(sc.defined));   // Določeni kanali (tudi ničle)
+    }
   }
 
   // --- Sound config ---
@@ -872,7 +1071,7 @@ static void apiCfgLoad(AsyncWebServerRequest* req, uint8_t* data, size_t len, si
     int slot = 0;
     for (JsonObject o : pArr) {
       if (slot >= MAX_FIXTURES) break;
-      _fix->addFixture(o["name"]|"?", o["profileId"]|"", o["dmxAddress"]|1, o["groupMask"]|0, o["soundReactive"]|false);
+      _fix->addFixture(o["name"]|"?", o["profileId"]|"", o["dmxAddress"]|1, o["groupMask"]|0, o["soundReactive"]|false, o["universe"]|0);
       // Pan/Tilt omejitve
       PatchEntry* pe = _fix->getFixtureMut(slot);
       if (pe) {
@@ -921,7 +1120,9 @@ static void apiCfgLoad(AsyncWebServerRequest* req, uint8_t* data, size_t len, si
       uint8_t dmx[DMX_MAX_CHANNELS];
       memset(dmx, 0, sizeof(dmx));
       if (base64ToDmx(b64, dmx)) {
-        _scn->saveScene(slot, name, dmx);
+        uint32_t def[DMX_MAX_CHANNELS / 32];
+        bool hasDef = base64ToDmx(o["def"] | "", (uint8_t*)def, sizeof(def));
+        _scn->saveScene(slot, name, dmx, o["p"] | false, hasDef ? def : nullptr);
       }
     }
   }
@@ -1247,10 +1448,14 @@ static void apiLayoutDelete(AsyncWebServerRequest* req) {
 
 void webSetLfoEngine(LfoEngine* lfo) { _lfo = lfo; }
 void webSetShapeGenerator(ShapeGenerator* shapes) { _shapeGen = shapes; }
+void webSetPlaybackEngine(PlaybackEngine* playbacks) { _pbk = playbacks; }
+void webSetLaunchQueue(LaunchQueue* queue) { _lq = queue; }
 #if defined(CONFIG_IDF_TARGET_ESP32S3)
 void webSetPixelMapper(PixelMapper* px) { _pxMap = px; }
 #endif
 void webSetEspNow(EspNowDmx* espNow) { _espNow = espNow; }
+void webSetDmxOutput(DmxOutput* dmx) { _dmxOut = dmx; }
+void webSetFrameClock(FrameClock* clock) { _clock = clock; }
 
 void webBegin(AsyncWebServer* server, AsyncWebSocket* ws,
               NodeConfig* cfg, FixtureEngine* fixtures, MixerEngine* mixer,
@@ -1291,6 +1496,10 @@ void webBegin(AsyncWebServer* server, AsyncWebSocket* ws,
   server->on("/api/sound/rules",HTTP_POST,[](AsyncWebServerRequest* req){},NULL,apiPostSoundRules);
   server->on("/api/factory-reset",HTTP_POST,apiFactoryReset);
   server->on("/api/wifiscan",HTTP_GET,[](AsyncWebServerRequest* req){if(!checkAuth(req))return;apiWifiScan(req);});
+  server->on("/api/metrics",HTTP_GET,[](AsyncWebServerRequest* req){if(!checkAuth(req))return;apiGetMetrics(req);});
+  server->on("/api/metrics/reset",HTTP_POST,[](AsyncWebServerRequest* req){if(!checkAuth(req))return;metricsReset();req->send(200,"application/json","{\"ok\":true}");});
+  server->on("/api/stages",HTTP_GET,[](AsyncWebServerRequest* req){if(!checkAuth(req))return;apiGetStages(req);});
+  server->on("/api/stages",HTTP_POST,[](AsyncWebServerRequest* req){},NULL,apiPostStages);
 
   // Cue list API
   server->on("/api/cuelist",HTTP_GET,[](AsyncWebServerRequest* req){
@@ -1299,7 +1508,20 @@ void webBegin(AsyncWebServer* server, AsyncWebSocket* ws,
     for(int i=0;i<_scn->getCueCount();i++){
       const CueEntry* c=_scn->getCue(i);if(!c)continue;
       JsonObject o=arr.add<JsonObject>();
-      o["s"]=c->sceneSlot;o["f"]=c->fadeMs;o["a"]=c->autoFollowMs;o["l"]=c->label;
+      o["s"]=c->sceneSlot;o["f"]=c->fadeMs;o["a"]=c->autoFollowMs;o["l"]=c->label;o["c"]=c->curve;
+      SceneEngine::timingToJson(o,"t",c->timing);
+    }
+    String json;serializeJson(doc,json);req->send(200,"application/json",json);
+  });
+
+  // Playbacki (dodelitev scen in faderji; živi nivoji so v WS statusu)
+  server->on("/api/playbacks",HTTP_GET,[](AsyncWebServerRequest* req){
+    if(!_pbk){req->send(500);return;}
+    JsonDocument doc;JsonArray arr=doc["pb"].to<JsonArray>();
+    for(int i=0;i<MAX_PLAYBACKS;i++){
+      const Playback* p=_pbk->get(i);
+      JsonObject o=arr.add<JsonObject>();
+      o["s"]=p->sceneSlot;o["l"]=p->level;o["on"]=p->on;
     }
     String json;serializeJson(doc,json);req->send(200,"application/json",json);
   });
@@ -1324,7 +1546,7 @@ void webBegin(AsyncWebServer* server, AsyncWebSocket* ws,
     [](AsyncWebServerRequest* req) {
       bool ok = !Update.hasError();
       req->send(200, "application/json", ok ? "{\"ok\":true}" : "{\"ok\":false,\"error\":\"Update failed\"}");
-      if (ok) { delay(500); ESP.restart(); }
+      if (ok) { flushForRestart(); delay(500); ESP.restart(); }
     },
     [](AsyncWebServerRequest* req, const String& filename, size_t index, uint8_t* data, size_t len, bool final) {
       if (index == 0) {
@@ -1414,12 +1636,17 @@ void webLoop() {
   _lastWsSend=now; _forceSendState=false;
   if(_ws->count()==0)return;
 
+  // En konsistenten frame za ves status (brez mutexa, brez raztrganih vrednosti)
+  static DmxFrame frame;
+  _mix->readFrame(frame);
+
   JsonDocument doc;
-  doc["t"]="status"; doc["mode"]=(int)_mix->getMode(); doc["fps"]=_mix->getArtNetFps();
+  doc["t"]="status"; doc["mode"]=(int)_mix->getMode(); doc["src"]=_mix->getActiveSources(); doc["fps"]=_mix->getArtNetFps();
   doc["pkts"]=_mix->getArtNetPackets(); doc["master"]=_mix->getMasterDimmer(); doc["bo"]=_mix->isBlackout(); doc["flash"]=_mix->isFlashing();
   doc["heap"]=esp_get_free_heap_size();
   doc["iheap"]=heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
   doc["mspd"]=_mix->getMasterSpeed();
+  doc["tch"]=_mix->getTouchedCount();   // Ročno nastavljeni kanali (delna scena)
 
   // Group dimmers
   JsonArray gd=doc["gd"].to<JsonArray>();
@@ -1436,9 +1663,10 @@ void webLoop() {
 
   // Cue list status
   if(_scn){
-    _scn->cueUpdateAutoFollow(_mix);
     JsonObject cl=doc["cl"].to<JsonObject>();
     cl["cur"]=_scn->getCurrentCue();cl["cnt"]=_scn->getCueCount();cl["run"]=_scn->isCueRunning();
+    int32_t fol=_scn->cueFollowRemainingMs();
+    if(fol>=0) cl["fol"]=fol;
   }
 
   // LFO status
@@ -1454,6 +1682,20 @@ void webLoop() {
     }
   }
 
+  // Playback status: [nivo × ovojnica, flash] za dodeljene
+  if(_pbk){
+    JsonArray pa=doc["pb"].to<JsonArray>();
+    for(int i=0;i<MAX_PLAYBACKS;i++){
+      const Playback* p=_pbk->get(i);
+      if(p->sceneSlot<0){pa.add(nullptr);continue;}
+      JsonArray o=pa.add<JsonArray>();
+      o.add(_pbk->outputLevel(i));o.add(p->flash?1:0);
+    }
+  }
+
+  // Kvantizirani ukazi, ki čakajo na mejo
+  if(_lq && _lq->pendingCount()) doc["lq"]=_lq->pendingCount();
+
   // Shape status
   if(_shapeGen && _shapeGen->isActive()){
     JsonArray sa=doc["shapes"].to<JsonArray>();
@@ -1553,42 +1795,45 @@ void webLoop() {
     }
   }
 
-  // Undo
-  doc["undo"]=_mix->hasUndo();
+  // Undo/redo (globina za oznako gumba)
+  doc["undo"]=_mix->getUndoDepth();
+  doc["redo"]=_mix->getRedoDepth();
 
   // Snapshots
   JsonArray snaps=doc["snaps"].to<JsonArray>();
   for(int i=0;i<_mix->getSnapshotCount();i++){
-    const StateSnapshot* s=_mix->getSnapshot(i);
-    if(s&&s->valid){JsonObject o=snaps.add<JsonObject>();o["ts"]=s->timestamp;char src[2]={s->source,0};o["src"]=src;}
+    uint32_t ts;char src[2]={0,0};
+    if(_mix->getSnapshotInfo(i,ts,src[0])){JsonObject o=snaps.add<JsonObject>();o["ts"]=ts;o["src"]=src;}
   }
 
   // Fixture vrednosti za sinhronizacijo sliderjev
   // V ArtNet načinu prikaži dejanski ArtNet vhod, v lokalnem pa ročne vrednosti
-  const uint8_t* vals = (_mix->getMode() == CTRL_ARTNET) ? _mix->getDmxOutput() : _mix->getManualValues();
+  static UniverseValues inVals; inVals.reset(frame.data,false);
   JsonArray fxv=doc["fxv"].to<JsonArray>();
   for(int i=0;i<MAX_FIXTURES;i++){
     const PatchEntry* fx=_fix->getFixture(i);
     if(!fx||!fx->active){fxv.add(nullptr);continue;}
     JsonArray chv=fxv.add<JsonArray>();
     uint8_t chCount=_fix->fixtureChannelCount(i);
+    const uint8_t* uv=inVals.get(fx->universe);
     for(int c=0;c<chCount;c++){
       uint16_t addr=fx->dmxAddress+c-1;
-      chv.add(addr<DMX_MAX_CHANNELS?vals[addr]:0);
+      chv.add(uv&&addr<DMX_MAX_CHANNELS?uv[addr]:0);
     }
   }
 
   // Fixture output vrednosti za prikaz (dejanski DMX izhod z beatom, master/group dimmerji)
-  const uint8_t* outVals=_mix->getDmxOutput();
+  static UniverseValues outVals; outVals.reset(frame.data,true);
   JsonArray fxo=doc["fxo"].to<JsonArray>();
   for(int i=0;i<MAX_FIXTURES;i++){
     const PatchEntry* fx=_fix->getFixture(i);
     if(!fx||!fx->active){fxo.add(nullptr);continue;}
     JsonArray cho=fxo.add<JsonArray>();
     uint8_t chCount=_fix->fixtureChannelCount(i);
+    const uint8_t* uv=outVals.get(fx->universe);
     for(int c=0;c<chCount;c++){
       uint16_t addr=fx->dmxAddress+c-1;
-      cho.add(addr<DMX_MAX_CHANNELS?outVals[addr]:0);
+      cho.add(uv&&addr<DMX_MAX_CHANNELS?uv[addr]:0);
     }
   }
 
@@ -1596,7 +1841,7 @@ void webLoop() {
 
   // DMX Monitor — send raw 512 bytes as base64 (only when active)
   if (_dmxMonActive && _ws->count() > 0) {
-    String b64 = dmxToBase64(_mix->getDmxOutput());
+    String b64 = dmxToBase64(frame.data);
     _ws->textAll("{\"t\":\"dmx\",\"d\":\"" + b64 + "\"}");
   }
 }
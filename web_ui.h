@@ -10,18 +10,26 @@
 #include "audio_input.h"
 #include "lfo_engine.h"
 #include "shape_engine.h"
+#include "playback_engine.h"
+#include "launch_queue.h"
 #include "pixel_mapper.h"
 #include "espnow_dmx.h"
+#include "dmx_driver.h"
+#include "frame_clock.h"
 
 void webBegin(AsyncWebServer* server, AsyncWebSocket* ws,
               NodeConfig* cfg, FixtureEngine* fixtures, MixerEngine* mixer,
               SceneEngine* scenes, SoundEngine* sound, AudioInput* audio);
 void webSetLfoEngine(LfoEngine* lfo);
 void webSetShapeGenerator(ShapeGenerator* shapes);
+void webSetPlaybackEngine(PlaybackEngine* playbacks);
+void webSetLaunchQueue(LaunchQueue* queue);
 #if defined(CONFIG_IDF_TARGET_ESP32S3)
 void webSetPixelMapper(PixelMapper* px);
 #endif
 void webSetEspNow(EspNowDmx* espNow);
+void webSetDmxOutput(DmxOutput* dmx);
+void webSetFrameClock(FrameClock* clock);
 void webLoop();   // Periodično pošilja status prek WebSocket
 
 #endif